@@ -196,6 +196,42 @@ function TEST_import_after_split() {
     wait_for_clean || return 1
 }
 
+# start osd.0 with both halves of 1.0 still at the epoch before their
+# merge, loading pgs in line and in the background
+function TEST_load_pending_merge() {
+    local dir=$1
+
+    setup $dir || return 1
+    run_mon $dir a --osd_pool_default_size=1 || return 1
+    run_mgr $dir x || return 1
+    run_osd $dir 0 || return 1
+
+    ceph osd pool create foo 2 || return 1
+    wait_for_clean || return 1
+    rados -p foo bench 3 write -b 1024 --no-cleanup || return 1
+
+    kill_daemons $dir TERM osd.0 || return 1
+    ceph-objectstore-tool --data-path $dir/0 --op export --pgid 1.1 --file $dir/1.1  --force || return 1
+    ceph-objectstore-tool --data-path $dir/0 --op export --pgid 1.0 --file $dir/1.0  --force || return 1
+    activate_osd $dir 0 || return 1
+
+    ceph osd pool set foo pg_num 1
+    sleep 5
+    while ceph daemon osd.0 perf dump | jq '.osd.numpg' | grep 2 ; do sleep 1 ; done
+    wait_for_clean || return 1
+
+    for threads in 0 2 ; do
+        kill_daemons $dir TERM osd.0 || return 1
+        ceph-objectstore-tool --data-path $dir/0 --op remove --pgid 1.0 --force || return 1
+        ceph-objectstore-tool --data-path $dir/0 --op import --pgid 1.1 --file $dir/1.1 || return 1
+        ceph-objectstore-tool --data-path $dir/0 --op import --pgid 1.0 --file $dir/1.0 || return 1
+        activate_osd $dir 0 --osd_load_pgs_threads=$threads || return 1
+
+        wait_for_clean || return 1
+        ceph daemon osd.0 perf dump | jq '.osd.numpg' | grep -q '^1$' || return 1
+    done
+}
+
 
 main pg-split-merge "$@"
 
@@ -6,7 +6,16 @@
 
 class DummyAuthClientServer : public AuthClient,
 			      public AuthServer {
+  // secure mode needs a connection secret; any will do, as long as both
+  // ends agree on it
+  static std::string dummy_secret() {
+    return std::string(64, 's');
+  }
+
 public:
+  /// ask for, and agree to, secure mode instead of crc
+  bool secure = false;
+
   DummyAuthClientServer(CephContext *cct) : AuthServer(cct) {}
 
   // client
@@ -17,7 +26,7 @@ public:
     std::vector<uint32_t> *preferred_modes,
     bufferlist *out) override {
     *method = CEPH_AUTH_NONE;
-    *preferred_modes = { CEPH_CON_MODE_CRC };
+    *preferred_modes = { secure ? CEPH_CON_MODE_SECURE : CEPH_CON_MODE_CRC };
     return 0;
   }
 
@@ -37,6 +46,9 @@ public:
     const bufferlist& bl,
     CryptoKey *session_key,
     std::string *connection_secret) {
+    if (con_mode == CEPH_CON_MODE_SECURE) {
+      *connection_secret = dummy_secret();
+    }
     return 0;
   }
 
@@ -51,6 +63,18 @@ public:
   }
 
   // server
+  uint32_t pick_con_mode(
+    int peer_type,
+    uint32_t auth_method,
+    const std::vector<uint32_t>& preferred_modes) override {
+    // AUTH_NONE is otherwise only good for crc
+    if (secure && preferred_modes == std::vector<uint32_t>{
+	  CEPH_CON_MODE_SECURE }) {
+      return CEPH_CON_MODE_SECURE;
+    }
+    return AuthServer::pick_con_mode(peer_type, auth_method, preferred_modes);
+  }
+
   int handle_auth_request(
     Connection *con,
     AuthConnectionMeta *auth_meta,
@@ -58,6 +82,9 @@ public:
     uint32_t auth_method,
     const bufferlist& bl,
     bufferlist *reply) override {
+    if (auth_meta->is_mode_secure()) {
+      auth_meta->connection_secret = dummy_secret();
+    }
     return 1;
   }
 };
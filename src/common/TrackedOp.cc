@@ -22,6 +22,58 @@ static ostream& _prefix(std::ostream* _dout)
   return *_dout << "-- op tracker -- ";
 }
 
+namespace {
+// Event names of lightweight ops, interned so that marking an event
+// stores a 16 bit id rather than a copy of the string.  Only names that
+// live as long as the process are interned, so the table holds a fixed
+// set of them; should it still get 3/4 full, further names are stored
+// as text like the events built at runtime.
+class EventNames {
+  static constexpr unsigned SIZE = 4096;  // a power of two
+
+  std::atomic<const std::string*> names[SIZE] = {};
+  std::atomic<unsigned> num = {0};
+
+public:
+  /// the event's text is stored with the op instead
+  static constexpr uint16_t TEXT = 0xffff;
+
+  uint16_t get_id(std::string_view name) {
+    size_t h = std::hash<std::string_view>()(name);
+    for (unsigned i = 0; i < SIZE; ++i) {
+      unsigned slot = (h + i) & (SIZE - 1);
+      const std::string *p = names[slot].load(std::memory_order_acquire);
+      if (!p) {
+	if (num.load(std::memory_order_relaxed) >= SIZE / 4 * 3) {
+	  break;
+	}
+	auto n = new std::string(name);
+	if (names[slot].compare_exchange_strong(p, n)) {
+	  ++num;
+	  return slot + 1;
+	}
+	// lost the race; p is the winner
+	delete n;
+      }
+      if (*p == name) {
+	return slot + 1;
+      }
+    }
+    return TEXT;
+  }
+
+  std::string_view get_name(uint16_t id) const {
+    return *names[id - 1].load(std::memory_order_acquire);
+  }
+};
+
+EventNames& event_names()
+{
+  static EventNames names;
+  return names;
+}
+}
+
 void OpHistoryServiceThread::break_thread() {
   queue_spinlock.lock();
   _external_queue.clear();
@@ -40,7 +92,8 @@ void* OpHistoryServiceThread::entry() {
     }
     internal_queue.swap(_external_queue);
     queue_spinlock.unlock();
-    if (internal_queue.empty()) {
+    unsigned drained = _ophistory->_drain_rings(ceph_clock_now());
+    if (internal_queue.empty() && !drained) {
       usleep(sleep_time);
       if (sleep_time < 128000) {
         sleep_time <<= 2;
@@ -59,6 +112,18 @@ void* OpHistoryServiceThread::entry() {
 }
 
 
+OpHistory::~OpHistory()
+{
+  for (auto& ring : rings) {
+    ring->consume_all([](TrackedOp *op) {
+	op->put();
+      });
+  }
+  ceph_assert(arrived.empty());
+  ceph_assert(duration.empty());
+  ceph_assert(slow_op.empty());
+}
+
 void OpHistory::on_shutdown()
 {
   opsvc.break_thread();
@@ -68,6 +133,46 @@ void OpHistory::on_shutdown()
   duration.clear();
   slow_op.clear();
   shutdown = true;
+  for (auto& ring : rings) {
+    ring->consume_all([](TrackedOp *op) {
+	op->put();
+      });
+  }
+}
+
+void OpHistory::insert(const utime_t& now, TrackedOpRef op)
+{
+  if (shutdown)
+    return;
+
+  if (op->lightweight) {
+    auto& ring = rings[op->seq % rings.size()];
+    TrackedOp *p = op.detach();
+    if (ring->bounded_push(p)) {
+      if (shutdown) {
+	// raced with on_shutdown(), which may have drained the ring
+	// already
+	ring->consume_all([](TrackedOp *op) {
+	    op->put();
+	  });
+      }
+      return;
+    }
+    // the ring is full; take the slow path
+    op.reset(p, false);
+  }
+  opsvc.insert_op(now, op);
+}
+
+unsigned OpHistory::_drain_rings(const utime_t& now)
+{
+  unsigned n = 0;
+  for (auto& ring : rings) {
+    n += ring->consume_all([this, &now](TrackedOp *op) {
+	_insert_delayed(now, TrackedOpRef(op, false));
+      });
+  }
+  return n;
 }
 
 void OpHistory::_insert_delayed(const utime_t& now, TrackedOpRef op)
@@ -146,6 +251,7 @@ struct ShardedTrackingData {
 
 OpTracker::OpTracker(CephContext *cct_, bool tracking, uint32_t num_shards):
   seq(0),
+  history(num_shards),
   num_optracker_shards(num_shards),
   complaint_time(0), log_threshold(0),
   tracking_enabled(tracking),
@@ -434,12 +540,132 @@ void OpTracker::get_age_ms_histogram(pow2_hist_t *h)
 #undef dout_context
 #define dout_context tracker->cct
 
-void TrackedOp::mark_event(std::string_view event, utime_t stamp)
+void TrackedOp::_mark_light_event(std::string_view event, bool interned,
+				  utime_t stamp)
+{
+  uint32_t i = num_light_events++;
+  if (i >= OPTRACKER_PREALLOC_EVENTS) {
+    // out of room; the latest event replaces the previous latest
+    i = OPTRACKER_PREALLOC_EVENTS - 1;
+  }
+  uint64_t ns = stamp > initiated_at ? (stamp - initiated_at).to_nsec() : 0;
+  ns = std::min<uint64_t>(ns, (1ull << 48) - 1);
+  uint16_t id = interned ? event_names().get_id(event) : EventNames::TEXT;
+  if (id != EventNames::TEXT) {
+    light_events[i].store((ns << 16) | id, std::memory_order_release);
+    return;
+  }
+
+  std::string *texts = light_texts.load(std::memory_order_acquire);
+  if (!texts) {
+    auto n = new std::string[OPTRACKER_PREALLOC_EVENTS];
+    if (light_texts.compare_exchange_strong(texts, n)) {
+      texts = n;
+    } else {
+      delete[] n;
+    }
+  }
+  if (i < OPTRACKER_PREALLOC_EVENTS - 1) {
+    // the slot is ours alone; the text is in place before the event is
+    texts[i] = event;
+    light_events[i].store((ns << 16) | id, std::memory_order_release);
+  } else {
+    std::lock_guard l(lock);
+    texts[i] = event;
+    light_events[i].store((ns << 16) | id, std::memory_order_release);
+  }
+}
+
+bool TrackedOp::_get_light_event(uint32_t i, utime_t *stamp,
+				 std::string_view *event,
+				 std::string *text) const
+{
+  uint64_t v = light_events[i].load(std::memory_order_acquire);
+  if (!v) {
+    return false;
+  }
+  if ((v & 0xffff) == EventNames::TEXT &&
+      i == OPTRACKER_PREALLOC_EVENTS - 1) {
+    // the last slot's text may be replaced at any time
+    std::lock_guard l(lock);
+    v = light_events[i].load(std::memory_order_acquire);
+    if ((v & 0xffff) == EventNames::TEXT) {
+      *text = light_texts.load(std::memory_order_acquire)[i];
+      *event = *text;
+    } else {
+      *event = event_names().get_name(v & 0xffff);
+    }
+  } else if ((v & 0xffff) == EventNames::TEXT) {
+    *event = light_texts.load(std::memory_order_acquire)[i];
+  } else {
+    *event = event_names().get_name(v & 0xffff);
+  }
+  uint64_t ns = v >> 16;
+  *stamp = initiated_at;
+  *stamp += utime_t(ns / 1000000000ull, ns % 1000000000ull);
+  return true;
+}
+
+bool TrackedOp::_get_last_light_event(utime_t *stamp,
+				      std::string_view *event,
+				      std::string *text) const
+{
+  uint32_t n = std::min<uint32_t>(num_light_events,
+				  OPTRACKER_PREALLOC_EVENTS);
+  while (n > 0) {
+    if (_get_light_event(--n, stamp, event, text)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+double TrackedOp::get_duration() const
+{
+  if (lightweight) {
+    utime_t stamp;
+    std::string_view event;
+    std::string text;
+    if (_get_last_light_event(&stamp, &event, &text) && event == "done")
+      return stamp - get_initiated();
+    return ceph_clock_now() - get_initiated();
+  }
+  std::lock_guard l(lock);
+  if (!events.empty() && events.rbegin()->compare("done") == 0)
+    return events.rbegin()->stamp - get_initiated();
+  else
+    return ceph_clock_now() - get_initiated();
+}
+
+std::string_view TrackedOp::state_string() const
+{
+  if (lightweight) {
+    utime_t stamp;
+    std::string_view event;
+    std::string text;
+    if (!_get_last_light_event(&stamp, &event, &text) ||
+	event.data() != text.data()) {
+      return event;
+    }
+    // copied out of the last slot; keep it with the op, as the events
+    // of an op that is not lightweight are
+    std::lock_guard l(lock);
+    light_state = std::move(text);
+    return light_state;
+  }
+  std::lock_guard l(lock);
+  return events.empty() ? std::string_view() : std::string_view(events.rbegin()->str);
+}
+
+void TrackedOp::_mark_event(std::string_view event, bool interned,
+			     utime_t stamp)
 {
   if (!state)
     return;
 
-  {
+  if (lightweight) {
+    _mark_light_event(event, interned, stamp);
+  } else {
     std::lock_guard l(lock);
     events.emplace_back(stamp, event);
   }
@@ -466,3 +692,32 @@ void TrackedOp::dump(utime_t now, Formatter *f) const
     f->close_section();
   }
 }
+
+void TrackedOp::dump_events(Formatter *f) const
+{
+  f->open_array_section("events");
+  if (lightweight) {
+    uint32_t num = num_light_events;
+    uint32_t n = std::min<uint32_t>(num, OPTRACKER_PREALLOC_EVENTS);
+    utime_t stamp;
+    std::string_view event;
+    std::string text;
+    for (uint32_t i = 0; i < n; ++i) {
+      if (i == OPTRACKER_PREALLOC_EVENTS - 1 &&
+	  num > OPTRACKER_PREALLOC_EVENTS) {
+	// only the latest of the events past the others is kept
+	f->dump_object("event", Event(stamp, "truncated " +
+				      std::to_string(num - n) + " events"));
+      }
+      if (_get_light_event(i, &stamp, &event, &text)) {
+	f->dump_object("event", Event(stamp, event));
+      }
+    }
+  } else {
+    std::lock_guard l(lock);
+    for (auto& i : events) {
+      f->dump_object("event", i);
+    }
+  }
+  f->close_section();
+}
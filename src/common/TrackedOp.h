@@ -15,6 +15,7 @@
 #define TRACKEDREQUEST_H_
 
 #include <atomic>
+#include <boost/lockfree/queue.hpp>
 #include "common/histogram.h"
 #include "common/RWLock.h"
 #include "common/Thread.h"
@@ -24,6 +25,7 @@
 #include "msg/Message.h"
 
 #define OPTRACKER_PREALLOC_EVENTS 20
+#define OPTRACKER_HISTORY_RING_SIZE 1024
 
 class TrackedOp;
 class OpHistory;
@@ -64,30 +66,28 @@ class OpHistory {
   uint32_t history_slow_op_size;
   uint32_t history_slow_op_threshold;
   std::atomic_bool shutdown;
+  /// per-shard queues of finished lightweight ops, drained by opsvc
+  std::vector<std::unique_ptr<boost::lockfree::queue<TrackedOp*>>> rings;
   OpHistoryServiceThread opsvc;
   friend class OpHistoryServiceThread;
 
 public:
-  OpHistory()
+  explicit OpHistory(uint32_t num_shards = 1)
     : history_size(0), history_duration(0),
       history_slow_op_size(0), history_slow_op_threshold(0),
       shutdown(false), opsvc(this) {
+    for (uint32_t i = 0; i < std::max<uint32_t>(num_shards, 1); ++i) {
+      rings.emplace_back(
+	new boost::lockfree::queue<TrackedOp*>(OPTRACKER_HISTORY_RING_SIZE));
+    }
     opsvc.create("OpHistorySvc");
   }
-  ~OpHistory() {
-    ceph_assert(arrived.empty());
-    ceph_assert(duration.empty());
-    ceph_assert(slow_op.empty());
-  }
-  void insert(const utime_t& now, TrackedOpRef op)
-  {
-    if (shutdown)
-      return;
-
-    opsvc.insert_op(now, op);
-  }
+  ~OpHistory();
+  void insert(const utime_t& now, TrackedOpRef op);
 
   void _insert_delayed(const utime_t& now, TrackedOpRef op);
+  /// move finished ops from the rings into the history
+  unsigned _drain_rings(const utime_t& now);
   void dump_ops(utime_t now, ceph::Formatter *f, std::set<std::string> filters = {""}, bool by_duration=false);
   void dump_slow_ops(utime_t now, ceph::Formatter *f, std::set<std::string> filters = {""});
   void on_shutdown();
@@ -111,6 +111,7 @@ class OpTracker {
   float complaint_time;
   int log_threshold;
   std::atomic<bool> tracking_enabled;
+  std::atomic<bool> lightweight = {false};
   RWLock       lock;
 
 public:
@@ -133,6 +134,17 @@ public:
   void set_tracking(bool enable) {
     tracking_enabled = enable;
   }
+  /**
+   * ops created from now on record events as interned ids in a
+   * preallocated array, without locking or copying the event string,
+   * and are passed to the history through lock-free per-shard rings
+   */
+  void set_lightweight(bool enable) {
+    lightweight = enable;
+  }
+  bool is_lightweight() const {
+    return lightweight;
+  }
   bool dump_ops_in_flight(ceph::Formatter *f, bool print_only_blocked = false, std::set<std::string> filters = {""});
   bool dump_historic_ops(ceph::Formatter *f, bool by_duration = false, std::set<std::string> filters = {""});
   bool dump_historic_slow_ops(ceph::Formatter *f, std::set<std::string> filters = {""});
@@ -254,6 +266,18 @@ protected:
 
   std::vector<Event> events;    ///< std::list of events and their times
   mutable ceph::mutex lock = ceph::make_mutex("TrackedOp::lock"); ///< to protect the events list
+
+  /// the events of a lightweight op: nanoseconds since initiated_at in
+  /// the upper 48 bits and the interned event name in the lower 16, in
+  /// one word so that racing writers of the last slot cannot tear it.
+  /// 0 until the event is marked.
+  const bool lightweight;  ///< events go to light_events, not events
+  std::unique_ptr<std::atomic<uint64_t>[]> light_events;
+  std::atomic<uint32_t> num_light_events = {0};
+  /// the text of light_events built at runtime, by slot; allocated with
+  /// the first such event.  The last slot's text is protected by lock.
+  std::atomic<std::string*> light_texts = {nullptr};
+  mutable std::string light_state;  ///< protected by lock
   uint64_t seq = 0;        ///< a unique value std::set by the OpTracker
 
   uint32_t warn_interval_multiplier = 1; //< limits output of a given op warning
@@ -271,11 +295,20 @@ protected:
 
   TrackedOp(OpTracker *_tracker, const utime_t& initiated) :
     tracker(_tracker),
-    initiated_at(initiated)
+    initiated_at(initiated),
+    lightweight(_tracker && _tracker->is_lightweight())
   {
-    events.reserve(OPTRACKER_PREALLOC_EVENTS);
+    if (lightweight) {
+      light_events.reset(
+	new std::atomic<uint64_t>[OPTRACKER_PREALLOC_EVENTS]());
+    } else {
+      events.reserve(OPTRACKER_PREALLOC_EVENTS);
+    }
   }
 
+  /// dump the events array; use in _dump()
+  void dump_events(ceph::Formatter *f) const;
+
   /// output any type-specific data you want to get when dump() is called
   virtual void _dump(ceph::Formatter *f) const {}
   /// if you want something else to happen when events are marked, implement
@@ -293,7 +326,9 @@ public:
   ZTracer::Trace store_trace;
   ZTracer::Trace journal_trace;
 
-  virtual ~TrackedOp() {}
+  virtual ~TrackedOp() {
+    delete[] light_texts.load();
+  }
 
   void get() {
     ++nref;
@@ -352,35 +387,51 @@ public:
   void reset_desc() {
     want_new_desc = true;
   }
+private:
+  void _mark_event(std::string_view event, bool interned, utime_t stamp);
+  void _mark_light_event(std::string_view event, bool interned,
+			 utime_t stamp);
+  /// the stamp and name of light_events slot i; false if not marked yet.
+  /// *text holds the name if it has to be copied out.
+  bool _get_light_event(uint32_t i, utime_t *stamp, std::string_view *event,
+			std::string *text) const;
+  /// the latest event of a lightweight op; false if there is none
+  bool _get_last_light_event(utime_t *stamp, std::string_view *event,
+			     std::string *text) const;
+public:
 
   const utime_t& get_initiated() const {
     return initiated_at;
   }
 
-  double get_duration() const {
-    std::lock_guard l(lock);
-    if (!events.empty() && events.rbegin()->compare("done") == 0)
-      return events.rbegin()->stamp - get_initiated();
-    else
-      return ceph_clock_now() - get_initiated();
-  }
+  double get_duration() const;
 
-  void mark_event(std::string_view event, utime_t stamp=ceph_clock_now());
+  /// mark an event whose name lives as long as the process, such as a
+  /// string literal; lightweight ops record it by an interned id
+  void mark_event(const char *event, utime_t stamp=ceph_clock_now()) {
+    _mark_event(event, true, stamp);
+  }
+  /// mark an event whose text is built at runtime; lightweight ops keep
+  /// a copy of it
+  void mark_event(std::string_view event, utime_t stamp=ceph_clock_now()) {
+    _mark_event(event, false, stamp);
+  }
 
   void mark_nowarn() {
     warn_interval_multiplier = 0;
   }
 
-  virtual std::string_view state_string() const {
-    std::lock_guard l(lock);
-    return events.empty() ? std::string_view() : std::string_view(events.rbegin()->str);
-  }
+  virtual std::string_view state_string() const;
 
   void dump(utime_t now, ceph::Formatter *f) const;
 
   void tracking_start() {
     if (tracker->register_inflight_op(this)) {
-      events.emplace_back(initiated_at, "initiated");
+      if (lightweight) {
+	_mark_light_event("initiated", true, initiated_at);
+      } else {
+	events.emplace_back(initiated_at, "initiated");
+      }
       state = STATE_LIVE;
     }
   }
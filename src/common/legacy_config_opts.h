@@ -636,6 +636,7 @@ OPTION(osd_op_queue_mclock_peering_event_lim, OPT_DOUBLE)
 OPTION(osd_op_queue_mclock_anticipation_timeout, OPT_DOUBLE)
 
 OPTION(osd_ignore_stale_divergent_priors, OPT_BOOL) // do not assert on divergent_prior entries which aren't in the log and whose on-disk objects are newer
+OPTION(osd_load_pgs_threads, OPT_U32)
 
 // Set to true for testing.  Users should NOT set this.
 // If set to true even after reading enough shards to
@@ -649,6 +650,9 @@ OPTION(osd_debug_feed_pullee, OPT_INT)
 
 OPTION(osd_backfill_scan_min, OPT_INT)
 OPTION(osd_backfill_scan_max, OPT_INT)
+OPTION(osd_backfill_scan_readahead, OPT_U32)  // scan windows requested ahead per backfill target
+OPTION(osd_backfill_batch_objects, OPT_U64)  // small objects per backfill op
+OPTION(osd_backfill_batch_object_size, OPT_U64)  // max size of a batched backfill object
 OPTION(osd_op_thread_timeout, OPT_INT)
 OPTION(osd_op_thread_suicide_timeout, OPT_INT)
 OPTION(osd_recovery_sleep, OPT_FLOAT)         // seconds to sleep between recovery ops
@@ -666,9 +670,14 @@ OPTION(osd_heartbeat_grace, OPT_INT)
 OPTION(osd_heartbeat_min_peers, OPT_INT)     // minimum number of peers
 OPTION(osd_heartbeat_use_min_delay_socket, OPT_BOOL) // prio the heartbeat tcp socket and set dscp as CS6 on it if true
 OPTION(osd_heartbeat_min_size, OPT_INT) // the minimum size of OSD heartbeat messages to send
+OPTION(osd_heartbeat_fast_interval, OPT_DOUBLE) // (seconds) ping interval in fast mode, 0 = off
+OPTION(osd_heartbeat_fast_grace, OPT_DOUBLE) // (seconds) minimum grace in fast mode
+OPTION(osd_heartbeat_fast_grace_rtt_multiple, OPT_DOUBLE) // grace in fast mode, in p99 ping rtts
 
 // max number of parallel snap trims/pg
 OPTION(osd_pg_max_concurrent_snap_trims, OPT_U64)
+OPTION(osd_snap_trim_batch_objects, OPT_U32) // clones trimmed per op in bulk mode
+OPTION(osd_snap_trim_batch_bytes_per_sec, OPT_U64) // pace bulk snap trim by bytes freed
 // max number of trimming pgs
 OPTION(osd_max_trimming_pgs, OPT_U64)
 
@@ -709,11 +718,18 @@ OPTION(osd_scrub_backoff_ratio, OPT_DOUBLE)   // the probability to back off the
 OPTION(osd_scrub_chunk_min, OPT_INT)
 OPTION(osd_scrub_chunk_max, OPT_INT)
 OPTION(osd_scrub_sleep, OPT_FLOAT)   // sleep between [deep]scrub ops
+OPTION(osd_scrub_idle_window, OPT_FLOAT)   // start scrub chunks only after this long without client ops
+OPTION(osd_scrub_idle_max_queued_ops, OPT_U32)   // client ops allowed in the op queue while scrubbing
+OPTION(osd_scrub_idle_max_device_util, OPT_FLOAT)   // device busy fraction above which scrub holds back
+OPTION(osd_scrub_idle_backoff, OPT_FLOAT)   // wait before re-checking for an idle window
+OPTION(osd_scrub_idle_max_wait, OPT_FLOAT)   // longest a scrub is held back in a row
 OPTION(osd_scrub_auto_repair, OPT_BOOL)   // whether auto-repair inconsistencies upon deep-scrubbing
 OPTION(osd_scrub_auto_repair_num_errors, OPT_U32)   // only auto-repair when number of errors is below this threshold
 OPTION(osd_deep_scrub_interval, OPT_FLOAT) // once a week
 OPTION(osd_deep_scrub_randomize_ratio, OPT_FLOAT) // scrubs will randomly become deep scrubs at this rate (0.15 -> 15% of scrubs are deep)
 OPTION(osd_deep_scrub_stride, OPT_INT)
+OPTION(osd_deep_scrub_incremental, OPT_BOOL) // skip data of objects unchanged since the last clean deep scrub
+OPTION(osd_deep_scrub_reread_ratio, OPT_FLOAT) // fraction of unchanged objects read anyway
 OPTION(osd_deep_scrub_keys, OPT_INT)
 OPTION(osd_deep_scrub_update_digest_min_age, OPT_INT)   // objects must be this old (seconds) before we update the whole-object digest on scrub
 OPTION(osd_skip_data_digest, OPT_BOOL)
@@ -739,6 +755,8 @@ OPTION(osd_object_clean_region_max_num_intervals, OPT_INT) // number of interval
 OPTION(osd_force_recovery_pg_log_entries_factor, OPT_FLOAT) // max entries factor before force recovery
 OPTION(osd_pg_log_trim_min, OPT_U32)
 OPTION(osd_pg_log_trim_max, OPT_U32)
+OPTION(osd_pg_log_chunk_entries, OPT_U32) // fold this many consecutive pg log entries into one omap value
+OPTION(osd_pg_log_spill_entries, OPT_U32) // keep this many trimmed pg log entries on disk
 OPTION(osd_op_complaint_time, OPT_FLOAT) // how many seconds old makes an op complaint-worthy
 OPTION(osd_command_max_records, OPT_INT)
 OPTION(osd_max_pg_blocked_by, OPT_U32)    // max peer osds to report that are blocking our progress
@@ -767,6 +785,7 @@ OPTION(osd_debug_deep_scrub_sleep, OPT_FLOAT)
 OPTION(osd_debug_no_acting_change, OPT_BOOL)
 OPTION(osd_enable_op_tracker, OPT_BOOL) // enable/disable OSD op tracking
 OPTION(osd_num_op_tracker_shard, OPT_U32) // The number of shards for holding the ops
+OPTION(osd_op_tracker_lightweight, OPT_BOOL)
 OPTION(osd_op_history_size, OPT_U32)    // Max number of completed ops to track
 OPTION(osd_op_history_duration, OPT_U32) // Oldest completed op to track
 OPTION(osd_op_history_slow_op_size, OPT_U32)           // Max number of slow ops to track
@@ -956,6 +956,12 @@ std::vector<Option> get_global_options() {
     .set_default(100_M)
     .set_description("Limit messages that are read off the network but still being processed"),
 
+    Option("ms_dispatch_throttle_bytes_per_connection", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Limit how much of ms_dispatch_throttle_bytes messages from one connection may hold (0 for no limit)")
+    .set_long_description("A connection over its share stops reading until its messages are processed, while other connections keep going. Without it, a single peer sending faster than its messages are processed can fill the throttler and stall every connection.")
+    .add_see_also("ms_dispatch_throttle_bytes"),
+
     Option("ms_msgr2_sign_messages", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description("Sign msgr2 frames' payload")
@@ -1066,6 +1072,10 @@ std::vector<Option> get_global_options() {
     .set_default(0)
     .set_description("Inject various internal delays to induce races (seconds)"),
 
+    Option("ms_inject_msgr2_features_off", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(0)
+    .set_description("msgr2 feature bits not to advertise to peers"),
+
     Option("ms_dump_on_send", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description("Hexdump message to debug log on message send"),
@@ -1084,6 +1094,73 @@ std::vector<Option> get_global_options() {
     .set_description("Maximum threadpool size of AsyncMessenger")
     .add_see_also("ms_async_op_threads"),
 
+    Option("ms_async_lockless_send", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Queue outgoing msgr2 messages without taking the connection's write lock")
+    .set_long_description("Threads sending on a connection push messages onto a lock-free queue, and only the first message of a batch wakes the connection's event thread, which moves the batch into the send queue. This cuts lock contention when many threads reply through the same connection, as OSD shard threads do."),
+
+    Option("ms_async_busy_poll_us", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("How long a messenger worker keeps polling without blocking after doing some work (0 to disable)")
+    .set_long_description("While polling, a worker checks its sockets, external events and pollers in a loop instead of sleeping in epoll_wait, and threads queueing work for it do not need to wake it up. This trades CPU for latency. The polling window adapts: it doubles while polling keeps finding work and halves each time it runs out idle, so a worker with little traffic goes back to blocking."),
+
+    Option("ms_async_stripe_connections", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_description("Number of connections the data of a large msgr2 message is striped over")
+    .set_long_description("With a value above 1, a connection opens that many minus one extra connections (stripe lanes) to the same peer, each handled by its own messenger worker. Messages with at least ms_async_stripe_min_size bytes of data send one stripe with the message and the others over the lanes, and the peer reassembles the data before dispatching the message, so message ordering is unchanged. Only used when the peer supports it. This also caps how many stripes a peer may split a message into, so set it to the same value on both sides.")
+    .add_see_also("ms_async_stripe_min_size"),
+
+    Option("ms_async_stripe_min_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_M)
+    .set_description("Smallest message data size striped over stripe lanes")
+    .add_see_also("ms_async_stripe_connections"),
+
+    Option("ms_async_stripe_timeout", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(30.0)
+    .set_description("Seconds a connection waits for the stripes of a message before faulting")
+    .set_long_description("The fault is handled like any other connection failure, so the message is resent or the sender is told about the reset.")
+    .add_see_also("ms_async_stripe_connections"),
+
+    Option("ms_async_compress_mode", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("none")
+    .set_enum_allowed({"none", "force"})
+    .set_description("Whether msgr2 connections compress the messages they send")
+    .set_long_description("With force, the front and data of a message are compressed separately with ms_async_compress_algorithm when they are at least ms_async_compress_min_size bytes, provided the peer supports on-wire compression and the messenger policy for its type allows it. A segment that does not shrink is sent as is. Connections in secure mode only compress with ms_async_compress_secure, and then compress before encrypting. The receiving side always decompresses, whatever its own setting.")
+    .add_see_also({"ms_async_compress_algorithm", "ms_async_compress_min_size", "ms_async_compress_secure"}),
+
+    Option("ms_async_compress_algorithm", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("snappy")
+    .set_enum_allowed({"snappy", "zlib", "zstd", "lz4"})
+    .set_description("Compressor plugin used for msgr2 on-wire compression")
+    .add_see_also("ms_async_compress_mode"),
+
+    Option("ms_async_compress_min_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(4_K)
+    .set_description("Smallest message front or data size compressed on the wire")
+    .add_see_also("ms_async_compress_mode"),
+
+    Option("ms_async_compress_secure", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Also compress messages on msgr2 connections in secure mode")
+    .set_long_description("Compressing before encrypting leaks how well the plaintext compresses through the size of the frames. An attacker who can get data of their choosing sent along with a secret can use that to recover the secret (as in the CRIME and BREACH attacks on TLS). Only enable this if that is not a concern for the traffic involved.")
+    .add_see_also("ms_async_compress_mode"),
+
+    Option("ms_async_decompress_max_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(128_M)
+    .set_description("Largest size a compressed message may decompress to")
+    .set_long_description("A connection receiving a compressed message that claims to decompress to more than this faults instead of decompressing it.")
+    .add_see_also("ms_async_compress_mode"),
+
+    Option("ms_async_zerocopy_min_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Send buffers at least this large with MSG_ZEROCOPY (0 to disable)")
+    .set_long_description("Only used by the posix stack on Linux 4.14 and later. The kernel sends such buffers straight from their pages instead of copying them into the socket, and the messenger holds the buffers until the kernel reports that it is done with them. Zero copy only pays off for large buffers (tens of KB and up), and a connection stops using it once the kernel reports that it copied anyway, as on loopback."),
+
+    Option("ms_async_rx_buffer_pool_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Idle memory each messenger worker keeps for receiving message data (0 to disable)")
+    .set_long_description("Message data is read into page aligned buffers whose size is rounded up to a power of two, up to 4MB. When the last reference to such a buffer is dropped, it goes back to the pool of the worker that read it instead of to the allocator, as long as the pool holds less than this much memory."),
+
     Option("ms_async_rdma_device_name", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("")
     .set_description(""),
@@ -1112,6 +1189,27 @@ std::vector<Option> get_global_options() {
     .set_default(true)
     .set_description(""),
 
+    Option("ms_async_rdma_zero_copy_rx_buffers", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Number of RDMA receive buffers received messages may hold on to")
+    .set_long_description("Message data is handed to the messenger in the "
+                          "registered buffers it was received into, instead "
+                          "of being copied out of them, as long as fewer "
+                          "than this many receive buffers are held by "
+                          "received messages. 0 disables zero copy receive. "
+                          "The limit is lowered if needed so that the "
+                          "receive queue can always be refilled within "
+                          "ms_async_rdma_receive_buffers.")
+    .add_see_also("ms_async_rdma_receive_buffers"),
+
+    Option("ms_async_rdma_worker_rx_cq", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Give each messenger worker its own RDMA receive completion queue")
+    .set_long_description("Receive completions are then polled by the "
+                          "worker that owns the connection, in its event "
+                          "loop, instead of all going through the single "
+                          "RDMA polling thread."),
+
     Option("ms_async_rdma_port_num", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description(""),
@@ -2280,6 +2378,20 @@ std::vector<Option> get_global_options() {
     .set_description("Maximum number of PGs we can attempt to unmap or upmap "
                      "for a specific overfull or underfull osd per iteration "),
 
+    Option("osd_calc_pg_upmaps_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Number of threads used to map PGs and score candidate "
+                     "remappings while calculating PG upmaps"),
+
+    Option("osd_calc_pg_upmaps_seed", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Seed for the PG shuffling done while calculating PG "
+                     "upmaps aggressively; 0 picks a random seed")
+    .add_see_also("osd_calc_pg_upmaps_aggressively"),
+
     Option("osd_numa_prefer_iface", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_flag(Option::FLAG_STARTUP)
@@ -2589,6 +2701,48 @@ std::vector<Option> get_global_options() {
     .set_default(5_M)
     .set_description(""),
 
+    Option("osd_hot_object_cache_path", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("")
+    .set_description("File or block device holding the OSD's hot object cache; empty disables it")
+    .set_long_description("When set, the OSD keeps copies of frequently read objects of replicated pools in this file (typically on a faster device than the OSD's data), and serves whole or partial reads of those objects from it.  Objects are promoted once they have been read in osd_hot_object_cache_min_read_recency of the last osd_hot_object_cache_hit_set_count hit sets.  The cache is written sequentially as a ring and is discarded when the OSD restarts.")
+    .add_see_also("osd_hot_object_cache_size")
+    .add_see_also("osd_hot_object_cache_min_read_recency"),
+
+    Option("osd_hot_object_cache_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(10_G)
+    .set_description("Size of the hot object cache file")
+    .add_see_also("osd_hot_object_cache_path"),
+
+    Option("osd_hot_object_cache_max_object_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(4_M)
+    .set_description("Largest object the hot object cache will hold")
+    .add_see_also("osd_hot_object_cache_path"),
+
+    Option("osd_hot_object_cache_min_read_recency", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(2)
+    .set_min(1)
+    .set_description("Number of recent hit sets an object must have been read in to be promoted into the hot object cache")
+    .add_see_also("osd_hot_object_cache_path"),
+
+    Option("osd_hot_object_cache_hit_set_count", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_description("Number of bloom filter hit sets the hot object cache keeps")
+    .add_see_also("osd_hot_object_cache_path"),
+
+    Option("osd_hot_object_cache_hit_set_period", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(10)
+    .set_min(.001)
+    .set_description("Seconds of reads each hot object cache hit set covers")
+    .add_see_also("osd_hot_object_cache_path"),
+
+    Option("osd_hot_object_cache_shards", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_min(1)
+    .set_description("Number of independently locked regions the hot object cache is split into")
+    .set_long_description("Each object maps to one region, which has its own hit sets and is written as its own ring.  More regions reduce contention between reads and promotions, but limit the largest object held to the size of a region.")
+    .add_see_also("osd_hot_object_cache_path"),
+
     Option("osd_tier_default_cache_mode", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("writeback")
     .set_enum_allowed({"none", "writeback", "forward",
@@ -3197,6 +3351,11 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("osd_load_pgs_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Threads reading PG state and logs in the background at startup")
+    .set_long_description("When greater than 0, OSD startup only reads each PG's map epoch from its pgmeta object before moving on, and this many threads read the PGs' info, past intervals, logs and missing sets while the OSD boots.  Ops and peering messages for a PG wait until that PG is loaded.  0 reads every PG in turn before continuing."),
+
     Option("osd_read_ec_check_for_errors", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description(""),
@@ -3218,6 +3377,24 @@ std::vector<Option> get_global_options() {
     .set_default(512)
     .set_description(""),
 
+    Option("osd_backfill_scan_readahead", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(2)
+    .set_description("Number of scan windows to request ahead from each backfill target")
+    .set_long_description("While the primary pushes the objects of the current backfill scan window, it asks backfill targets for up to this many following windows so that it does not stop to wait for a scan.  0 disables read-ahead.")
+    .add_see_also("osd_backfill_scan_max"),
+
+    Option("osd_backfill_batch_objects", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(64)
+    .set_min(1)
+    .set_description("Number of small objects backfilled together as a single recovery op")
+    .set_long_description("Objects no larger than osd_backfill_batch_object_size are backfilled in batches of up to this many objects.  A batch counts as one op against osd_recovery_max_active and its pushes share MOSDPGPush messages.  1 disables batching.")
+    .add_see_also("osd_backfill_batch_object_size"),
+
+    Option("osd_backfill_batch_object_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_description("Objects up to this size are backfilled in batches")
+    .add_see_also("osd_backfill_batch_objects"),
+
     Option("osd_op_thread_timeout", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(15)
     .set_description(""),
@@ -3281,10 +3458,43 @@ std::vector<Option> get_global_options() {
     .set_default(2000)
     .set_description("Minimum heartbeat packet size in bytes. Will add dummy payload if heartbeat packet is smaller than this."),
 
+    Option("osd_heartbeat_fast_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_min(0)
+    .set_description("Interval (in seconds) between peer pings in fast heartbeat mode; 0 disables it")
+    .set_long_description("When set, peers are pinged at this interval with unpadded pings (a padded osd_heartbeat_min_size ping still goes out every osd_heartbeat_interval), each peer's ping round trip times are tracked, and a peer is reported failed once a ping has gone unanswered for osd_heartbeat_fast_grace_rtt_multiple times its 99th percentile round trip time, but at least osd_heartbeat_fast_grace and at most osd_heartbeat_grace.  Failures are reported to the monitors right away, flagged so that they do not wait out osd_heartbeat_grace again.")
+    .add_see_also("osd_heartbeat_fast_grace")
+    .add_see_also("osd_heartbeat_fast_grace_rtt_multiple"),
+
+    Option("osd_heartbeat_fast_grace", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.5)
+    .set_min(0)
+    .set_description("Minimum time (in seconds) a peer may leave a ping unanswered in fast heartbeat mode")
+    .add_see_also("osd_heartbeat_fast_interval"),
+
+    Option("osd_heartbeat_fast_grace_rtt_multiple", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(20)
+    .set_min(1)
+    .set_description("Multiple of a peer's 99th percentile ping round trip time it may leave a ping unanswered in fast heartbeat mode")
+    .add_see_also("osd_heartbeat_fast_interval"),
+
     Option("osd_pg_max_concurrent_snap_trims", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(2)
     .set_description(""),
 
+    Option("osd_snap_trim_batch_objects", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Trim up to this many clones of a PG as a single op")
+    .set_long_description("When greater than 1, the snap trimmer takes batches of this many clones from the snap mapper and removes them, and updates their heads' SnapSets, in one transaction instead of one op per clone.  0 or 1 trims osd_pg_max_concurrent_snap_trims clones at a time, each in its own op.")
+    .add_see_also("osd_snap_trim_batch_bytes_per_sec")
+    .add_see_also("osd_pg_max_concurrent_snap_trims"),
+
+    Option("osd_snap_trim_batch_bytes_per_sec", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_M)
+    .set_description("Limit the rate at which each PG frees clone data when trimming in batches")
+    .set_long_description("After each batch the snap trimmer sleeps in proportion to the bytes the batch freed, in addition to osd_snap_trim_sleep.  0 disables the limit.")
+    .add_see_also("osd_snap_trim_batch_objects"),
+
     Option("osd_max_trimming_pgs", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(2)
     .set_description(""),
@@ -3442,6 +3652,39 @@ std::vector<Option> get_global_options() {
     .set_default(0)
     .set_description("Duration to inject a delay during scrubbing"),
 
+    Option("osd_scrub_idle_window", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_min(0)
+    .set_description("Only start a scrub chunk once no client op has been dequeued for this many seconds")
+    .set_long_description("When set, the primary checks the client op queue and the OSD's devices before each scrub chunk and holds the scrub back while client I/O is active.  0 disables the check.")
+    .add_see_also("osd_scrub_idle_max_queued_ops")
+    .add_see_also("osd_scrub_idle_max_device_util")
+    .add_see_also("osd_scrub_idle_backoff"),
+
+    Option("osd_scrub_idle_max_queued_ops", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Hold back scrub chunks while more than this many client ops are waiting in the op queue")
+    .add_see_also("osd_scrub_idle_window"),
+
+    Option("osd_scrub_idle_max_device_util", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.5)
+    .set_min_max(0.0, 1.0)
+    .set_description("Hold back scrub chunks while the busiest OSD device was busy for more than this fraction of the last tick")
+    .add_see_also("osd_scrub_idle_window"),
+
+    Option("osd_scrub_idle_backoff", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.005)
+    .set_min(.001)
+    .set_description("Seconds a held-back scrub waits before checking for an idle window again")
+    .add_see_also("osd_scrub_idle_window"),
+
+    Option("osd_scrub_idle_max_wait", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(60)
+    .set_min(0)
+    .set_description("Longest a scrub is held back for client I/O in a row")
+    .set_long_description("A scrub keeps its local and replica reservations while held back. Past this many seconds, a scrub that has not started gives them back and is scheduled again later, and one that has started scrubs its next chunk anyway. 0 holds scrubs back for as long as the OSD is busy.")
+    .add_see_also("osd_scrub_idle_window"),
+
     Option("osd_scrub_auto_repair", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description("Automatically repair damaged objects detected during scrub"),
@@ -3468,6 +3711,20 @@ std::vector<Option> get_global_options() {
     .set_default(512_K)
     .set_description("Number of bytes to read from an object at a time during deep scrub"),
 
+    Option("osd_deep_scrub_incremental", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Skip reading the data of objects unchanged since the last clean deep scrub")
+    .set_long_description("When enabled, a scheduled deep scrub of a replicated pool does not re-read the data of objects that have not been modified since the previous deep scrub of the PG found no errors, and whose object info carries a data digest; that digest is reported instead.  A fraction of such objects (osd_deep_scrub_reread_ratio) is still read in full on every deep scrub to detect media errors.  Omap data is always read.  Operator-requested deep scrubs and repairs always read everything.")
+    .add_service("osd")
+    .add_see_also("osd_deep_scrub_reread_ratio"),
+
+    Option("osd_deep_scrub_reread_ratio", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.1)
+    .set_min_max(0.0, 1.0)
+    .set_description("Fraction of unchanged objects whose data an incremental deep scrub reads anyway")
+    .add_service("osd")
+    .add_see_also("osd_deep_scrub_incremental"),
+
     Option("osd_deep_scrub_keys", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1024)
     .set_description("Number of keys to read from an object at a time during deep scrub"),
@@ -3589,6 +3846,23 @@ std::vector<Option> get_global_options() {
     .add_see_also("osd_min_pg_log_entries")
     .add_see_also("osd_max_pg_log_entries"),
 
+    Option("osd_pg_log_chunk_entries", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("number of consecutive PG log entries (and dups) to store in a single omap value")
+    .set_long_description("When non-zero, the PG log is persisted in a compact format: once this many log entries (or dup entries) have accumulated under individual omap keys they are folded into a single delta-encoded chunk, and chunks are removed as a whole once every entry in them has been trimmed.  This reduces the number of omap keys, and hence the RocksDB write and compaction traffic, generated by the PG log.  Existing logs are converted in place on the next write; setting this back to 0 converts them back to one key per entry.  Changes apply to PGs instantiated afterwards.  OSDs that do not understand the compact format cannot read a PG log written with it.")
+    .add_service("osd")
+    .add_see_also("osd_min_pg_log_entries")
+    .add_see_also("osd_pg_log_dups_tracked"),
+
+    Option("osd_pg_log_spill_entries", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("number of trimmed PG log entries to keep on disk only")
+    .set_long_description("When non-zero, entries trimmed from the in-memory PG log (as governed by osd_min_pg_log_entries and osd_max_pg_log_entries) are left on disk, up to this many per PG, instead of being removed right away.  Only their versions are kept in memory.  During peering the primary reads them back when that lets a peer recover from the log rather than by backfill.  This allows a long effective log for log based recovery without the memory cost of keeping every entry and its indexes resident.  Spilled entries are not used to detect duplicate client ops; that stays bounded by osd_pg_log_dups_tracked.  Changes apply to PGs instantiated afterwards.")
+    .add_service("osd")
+    .add_see_also("osd_min_pg_log_entries")
+    .add_see_also("osd_max_pg_log_entries")
+    .add_see_also("osd_pg_log_dups_tracked"),
+
     Option("osd_op_complaint_time", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(30)
     .set_description(""),
@@ -3706,6 +3980,12 @@ std::vector<Option> get_global_options() {
     .set_default(32)
     .set_description(""),
 
+    Option("osd_op_tracker_lightweight", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Track ops with less CPU overhead")
+    .set_long_description("Ops record their events in a preallocated array without locking, fixed event names as interned ids and text built at runtime as a copy, and are passed to the op history through lock-free per-shard queues. An op keeps at most 20 events: later ones replace the last, and the dump reports how many were truncated.")
+    .add_see_also("osd_enable_op_tracker"),
+
     Option("osd_op_history_size", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(20)
     .set_description(""),
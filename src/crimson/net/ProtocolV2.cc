@@ -27,6 +27,12 @@ using namespace ceph::msgr::v2;
 
 namespace {
 
+// we advertise all msgr2 features but those only the async messenger
+// implements so far
+constexpr uint64_t supported_msgr2_features =
+  CEPH_MSGR2_SUPPORTED_FEATURES &
+  ~(CEPH_MSGR2_FEATURE_COMPRESSION | CEPH_MSGR2_FEATURE_STRIPE);
+
 seastar::logger& logger() {
   return ceph::get_logger(ceph_subsys_ms);
 }
@@ -392,7 +398,7 @@ seastar::future<entity_type_t, entity_addr_t> ProtocolV2::banner_exchange()
 {
   // 1. prepare and send banner
   bufferlist banner_payload;
-  encode((uint64_t)CEPH_MSGR2_SUPPORTED_FEATURES, banner_payload, 0);
+  encode(supported_msgr2_features, banner_payload, 0);
   encode((uint64_t)CEPH_MSGR2_REQUIRED_FEATURES, banner_payload, 0);
 
   bufferlist bl;
@@ -444,7 +450,7 @@ seastar::future<entity_type_t, entity_addr_t> ProtocolV2::banner_exchange()
                      conn, peer_supported_features, peer_required_features);
 
       // Check feature bit compatibility
-      uint64_t supported_features = CEPH_MSGR2_SUPPORTED_FEATURES;
+      uint64_t supported_features = supported_msgr2_features;
       uint64_t required_features = CEPH_MSGR2_REQUIRED_FEATURES;
       if ((required_features & peer_supported_features) != required_features) {
         logger().error("{} peer does not support all required features"
@@ -2,6 +2,7 @@
 // vim: ts=8 sw=2 smarttab
 
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 
@@ -805,3 +806,79 @@ int CrushTester::compare(CrushWrapper& crush2)
   }
   return ret;
 }
+
+int CrushTester::bench_straw2()
+{
+  typedef std::chrono::steady_clock clock;
+  if (min_rule < 0 || max_rule < 0) {
+    min_rule = 0;
+    max_rule = crush.get_max_rules() - 1;
+  }
+  if (min_x < 0 || max_x < 0) {
+    min_x = 0;
+    max_x = 1023;
+  }
+
+  // initial osd weights, as in compare()
+  vector<__u32> weight;
+  for (int o = 0; o < crush.get_max_devices(); o++) {
+    if (device_weight.count(o)) {
+      weight.push_back(device_weight[o]);
+    } else if (crush.check_item_present(o)) {
+      weight.push_back(0x10000);
+    } else {
+      weight.push_back(0);
+    }
+  }
+  adjust_weights(weight);
+
+  int ret = 0;
+  int saved_lanes = crush_straw2_lanes;
+  for (int r = min_rule; r < crush.get_max_rules() && r <= max_rule; r++) {
+    if (!crush.rule_exists(r)) {
+      continue;
+    }
+    if (ruleset >= 0 &&
+	crush.get_rule_mask_ruleset(r) != ruleset) {
+      continue;
+    }
+    int minr = min_rep, maxr = max_rep;
+    if (min_rep < 0 || max_rep < 0) {
+      minr = crush.get_rule_mask_min_size(r);
+      maxr = crush.get_rule_mask_max_size(r);
+    }
+    vector<vector<int>> out[2];
+    double seconds[2];
+    for (int lanes = 0; lanes < 2; lanes++) {
+      crush_straw2_lanes = lanes;
+      auto start = clock::now();
+      for (int nr = minr; nr <= maxr; nr++) {
+	for (int x = min_x; x <= max_x; ++x) {
+	  out[lanes].emplace_back();
+	  crush.do_rule(r, x, out[lanes].back(), nr, weight, 0);
+	}
+      }
+      seconds[lanes] = std::chrono::duration<double>(
+	clock::now() - start).count();
+    }
+    int bad = 0;
+    for (size_t i = 0; i < out[0].size(); ++i) {
+      if (out[0][i] != out[1][i]) {
+	++bad;
+      }
+    }
+    if (bad) {
+      ret = -1;
+    }
+    cout << "rule " << r << " (" << crush.get_rule_name(r) << ") "
+	 << out[0].size() << " mappings: one item at a time " << seconds[0]
+	 << "s, " << CRUSH_HASH_LANES << " items at a time " << seconds[1]
+	 << "s (" << seconds[0] / seconds[1] << "x), "
+	 << bad << " mismatched" << std::endl;
+  }
+  crush_straw2_lanes = saved_lanes;
+  if (ret) {
+    cerr << "warning: straw2 mappings differ" << std::endl;
+  }
+  return ret;
+}
@@ -361,6 +361,11 @@ public:
   int test_with_fork(int timeout);
 
   int compare(CrushWrapper& other);
+  /**
+   * time the --test mappings with straw2 items hashed one at a time
+   * and CRUSH_HASH_LANES at a time, and check that they agree
+   */
+  int bench_straw2();
 };
 
 #endif
@@ -20,4 +20,16 @@ extern __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d);
 extern __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d,
 			    __u32 e);
 
+#ifndef __KERNEL__
+/*
+ * Compute crush_hash32_3(type, a, b[i], c) for CRUSH_HASH_LANES
+ * consecutive values of b at once, using SIMD where the platform has
+ * it.  Returns 0 if there is no multi-lane implementation for this
+ * hash type or platform, in which case out is untouched.
+ */
+#define CRUSH_HASH_LANES 8
+extern int crush_hash32_3_lanes(int type, __u32 a, const __s32 *b, __u32 c,
+				__u32 *out);
+#endif
+
 #endif
@@ -331,10 +331,8 @@ static inline __s32 *get_choose_arg_ids(const struct crush_bucket_straw2 *bucket
  * for reference, see the exponential distribution example at:  
  * https://en.wikipedia.org/wiki/Inverse_transform_sampling#Examples
  */
-static inline __s64 generate_exponential_distribution(int type, int x, int y, int z, 
-                                                      int weight)
+static inline __s64 exponential_draw(unsigned int u, int weight)
 {
-	unsigned int u = crush_hash32_3(type, x, y, z);
 	u &= 0xffff;
 
 	/*
@@ -358,6 +356,55 @@ static inline __s64 generate_exponential_distribution(int type, int x, int y, in
 	return div64_s64(ln, weight);
 }
 
+static inline __s64 generate_exponential_distribution(int type, int x, int y, int z, 
+                                                      int weight)
+{
+	return exponential_draw(crush_hash32_3(type, x, y, z), weight);
+}
+
+#ifndef __KERNEL__
+int crush_straw2_lanes = 1;
+
+/*
+ * same as bucket_straw2_choose(), but hashes CRUSH_HASH_LANES items
+ * at a time.  the draws are compared in the same order, so the
+ * result is identical.
+ */
+static int bucket_straw2_choose_lanes(const struct crush_bucket_straw2 *bucket,
+				      int x, int r, const __u32 *weights,
+				      const __s32 *ids)
+{
+	unsigned int i, j, high = 0;
+	__s64 draw, high_draw = 0;
+	__u32 u[CRUSH_HASH_LANES];
+
+	for (i = 0; i < bucket->h.size; i++) {
+		j = i % CRUSH_HASH_LANES;
+		if (j == 0 &&
+		    (i + CRUSH_HASH_LANES > bucket->h.size ||
+		     !crush_hash32_3_lanes(bucket->h.hash, x, ids + i, r, u))) {
+			for (j = 0; i + j < bucket->h.size &&
+				    j < CRUSH_HASH_LANES; j++)
+				u[j] = crush_hash32_3(bucket->h.hash, x,
+						      ids[i + j], r);
+			j = 0;
+		}
+		if (weights[i]) {
+			draw = exponential_draw(u[j], weights[i]);
+		} else {
+			draw = S64_MIN;
+		}
+
+		if (i == 0 || draw > high_draw) {
+			high = i;
+			high_draw = draw;
+		}
+	}
+
+	return bucket->h.items[high];
+}
+#endif
+
 static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 				int x, int r, const struct crush_choose_arg *arg,
                                 int position)
@@ -366,6 +413,10 @@ static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 	__s64 draw, high_draw = 0;
         __u32 *weights = get_choose_arg_weights(bucket, arg, position);
         __s32 *ids = get_choose_arg_ids(bucket, arg);
+#ifndef __KERNEL__
+	if (crush_straw2_lanes && bucket->h.size >= CRUSH_HASH_LANES)
+		return bucket_straw2_choose_lanes(bucket, x, r, weights, ids);
+#endif
 	for (i = 0; i < bucket->h.size; i++) {
                 dprintk("weight 0x%x item %d\n", weights[i], ids[i]);
 		if (weights[i]) {
@@ -90,4 +90,10 @@ static inline size_t crush_work_size(const struct crush_map *map,
 
 extern void crush_init_workspace(const struct crush_map *m, void *v);
 
+#ifndef __KERNEL__
+/* hash straw2 bucket items several at a time (default on); the
+ * mappings are the same either way */
+extern int crush_straw2_lanes;
+#endif
+
 #endif
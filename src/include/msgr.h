@@ -44,15 +44,19 @@
 #define DEFINE_MSGR2_FEATURE(bit, incarnation, name)               \
 	const static uint64_t CEPH_MSGR2_FEATURE_##name = (1ULL << bit); \
 	const static uint64_t CEPH_MSGR2_FEATUREMASK_##name =            \
-			(1ULL << bit | CEPH_FEATURE_INCARNATION_##incarnation);
+			(1ULL << bit | CEPH_MSGR2_INCARNATION_##incarnation);
 
 #define HAVE_MSGR2_FEATURE(x, name) \
 	(((x) & (CEPH_MSGR2_FEATUREMASK_##name)) == (CEPH_MSGR2_FEATUREMASK_##name))
 
 
-#define CEPH_MSGR2_SUPPORTED_FEATURES (0ull)
+DEFINE_MSGR2_FEATURE(2, 1, STRIPE)
+DEFINE_MSGR2_FEATURE(3, 1, COMPRESSION)
 
-#define CEPH_MSGR2_REQUIRED_FEATURES (CEPH_MSGR2_SUPPORTED_FEATURES)
+#define CEPH_MSGR2_SUPPORTED_FEATURES (CEPH_MSGR2_FEATURE_COMPRESSION | \
+				       CEPH_MSGR2_FEATURE_STRIPE)
+
+#define CEPH_MSGR2_REQUIRED_FEATURES (0ull)
 
 
 /*
@@ -148,6 +152,7 @@ struct ceph_msg_connect_reply {
 } __attribute__ ((packed));
 
 #define CEPH_MSG_CONNECT_LOSSY  1  /* messages i send may be safely dropped */
+#define CEPH_MSG_CONNECT_STRIPE_LANE 2  /* msgr2: data lane of another session */
 
 
 /*
@@ -235,6 +240,9 @@ struct ceph_msg_footer {
 #define CEPH_MSG_FOOTER_COMPLETE  (1<<0)   /* msg wasn't aborted */
 #define CEPH_MSG_FOOTER_NOCRC     (1<<1)   /* no data crc */
 #define CEPH_MSG_FOOTER_SIGNED	  (1<<2)   /* msg was signed */
+#define CEPH_MSG_FOOTER_STRIPED	  (1<<3)   /* msgr2: data continues on stripe lanes */
+#define CEPH_MSG_FOOTER_FRONT_COMPRESSED (1<<4)   /* msgr2: front segment is compressed */
+#define CEPH_MSG_FOOTER_DATA_COMPRESSED  (1<<5)   /* msgr2: data segment is compressed */
 
 
 #endif
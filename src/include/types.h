@@ -556,6 +556,10 @@ struct errorcode32_t {
   int operator<(int i)  { return code < i; }
   int operator<=(int i) { return code <= i; }
 
+  void encode(ceph::buffer::list::contiguous_appender& p) const {
+    __s32 newcode = hostos_to_ceph_errno(code);
+    denc(newcode, p);
+  }
   void encode(ceph::buffer::list &bl) const {
     using ceph::encode;
     __s32 newcode = hostos_to_ceph_errno(code);
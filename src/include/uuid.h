@@ -58,6 +58,9 @@ struct uuid_d {
     return (char*)uuid.data;
   }
 
+  void encode(ceph::buffer::list::contiguous_appender& p) const {
+    p.append(reinterpret_cast<const char*>(&uuid), sizeof(uuid));
+  }
   void encode(ceph::buffer::list& bl) const {
     ceph::encode_raw(uuid, bl);
   }
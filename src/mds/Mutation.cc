@@ -437,14 +437,7 @@ void MDRequestImpl::_dump(Formatter *f) const
       f->dump_string("op_type", "no_available_op_found");
     }
   }
-  {
-    f->open_array_section("events");
-    std::lock_guard l(lock);
-    for (auto& i : events) {
-      f->dump_object("event", i);
-    }
-    f->close_section(); // events
-  }
+  dump_events(f);
 }
 
 void MDRequestImpl::_dump_op_descriptor_unlocked(ostream& stream) const
@@ -0,0 +1,69 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MMSGRSTRIPE_H
+#define CEPH_MMSGRSTRIPE_H
+
+#include "msg/Message.h"
+
+/**
+ * One stripe of the data of a large message, sent by the async
+ * messenger over a stripe lane (see ms_async_stripe_connections).  The
+ * data segment holds the stripe; the receiving messenger reassembles
+ * the stripes and hands the whole message to its dispatchers.  This
+ * message itself is never dispatched.
+ */
+class MMsgrStripe : public Message {
+public:
+  uint64_t token = 0;      ///< stripe token of the session of the message
+  uint64_t stripe_id = 0;  ///< unique per sending messenger
+  uint32_t index = 0;      ///< 1..count-1; stripe 0 travels with the message
+  uint32_t count = 0;
+
+  MMsgrStripe(uint64_t t, uint64_t id, uint32_t i, uint32_t n)
+    : Message{MSG_MSGR_STRIPE, HEAD_VERSION, COMPAT_VERSION},
+      token(t), stripe_id(id), index(i), count(n) {}
+  MMsgrStripe()
+    : MMsgrStripe(0, 0, 0, 0) {}
+private:
+  ~MMsgrStripe() override {}
+
+public:
+  void encode_payload(uint64_t features) override {
+    using ceph::encode;
+    encode(token, payload);
+    encode(stripe_id, payload);
+    encode(index, payload);
+    encode(count, payload);
+  }
+  void decode_payload() override {
+    auto p = payload.cbegin();
+    decode(token, p);
+    decode(stripe_id, p);
+    decode(index, p);
+    decode(count, p);
+  }
+
+  std::string_view get_type_name() const override { return "msgr_stripe"; }
+  void print(ostream &out) const override {
+    out << "msgr_stripe(" << stripe_id << " " << index << "/" << count
+	<< " " << get_data().length() << " bytes)";
+  }
+private:
+  static constexpr int HEAD_VERSION = 1;
+  static constexpr int COMPAT_VERSION = 1;
+
+  template<class T, typename... Args>
+  friend boost::intrusive_ptr<T> ceph::make_message(Args&&... args);
+};
+
+#endif
@@ -29,6 +29,7 @@ private:
     FLAG_ALIVE = 0,      // use this on its own to mark as "I'm still alive"
     FLAG_FAILED = 1,     // if set, failure; if not, recovery
     FLAG_IMMEDIATE = 2,  // known failure, not a timeout
+    FLAG_FAST = 4,       // timeout after the reporter's fast heartbeat grace
   };
   
   uuid_d fsid;
@@ -68,6 +69,9 @@ public:
   bool is_immediate() const { 
     return flags & FLAG_IMMEDIATE; 
   }
+  bool is_fast() const {
+    return flags & FLAG_FAST;
+  }
   epoch_t get_epoch() const { return epoch; }
 
   void decode_payload() override {
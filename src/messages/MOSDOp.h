@@ -363,31 +363,49 @@ struct ceph_osd_request_head {
       // reassert version
       header.version = HEAD_VERSION;
 
-      encode(pgid, payload);
-      encode(hobj.get_hash(), payload);
-      encode(osdmap_epoch, payload);
-      encode(flags, payload);
-      encode(reqid, payload);
-      encode_trace(payload, features);
-
-      // -- above decoded up front; below decoded post-dispatch thread --
-
-      encode(client_inc, payload);
-      encode(mtime, payload);
+      // all but the object locator goes through two contiguous appenders
+      // sized up front.
+      {
+	size_t len = spg_t::ENCODED_SIZE + sizeof(uint32_t) +
+	  sizeof(osdmap_epoch) + sizeof(flags) + TRACE_ENCODED_SIZE +
+	  sizeof(client_inc);
+	denc(reqid, len);
+	denc(mtime, len);
+	auto a = payload.get_contiguous_appender(len);
+	pgid.encode(a);
+	denc(hobj.get_hash(), a);
+	denc(osdmap_epoch, a);
+	denc(flags, a);
+	denc(reqid, a);
+	encode_trace(a, features);
+
+	// -- above decoded up front; below decoded post-dispatch thread --
+
+	denc(client_inc, a);
+	denc(mtime, a);
+      }
       encode(get_object_locator(), payload);
-      encode(hobj.oid, payload);
-
-      __u16 num_ops = ops.size();
-      encode(num_ops, payload);
-      for (unsigned i = 0; i < ops.size(); i++)
-	encode(ops[i].op, payload);
-
-      encode(hobj.snap, payload);
-      encode(snap_seq, payload);
-      encode(snaps, payload);
-
-      encode(retry_attempt, payload);
-      encode(features, payload);
+      {
+	__u16 num_ops = ops.size();
+	size_t len = sizeof(num_ops) + num_ops * sizeof(ceph_osd_op) +
+	  sizeof(retry_attempt) + sizeof(features);
+	denc(hobj.oid.name, len);
+	denc(hobj.snap, len);
+	denc(snap_seq, len);
+	denc(snaps, len);
+	auto a = payload.get_contiguous_appender(len);
+	denc(hobj.oid.name, a);	// object_t
+	denc(num_ops, a);
+	for (unsigned i = 0; i < ops.size(); i++)
+	  a.append(reinterpret_cast<const char*>(&ops[i].op),
+		   sizeof(ceph_osd_op));
+	denc(hobj.snap, a);
+	denc(snap_seq, a);
+	denc(snaps, a);
+
+	denc(retry_attempt, a);
+	denc(features, a);
+      }
     }
   }
 
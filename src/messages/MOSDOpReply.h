@@ -179,8 +179,46 @@ public:
 	encode(ops[i].op, payload);
       }
       ceph::encode_nohead(oid.name, payload);
-    } else {
+    } else if (HAVE_FEATURE(features, NEW_OSDOPREPLY_ENCODING)) {
+      // everything up to the (rare) redirect through one contiguous
+      // appender sized up front
       header.version = HEAD_VERSION;
+      do_redirect = !redirect.empty();
+      {
+	__u32 num_ops = ops.size();
+	size_t len = pg_t::ENCODED_SIZE + sizeof(flags) + sizeof(int32_t) +
+	  2 * eversion_t::ENCODED_SIZE + sizeof(osdmap_epoch) +
+	  sizeof(num_ops) + num_ops * (sizeof(ceph_osd_op) + sizeof(int32_t)) +
+	  sizeof(retry_attempt) + sizeof(user_version) + sizeof(__u8);
+	denc(oid.name, len);
+	auto a = payload.get_contiguous_appender(len);
+	denc(oid.name, a);	// object_t
+	pgid.encode(a);
+	denc(flags, a);
+	result.encode(a);
+	bad_replay_version.encode(a);
+	denc(osdmap_epoch, a);
+
+	denc(num_ops, a);
+	for (unsigned i = 0; i < num_ops; i++)
+	  a.append(reinterpret_cast<const char*>(&ops[i].op),
+		   sizeof(ceph_osd_op));
+
+	denc(retry_attempt, a);
+
+	for (unsigned i = 0; i < num_ops; i++)
+	  ops[i].rval.encode(a);
+
+	replay_version.encode(a);
+	denc(user_version, a);
+	denc((__u8)do_redirect, a);	// bool
+      }
+      if (do_redirect) {
+	encode(redirect, payload);
+      }
+      encode_trace(payload, features);
+    } else {
+      header.version = 6;
       encode(oid, payload);
       encode(pgid, payload);
       encode(flags, payload);
@@ -200,16 +238,7 @@ public:
 
       encode(replay_version, payload);
       encode(user_version, payload);
-      if ((features & CEPH_FEATURE_NEW_OSDOPREPLY_ENCODING) == 0) {
-        header.version = 6;
-        encode(redirect, payload);
-      } else {
-        do_redirect = !redirect.empty();
-        encode(do_redirect, payload);
-        if (do_redirect) {
-          encode(redirect, payload);
-        }
-      }
+      encode(redirect, payload);
       encode_trace(payload, features);
     }
   }
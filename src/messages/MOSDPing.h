@@ -88,18 +88,24 @@ public:
     p.advance(size);
     min_message_size = size + payload_mid_length;
   }
-  void encode_payload(uint64_t features) override {
-    using ceph::encode;
-    encode(fsid, payload);
-    encode(map_epoch, payload);
-    encode(op, payload);
-    encode(stamp, payload);
+  // fsid, map_epoch, op and stamp
+  static constexpr size_t HEAD_ENCODED_SIZE =
+    sizeof(uuid_d::uuid) + sizeof(epoch_t) + sizeof(__u8) + sizeof(ceph_timespec);
 
+  void encode_payload(uint64_t features) override {
     size_t s = 0;
-    if (min_message_size > payload.length()) {
-      s = min_message_size - payload.length();
+    if (min_message_size > HEAD_ENCODED_SIZE) {
+      s = min_message_size - HEAD_ENCODED_SIZE;
+    }
+    {
+      auto a = payload.get_contiguous_appender(
+	HEAD_ENCODED_SIZE + sizeof(uint32_t));
+      fsid.encode(a);
+      denc(map_epoch, a);
+      denc(op, a);
+      denc(stamp, a);
+      denc((uint32_t)s, a);
     }
-    encode((uint32_t)s, payload);
     if (s) {
       // this should be big enough for normal min_message padding sizes. since
       // we are targeting jumbo ethernet frames around 9000 bytes, 16k should
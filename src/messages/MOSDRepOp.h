@@ -116,20 +116,32 @@ public:
 
   void encode_payload(uint64_t features) override {
     using ceph::encode;
-    encode(map_epoch, payload);
     if (HAVE_FEATURE(features, SERVER_LUMINOUS)) {
+      // the fixed-size head, decoded up front, in one go
       header.version = HEAD_VERSION;
-      encode(min_epoch, payload);
-      encode_trace(payload, features);
+      size_t len = sizeof(map_epoch) + sizeof(min_epoch) +
+	TRACE_ENCODED_SIZE + spg_t::ENCODED_SIZE;
+      denc(reqid, len);
+      auto a = payload.get_contiguous_appender(len);
+      denc(map_epoch, a);
+      denc(min_epoch, a);
+      encode_trace(a, features);
+      denc(reqid, a);
+      pgid.encode(a);
     } else {
       header.version = 1;
+      encode(map_epoch, payload);
+      encode(reqid, payload);
+      encode(pgid, payload);
     }
-    encode(reqid, payload);
-    encode(pgid, payload);
     encode(poid, payload);
 
-    encode(acks_wanted, payload);
-    encode(version, payload);
+    {
+      auto a = payload.get_contiguous_appender(
+	sizeof(acks_wanted) + eversion_t::ENCODED_SIZE);
+      denc(acks_wanted, a);
+      version.encode(a);
+    }
     encode(logbl, payload);
     encode(pg_stats, payload);
     encode(pg_trim_to, payload);
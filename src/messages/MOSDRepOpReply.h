@@ -86,14 +86,27 @@ public:
   }
   void encode_payload(uint64_t features) override {
     using ceph::encode;
-    encode(map_epoch, payload);
     if (HAVE_FEATURE(features, SERVER_LUMINOUS)) {
+      // every field has a fixed size: encode them in one go
       header.version = HEAD_VERSION;
-      encode(min_epoch, payload);
-      encode_trace(payload, features);
-    } else {
-      header.version = 1;
+      size_t len = sizeof(map_epoch) + sizeof(min_epoch) +
+	TRACE_ENCODED_SIZE + spg_t::ENCODED_SIZE + sizeof(ack_type) +
+	sizeof(result) + eversion_t::ENCODED_SIZE + pg_shard_t::ENCODED_SIZE;
+      denc(reqid, len);
+      auto a = payload.get_contiguous_appender(len);
+      denc(map_epoch, a);
+      denc(min_epoch, a);
+      encode_trace(a, features);
+      denc(reqid, a);
+      pgid.encode(a);
+      denc(ack_type, a);
+      denc(result, a);
+      last_complete_ondisk.encode(a);
+      from.encode(a);
+      return;
     }
+    header.version = 1;
+    encode(map_epoch, payload);
     encode(reqid, payload);
     encode(pgid, payload);
     encode(ack_type, payload);
@@ -2692,6 +2692,11 @@ bool OSDMonitor::check_failure(utime_t now, int target_osd, failure_info_t& fi)
   set<string> reporters_by_subtree;
   auto reporter_subtree_level = g_conf().get_val<string>("mon_osd_reporter_subtree_level");
   utime_t orig_grace(g_conf()->osd_heartbeat_grace, 0);
+  if (fi.all_fast()) {
+    // the reporters only reported once the target missed the grace
+    // they derive from its ping round trip times
+    orig_grace = utime_t();
+  }
   utime_t max_failed_since = fi.get_failed_since();
   utime_t failed_for = now - max_failed_since;
 
@@ -2819,7 +2824,8 @@ bool OSDMonitor::prepare_failure(MonOpRequestRef op)
 		      << m->get_orig_source();
 
     failure_info_t& fi = failure_info[target_osd];
-    MonOpRequestRef old_op = fi.add_report(reporter, failed_since, op);
+    MonOpRequestRef old_op = fi.add_report(reporter, failed_since, op,
+					   m->is_fast());
     if (old_op) {
       mon->no_reply(old_op);
     }
@@ -13274,7 +13280,7 @@ int OSDMonitor::_prepare_remove_pool(
     }
   }
   // remove any pg_upmap mappings for this pool
-  for (auto& p : osdmap.pg_upmap) {
+  for (auto& p : *osdmap.pg_upmap) {
     if (p.first.pool() == pool) {
       dout(10) << __func__ << " " << pool
                << " removing obsolete pg_upmap "
@@ -13297,7 +13303,7 @@ int OSDMonitor::_prepare_remove_pool(
     }
   }
   // remove any pg_upmap_items mappings for this pool
-  for (auto& p : osdmap.pg_upmap_items) {
+  for (auto& p : *osdmap.pg_upmap_items) {
     if (p.first.pool() == pool) {
       dout(10) << __func__ << " " << pool
                << " removing obsolete pg_upmap_items " << p.first
@@ -49,10 +49,12 @@ class MOSDMap;
 /// information about a particular peer's failure reports for one osd
 struct failure_reporter_t {
   utime_t failed_since;     ///< when they think it failed
+  bool fast = false;        ///< reported by fast heartbeats, grace already applied
   MonOpRequestRef op;       ///< failure op request
 
   failure_reporter_t() {}
-  explicit failure_reporter_t(utime_t s) : failed_since(s) {}
+  explicit failure_reporter_t(utime_t s, bool f = false)
+    : failed_since(s), fast(f) {}
   ~failure_reporter_t() { }
 };
 
@@ -78,12 +80,12 @@ struct failure_info_t {
   // set the message for the latest report.  return any old op request we had,
   // if any, so we can discard it.
   MonOpRequestRef add_report(int who, utime_t failed_since,
-			     MonOpRequestRef op) {
+			     MonOpRequestRef op, bool fast = false) {
     map<int, failure_reporter_t>::iterator p = reporters.find(who);
     if (p == reporters.end()) {
       if (max_failed_since != utime_t() && max_failed_since < failed_since)
 	max_failed_since = failed_since;
-      p = reporters.insert(map<int, failure_reporter_t>::value_type(who, failure_reporter_t(failed_since))).first;
+      p = reporters.insert(map<int, failure_reporter_t>::value_type(who, failure_reporter_t(failed_since, fast))).first;
     }
 
     MonOpRequestRef ret = p->second.op;
@@ -91,6 +93,15 @@ struct failure_info_t {
     return ret;
   }
 
+  /// true if every reporter already applied its own (fast) grace
+  bool all_fast() const {
+    for (auto& p : reporters) {
+      if (!p.second.fast)
+	return false;
+    }
+    return !reporters.empty();
+  }
+
   void take_report_messages(list<MonOpRequestRef>& ls) {
     for (map<int, failure_reporter_t>::iterator p = reporters.begin();
 	 p != reporters.end();
@@ -16,6 +16,7 @@
 #define CEPH_CONNECTION_H
 
 #include <stdlib.h>
+#include <atomic>
 #include <ostream>
 
 #include <boost/intrusive_ptr.hpp>
@@ -59,6 +60,9 @@ public:
   int rx_buffers_version;
   std::map<ceph_tid_t,std::pair<ceph::buffer::list, int>> rx_buffers;
 
+  /// bytes of the msgr dispatch throttler held by messages read from us
+  std::atomic<uint64_t> dispatch_throttle_bytes = {0};
+
   // authentication state
   // FIXME make these private after ms_handle_authorizer is removed
 public:
@@ -28,6 +28,54 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "-- " << msgr->get_myaddrs() << " "
 
+DispatchQueue::DispatchQueue(CephContext *cct, Messenger *msgr, string &name)
+  : cct(cct), msgr(msgr),
+    logger(nullptr),
+    lock("Messenger::DispatchQueue::lock" + name),
+    mqueue(cct->_conf->ms_pq_max_tokens_per_priority,
+	   cct->_conf->ms_pq_min_cost),
+    next_id(1),
+    dispatch_thread(this),
+    local_delivery_lock("Messenger::DispatchQueue::local_delivery_lock" + name),
+    stop_local_delivery(false),
+    local_delivery_thread(this),
+    dispatch_throttler(cct, string("msgr_dispatch_throttler-") + name,
+		       cct->_conf->ms_dispatch_throttle_bytes),
+    dispatch_throttle_bytes_per_conn(
+      cct->_conf.get_val<Option::size_t>(
+	"ms_dispatch_throttle_bytes_per_connection")),
+    stop(false)
+{
+  PerfCountersBuilder plb(cct, string("msgr_dispatch_queue-") + name,
+			  l_dispatch_queue_first, l_dispatch_queue_last);
+  plb.add_u64(l_dispatch_queue_len, "queue_len",
+	      "Messages waiting for the dispatch thread");
+  plb.add_time_avg(l_dispatch_queue_wait_lat, "wait_lat",
+		   "Time messages waited for the dispatch thread");
+  plb.add_time_avg(l_dispatch_queue_dispatch_lat, "dispatch_lat",
+		   "Time spent in ms_dispatch");
+  plb.add_u64_counter(l_dispatch_queue_fast_dispatch, "fast_dispatch",
+		      "Messages fast dispatched");
+  plb.add_time_avg(l_dispatch_queue_fast_dispatch_lat, "fast_dispatch_lat",
+		   "Time spent in ms_fast_dispatch");
+  plb.add_u64_counter(l_dispatch_queue_throttled_global, "throttled_global",
+		      "Reads deferred because the dispatch throttler was full");
+  plb.add_u64_counter(l_dispatch_queue_throttled_conn, "throttled_conn",
+		      "Reads deferred because the connection held its share "
+		      "of the dispatch throttler");
+  logger = plb.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+DispatchQueue::~DispatchQueue()
+{
+  ceph_assert(mqueue.empty());
+  ceph_assert(marrival.empty());
+  ceph_assert(local_messages.empty());
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
+}
+
 double DispatchQueue::get_max_age(utime_t now) const {
   Mutex::Locker l(lock);
   if (marrival.empty())
@@ -57,7 +105,7 @@ uint64_t DispatchQueue::pre_dispatch(const ref_t<Message>& m)
 
 void DispatchQueue::post_dispatch(const ref_t<Message>& m, uint64_t msize)
 {
-  dispatch_throttle_release(msize);
+  dispatch_throttle_release(m->get_connection().get(), msize);
   ldout(cct,20) << "done calling dispatch on " << m << dendl;
 }
 
@@ -69,7 +117,11 @@ bool DispatchQueue::can_fast_dispatch(const cref_t<Message> &m) const
 void DispatchQueue::fast_dispatch(const ref_t<Message>& m)
 {
   uint64_t msize = pre_dispatch(m);
+  auto start = ceph::mono_clock::now();
   msgr->ms_fast_dispatch(m);
+  logger->inc(l_dispatch_queue_fast_dispatch);
+  logger->tinc(l_dispatch_queue_fast_dispatch_lat,
+	       ceph::mono_clock::now() - start);
   post_dispatch(m, msize);
 }
 
@@ -91,6 +143,7 @@ void DispatchQueue::enqueue(const ref_t<Message>& m, int priority, uint64_t id)
   } else {
     mqueue.enqueue(id, priority, m->get_cost(), QueueItem(m));
   }
+  logger->set(l_dispatch_queue_len, mqueue.length());
   cond.Signal();
 }
 
@@ -130,12 +183,44 @@ void DispatchQueue::run_local_delivery()
   local_delivery_lock.Unlock();
 }
 
-void DispatchQueue::dispatch_throttle_release(uint64_t msize)
+bool DispatchQueue::dispatch_throttle_get(Connection *con, uint64_t msize)
+{
+  // only con's own reader takes its share, so this can't overshoot
+  uint64_t held = con->dispatch_throttle_bytes;
+  if (dispatch_throttle_bytes_per_conn && held &&
+      held + msize > dispatch_throttle_bytes_per_conn) {
+    ldout(cct,10) << __func__ << " " << con << " holds " << held
+		  << " of " << dispatch_throttle_bytes_per_conn
+		  << " bytes, wants " << msize << dendl;
+    logger->inc(l_dispatch_queue_throttled_conn);
+    return false;
+  }
+  if (!dispatch_throttler.get_or_fail(msize)) {
+    logger->inc(l_dispatch_queue_throttled_global);
+    return false;
+  }
+  con->dispatch_throttle_bytes += msize;
+  return true;
+}
+
+void DispatchQueue::dispatch_throttle_take(Connection *con, uint64_t msize)
+{
+  if (msize) {
+    ldout(cct,10) << __func__ << " " << msize << " more to dispatch throttler "
+	    << dispatch_throttler.get_current() << "/"
+	    << dispatch_throttler.get_max() << dendl;
+    dispatch_throttler.take(msize);
+    con->dispatch_throttle_bytes += msize;
+  }
+}
+
+void DispatchQueue::dispatch_throttle_release(Connection *con, uint64_t msize)
 {
   if (msize) {
     ldout(cct,10) << __func__ << " " << msize << " to dispatch throttler "
 	    << dispatch_throttler.get_current() << "/"
 	    << dispatch_throttler.get_max() << dendl;
+    con->dispatch_throttle_bytes -= msize;
     dispatch_throttler.put(msize);
   }
 }
@@ -157,8 +242,12 @@ void DispatchQueue::entry()
       QueueItem qitem = mqueue.dequeue();
       if (!qitem.is_code())
 	remove_arrival(qitem.get_message());
+      logger->set(l_dispatch_queue_len, mqueue.length());
       lock.Unlock();
 
+      auto start = ceph::mono_clock::now();
+      logger->tinc(l_dispatch_queue_wait_lat, start - qitem.stamp);
+
       if (qitem.is_code()) {
 	if (cct->_conf->ms_inject_internal_delays &&
 	    cct->_conf->ms_inject_delay_probability &&
@@ -195,6 +284,8 @@ void DispatchQueue::entry()
 	} else {
 	  uint64_t msize = pre_dispatch(m);
 	  msgr->ms_deliver_dispatch(m);
+	  logger->tinc(l_dispatch_queue_dispatch_lat,
+		       ceph::mono_clock::now() - start);
 	  post_dispatch(m, msize);
 	}
       }
@@ -220,8 +311,10 @@ void DispatchQueue::discard_queue(uint64_t id) {
     ceph_assert(!(i->is_code())); // We don't discard id 0, ever!
     const ref_t<Message>& m = i->get_message();
     remove_arrival(m);
-    dispatch_throttle_release(m->get_dispatch_throttle_size());
+    dispatch_throttle_release(m->get_connection().get(),
+			      m->get_dispatch_throttle_size());
   }
+  logger->set(l_dispatch_queue_len, mqueue.length());
 }
 
 void DispatchQueue::start()
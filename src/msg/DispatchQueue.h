@@ -25,6 +25,8 @@
 #include "common/Cond.h"
 #include "common/Thread.h"
 #include "common/PrioritizedQueue.h"
+#include "common/ceph_time.h"
+#include "common/perf_counters.h"
 
 #include "Message.h"
 
@@ -32,6 +34,18 @@ class CephContext;
 class Messenger;
 struct Connection;
 
+enum {
+  l_dispatch_queue_first = 96000,
+  l_dispatch_queue_len,
+  l_dispatch_queue_wait_lat,
+  l_dispatch_queue_dispatch_lat,
+  l_dispatch_queue_fast_dispatch,
+  l_dispatch_queue_fast_dispatch_lat,
+  l_dispatch_queue_throttled_global,
+  l_dispatch_queue_throttled_conn,
+  l_dispatch_queue_last,
+};
+
 /**
  * The DispatchQueue contains all the connections which have Messages
  * they want to be dispatched, carefully organized by Message priority
@@ -44,8 +58,11 @@ class DispatchQueue {
     ConnectionRef con;
     ref_t<Message> m;
   public:
-    explicit QueueItem(const ref_t<Message>& m) : type(-1), con(0), m(m) {}
-    QueueItem(int type, Connection *con) : type(type), con(con), m(0) {}
+    ceph::mono_time stamp;  ///< when it was queued
+    explicit QueueItem(const ref_t<Message>& m)
+      : type(-1), con(0), m(m), stamp(ceph::mono_clock::now()) {}
+    QueueItem(int type, Connection *con)
+      : type(type), con(con), m(0), stamp(ceph::mono_clock::now()) {}
     bool is_code() const {
       return type != -1;
     }
@@ -65,6 +82,7 @@ class DispatchQueue {
     
   CephContext *cct;
   Messenger *msgr;
+  PerfCounters *logger;
   mutable Mutex lock;
   Cond cond;
 
@@ -125,6 +143,8 @@ class DispatchQueue {
 
   /// Throttle preventing us from building up a big backlog waiting for dispatch
   Throttle dispatch_throttler;
+  /// How much of dispatch_throttler one connection may hold (0 for no limit)
+  const uint64_t dispatch_throttle_bytes_per_conn;
 
   bool stop;
   void local_delivery(const ref_t<Message>& m, int priority);
@@ -140,12 +160,36 @@ class DispatchQueue {
     return mqueue.length();
   }
 
+  /**
+   * Reserve room in the dispatch throttler for a message read from con.
+   *
+   * Fails, rather than blocks, if the throttler is full or if con
+   * already holds its share of it, so that a peer sending faster than
+   * we dispatch only stalls its own connection.  A connection holding
+   * nothing is always allowed one message.
+   *
+   * @param con The connection the message is read from.
+   * @param msize The amount of memory to reserve.
+   * @return true if the memory was reserved
+   */
+  bool dispatch_throttle_get(Connection *con, uint64_t msize);
+
+  /**
+   * Charge more memory to the dispatch throttler, even past its limits,
+   * for a message that turned out bigger than what was reserved for it.
+   *
+   * @param con The connection the message is read from.
+   * @param msize The amount of memory to add.
+   */
+  void dispatch_throttle_take(Connection *con, uint64_t msize);
+
   /**
    * Release memory accounting back to the dispatch throttler.
    *
+   * @param con The connection the memory was reserved for.
    * @param msize The amount of memory to release.
    */
-  void dispatch_throttle_release(uint64_t msize);
+  void dispatch_throttle_release(Connection *con, uint64_t msize);
 
   void queue_connect(Connection *con) {
     Mutex::Locker l(lock);
@@ -219,25 +263,8 @@ class DispatchQueue {
   void shutdown();
   bool is_started() const {return dispatch_thread.is_started();}
 
-  DispatchQueue(CephContext *cct, Messenger *msgr, string &name)
-    : cct(cct), msgr(msgr),
-      lock("Messenger::DispatchQueue::lock" + name),
-      mqueue(cct->_conf->ms_pq_max_tokens_per_priority,
-	     cct->_conf->ms_pq_min_cost),
-      next_id(1),
-      dispatch_thread(this),
-      local_delivery_lock("Messenger::DispatchQueue::local_delivery_lock" + name),
-      stop_local_delivery(false),
-      local_delivery_thread(this),
-      dispatch_throttler(cct, string("msgr_dispatch_throttler-") + name,
-                         cct->_conf->ms_dispatch_throttle_bytes),
-      stop(false)
-    {}
-  ~DispatchQueue() {
-    ceph_assert(mqueue.empty());
-    ceph_assert(marrival.empty());
-    ceph_assert(local_messages.empty());
-  }
+  DispatchQueue(CephContext *cct, Messenger *msgr, string &name);
+  ~DispatchQueue();
 };
 
 #endif
@@ -47,6 +47,7 @@
 #include "messages/MLogAck.h"
 
 #include "messages/MPing.h"
+#include "messages/MMsgrStripe.h"
 
 #include "messages/MCommand.h"
 #include "messages/MCommandReply.h"
@@ -407,6 +408,9 @@ Message *decode_message(CephContext *cct, int crcflags,
   case CEPH_MSG_PING:
     m = make_message<MPing>();
     break;
+  case MSG_MSGR_STRIPE:
+    m = make_message<MMsgrStripe>();
+    break;
   case MSG_COMMAND:
     m = make_message<MCommand>();
     break;
@@ -914,6 +918,19 @@ void Message::encode_trace(bufferlist &bl, uint64_t features) const
   encode(*p, bl);
 }
 
+void Message::encode_trace(bufferlist::contiguous_appender &p,
+			   uint64_t features) const
+{
+  auto info = trace.get_info();
+  static const blkin_trace_info empty = { 0, 0, 0 };
+  if (!info) {
+    info = &empty;
+  }
+  denc(info->trace_id, p);
+  denc(info->span_id, p);
+  denc(info->parent_span_id, p);
+}
+
 void Message::decode_trace(bufferlist::const_iterator &p, bool create)
 {
   blkin_trace_info info = {};
@@ -196,6 +196,9 @@
 #define MSG_MON_HEALTH_CHECKS     0x608
 #define MSG_TIMECHECK2            0x609
 
+// async messenger internal: a data stripe of a large msgr2 message
+#define MSG_MSGR_STRIPE           0x60f
+
 // *** ceph-mgr <-> OSD/MDS daemons ***
 #define MSG_MGR_OPEN              0x700
 #define MSG_MGR_CONFIGURE         0x701
@@ -259,7 +262,11 @@ protected:
 public:
   // zipkin tracing
   ZTracer::Trace trace;
+  // the trace is three 64-bit ids, traced or not
+  static constexpr size_t TRACE_ENCODED_SIZE = 3 * sizeof(int64_t);
   void encode_trace(ceph::buffer::list &bl, uint64_t features) const;
+  void encode_trace(ceph::buffer::list::contiguous_appender &p,
+		    uint64_t features) const;
   void decode_trace(ceph::buffer::list::const_iterator &p, bool create = false);
 
   class CompletionHook : public Context {
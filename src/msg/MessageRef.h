@@ -119,6 +119,7 @@ class MMonScrub;
 class MMonSubscribeAck;
 class MMonSubscribe;
 class MMonSync;
+class MMsgrStripe;
 class MOSDAlive;
 class MOSDBackoff;
 class MOSDBeacon;
@@ -25,6 +25,8 @@ struct Policy {
   bool standby;
   /// If true, we will try to detect session resets
   bool resetcheck;
+  /// If true, messages may be compressed on the wire (ms_async_compress_mode)
+  bool compress;
   /**
    *  The throttler is used to limit how much data is held by Messages from
    *  the associated Connection(s). When reading in a new Message, the Messenger
@@ -40,6 +42,7 @@ struct Policy {
   
   Policy()
     : lossy(false), server(false), standby(false), resetcheck(true),
+      compress(true),
       throttler_bytes(NULL),
       throttler_messages(NULL),
       features_supported(CEPH_FEATURES_SUPPORTED_DEFAULT),
@@ -47,6 +50,7 @@ struct Policy {
 private:
   Policy(bool l, bool s, bool st, bool r, uint64_t req)
     : lossy(l), server(s), standby(st), resetcheck(r),
+      compress(true),
       throttler_bytes(NULL),
       throttler_messages(NULL),
       features_supported(CEPH_FEATURES_SUPPORTED_DEFAULT),
@@ -189,6 +189,25 @@ ssize_t AsyncConnection::read(unsigned len, char *buffer,
     readCallback = callback;
     pendingReadLen = len;
     read_buffer = buffer;
+    read_bl = nullptr;
+  }
+  return r;
+}
+
+// Like read(), but appends to `bl` the buffers the stack hands over via
+// zero_copy_read() instead of copying into a flat buffer.  Only for stacks
+// that support_zero_copy_read().
+ssize_t AsyncConnection::read_zero_copy(unsigned len, bufferlist *bl,
+                                        std::function<void(char *, ssize_t)> callback) {
+  ldout(async_msgr->cct, 20) << __func__
+                             << (pendingReadLen ? " continue" : " start")
+                             << " len=" << len << dendl;
+  ssize_t r = read_until_zero_copy(len, bl);
+  if (r > 0) {
+    readCallback = callback;
+    pendingReadLen = len;
+    read_buffer = nullptr;
+    read_bl = bl;
   }
   return r;
 }
@@ -216,6 +235,21 @@ ssize_t AsyncConnection::read_until(unsigned len, char *p)
 
   ssize_t r = 0;
   uint64_t left = len - state_offset;
+  if (recv_zero_copy.length()) {
+    // recv_buf is empty, see read_until_zero_copy()
+    uint64_t to_read = std::min<uint64_t>(recv_zero_copy.length(), left);
+    recv_zero_copy.begin().copy(to_read, p + state_offset);
+    recv_zero_copy.splice(0, to_read);
+    left -= to_read;
+    ldout(async_msgr->cct, 25) << __func__ << " got " << to_read
+                               << " in zero copy buffer left is " << left
+                               << dendl;
+    if (left == 0) {
+      state_offset = 0;
+      return 0;
+    }
+    state_offset += to_read;
+  }
   if (recv_end > recv_start) {
     uint64_t to_read = std::min<uint64_t>(recv_end - recv_start, left);
     memcpy(p, recv_buf+recv_start, to_read);
@@ -274,6 +308,66 @@ ssize_t AsyncConnection::read_until(unsigned len, char *p)
   return len - state_offset;
 }
 
+// The zero copy counterpart of read_until(), the bytes read so far are
+// `bl->length()`.  Whatever is left in the prefetch buffer is copied first,
+// the rest is appended as handed over by the stack.  The part of the last
+// buffer beyond `len` is kept in "recv_zero_copy" for the next read.
+//
+// return the remaining bytes, 0 means this buffer is finished
+// else return < 0 means error
+ssize_t AsyncConnection::read_until_zero_copy(unsigned len, bufferlist *bl)
+{
+  ldout(async_msgr->cct, 25) << __func__ << " len is " << len << " got "
+                             << bl->length() << dendl;
+
+  if (async_msgr->cct->_conf->ms_inject_socket_failures && cs) {
+    if (rand() % async_msgr->cct->_conf->ms_inject_socket_failures == 0) {
+      ldout(async_msgr->cct, 0) << __func__ << " injecting socket failure" << dendl;
+      cs.shutdown();
+    }
+  }
+
+  uint64_t left = len - bl->length();
+  if (recv_end > recv_start) {
+    uint64_t to_read = std::min<uint64_t>(recv_end - recv_start, left);
+    bl->append(recv_buf + recv_start, to_read);
+    recv_start += to_read;
+    left -= to_read;
+    if (left == 0) {
+      return 0;
+    }
+  }
+  recv_end = recv_start = 0;
+
+  if (recv_zero_copy.length()) {
+    uint64_t to_read = std::min<uint64_t>(recv_zero_copy.length(), left);
+    recv_zero_copy.splice(0, to_read, bl);
+    left -= to_read;
+  }
+
+  while (left) {
+    bufferptr bp;
+    ssize_t r = cs.zero_copy_read(bp);
+    if (r == -EAGAIN) {
+      break;
+    } else if (r == -EINTR) {
+      continue;
+    } else if (r <= 0) {
+      ldout(async_msgr->cct, 1) << __func__ << " read failed r=" << r << dendl;
+      return -1;
+    }
+    if ((uint64_t)r > left) {
+      recv_zero_copy.append(bufferptr(bp, left, r - left));
+      bp.set_length(left);
+    }
+    left -= bp.length();
+    bl->append(std::move(bp));
+  }
+  ldout(async_msgr->cct, 25) << __func__ << " need len " << len << " remaining "
+                             << left << " bytes" << dendl;
+  return left;
+}
+
 /* return -1 means `fd` occurs error or closed, it should be closed
  * return 0 means EAGAIN or EINTR */
 ssize_t AsyncConnection::read_bulk(char *buf, unsigned len)
@@ -448,11 +542,14 @@ void AsyncConnection::process() {
 
     case STATE_CONNECTION_ESTABLISHED: {
       if (pendingReadLen) {
-        ssize_t r = read(*pendingReadLen, read_buffer, readCallback);
+        ssize_t r = read_bl ?
+          read_zero_copy(*pendingReadLen, read_bl, readCallback) :
+          read(*pendingReadLen, read_buffer, readCallback);
         if (r <= 0) { // read all bytes, or an error occured
           pendingReadLen.reset();
           char *buf_tmp = read_buffer;
           read_buffer = nullptr;
+          read_bl = nullptr;
           readCallback(buf_tmp, r);
         }
 	logger->tinc(l_msgr_running_recv_time,
@@ -480,6 +577,10 @@ void AsyncConnection::connect(const entity_addrvec_t &addrs, int type,
   set_peer_type(type);
   set_peer_addrs(addrs);
   policy = msgr->get_policy(type);
+  if (stripe_lane) {
+    // the connection it serves takes care of resending
+    policy.lossy = true;
+  }
   target_addr = target;
   _connect();
 }
@@ -587,6 +688,7 @@ void AsyncConnection::fault()
     delay_state->flush();
 
   recv_start = recv_end = 0;
+  recv_zero_copy.clear();
   state_offset = 0;
   outcoming_bl.clear();
 }
@@ -651,6 +753,7 @@ void AsyncConnection::DelayedDelivery::discard() {
                       while (!delay_queue.empty()) {
                         Message *m = delay_queue.front();
                         dispatch_queue->dispatch_throttle_release(
+                            m->get_connection().get(),
                             m->get_dispatch_throttle_size());
                         m->put();
                         delay_queue.pop_front();
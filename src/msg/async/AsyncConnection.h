@@ -55,6 +55,9 @@ class AsyncConnection : public Connection {
   ssize_t read(unsigned len, char *buffer,
                std::function<void(char *, ssize_t)> callback);
   ssize_t read_until(unsigned needed, char *p);
+  ssize_t read_zero_copy(unsigned len, bufferlist *bl,
+                         std::function<void(char *, ssize_t)> callback);
+  ssize_t read_until_zero_copy(unsigned needed, bufferlist *bl);
   ssize_t read_bulk(char *buf, unsigned len);
 
   ssize_t write(bufferlist &bl, std::function<void(ssize_t)> callback,
@@ -185,6 +188,9 @@ class AsyncConnection : public Connection {
   uint32_t recv_max_prefetch;
   uint32_t recv_start;
   uint32_t recv_end;
+  // received by read_until_zero_copy but not consumed yet, always follows
+  // whatever is left in recv_buf
+  bufferlist recv_zero_copy;
   set<uint64_t> register_time_events; // need to delete it if stop
   ceph::coarse_mono_clock::time_point last_connect_started;
   ceph::coarse_mono_clock::time_point last_active;
@@ -213,6 +219,7 @@ class AsyncConnection : public Connection {
   std::function<void(char *, ssize_t)> readCallback;
   std::optional<unsigned> pendingReadLen;
   char *read_buffer;
+  bufferlist *read_bl = nullptr;
 
  public:
   // used by eventcallback
@@ -228,6 +235,10 @@ class AsyncConnection : public Connection {
     return logger;
   }
 
+  /// carries stripes of another connection's messages (msgr2 only);
+  /// set before connect() or while accepting
+  bool stripe_lane = false;
+
   bool is_msgr2() const override;
 
   friend class Protocol;
@@ -27,6 +27,7 @@
 
 #include "messages/MOSDOp.h"
 #include "messages/MOSDOpReply.h"
+#include "messages/MMsgrStripe.h"
 #include "common/EventTrace.h"
 
 #define dout_subsys ceph_subsys_ms
@@ -270,6 +271,16 @@ class C_handle_reap : public EventCallback {
   }
 };
 
+class C_handle_stripe_expire : public EventCallback {
+  AsyncMessenger *msgr;
+
+  public:
+  explicit C_handle_stripe_expire(AsyncMessenger *m): msgr(m) {}
+  void do_request(uint64_t id) override {
+    msgr->expire_stripe_sets();
+  }
+};
+
 /*******************
  * AsyncMessenger
  */
@@ -299,6 +310,7 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
 					 local_worker, true, true);
   init_local_connection();
   reap_handler = new C_handle_reap(this);
+  stripe_expire_handler = new C_handle_stripe_expire(this);
   unsigned processor_num = 1;
   if (stack->support_local_listen_table())
     processor_num = stack->get_num_worker();
@@ -313,6 +325,7 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
 AsyncMessenger::~AsyncMessenger()
 {
   delete reap_handler;
+  delete stripe_expire_handler;
   ceph_assert(!did_bind); // either we didn't bind or we shut down the Processor
   local_connection->mark_down();
   for (auto &&p : processors)
@@ -346,6 +359,15 @@ int AsyncMessenger::shutdown()
   for (auto &&p : processors)
     p->stop();
   mark_down_all();
+  // the stripe sets went with the connections
+  local_worker->center.submit_to(local_worker->center.get_id(), [this] {
+      std::lock_guard l(stripe_lock);
+      if (stripe_expire_timer) {
+	local_worker->center.delete_time_event(stripe_expire_timer);
+	stripe_expire_timer = 0;
+      }
+      stripe_expire_scheduled = false;
+    });
   // break ref cycles on the loopback connection
   local_connection->set_priv(NULL);
   did_bind = false;
@@ -805,6 +827,17 @@ void AsyncMessenger::shutdown_connections(bool queue_reset)
   }
   conns.clear();
 
+  for (const auto& [e, c] : stripe_lanes) {
+    ldout(cct, 5) << __func__ << " stripe lane " << e << " " << c << dendl;
+    c->get_perf_counter()->dec(l_msgr_active_connections);
+    c->stop(false);
+  }
+  stripe_lanes.clear();
+  {
+    std::lock_guard l(stripe_lock);
+    stripe_sets.clear();
+  }
+
   {
     Mutex::Locker l(deleted_lock);
     if (cct->_conf->subsys.should_gather<ceph_subsys_ms, 5>()) {
@@ -872,6 +905,182 @@ int AsyncMessenger::accept_conn(const AsyncConnectionRef& conn)
   return 0;
 }
 
+std::vector<AsyncConnectionRef> AsyncMessenger::get_stripe_lanes(
+  const entity_addrvec_t& peer, int type, const entity_addr_t *target,
+  unsigned want)
+{
+  std::vector<AsyncConnectionRef> lanes;
+  Mutex::Locker l(lock);
+  {
+    // lanes that closed stay until reap_dead()
+    Mutex::Locker l(deleted_lock);
+    auto [first, last] = stripe_lanes.equal_range(peer);
+    for (auto p = first; p != last && lanes.size() < want; ++p) {
+      if (!deleted_conns.count(p->second)) {
+	lanes.push_back(p->second);
+      }
+    }
+  }
+  while (target && !stopped && lanes.size() < want) {
+    Worker *w = stack->get_worker();
+    AsyncConnectionRef conn = new AsyncConnection(cct, this, &dispatch_queue,
+						  w, true, false);
+    conn->stripe_lane = true;
+    entity_addr_t t = *target;
+    conn->connect(peer, type, t);
+    ldout(cct, 10) << __func__ << " " << conn << " " << peer << dendl;
+    stripe_lanes.emplace(peer, conn);
+    w->get_perf_counter()->inc(l_msgr_active_connections);
+    lanes.push_back(std::move(conn));
+  }
+  return lanes;
+}
+
+void AsyncMessenger::accept_stripe_lane(const AsyncConnectionRef& conn)
+{
+  Mutex::Locker l(lock);
+  ldout(cct, 10) << __func__ << " " << conn << " " << *conn->peer_addrs
+		 << dendl;
+  stripe_lanes.emplace(*conn->peer_addrs, conn);
+  conn->get_perf_counter()->inc(l_msgr_active_connections);
+  accepting_conns.erase(conn);
+}
+
+AsyncMessenger::stripe_set_t* AsyncMessenger::_get_stripe_set(
+  uint64_t token, uint64_t id, uint32_t count, const entity_name_t& peer,
+  uint64_t peer_global_id)
+{
+  const auto max_count =
+    cct->_conf.get_val<uint64_t>("ms_async_stripe_connections");
+  if (count < 2 || count > max_count) {
+    ldout(cct, 0) << __func__ << " stripe set " << id << " from " << peer
+		  << " has " << count << " stripes, expected 2.." << max_count
+		  << dendl;
+    return nullptr;
+  }
+  const auto key = std::make_pair(token, id);
+  auto p = stripe_sets.find(key);
+  if (p == stripe_sets.end()) {
+    auto& set = stripe_sets[key];
+    set.stripes.resize(count);
+    set.peer = peer;
+    set.peer_global_id = peer_global_id;
+    set.stamp = ceph::coarse_mono_clock::now();
+    if (!stripe_expire_scheduled) {
+      stripe_expire_scheduled = true;
+      local_worker->center.dispatch_event_external(stripe_expire_handler);
+    }
+    return &set;
+  }
+  auto& set = p->second;
+  if (set.stripes.size() != count || set.peer != peer ||
+      set.peer_global_id != peer_global_id) {
+    ldout(cct, 0) << __func__ << " stripe set " << id << " from " << peer
+		  << " global_id " << peer_global_id << " count " << count
+		  << " does not match the one from " << set.peer
+		  << " global_id " << set.peer_global_id << " count "
+		  << set.stripes.size() << dendl;
+    return nullptr;
+  }
+  return &set;
+}
+
+bool AsyncMessenger::stripe_received(const entity_name_t& peer,
+				     uint64_t peer_global_id, MessageRef m)
+{
+  auto stripe = static_cast<MMsgrStripe*>(m.get());
+  std::function<void()> wakeup;
+  {
+    std::lock_guard l(stripe_lock);
+    if (stripe->index == 0 || stripe->index >= stripe->count) {
+      ldout(cct, 0) << __func__ << " bad " << *stripe << " from " << peer
+		    << dendl;
+      return false;
+    }
+    auto set = _get_stripe_set(stripe->token, stripe->stripe_id,
+			       stripe->count, peer, peer_global_id);
+    if (!set || set->stripes[stripe->index]) {
+      ldout(cct, 0) << __func__ << " unexpected " << *stripe << " from "
+		    << peer << dendl;
+      return false;
+    }
+    set->stripes[stripe->index] = std::move(m);
+    ldout(cct, 20) << __func__ << " " << *stripe << " from " << peer << dendl;
+    if (++set->received == set->stripes.size() - 1) {
+      wakeup = std::move(set->wakeup);
+    }
+  }
+  if (wakeup) {
+    wakeup();
+  }
+  return true;
+}
+
+int AsyncMessenger::stripe_claim(uint64_t token, uint64_t id, uint32_t count,
+				 const entity_name_t& peer,
+				 uint64_t peer_global_id, bufferlist& data,
+				 std::function<void()>&& wakeup)
+{
+  std::lock_guard l(stripe_lock);
+  const auto key = std::make_pair(token, id);
+  auto set = _get_stripe_set(token, id, count, peer, peer_global_id);
+  if (!set) {
+    stripe_sets.erase(key);
+    return -EINVAL;
+  }
+  if (set->received < count - 1) {
+    set->wakeup = std::move(wakeup);
+    return -EAGAIN;
+  }
+  for (uint32_t i = 1; i < count; i++) {
+    data.append(set->stripes[i]->get_data());
+  }
+  stripe_sets.erase(key);
+  return 0;
+}
+
+void AsyncMessenger::stripe_cancel(uint64_t token, uint64_t id)
+{
+  std::lock_guard l(stripe_lock);
+  stripe_sets.erase(std::make_pair(token, id));
+}
+
+void AsyncMessenger::stripe_forget(uint64_t token)
+{
+  std::lock_guard l(stripe_lock);
+  auto p = stripe_sets.lower_bound(std::make_pair(token, 0));
+  while (p != stripe_sets.end() && p->first.first == token) {
+    ldout(cct, 10) << __func__ << " dropping stripe set " << p->first.second
+		   << " from " << p->second.peer << dendl;
+    p = stripe_sets.erase(p);
+  }
+}
+
+void AsyncMessenger::expire_stripe_sets()
+{
+  std::lock_guard l(stripe_lock);
+  stripe_expire_timer = 0;
+  const auto timeout = ceph::make_timespan(
+    cct->_conf.get_val<double>("ms_async_stripe_timeout"));
+  const auto now = ceph::coarse_mono_clock::now();
+  // the sets a connection waits for go when it times out itself
+  for (auto p = stripe_sets.begin(); p != stripe_sets.end(); ) {
+    if (!p->second.wakeup && now - p->second.stamp > timeout) {
+      ldout(cct, 1) << __func__ << " dropping stale stripe set "
+		    << p->first.second << " from " << p->second.peer << dendl;
+      p = stripe_sets.erase(p);
+    } else {
+      ++p;
+    }
+  }
+  if (stripe_sets.empty()) {
+    stripe_expire_scheduled = false;
+    return;
+  }
+  stripe_expire_timer = local_worker->center.create_time_event(
+    std::chrono::duration_cast<std::chrono::microseconds>(timeout).count(),
+    stripe_expire_handler);
+}
 
 bool AsyncMessenger::learned_addr(const entity_addr_t &peer_addr_for_me)
 {
@@ -939,6 +1148,14 @@ int AsyncMessenger::reap_dead()
       if (conns_it != conns.end() && conns_it->second == c)
         conns.erase(conns_it);
       accepting_conns.erase(c);
+      if (c->stripe_lane) {
+	for (auto p = stripe_lanes.begin(); p != stripe_lanes.end(); ++p) {
+	  if (p->second == c) {
+	    stripe_lanes.erase(p);
+	    break;
+	  }
+	}
+      }
       ++num;
     }
     deleted_conns.clear();
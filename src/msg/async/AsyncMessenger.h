@@ -297,6 +297,43 @@ private:
   Mutex deleted_lock;
   set<AsyncConnectionRef> deleted_conns;
 
+  /**
+   * stripe lanes, ours and our peers' (see ms_async_stripe_connections),
+   * by the addrs of the peer whose connection they carry data for
+   *
+   * A lane has the same peer addrs as that connection, so it is kept out
+   * of conns.  Protected by lock.
+   */
+  std::multimap<entity_addrvec_t, AsyncConnectionRef> stripe_lanes;
+
+  /**
+   * stripes that arrived over lanes, waiting for their message, by the
+   * stripe token of the sending session and the stripe set id
+   *
+   * The token is random and only travels on the session's own
+   * connection, so a lane can only add stripes to the sets of a session
+   * it knows the token of, and only if it belongs to the same peer.
+   */
+  struct stripe_set_t {
+    std::vector<MessageRef> stripes;  ///< by MMsgrStripe::index
+    uint32_t received = 0;
+    entity_name_t peer;               ///< who sent the stripes
+    uint64_t peer_global_id = 0;
+    ceph::coarse_mono_clock::time_point stamp;
+    std::function<void()> wakeup;     ///< set while a connection waits
+  };
+  std::mutex stripe_lock;
+  std::map<std::pair<uint64_t, uint64_t>, stripe_set_t> stripe_sets;
+  std::atomic<uint64_t> stripe_seq = {0};
+  /// drops the stripe sets nobody claimed in time, on local_worker
+  EventCallbackRef stripe_expire_handler;
+  bool stripe_expire_scheduled = false;
+  uint64_t stripe_expire_timer = 0;
+
+  stripe_set_t* _get_stripe_set(uint64_t token, uint64_t id, uint32_t count,
+				const entity_name_t& peer,
+				uint64_t peer_global_id);
+
   EventCallbackRef reap_handler;
 
   /// internal cluster protocol version, if any, for talking to entities of the same type.
@@ -352,6 +389,48 @@ public:
   }
 
   int accept_conn(const AsyncConnectionRef& conn);
+
+  /**
+   * Get up to want open stripe lanes to peer.
+   *
+   * @param target if not null, open lanes to this address until there
+   *   are want of them; only the side that opened the connection does,
+   *   the other may not even be listening.
+   */
+  std::vector<AsyncConnectionRef> get_stripe_lanes(
+    const entity_addrvec_t& peer, int type, const entity_addr_t *target,
+    unsigned want);
+  /// Keep an accepted stripe lane around instead of registering it.
+  void accept_stripe_lane(const AsyncConnectionRef& conn);
+  uint64_t get_stripe_id() {
+    return ++stripe_seq;
+  }
+  /**
+   * Stash a stripe received over a lane from peer.  Wakes up the
+   * connection waiting for the stripe set if this completes it.
+   *
+   * @return false if the stripe is malformed or does not fit its set;
+   *   the lane should be faulted.
+   */
+  bool stripe_received(const entity_name_t& peer, uint64_t peer_global_id,
+		       MessageRef m);
+  /**
+   * Append stripes 1..count-1 of stripe set id of the session with token
+   * to data.
+   *
+   * @return 0 if all of them were there and appended, -EAGAIN if not, in
+   *   which case wakeup is called once they are, or -EINVAL if count is
+   *   out of range or the set came from someone other than peer.
+   */
+  int stripe_claim(uint64_t token, uint64_t id, uint32_t count,
+		   const entity_name_t& peer, uint64_t peer_global_id,
+		   bufferlist& data, std::function<void()>&& wakeup);
+  /// Forget stripe set id of a session, e.g. because its connection faulted.
+  void stripe_cancel(uint64_t token, uint64_t id);
+  /// Forget all stripe sets of a session, e.g. because it was reset.
+  void stripe_forget(uint64_t token);
+  /// Drop stripe sets older than ms_async_stripe_timeout nobody waits for.
+  void expire_stripe_sets();
   bool learned_addr(const entity_addr_t &peer_addr_for_me);
   void add_accept(Worker *w, ConnectedSocket cli_socket,
 		  const entity_addr_t &listen_addr,
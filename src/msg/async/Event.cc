@@ -17,6 +17,7 @@
 #include "include/compat.h"
 #include "common/errno.h"
 #include "Event.h"
+#include "Stack.h"
 
 #ifdef HAVE_DPDK
 #include "dpdk/EventDPDK.h"
@@ -107,6 +108,8 @@ int EventCenter::init(int n, unsigned i, const std::string &t)
 
   type = t;
   idx = i;
+  busy_poll_max = std::chrono::microseconds(
+    cct->_conf.get_val<uint64_t>("ms_async_busy_poll_us"));
 
   if (t == "dpdk") {
 #ifdef HAVE_DPDK
@@ -369,7 +372,8 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
   auto now = clock_type::now();
 
   auto it = time_events.begin();
-  bool blocking = pollers.empty() && !external_num_events.load();
+  bool spin = busy_poll_begin();
+  bool blocking = !spin && pollers.empty() && !external_num_events.load();
   // If exists external events or poller, don't block
   if (!blocking) {
     if (it != time_events.end() && now >= it->first)
@@ -448,11 +452,64 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
       numevents += pollers[i]->poll();
   }
 
+  busy_poll_end(spin, numevents);
+
   if (working_dur)
     *working_dur = ceph::mono_clock::now() - working_start;
   return numevents;
 }
 
+/*
+ * Returns true if this pass should poll without blocking because the
+ * center did some work less than busy_poll_window ago.
+ */
+bool EventCenter::busy_poll_begin()
+{
+  if (busy_poll_max == ceph::timespan::zero())
+    return false;
+  auto now = ceph::mono_clock::now();
+  if (now < busy_poll_deadline) {
+    busy_poll_pass_start = now;
+    return true;
+  }
+  if (busy_polling.load(std::memory_order_relaxed)) {
+    // the whole window went by without any work, back off
+    if (logger)
+      logger->inc(l_msgr_busy_poll_misses);
+    busy_poll_window /= 2;
+    // must be ordered before process_events() reads external_num_events:
+    // an event queued by dispatch_event_external() while this was still
+    // true did not wake us up.
+    busy_polling.store(false);
+    ldout(cct, 30) << __func__ << " window now " << busy_poll_window << dendl;
+  }
+  return false;
+}
+
+void EventCenter::busy_poll_end(bool spun, int numevents)
+{
+  if (busy_poll_max == ceph::timespan::zero())
+    return;
+  if (spun && logger) {
+    if (numevents > 0) {
+      logger->inc(l_msgr_busy_poll_hits);
+    } else {
+      logger->tinc(l_msgr_busy_poll_idle_time,
+		   ceph::mono_clock::now() - busy_poll_pass_start);
+    }
+  }
+  if (numevents <= 0)
+    return;
+  if (spun) {
+    // spinning paid off
+    busy_poll_window = std::min(busy_poll_window * 2, busy_poll_max);
+  } else {
+    busy_poll_window = std::max(busy_poll_window, busy_poll_max / 16);
+  }
+  busy_poll_deadline = ceph::mono_clock::now() + busy_poll_window;
+  busy_polling.store(true);
+}
+
 void EventCenter::dispatch_event_external(EventCallbackRef e)
 {
   uint64_t num = 0;
@@ -464,7 +521,8 @@ void EventCenter::dispatch_event_external(EventCallbackRef e)
     external_events.push_back(e);
     num = ++external_num_events;
   }
-  if (num == 1 && !in_thread())
+  // a busy polling owner finds the event without being woken up
+  if (num == 1 && !in_thread() && !busy_polling.load())
     wakeup();
 
   ldout(cct, 30) << __func__ << " " << e << " pending " << num << dendl;
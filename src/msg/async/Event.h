@@ -50,6 +50,7 @@
 #define EVENT_WRITABLE 2
 
 class EventCenter;
+class PerfCounters;
 
 class EventCallback {
 
@@ -175,7 +176,22 @@ class EventCenter {
   unsigned idx;
   AssociatedCenters *global_centers = nullptr;
 
+  // Hybrid busy polling (ms_async_busy_poll_us).  After doing some work
+  // the center keeps polling without blocking until busy_poll_deadline.
+  // The window doubles every time spinning finds work and halves every
+  // time it runs out idle; work found after blocking restarts it at no
+  // less than 1/16 of the maximum, which bounds what an idle burst costs.
+  ceph::timespan busy_poll_max = ceph::timespan::zero();  ///< 0 if off
+  ceph::timespan busy_poll_window = ceph::timespan::zero();
+  ceph::mono_clock::time_point busy_poll_deadline;
+  // true while the owner spins; external threads skip the wakeup then
+  std::atomic<bool> busy_polling = { false };
+  ceph::mono_clock::time_point busy_poll_pass_start;
+  PerfCounters *logger = nullptr;  ///< the worker's, for busy poll stats
+
   int process_time_events();
+  bool busy_poll_begin();
+  void busy_poll_end(bool spun, int numevents);
   FileEvent *_get_file_event(int fd) {
     ceph_assert(fd < nevent);
     return &file_events[fd];
@@ -193,6 +209,7 @@ class EventCenter {
 
   int init(int nevent, unsigned idx, const std::string &t);
   void set_owner();
+  void set_perf_counters(PerfCounters *l) { logger = l; }
   pthread_t get_owner() const { return owner; }
   unsigned get_id() const { return idx; }
 
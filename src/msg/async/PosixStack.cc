@@ -19,8 +19,12 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
@@ -37,15 +41,45 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define HAVE_MSG_ZEROCOPY
+#endif
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   NetHandler &handler;
   int _fd;
   entity_addr_t sa;
   bool connected;
 
+  // MSG_ZEROCOPY sends: the kernel numbers each sendmsg() call and
+  // reports on the socket's error queue when it no longer needs the
+  // pages of a range of calls.  Until then we hold the buffers.
+  struct ZeroCopySend {
+    uint64_t first, last;  ///< call ids
+    uint64_t done = 0;     ///< calls completed
+    bufferlist bl;
+  };
+  CephContext *cct;
+  uint64_t zerocopy_min_size = 0;  ///< 0 if zerocopy is off
+  uint64_t zerocopy_next = 0;      ///< id of the next zerocopy call
+  std::deque<ZeroCopySend> zerocopy_sends;
+
  public:
-  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected,
+				    CephContext *cct)
+      : handler(h), _fd(f), sa(sa), connected(connected), cct(cct) {
+#ifdef HAVE_MSG_ZEROCOPY
+    uint64_t min_size = cct->_conf.get_val<Option::size_t>("ms_async_zerocopy_min_size");
+    int one = 1;
+    if (min_size &&
+	::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+      zerocopy_min_size = min_size;
+    } else if (min_size) {
+      ldout(cct, 1) << __func__ << " unable to set SO_ZEROCOPY: "
+		    << cpp_strerror(errno) << dendl;
+    }
+#endif
+  }
 
   int is_connected() override {
     if (connected)
@@ -67,6 +101,8 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t read(char *buf, size_t len) override {
+    if (!zerocopy_sends.empty())
+      reap_zerocopy();
     ssize_t r = ::read(_fd, buf, len);
     if (r < 0)
       r = -errno;
@@ -75,22 +111,34 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   // return the sent length
   // < 0 means error occurred
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  // *zerocopy_calls counts the calls made with MSG_ZEROCOPY in flags
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+			    int flags = 0, unsigned *zerocopy_calls = nullptr)
   {
     size_t sent = 0;
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0) | flags);
       if (r < 0) {
         if (errno == EINTR) {
           continue;
         } else if (errno == EAGAIN) {
           break;
+#ifdef HAVE_MSG_ZEROCOPY
+        } else if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+          // too many zerocopy sends outstanding; copy this one
+          flags &= ~MSG_ZEROCOPY;
+          continue;
+#endif
         }
         return -errno;
       }
 
+#ifdef HAVE_MSG_ZEROCOPY
+      if (flags & MSG_ZEROCOPY)
+        ++*zerocopy_calls;
+#endif
       sent += r;
       if (len == sent) break;
 
@@ -110,26 +158,103 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     return (ssize_t)sent;
   }
 
+#ifdef HAVE_MSG_ZEROCOPY
+  void complete_zerocopy(uint32_t lo, uint32_t hi) {
+    // widen the kernel's 32 bit ids; all are below zerocopy_next
+    uint64_t first = zerocopy_next - (uint32_t)((uint32_t)zerocopy_next - lo);
+    uint64_t last = zerocopy_next - (uint32_t)((uint32_t)zerocopy_next - hi);
+    for (auto& z : zerocopy_sends) {
+      uint64_t b = std::max(first, z.first), e = std::min(last, z.last);
+      if (b <= e)
+	z.done += e - b + 1;
+    }
+    zerocopy_sends.erase(
+      std::remove_if(zerocopy_sends.begin(), zerocopy_sends.end(),
+		     [](const ZeroCopySend& z) {
+		       return z.done == z.last - z.first + 1;
+		     }),
+      zerocopy_sends.end());
+  }
+#endif
+
+  // release the buffers of zerocopy sends the kernel is done with
+  void reap_zerocopy() {
+#ifdef HAVE_MSG_ZEROCOPY
+    while (!zerocopy_sends.empty()) {
+      char control[128];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(_fd, &msg, MSG_ERRQUEUE) < 0)
+	break;
+      for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+	   cm = CMSG_NXTHDR(&msg, cm)) {
+	if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+	    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+	  continue;
+	auto serr = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+	if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+	  continue;
+	complete_zerocopy(serr->ee_info, serr->ee_data);
+	if ((serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && zerocopy_min_size) {
+	  // the kernel copied anyway (e.g. loopback); stop paying for
+	  // the notifications
+	  ldout(cct, 10) << __func__ << " kernel copied zerocopy send, disabling"
+			 << dendl;
+	  zerocopy_min_size = 0;
+	}
+      }
+    }
+#endif
+  }
+
   ssize_t send(bufferlist &bl, bool more) override {
+    if (!zerocopy_sends.empty())
+      reap_zerocopy();
     size_t sent_bytes = 0;
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = std::size(bl.buffers());
     while (left_pbrs) {
       struct msghdr msg;
       struct iovec msgvec[IOV_MAX];
-      uint64_t size = std::min<uint64_t>(left_pbrs, IOV_MAX);
-      left_pbrs -= size;
+      // buffers of at least zerocopy_min_size go out in their own
+      // MSG_ZEROCOPY calls
+      bool zerocopy = zerocopy_min_size && pb->length() >= zerocopy_min_size;
       memset(&msg, 0, sizeof(msg));
-      msg.msg_iovlen = size;
       msg.msg_iov = msgvec;
       unsigned msglen = 0;
-      for (auto iov = msgvec; iov != msgvec + size; iov++) {
+      bufferlist zerocopy_bl;
+      uint64_t size = 0;
+      for (auto iov = msgvec; size < std::min<uint64_t>(left_pbrs, IOV_MAX);
+	   iov++, size++) {
+	if (zerocopy_min_size &&
+	    (pb->length() >= zerocopy_min_size) != zerocopy)
+	  break;
 	iov->iov_base = (void*)(pb->c_str());
 	iov->iov_len = pb->length();
 	msglen += pb->length();
+	if (zerocopy)
+	  zerocopy_bl.append(*pb);
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      left_pbrs -= size;
+      msg.msg_iovlen = size;
+      ssize_t r;
+#ifdef HAVE_MSG_ZEROCOPY
+      if (zerocopy) {
+	unsigned calls = 0;
+	r = do_sendmsg(_fd, msg, msglen, left_pbrs || more, MSG_ZEROCOPY,
+		       &calls);
+	if (calls) {
+	  zerocopy_sends.push_back(ZeroCopySend{
+	      zerocopy_next, zerocopy_next + calls - 1, 0,
+	      std::move(zerocopy_bl)});
+	  zerocopy_next += calls;
+	}
+      } else
+#endif
+      r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
       if (r < 0)
         return r;
 
@@ -156,7 +281,17 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+    if (!zerocopy_sends.empty()) {
+      reap_zerocopy();
+      if (!zerocopy_sends.empty()) {
+	// the kernel may still transmit from our buffers; reset the
+	// connection so that it drops them before we free them
+	struct linger l = {1, 0};
+	::setsockopt(_fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+      }
+    }
     ::close(_fd);
+    zerocopy_sends.clear();
   }
   int fd() const override {
     return _fd;
@@ -214,7 +349,7 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true, w->cct));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -283,7 +418,7 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock, cct)));
   return 0;
 }
 
@@ -714,8 +714,8 @@ CtPtr ProtocolV1::throttle_dispatch_queue() {
   ldout(cct, 20) << __func__ << dendl;
 
   if (cur_msg_size) {
-    if (!connection->dispatch_queue->dispatch_throttler.get_or_fail(
-            cur_msg_size)) {
+    if (!connection->dispatch_queue->dispatch_throttle_get(
+            connection, cur_msg_size)) {
       ldout(cct, 10)
           << __func__ << " wants " << cur_msg_size
           << " bytes from dispatch throttle "
@@ -1270,7 +1270,8 @@ void ProtocolV1::reset_recv_state()
         << " bytes to dispatch_queue throttler "
         << connection->dispatch_queue->dispatch_throttler.get_current() << "/"
         << connection->dispatch_queue->dispatch_throttler.get_max() << dendl;
-    connection->dispatch_queue->dispatch_throttle_release(cur_msg_size);
+    connection->dispatch_queue->dispatch_throttle_release(connection,
+                                                     cur_msg_size);
   }
 }
 
@@ -12,6 +12,7 @@
 #include "include/random.h"
 #include "auth/AuthClient.h"
 #include "auth/AuthServer.h"
+#include "messages/MMsgrStripe.h"
 
 #define dout_subsys ceph_subsys_ms
 #undef dout_prefix
@@ -81,6 +82,7 @@ if(connection->interceptor) { \
 ProtocolV2::ProtocolV2(AsyncConnection *connection)
     : Protocol(2, connection),
       state(NONE),
+      peer_supported_features(0),
       peer_required_features(0),
       client_cookie(0),
       server_cookie(0),
@@ -91,12 +93,40 @@ ProtocolV2::ProtocolV2(AsyncConnection *connection)
       reconnecting(false),
       replacing(false),
       can_write(false),
+      lockless_send(cct->_conf.get_val<bool>("ms_async_lockless_send")),
+      submitted(lockless_send ? std::make_unique<submitted_queue_t>()
+			      : nullptr),
+      submitted_handler(this),
       bannerExchangeCallback(nullptr),
       next_tag(static_cast<Tag>(0)),
-      keepalive(false) {
+      keepalive(false),
+      stripe_connections(
+	cct->_conf.get_val<uint64_t>("ms_async_stripe_connections")),
+      stripe_min_size(
+	cct->_conf.get_val<Option::size_t>("ms_async_stripe_min_size")),
+      stripe_token(ceph::util::generate_random_number<uint64_t>(1, -1ll)),
+      peer_stripe_token(0),
+      stripe_waiting(false),
+      stripe_wait_id(0),
+      stripe_timer_id(0),
+      compress_min_size(
+	cct->_conf.get_val<Option::size_t>("ms_async_compress_min_size")),
+      compress_secure(cct->_conf.get_val<bool>("ms_async_compress_secure")),
+      decompress_max_size(
+	cct->_conf.get_val<Option::size_t>("ms_async_decompress_max_size")),
+      rx_decompressed_extra(0) {
+  if (cct->_conf.get_val<std::string>("ms_async_compress_mode") == "force") {
+    compressor = Compressor::create(
+      cct, cct->_conf.get_val<std::string>("ms_async_compress_algorithm"));
+  }
 }
 
 ProtocolV2::~ProtocolV2() {
+  if (submitted) {
+    submitted->consume_all([](const submitted_entry_t& entry) {
+      entry.m->put();
+    });
+  }
 }
 
 void ProtocolV2::connect() {
@@ -119,6 +149,8 @@ bool ProtocolV2::is_connected() { return can_write; }
 void ProtocolV2::discard_out_queue() {
   ldout(cct, 10) << __func__ << " started" << dendl;
 
+  _drain_submitted();
+
   for (list<Message *>::iterator p = sent.begin(); p != sent.end(); ++p) {
     ldout(cct, 20) << __func__ << " discard " << *p << dendl;
     (*p)->put();
@@ -134,6 +166,59 @@ void ProtocolV2::discard_out_queue() {
   out_queue.clear();
 }
 
+/*
+ * Moves the messages pushed by lockless senders into out_queue, oldest
+ * first, or drops them if the connection is closed. Must hold write_lock
+ * prior to calling.
+ */
+void ProtocolV2::_drain_submitted() {
+  if (!lockless_send) {
+    return;
+  }
+
+  submitted->consume_all([this](const submitted_entry_t& entry) {
+    Message* const m = entry.m;
+    bool is_prepared = entry.is_prepared;
+    // "features" changes will change the payload encoding
+    if (is_prepared &&
+	(!can_write || connection->get_features() != entry.features)) {
+      m->clear_payload();
+      is_prepared = false;
+      ldout(cct, 10) << "_drain_submitted clear encoded buffer previous "
+		     << entry.features << " != "
+		     << connection->get_features() << dendl;
+    }
+    if (state == CLOSED) {
+      ldout(cct, 10) << "_drain_submitted connection closed."
+		     << " Drop message " << m << dendl;
+      m->put();
+    } else {
+      out_queue[m->get_priority()].emplace_back(
+	out_queue_entry_t{is_prepared, m});
+    }
+  });
+}
+
+void ProtocolV2::handle_submitted() {
+  ldout(cct, 20) << __func__ << dendl;
+
+  // clear before draining so that a sender racing with us either lands
+  // in this batch or schedules another wakeup.
+  submitted_wakeup_pending = false;
+  bool need_write;
+  {
+    std::lock_guard<std::mutex> l(connection->write_lock);
+    _drain_submitted();
+    need_write = !out_queue.empty() &&
+		 ((!replacing && can_write) || state == STANDBY);
+  }
+  if (need_write) {
+    connection->handle_write();
+  }
+  // taken by the sender that scheduled us
+  connection->put();
+}
+
 void ProtocolV2::reset_session() {
   ldout(cct, 1) << __func__ << dendl;
 
@@ -157,6 +242,7 @@ void ProtocolV2::reset_session() {
   message_seq = 0;
   ack_left = 0;
   can_write = false;
+  stripe_token = ceph::util::generate_random_number<uint64_t>(1, -1ll);
 }
 
 void ProtocolV2::stop() {
@@ -200,6 +286,7 @@ void ProtocolV2::requeue_sent() {
 uint64_t ProtocolV2::discard_requeued_up_to(uint64_t out_seq, uint64_t seq) {
   ldout(cct, 10) << __func__ << " " << seq << dendl;
   std::lock_guard<std::mutex> l(connection->write_lock);
+  _drain_submitted();
   if (out_queue.count(CEPH_MSG_PRIO_HIGHEST) == 0) {
     return seq;
   }
@@ -235,6 +322,11 @@ void ProtocolV2::reset_recv_state() {
 
   next_tag = static_cast<Tag>(0);
 
+  cancel_stripes();
+  // the peer resends whatever it striped, with new stripe sets
+  if (peer_stripe_token) {
+    messenger->stripe_forget(peer_stripe_token);
+  }
   reset_throttle();
 }
 
@@ -245,7 +337,7 @@ size_t ProtocolV2::get_current_msg_size() const {
   for (__u8 idx = 1; idx < rx_segments_desc.size(); idx++) {
     sum += rx_segments_desc[idx].length;
   }
-  return sum;
+  return sum + rx_decompressed_extra;
 }
 
 void ProtocolV2::reset_throttle() {
@@ -275,7 +367,8 @@ void ProtocolV2::reset_throttle() {
         << " bytes to dispatch_queue throttler "
         << connection->dispatch_queue->dispatch_throttler.get_current() << "/"
         << connection->dispatch_queue->dispatch_throttler.get_max() << dendl;
-    connection->dispatch_queue->dispatch_throttle_release(cur_msg_size);
+    connection->dispatch_queue->dispatch_throttle_release(connection,
+                                                     cur_msg_size);
   }
 }
 
@@ -291,13 +384,17 @@ CtPtr ProtocolV2::_fault() {
       !(state >= START_CONNECT && state <= SESSION_RECONNECTING)) {
     ldout(cct, 2) << __func__ << " on lossy channel, failing" << dendl;
     stop();
-    connection->dispatch_queue->queue_reset(connection);
+    // nobody outside the messenger knows about stripe lanes
+    if (!connection->stripe_lane) {
+      connection->dispatch_queue->queue_reset(connection);
+    }
     return nullptr;
   }
 
   connection->write_lock.lock();
 
   can_write = false;
+  _drain_submitted();
   // requeue sent items
   requeue_sent();
 
@@ -401,7 +498,33 @@ void ProtocolV2::send_message(Message *m) {
     prepare_send_message(f, m);
   }
 
+  if (lockless_send) {
+    ldout(cct, 5) << __func__ << " submitting message m=" << m
+                  << " type=" << m->get_type() << " " << *m << dendl;
+    m->queue_start = ceph::mono_clock::now();
+    m->trace.event("async enqueueing message");
+    if (submitted->push(submitted_entry_t{m, f, can_fast_prepare})) {
+      connection->logger->inc(l_msgr_send_lockless);
+      // only the first sender of a batch wakes the event thread; the ref
+      // keeps the connection (and submitted_handler) alive until it runs.
+      if (!submitted_wakeup_pending.exchange(true)) {
+	connection->logger->inc(l_msgr_send_lockless_wakeups);
+	connection->get();
+	connection->center->dispatch_event_external(&submitted_handler);
+      }
+      return;
+    }
+    connection->logger->inc(l_msgr_send_lockless_full);
+    ldout(cct, 15) << __func__ << " submitted queue full, taking write_lock"
+		   << dendl;
+  }
+
+  auto lock_start = ceph::mono_clock::now();
   std::lock_guard<std::mutex> l(connection->write_lock);
+  auto locked = ceph::mono_clock::now();
+  connection->logger->tinc(l_msgr_send_lock_wait_time, locked - lock_start);
+  // anything submitted before us goes out first
+  _drain_submitted();
   bool is_prepared = can_fast_prepare;
   // "features" changes will change the payload encoding
   if (can_fast_prepare && (!can_write || connection->get_features() != f)) {
@@ -418,7 +541,7 @@ void ProtocolV2::send_message(Message *m) {
   } else {
     ldout(cct, 5) << __func__ << " enqueueing message m=" << m
                   << " type=" << m->get_type() << " " << *m << dendl;
-    m->queue_start = ceph::mono_clock::now();
+    m->queue_start = locked;
     m->trace.event("async enqueueing message");
     out_queue[m->get_priority()].emplace_back(
       out_queue_entry_t{is_prepared, m});
@@ -461,6 +584,11 @@ void ProtocolV2::read_event() {
     case THROTTLE_DISPATCH_QUEUE:
       run_continuation(CONTINUATION(throttle_dispatch_queue));
       break;
+    case THROTTLE_DONE:
+      if (stripe_waiting) {
+        run_continuation(CONTINUATION(handle_message));
+      }
+      break;
     default:
       break;
   }
@@ -503,11 +631,41 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
                            footer.flags,      header.compat_version,
                            header.reserved};
 
+  // a striped message carries stripe 0 as its data and the description
+  // of the stripe set in place of the (empty) middle.
+  bufferlist stripe_desc;
+  bufferlist stripe0;
+  if (should_stripe(m)) {
+    uint64_t id = messenger->get_stripe_id();
+    uint32_t count = send_stripes(m, id, stripe0);
+    if (count > 1) {
+      encode(id, stripe_desc);
+      encode(count, stripe_desc);
+      encode(m->get_data().length(), stripe_desc);
+      encode(stripe_token, stripe_desc);
+      encode(m->get_data().crc32c(0), stripe_desc);
+      header2.flags |= CEPH_MSG_FOOTER_STRIPED;
+      ldout(cct, 15) << __func__ << " m=" << m << " stripe set " << id
+		     << " count " << count << dendl;
+    }
+  }
+
+  bufferlist front = m->get_payload();
+  bufferlist data = stripe_desc.length() ? stripe0 : m->get_data();
+  if (should_compress()) {
+    if (compress_segment(front)) {
+      header2.flags |= CEPH_MSG_FOOTER_FRONT_COMPRESSED;
+    }
+    if (compress_segment(data)) {
+      header2.flags |= CEPH_MSG_FOOTER_DATA_COMPRESSED;
+    }
+  }
+
   auto message = MessageFrame::Encode(
 			     header2,
-			     m->get_payload(),
-			     m->get_middle(),
-			     m->get_data());
+			     front,
+			     stripe_desc.length() ? stripe_desc : m->get_middle(),
+			     data);
   connection->outcoming_bl.append(message.get_buffer(session_stream_handlers));
 
   ldout(cct, 5) << __func__ << " sending message m=" << m
@@ -541,6 +699,276 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
   return rc;
 }
 
+bool ProtocolV2::should_stripe(Message *m) const {
+  return stripe_connections > 1 &&
+    !connection->stripe_lane &&
+    m->get_data().length() >= stripe_min_size &&
+    m->get_middle().length() == 0 &&
+    HAVE_MSGR2_FEATURE(peer_supported_features, STRIPE);
+}
+
+uint32_t ProtocolV2::send_stripes(Message *m, uint64_t id,
+				  bufferlist& stripe0) {
+  // lanes are only opened by the side that opened this connection; the
+  // other one reuses them.
+  auto lanes = messenger->get_stripe_lanes(
+    *connection->peer_addrs, connection->get_peer_type(),
+    connection->policy.server ? nullptr : &connection->target_addr,
+    stripe_connections - 1);
+  if (lanes.empty()) {
+    return 1;
+  }
+
+  const bufferlist& data = m->get_data();
+  const uint32_t len = data.length();
+  const uint32_t stripe_len = p2roundup<uint32_t>(
+    div_round_up(len, lanes.size() + 1), CEPH_PAGE_SIZE);
+  const uint32_t count = div_round_up(len, stripe_len);
+  if (count < 2) {
+    return 1;
+  }
+
+  stripe0.substr_of(data, 0, stripe_len);
+  for (uint32_t i = 1; i < count; i++) {
+    const uint32_t off = i * stripe_len;
+    bufferlist bl;
+    bl.substr_of(data, off, std::min(stripe_len, len - off));
+    auto stripe = ceph::make_message<MMsgrStripe>(stripe_token, id, i, count);
+    stripe->set_data(bl);
+    stripe->set_priority(m->get_priority());
+    lanes[(i - 1) % lanes.size()]->send_message(stripe.detach());
+  }
+  return count;
+}
+
+bool ProtocolV2::claim_stripes() {
+  bufferlist& desc = rx_segments_data[SegmentIndex::Msg::MIDDLE];
+  uint64_t id;
+  uint32_t count;
+  uint32_t len;
+  uint64_t token;
+  uint32_t crc;
+  try {
+    auto p = desc.cbegin();
+    decode(id, p);
+    decode(count, p);
+    decode(len, p);
+    decode(token, p);
+    decode(crc, p);
+  } catch (const buffer::error &e) {
+    ldout(cct, 1) << __func__ << " failed to decode stripe set" << dendl;
+    return false;
+  }
+  if (count < 2 || count > stripe_connections) {
+    ldout(cct, 1) << __func__ << " bad stripe set " << id << " count "
+		  << count << dendl;
+    return false;
+  }
+  peer_stripe_token = token;
+
+  if (stripe_waiting) {
+    ceph_assert(stripe_wait_id == id);
+    // wakeup_from() unregisters the timer when it fires
+    if (!connection->register_time_events.count(stripe_timer_id)) {
+      ldout(cct, 1) << __func__ << " stripe set " << id << " incomplete after "
+		    << cct->_conf.get_val<double>("ms_async_stripe_timeout")
+		    << " seconds" << dendl;
+      cancel_stripes();
+      return false;
+    }
+  }
+
+  bufferlist& data = rx_segments_data[SegmentIndex::Msg::DATA];
+  AsyncConnectionRef conn(connection);
+  auto wakeup = [conn] {
+    conn->center->submit_to(conn->center->get_id(),
+			    [conn] { conn->process(); }, true);
+  };
+  int r = messenger->stripe_claim(token, id, count, peer_name,
+				  connection->get_peer_global_id(), data,
+				  std::move(wakeup));
+  if (r == -EAGAIN) {
+    if (!stripe_waiting) {
+      ldout(cct, 15) << __func__ << " waiting for stripe set " << id << dendl;
+      stripe_waiting = true;
+      stripe_wait_id = id;
+      stripe_timer_id = connection->center->create_time_event(
+	cct->_conf.get_val<double>("ms_async_stripe_timeout") * 1000000,
+	connection->wakeup_handler);
+      connection->register_time_events.insert(stripe_timer_id);
+    }
+    return false;
+  }
+  cancel_stripes();
+  if (r < 0) {
+    return false;
+  }
+
+  if (data.length() != len) {
+    ldout(cct, 1) << __func__ << " stripe set " << id << " has "
+		  << data.length() << " bytes, expected " << len << dendl;
+    return false;
+  }
+  if (data.crc32c(0) != crc) {
+    ldout(cct, 1) << __func__ << " stripe set " << id
+		  << " data crc mismatch" << dendl;
+    return false;
+  }
+  desc.clear();
+  auto& header = reinterpret_cast<ceph_msg_header2&>(
+    *rx_segments_data[SegmentIndex::Msg::HEADER].c_str());
+  header.flags &= ~CEPH_MSG_FOOTER_STRIPED;
+  return true;
+}
+
+void ProtocolV2::cancel_stripes() {
+  if (!stripe_waiting) {
+    return;
+  }
+  messenger->stripe_cancel(peer_stripe_token, stripe_wait_id);
+  stripe_waiting = false;
+  // may be called for another connection being replaced; its own thread
+  // ignores the timer when it fires.
+  if (connection->center->in_thread()) {
+    connection->center->delete_time_event(stripe_timer_id);
+    connection->register_time_events.erase(stripe_timer_id);
+  }
+}
+
+bool ProtocolV2::should_compress() const {
+  // compressing before encrypting lets an attacker who can inject data
+  // learn secrets sent along with it from the frame sizes (CRIME, BREACH)
+  return compressor &&
+    connection->policy.compress &&
+    (compress_secure || !auth_meta->is_mode_secure()) &&
+    HAVE_MSGR2_FEATURE(peer_supported_features, COMPRESSION);
+}
+
+bool ProtocolV2::compress_segment(bufferlist& bl) {
+  if (bl.length() < compress_min_size) {
+    return false;
+  }
+
+  bufferlist out;
+  encode((__u8)compressor->get_type(), out);
+  encode((uint32_t)bl.length(), out);
+  auto start = ceph::mono_clock::now();
+  int r = compressor->compress(bl, out);
+  connection->logger->tinc(l_msgr_compress_time,
+			   ceph::mono_clock::now() - start);
+  if (r < 0 || out.length() >= bl.length()) {
+    ldout(cct, 20) << __func__ << " " << bl.length() << " bytes sent as is"
+		   << " r=" << r << dendl;
+    connection->logger->inc(l_msgr_compress_rejected);
+    return false;
+  }
+
+  ldout(cct, 20) << __func__ << " " << bl.length() << " -> " << out.length()
+		 << " bytes" << dendl;
+  connection->logger->inc(l_msgr_compress_in_bytes, bl.length());
+  connection->logger->inc(l_msgr_compress_out_bytes, out.length());
+  bl.swap(out);
+  return true;
+}
+
+bool ProtocolV2::decompress_segment(bufferlist& bl, uint64_t *max_len) {
+  __u8 alg;
+  uint32_t len;
+  auto p = bl.cbegin();
+  try {
+    decode(alg, p);
+    decode(len, p);
+  } catch (const buffer::error &e) {
+    ldout(cct, 1) << __func__ << " bad compressed segment header" << dendl;
+    return false;
+  }
+  if (alg == Compressor::COMP_ALG_NONE || alg >= decompressors.size()) {
+    ldout(cct, 1) << __func__ << " unknown algorithm " << (int)alg << dendl;
+    return false;
+  }
+  // a segment is only sent compressed if that made it smaller
+  if (len <= bl.length() || len > *max_len) {
+    ldout(cct, 1) << __func__ << " " << bl.length() << " bytes would"
+		  << " decompress to " << len << ", at most " << *max_len
+		  << " allowed" << dendl;
+    return false;
+  }
+  auto& decompressor = decompressors[alg];
+  if (!decompressor) {
+    decompressor = Compressor::create(cct, alg);
+    if (!decompressor) {
+      return false;
+    }
+  }
+
+  // the throttlers were charged the on-wire size, the message releases
+  // what it holds once decompressed
+  const uint64_t extra = len - bl.length();
+  if (connection->policy.throttler_bytes) {
+    connection->policy.throttler_bytes->take(extra);
+  }
+  connection->dispatch_queue->dispatch_throttle_take(connection, extra);
+  rx_decompressed_extra += extra;
+  *max_len -= len;
+
+  bufferlist out;
+  auto start = ceph::mono_clock::now();
+  int r = decompressor->decompress(p, p.get_remaining(), out);
+  connection->logger->tinc(l_msgr_decompress_time,
+			   ceph::mono_clock::now() - start);
+  if (r < 0 || out.length() != len) {
+    ldout(cct, 1) << __func__ << " " << decompressor->get_type_name()
+		  << " failed r=" << r << ", got " << out.length()
+		  << " bytes, expected " << len << dendl;
+    return false;
+  }
+
+  connection->logger->inc(l_msgr_decompress_in_bytes, bl.length());
+  connection->logger->inc(l_msgr_decompress_out_bytes, out.length());
+  bl.swap(out);
+  return true;
+}
+
+bool ProtocolV2::decompress_message() {
+  auto& header = reinterpret_cast<ceph_msg_header2&>(
+    *rx_segments_data[SegmentIndex::Msg::HEADER].c_str());
+  const auto flags = header.flags;
+  if (!(flags & (CEPH_MSG_FOOTER_FRONT_COMPRESSED |
+		 CEPH_MSG_FOOTER_DATA_COMPRESSED))) {
+    return true;
+  }
+  // the whole message, as decompressed, must fit
+  uint64_t max_len = decompress_max_size;
+  for (unsigned idx = SegmentIndex::Msg::FRONT;
+       idx < rx_segments_data.size(); idx++) {
+    max_len -= std::min<uint64_t>(max_len, rx_segments_data[idx].length());
+  }
+  if (flags & CEPH_MSG_FOOTER_FRONT_COMPRESSED) {
+    if (rx_segments_data.size() <= SegmentIndex::Msg::FRONT) {
+      return false;
+    }
+    auto& front = rx_segments_data[SegmentIndex::Msg::FRONT];
+    max_len += front.length();
+    if (!decompress_segment(front, &max_len)) {
+      return false;
+    }
+  }
+  if (flags & CEPH_MSG_FOOTER_DATA_COMPRESSED) {
+    if (rx_segments_data.size() <= SegmentIndex::Msg::DATA) {
+      return false;
+    }
+    auto& data = rx_segments_data[SegmentIndex::Msg::DATA];
+    max_len += data.length();
+    if (!decompress_segment(data, &max_len)) {
+      return false;
+    }
+  }
+  // so that a message waiting for its stripes is not decompressed twice
+  header.flags &= ~(CEPH_MSG_FOOTER_FRONT_COMPRESSED |
+		    CEPH_MSG_FOOTER_DATA_COMPRESSED);
+  return true;
+}
+
 void ProtocolV2::append_keepalive() {
   ldout(cct, 10) << __func__ << dendl;
   auto keepalive_frame = KeepAliveFrame::Encode();
@@ -585,6 +1013,7 @@ void ProtocolV2::write_event() {
   ssize_t r = 0;
 
   connection->write_lock.lock();
+  _drain_submitted();
   if (can_write) {
     if (keepalive) {
       append_keepalive();
@@ -683,7 +1112,8 @@ void ProtocolV2::write_event() {
 }
 
 bool ProtocolV2::is_queued() {
-  return !out_queue.empty() || connection->is_queued();
+  return !out_queue.empty() || (submitted && !submitted->empty()) ||
+	 connection->is_queued();
 }
 
 uint32_t ProtocolV2::get_onwire_size(const uint32_t logical_size) const {
@@ -735,6 +1165,22 @@ CtPtr ProtocolV2::read(CONTINUATION_RXBPTR_TYPE<ProtocolV2> &next,
   return nullptr;
 }
 
+CtPtr ProtocolV2::read_zero_copy(CONTINUATION_RX_TYPE<ProtocolV2> &next,
+                                 unsigned len, bufferlist *bl) {
+  ssize_t r = connection->read_zero_copy(len, bl,
+    [&next, this](char *buffer, int r) {
+      next.setParams(buffer, r);
+      run_continuation(next);
+    });
+  if (r <= 0) {
+    // error or done synchronously
+    next.setParams(nullptr, r);
+    return &next;
+  }
+
+  return nullptr;
+}
+
 template <class F>
 CtPtr ProtocolV2::write(const std::string &desc,
                         CONTINUATION_TYPE<ProtocolV2> &next,
@@ -780,7 +1226,9 @@ CtPtr ProtocolV2::_banner_exchange(CtRef callback) {
   bannerExchangeCallback = &callback;
 
   bufferlist banner_payload;
-  encode((uint64_t)CEPH_MSGR2_SUPPORTED_FEATURES, banner_payload, 0);
+  encode((uint64_t)CEPH_MSGR2_SUPPORTED_FEATURES &
+	 ~cct->_conf.get_val<uint64_t>("ms_inject_msgr2_features_off"),
+	 banner_payload, 0);
   encode((uint64_t)CEPH_MSGR2_REQUIRED_FEATURES, banner_payload, 0);
 
   bufferlist bl;
@@ -887,6 +1335,7 @@ CtPtr ProtocolV2::_handle_peer_banner_payload(rx_buffer_t &&buffer, int r) {
     return nullptr;
   }
 
+  this->peer_supported_features = peer_supported_features;
   this->peer_required_features = peer_required_features;
   if (this->peer_required_features == 0) {
     this->connection_features = msgr2_required;
@@ -1073,6 +1522,7 @@ CtPtr ProtocolV2::handle_read_frame_preamble_main(rx_buffer_t &&buffer, int r) {
 
     rx_segments_desc.clear();
     rx_segments_data.clear();
+    rx_decompressed_extra = 0;
 
     if (main_preamble.num_segments > MAX_NUM_SEGMENTS) {
       ldout(cct, 30) << __func__
@@ -1146,10 +1596,35 @@ CtPtr ProtocolV2::read_frame_segment() {
 
   // description of current segment to read
   const auto& cur_rx_desc = rx_segments_desc.at(rx_segments_data.size());
+  // let the data segment point into the stack's own receive buffers if
+  // it can hand them over
+  if (cur_rx_desc.alignment == segment_t::PAGE_SIZE_ALIGNMENT &&
+      !pre_auth.enabled &&
+      messenger->get_stack()->support_zero_copy_read()) {
+    rx_segments_data.emplace_back();
+    return read_zero_copy(CONTINUATION(handle_read_frame_segment_zero_copy),
+			  get_onwire_size(cur_rx_desc.length),
+			  &rx_segments_data.back());
+  }
+
   rx_buffer_t rx_buffer;
   try {
-    rx_buffer = buffer::ptr_node::create(buffer::create_aligned(
-      get_onwire_size(cur_rx_desc.length), cur_rx_desc.alignment));
+    const unsigned onwire_len = get_onwire_size(cur_rx_desc.length);
+    ceph::unique_leakable_ptr<buffer::raw> raw;
+    // only the data segment is page aligned
+    if (cur_rx_desc.alignment == segment_t::PAGE_SIZE_ALIGNMENT) {
+      auto& pool = *connection->worker->rx_buffer_pool;
+      bool reused = false;
+      raw = pool.get(onwire_len, &reused);
+      connection->logger->inc(reused ? l_msgr_rx_buffer_reuses :
+			      l_msgr_rx_buffer_allocs);
+      connection->logger->set(l_msgr_rx_buffer_cached_bytes,
+			      pool.get_cached_bytes());
+    }
+    if (!raw) {
+      raw = buffer::create_aligned(onwire_len, cur_rx_desc.alignment);
+    }
+    rx_buffer = buffer::ptr_node::create(std::move(raw));
   } catch (std::bad_alloc&) {
     // Catching because of potential issues with satisfying alignment.
     ldout(cct, 20) << __func__ << " can't allocate aligned rx_buffer "
@@ -1173,7 +1648,22 @@ CtPtr ProtocolV2::handle_read_frame_segment(rx_buffer_t &&rx_buffer, int r) {
 
   rx_segments_data.emplace_back();
   rx_segments_data.back().push_back(std::move(rx_buffer));
+  return finish_read_frame_segment();
+}
 
+CtPtr ProtocolV2::handle_read_frame_segment_zero_copy(char *buffer, int r) {
+  ldout(cct, 20) << __func__ << " r=" << r << dendl;
+
+  if (r < 0) {
+    ldout(cct, 1) << __func__ << " read frame segment failed r=" << r << " ("
+                  << cpp_strerror(r) << ")" << dendl;
+    return _fault();
+  }
+
+  return finish_read_frame_segment();
+}
+
+CtPtr ProtocolV2::finish_read_frame_segment() {
   // decrypt incoming data
   // FIXME: if (auth_meta->is_mode_secure()) {
   if (session_stream_handlers.rx) {
@@ -1270,6 +1760,7 @@ CtPtr ProtocolV2::ready() {
 
   {
     std::lock_guard<std::mutex> l(connection->write_lock);
+    _drain_submitted();
     can_write = true;
     if (!out_queue.empty()) {
       connection->center->dispatch_event_external(connection->write_handler);
@@ -1365,6 +1856,19 @@ CtPtr ProtocolV2::handle_message() {
 #endif
   recv_stamp = ceph_clock_now();
 
+  if (!decompress_message()) {
+    return _fault();
+  }
+
+  if (rx_segments_data.size() > SegmentIndex::Msg::MIDDLE &&
+      !connection->stripe_lane) {
+    auto& hdrbl = rx_segments_data[SegmentIndex::Msg::HEADER];
+    auto& h = reinterpret_cast<const ceph_msg_header2&>(*hdrbl.c_str());
+    if ((h.flags & CEPH_MSG_FOOTER_STRIPED) && !claim_stripes()) {
+      return stripe_waiting ? nullptr : _fault();
+    }
+  }
+
   // we need to get the size before std::moving segments data
   const size_t cur_msg_size = get_current_msg_size();
   auto msg_frame = MessageFrame::Decode(std::move(rx_segments_data));
@@ -1471,6 +1975,26 @@ CtPtr ProtocolV2::handle_message() {
                 << " from=" << message->get_source() << " type=" << header.type
                 << " " << *message << dendl;
 
+  if (connection->stripe_lane) {
+    // stripes wait for their message in the messenger, not in the
+    // dispatch queue
+    state = READY;
+    connection->logger->inc(l_msgr_recv_messages);
+    connection->dispatch_queue->dispatch_throttle_release(
+      connection, message->get_dispatch_throttle_size());
+    message->set_dispatch_throttle_size(0);
+    if (message->get_type() != MSG_MSGR_STRIPE) {
+      ldout(cct, 0) << __func__ << " dropping " << *message
+		    << " received over stripe lane" << dendl;
+      message->put();
+    } else if (!messenger->stripe_received(peer_name,
+					   connection->get_peer_global_id(),
+					   MessageRef{message, false})) {
+      return _fault();
+    }
+    return CONTINUE(read_frame);
+  }
+
   bool need_dispatch_writer = false;
   if (!connection->policy.lossy) {
     ack_left++;
@@ -1482,7 +2006,8 @@ CtPtr ProtocolV2::handle_message() {
   connection->logger->inc(l_msgr_recv_messages);
   connection->logger->inc(
       l_msgr_recv_bytes,
-      cur_msg_size + sizeof(ceph_msg_header) + sizeof(ceph_msg_footer));
+      cur_msg_size - rx_decompressed_extra +
+      sizeof(ceph_msg_header) + sizeof(ceph_msg_footer));
 
   messenger->ms_fast_preprocess(message);
   auto fast_dispatch_time = ceph::mono_clock::now();
@@ -1593,8 +2118,8 @@ CtPtr ProtocolV2::throttle_dispatch_queue() {
 
   const size_t cur_msg_size = get_current_msg_size();
   if (cur_msg_size) {
-    if (!connection->dispatch_queue->dispatch_throttler.get_or_fail(
-            cur_msg_size)) {
+    if (!connection->dispatch_queue->dispatch_throttle_get(
+            connection, cur_msg_size)) {
       ldout(cct, 10)
           << __func__ << " wants " << cur_msg_size
           << " bytes from dispatch throttle "
@@ -1866,6 +2391,9 @@ CtPtr ProtocolV2::send_client_ident() {
   if (connection->policy.lossy) {
     flags |= CEPH_MSG_CONNECT_LOSSY;
   }
+  if (connection->stripe_lane) {
+    flags |= CEPH_MSG_CONNECT_STRIPE_LANE;
+  }
 
   auto client_ident = ClientIdentFrame::Encode(
       messenger->get_myaddrs(),
@@ -2097,8 +2625,10 @@ CtPtr ProtocolV2::handle_server_ident(ceph::bufferlist &payload)
     ceph_assert(connection->delay_state->ready());
   }
 
-  connection->dispatch_queue->queue_connect(connection);
-  messenger->ms_deliver_handle_fast_connect(connection);
+  if (!connection->stripe_lane) {
+    connection->dispatch_queue->queue_connect(connection);
+    messenger->ms_deliver_handle_fast_connect(connection);
+  }
 
   return ready();
 }
@@ -2338,6 +2868,15 @@ CtPtr ProtocolV2::handle_client_ident(ceph::bufferlist &payload)
 
   peer_global_seq = client_ident.global_seq();
 
+  if (client_ident.flags() & CEPH_MSG_CONNECT_STRIPE_LANE) {
+    // a lane never replaces nor is replaced by anything, and it only
+    // carries MMsgrStripe which can simply be resent with a new message
+    ldout(cct, 10) << __func__ << " stripe lane" << dendl;
+    connection->stripe_lane = true;
+    connection->policy.lossy = true;
+    return send_server_ident();
+  }
+
   // Looks good so far, let's check if there is already an existing connection
   // to this peer.
 
@@ -2659,6 +3198,9 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
     existing->set_features(connection_features);
   }
   exproto->peer_global_seq = peer_global_seq;
+  // the peer may have restarted with other msgr2 features
+  exproto->peer_supported_features = peer_supported_features;
+  exproto->peer_required_features = peer_required_features;
 
   auto temp_cs = std::move(connection->cs);
   EventCenter *new_center = connection->center;
@@ -2683,8 +3225,10 @@ CtPtr ProtocolV2::reuse_connection(const AsyncConnectionRef& existing,
   existing->state = AsyncConnection::STATE_NONE;
   // Discard existing prefetch buffer in `recv_buf`
   existing->recv_start = existing->recv_end = 0;
+  existing->recv_zero_copy.clear();
   // there shouldn't exist any buffer
   ceph_assert(connection->recv_start == connection->recv_end);
+  ceph_assert(connection->recv_zero_copy.length() == 0);
 
   auto deactivate_existing = std::bind(
       [existing, new_worker, new_center, exproto](ConnectedSocket &cs) mutable {
@@ -2794,7 +3338,12 @@ CtPtr ProtocolV2::send_server_ident() {
   connection->lock.unlock();
   // Because "replacing" will prevent other connections preempt this addr,
   // it's safe that here we don't acquire Connection's lock
-  ssize_t r = messenger->accept_conn(connection);
+  ssize_t r = 0;
+  if (connection->stripe_lane) {
+    messenger->accept_stripe_lane(connection);
+  } else {
+    r = messenger->accept_conn(connection);
+  }
 
   connection->inject_delay();
 
@@ -2820,8 +3369,10 @@ CtPtr ProtocolV2::send_server_ident() {
   connection->set_features(connection_features);
 
   // notify
-  connection->dispatch_queue->queue_accept(connection);
-  messenger->ms_deliver_handle_fast_accept(connection);
+  if (!connection->stripe_lane) {
+    connection->dispatch_queue->queue_accept(connection);
+    messenger->ms_deliver_handle_fast_accept(connection);
+  }
 
   INTERCEPT(12);
 
@@ -5,8 +5,10 @@
 #define _MSG_ASYNC_PROTOCOL_V2_
 
 #include <boost/container/static_vector.hpp>
+#include <boost/lockfree/queue.hpp>
 
 #include "Protocol.h"
+#include "compressor/Compressor.h"
 #include "crypto_onwire.h"
 #include "frames_v2.h"
 
@@ -73,6 +75,7 @@ public:
 private:
   entity_name_t peer_name;
   State state;
+  uint64_t peer_supported_features;
   uint64_t peer_required_features;
 
   uint64_t client_cookie;
@@ -89,6 +92,33 @@ private:
     Message* m {nullptr};
   };
   std::map<int, std::list<out_queue_entry_t>> out_queue;
+
+  // With ms_async_lockless_send, send_message() does not take write_lock.
+  // Senders push onto a preallocated lock-free queue and only the first
+  // sender of a batch wakes the event thread, which moves the whole batch
+  // into out_queue under write_lock. Once the queue is full senders fall
+  // back to write_lock, draining the queue first to keep the order.
+  struct submitted_entry_t {
+    Message* m;
+    uint64_t features;
+    bool is_prepared;
+  };
+  static constexpr size_t SUBMITTED_QUEUE_SIZE = 128;
+  using submitted_queue_t = boost::lockfree::queue<
+    submitted_entry_t,
+    boost::lockfree::capacity<SUBMITTED_QUEUE_SIZE>>;
+  class C_handle_submitted : public EventCallback {
+    ProtocolV2 *protocol;
+  public:
+    explicit C_handle_submitted(ProtocolV2 *p) : protocol(p) {}
+    void do_request(uint64_t fd) override {
+      protocol->handle_submitted();
+    }
+  };
+  const bool lockless_send;
+  std::unique_ptr<submitted_queue_t> submitted;
+  std::atomic<bool> submitted_wakeup_pending{false};
+  C_handle_submitted submitted_handler;
   std::list<Message *> sent;
   std::atomic<uint64_t> out_seq{0};
   std::atomic<uint64_t> in_seq{0};
@@ -114,12 +144,53 @@ private:
 
   bool keepalive;
 
+  // Striping (ms_async_stripe_connections): the data of a large message
+  // is split into stripes; stripe 0 stays in the message frame, the
+  // others travel as MMsgrStripe over extra connections ("lanes") to the
+  // same peer.  The middle segment of the frame describes the stripe set
+  // and the receiver holds the message in THROTTLE_DONE until the set is
+  // complete.  The description carries a random per-session token, which
+  // the stripes repeat, so that stripes only join the messages of the
+  // session they were sent for, and a crc of the whole data.
+  const uint32_t stripe_connections;
+  const uint64_t stripe_min_size;
+  uint64_t stripe_token;       ///< ours, sent with our striped messages
+  uint64_t peer_stripe_token;  ///< the peer's, 0 until it striped something
+  bool stripe_waiting;
+  uint64_t stripe_wait_id;
+  uint64_t stripe_timer_id;
+
+  bool should_stripe(Message *m) const;
+  uint32_t send_stripes(Message *m, uint64_t id, ceph::bufferlist& stripe0);
+  bool claim_stripes();
+  void cancel_stripes();
+
+  // On-wire compression (ms_async_compress_mode): the front and data
+  // segments of a message frame are compressed separately, before any
+  // encryption.  Header flags tell the receiver which of them are, and a
+  // compressed segment starts with the algorithm and its original length.
+  const uint64_t compress_min_size;
+  const bool compress_secure;  ///< also compress in secure mode
+  const uint64_t decompress_max_size;
+  CompressorRef compressor;  ///< null unless we compress what we send
+  std::array<CompressorRef, Compressor::COMP_ALG_LAST> decompressors;
+  /// what the current message grew by when decompressed, charged to the
+  /// throttlers on top of its on-wire size
+  uint64_t rx_decompressed_extra;
+
+  bool should_compress() const;
+  bool compress_segment(ceph::bufferlist& bl);
+  bool decompress_segment(ceph::bufferlist& bl, uint64_t *max_len);
+  bool decompress_message();
+
   ostream &_conn_prefix(std::ostream *_dout);
   void run_continuation(Ct<ProtocolV2> *pcontinuation);
   void run_continuation(Ct<ProtocolV2> &continuation);
 
   Ct<ProtocolV2> *read(CONTINUATION_RXBPTR_TYPE<ProtocolV2> &next,
                        rx_buffer_t&& buffer);
+  Ct<ProtocolV2> *read_zero_copy(CONTINUATION_RX_TYPE<ProtocolV2> &next,
+                                 unsigned len, bufferlist *bl);
   template <class F>
   Ct<ProtocolV2> *write(const std::string &desc,
                         CONTINUATION_TYPE<ProtocolV2> &next,
@@ -134,6 +205,8 @@ private:
   void reset_throttle();
   Ct<ProtocolV2> *_fault();
   void discard_out_queue();
+  void _drain_submitted();
+  void handle_submitted();
   void reset_session();
   void prepare_send_message(uint64_t features, Message *m);
   out_queue_entry_t _get_next_outgoing();
@@ -156,10 +229,12 @@ private:
   CONTINUATION_DECL(ProtocolV2, finish_auth);
   READ_BPTR_HANDLER_CONTINUATION_DECL(ProtocolV2, handle_read_frame_preamble_main);
   READ_BPTR_HANDLER_CONTINUATION_DECL(ProtocolV2, handle_read_frame_segment);
+  READ_HANDLER_CONTINUATION_DECL(ProtocolV2, handle_read_frame_segment_zero_copy);
   READ_BPTR_HANDLER_CONTINUATION_DECL(ProtocolV2, handle_read_frame_epilogue_main);
   CONTINUATION_DECL(ProtocolV2, throttle_message);
   CONTINUATION_DECL(ProtocolV2, throttle_bytes);
   CONTINUATION_DECL(ProtocolV2, throttle_dispatch_queue);
+  CONTINUATION_DECL(ProtocolV2, handle_message);
 
   Ct<ProtocolV2> *read_frame();
   Ct<ProtocolV2> *finish_auth();
@@ -167,6 +242,8 @@ private:
   Ct<ProtocolV2> *handle_read_frame_preamble_main(rx_buffer_t &&buffer, int r);
   Ct<ProtocolV2> *read_frame_segment();
   Ct<ProtocolV2> *handle_read_frame_segment(rx_buffer_t &&rx_buffer, int r);
+  Ct<ProtocolV2> *handle_read_frame_segment_zero_copy(char *buffer, int r);
+  Ct<ProtocolV2> *finish_read_frame_segment();
   Ct<ProtocolV2> *handle_read_frame_epilogue_main(rx_buffer_t &&buffer, int r);
   Ct<ProtocolV2> *handle_read_frame_dispatch();
   Ct<ProtocolV2> *handle_frame_payload();
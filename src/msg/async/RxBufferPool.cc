@@ -0,0 +1,74 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "RxBufferPool.h"
+#include "common/deleter.h"
+#include "include/intarith.h"
+
+RxBufferPool::~RxBufferPool()
+{
+  for (auto& bucket : buckets) {
+    for (char *buf : bucket.free) {
+      ::free(buf);
+    }
+  }
+}
+
+ceph::unique_leakable_ptr<ceph::buffer::raw> RxBufferPool::get(unsigned len,
+							       bool *reused)
+{
+  if (!max_bytes || !len || len > MAX_SIZE) {
+    return nullptr;
+  }
+  const unsigned order = std::max(MIN_ORDER, cbits(len - 1));
+
+  char *buf = nullptr;
+  {
+    auto& bucket = buckets[order - MIN_ORDER];
+    std::lock_guard l(bucket.lock);
+    if (!bucket.free.empty()) {
+      buf = bucket.free.back();
+      bucket.free.pop_back();
+      cached_bytes -= 1ull << order;
+    }
+  }
+  *reused = buf;
+  if (!buf && ::posix_memalign((void**)(void*)&buf, CEPH_PAGE_SIZE,
+			       1ull << order)) {
+    throw std::bad_alloc();
+  }
+
+  return ceph::unique_leakable_ptr<ceph::buffer::raw>(
+    ceph::buffer::claim_buffer(
+      len, buf,
+      make_deleter([pool = shared_from_this(), buf, order] {
+	pool->put(buf, order);
+      })));
+}
+
+void RxBufferPool::put(char *buf, unsigned order)
+{
+  const uint64_t size = 1ull << order;
+  // reserve the room first, so that racing puts can't overshoot max_bytes
+  uint64_t cached = cached_bytes.load(std::memory_order_relaxed);
+  do {
+    if (cached + size > max_bytes) {
+      ::free(buf);
+      return;
+    }
+  } while (!cached_bytes.compare_exchange_weak(cached, cached + size));
+  auto& bucket = buckets[order - MIN_ORDER];
+  std::lock_guard l(bucket.lock);
+  bucket.free.push_back(buf);
+}
@@ -0,0 +1,70 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+#define CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "include/buffer.h"
+
+/**
+ * Page aligned receive buffers for message data, recycled by size class.
+ *
+ * Each messenger worker has one.  A buffer goes back to the pool of the
+ * worker that read it when the last bufferptr to it is dropped, on
+ * whatever thread that happens (typically the one that finished with the
+ * message, e.g. an OSD op thread or the BlueStore kv thread), and outlives
+ * the worker if need be.  Buffers are powers of two from 4KB to MAX_SIZE;
+ * anything larger is left to the allocator.
+ */
+class RxBufferPool : public std::enable_shared_from_this<RxBufferPool> {
+ public:
+  static constexpr unsigned MIN_ORDER = 12;
+  static constexpr unsigned MAX_ORDER = 22;
+  static constexpr unsigned MAX_SIZE = 1u << MAX_ORDER;
+
+  /// @param max_bytes how much idle memory to keep around, 0 to disable
+  explicit RxBufferPool(uint64_t max_bytes) : max_bytes(max_bytes) {}
+  ~RxBufferPool();
+
+  /**
+   * Get a page aligned buffer of len bytes.
+   *
+   * @param reused set to whether the buffer came from the pool
+   * @return nullptr if len is not pooled or the pool is disabled
+   */
+  ceph::unique_leakable_ptr<ceph::buffer::raw> get(unsigned len,
+						   bool *reused);
+
+  /// idle memory held by the pool
+  uint64_t get_cached_bytes() const {
+    return cached_bytes;
+  }
+
+ private:
+  struct bucket_t {
+    std::mutex lock;
+    std::vector<char*> free;
+  };
+  std::array<bucket_t, MAX_ORDER - MIN_ORDER + 1> buckets;
+  const uint64_t max_bytes;
+  std::atomic<uint64_t> cached_bytes = {0};
+
+  void put(char *buf, unsigned order);
+};
+
+#endif
@@ -21,6 +21,7 @@
 #include "common/perf_counters.h"
 #include "msg/msg_types.h"
 #include "msg/async/Event.h"
+#include "msg/async/RxBufferPool.h"
 
 class Worker;
 class ConnectedSocketImpl {
@@ -214,6 +215,27 @@ enum {
   l_msgr_send_messages_queue_lat,
   l_msgr_handle_ack_lat,
 
+  l_msgr_rx_buffer_allocs,
+  l_msgr_rx_buffer_reuses,
+  l_msgr_rx_buffer_cached_bytes,
+
+  l_msgr_compress_in_bytes,
+  l_msgr_compress_out_bytes,
+  l_msgr_compress_rejected,
+  l_msgr_compress_time,
+  l_msgr_decompress_in_bytes,
+  l_msgr_decompress_out_bytes,
+  l_msgr_decompress_time,
+
+  l_msgr_send_lockless,
+  l_msgr_send_lockless_full,
+  l_msgr_send_lockless_wakeups,
+  l_msgr_send_lock_wait_time,
+
+  l_msgr_busy_poll_hits,
+  l_msgr_busy_poll_misses,
+  l_msgr_busy_poll_idle_time,
+
   l_msgr_last,
 };
 
@@ -231,12 +253,16 @@ class Worker {
 
   std::atomic_uint references;
   EventCenter center;
+  /// data segment buffers, see ms_async_rx_buffer_pool_size
+  std::shared_ptr<RxBufferPool> rx_buffer_pool;
 
   Worker(const Worker&) = delete;
   Worker& operator=(const Worker&) = delete;
 
   Worker(CephContext *c, unsigned i)
-    : cct(c), perf_logger(NULL), id(i), references(0), center(c) {
+    : cct(c), perf_logger(NULL), id(i), references(0), center(c),
+      rx_buffer_pool(std::make_shared<RxBufferPool>(
+	c->_conf.get_val<Option::size_t>("ms_async_rx_buffer_pool_size"))) {
     char name[128];
     sprintf(name, "AsyncMessenger::Worker-%u", id);
     // initialize perf_logger
@@ -257,8 +283,30 @@ class Worker {
     plb.add_time_avg(l_msgr_send_messages_queue_lat, "msgr_send_messages_queue_lat", "Network sent messages lat");
     plb.add_time_avg(l_msgr_handle_ack_lat, "msgr_handle_ack_lat", "Connection handle ack lat");
 
+    plb.add_u64_counter(l_msgr_rx_buffer_allocs, "msgr_rx_buffer_allocs", "Data segment buffers allocated");
+    plb.add_u64_counter(l_msgr_rx_buffer_reuses, "msgr_rx_buffer_reuses", "Data segment buffers reused from the pool");
+    plb.add_u64(l_msgr_rx_buffer_cached_bytes, "msgr_rx_buffer_cached_bytes", "Idle memory in the data segment buffer pool", NULL, 0, unit_t(UNIT_BYTES));
+
+    plb.add_u64_counter(l_msgr_compress_in_bytes, "msgr_compress_in_bytes", "Bytes of message segments sent compressed", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_compress_out_bytes, "msgr_compress_out_bytes", "Bytes those segments took on the wire", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_compress_rejected, "msgr_compress_rejected", "Message segments sent as is because they did not compress");
+    plb.add_time(l_msgr_compress_time, "msgr_compress_time", "The total time of compressing message segments");
+    plb.add_u64_counter(l_msgr_decompress_in_bytes, "msgr_decompress_in_bytes", "Bytes of compressed message segments received", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_decompress_out_bytes, "msgr_decompress_out_bytes", "Bytes those segments decompressed to", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_time(l_msgr_decompress_time, "msgr_decompress_time", "The total time of decompressing message segments");
+
+    plb.add_u64_counter(l_msgr_send_lockless, "msgr_send_lockless", "Messages queued without taking the connection's write lock");
+    plb.add_u64_counter(l_msgr_send_lockless_full, "msgr_send_lockless_full", "Lockless sends that found the queue full and took the write lock");
+    plb.add_u64_counter(l_msgr_send_lockless_wakeups, "msgr_send_lockless_wakeups", "Event thread wakeups to pick up lockless sends");
+    plb.add_time(l_msgr_send_lock_wait_time, "msgr_send_lock_wait_time", "The total time senders waited for the connection's write lock");
+
+    plb.add_u64_counter(l_msgr_busy_poll_hits, "msgr_busy_poll_hits", "Busy polling passes that found work without a wakeup");
+    plb.add_u64_counter(l_msgr_busy_poll_misses, "msgr_busy_poll_misses", "Busy polling windows that ran out without finding work");
+    plb.add_time(l_msgr_busy_poll_idle_time, "msgr_busy_poll_idle_time", "The total time busy polling found nothing to do");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
+    center.set_perf_counters(perf_logger);
   }
   virtual ~Worker() {
     if (perf_logger) {
@@ -74,6 +74,14 @@ struct TxHandler {
   // Generates authentication signature and returns bufferlist crafted
   // basing on plaintext from preceding call to _update().
   virtual ceph::bufferlist authenticated_encrypt_final() = 0;
+
+  // Encrypt an entire frame (preamble, segments and epilogue) in one go.
+  // This is equivalent to _reset() followed by _update() for each of the
+  // bufferlists in order and then _final(), and produces the same bytes,
+  // but lets implementation coalesce the fragments and hand the cipher
+  // as few and as large chunks as possible.
+  virtual ceph::bufferlist authenticated_encrypt_frame(
+    std::initializer_list<const ceph::bufferlist*> frame_parts) = 0;
 };
 
 class RxHandler {
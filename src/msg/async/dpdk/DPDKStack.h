@@ -73,7 +73,7 @@ class NativeConnectedSocketImpl : public ConnectedSocketImpl {
     while (left > 0) {
       if (!_cache_ptr) {
         _cache_ptr.construct();
-        r = zero_copy_read(*_cache_ptr);
+        r = read_frag(*_cache_ptr);
         if (r <= 0) {
           _cache_ptr.destroy();
           if (r == -EAGAIN)
@@ -98,6 +98,15 @@ class NativeConnectedSocketImpl : public ConnectedSocketImpl {
   }
 
   virtual ssize_t zero_copy_read(bufferptr &data) override {
+    // hand over what read() left behind first
+    if (_cache_ptr) {
+      data = std::move(*_cache_ptr);
+      _cache_ptr.destroy();
+      return data.length();
+    }
+    return read_frag(data);
+  }
+  ssize_t read_frag(bufferptr &data) {
     auto err = _conn.get_errno();
     if (err <= 0)
       return err;
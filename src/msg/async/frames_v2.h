@@ -7,6 +7,8 @@
 #include <array>
 #include <utility>
 
+#include <boost/container/static_vector.hpp>
+
 /**
  * Protocol V2 Frame Structures
  * 
@@ -228,11 +230,13 @@ private:
   }
 
   template <size_t... Is>
-  void reset_tx_handler(
+  ceph::bufferlist encrypt_frame(
     ceph::crypto::onwire::rxtx_t &session_stream_handlers,
+    const ceph::bufferlist &epilogue_bl,
     std::index_sequence<Is...>)
   {
-    session_stream_handlers.tx->reset_tx_handler({ segments[Is].length()... });
+    return session_stream_handlers.tx->authenticated_encrypt_frame(
+      { &segments[Is]..., &epilogue_bl });
   }
 
 public:
@@ -248,28 +252,18 @@ public:
         segment = segment_onwire_bufferlist(std::move(segment));
       }
 
-      // let's cipher allocate one huge buffer for entire ciphertext.
-      reset_tx_handler(
-          session_stream_handlers, std::make_index_sequence<SegmentsNumV>());
-
-      for (auto& segment : segments) {
-        if (segment.length()) {
-          session_stream_handlers.tx->authenticated_encrypt_update(
-            std::move(segment));
-        }
-      }
-
       // in secure mode we craft only the late_flags. Signature (for AES-GCM
       // called auth tag) will be added by the cipher.
-      {
-        epilogue_secure_block_t epilogue;
-        ::memset(&epilogue, 0, sizeof(epilogue));
-        ceph::bufferlist epilogue_bl;
-        epilogue_bl.append(reinterpret_cast<const char*>(&epilogue),
-                           sizeof(epilogue));
-        session_stream_handlers.tx->authenticated_encrypt_update(epilogue_bl);
-      }
-      return session_stream_handlers.tx->authenticated_encrypt_final();
+      epilogue_secure_block_t epilogue;
+      ::memset(&epilogue, 0, sizeof(epilogue));
+      ceph::bufferlist epilogue_bl;
+      epilogue_bl.append(reinterpret_cast<const char*>(&epilogue),
+                         sizeof(epilogue));
+
+      // let's cipher take the whole frame at once and allocate one huge
+      // buffer for entire ciphertext.
+      return encrypt_frame(session_stream_handlers, epilogue_bl,
+                           std::make_index_sequence<SegmentsNumV>());
     } else {
       // plain mode
       epilogue_plain_block_t epilogue;
@@ -138,6 +138,8 @@ enum {
   l_msgr_rdma_inflight_tx_chunks,
   l_msgr_rdma_rx_bufs_in_use,
   l_msgr_rdma_rx_bufs_total,
+  l_msgr_rdma_rx_zero_copy_bufs,
+  l_msgr_rdma_rx_copied_bufs,
 
   l_msgr_rdma_tx_total_wc,
   l_msgr_rdma_tx_total_wc_errors,
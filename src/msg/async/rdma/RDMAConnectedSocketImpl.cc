@@ -14,6 +14,7 @@
  *
  */
 #include "RDMAStack.h"
+#include "common/deleter.h"
 
 #define dout_subsys ceph_subsys_ms
 #undef dout_prefix
@@ -27,7 +28,7 @@ RDMAConnectedSocketImpl::RDMAConnectedSocketImpl(CephContext *cct, Infiniband* i
     active(false), pending(false)
 {
   if (!cct->_conf->ms_async_rdma_cm) {
-    qp = infiniband->create_queue_pair(cct, s->get_tx_cq(), s->get_rx_cq(), IBV_QPT_RC, NULL);
+    qp = infiniband->create_queue_pair(cct, s->get_tx_cq(), w->get_rx_cq(), IBV_QPT_RC, NULL);
     my_msg.qpn = qp->get_local_qp_number();
     my_msg.psn = qp->get_initial_psn();
     my_msg.lid = infiniband->get_lid();
@@ -365,49 +366,63 @@ ssize_t RDMAConnectedSocketImpl::read_buffers(char* buf, size_t len)
 
 ssize_t RDMAConnectedSocketImpl::zero_copy_read(bufferptr &data)
 {
-  if (error)
-    return -error;
-  static const int MAX_COMPLETIONS = 16;
-  ibv_wc wc[MAX_COMPLETIONS];
-  ssize_t size = 0;
-
-  ibv_wc*  response;
-  Chunk* chunk;
-  bool loaded = false;
-  auto iter = buffers.begin();
-  if (iter != buffers.end()) {
-    chunk = *iter;
-    // FIXME need to handle release
-    // auto del = std::bind(&Chunk::post_srq, std::move(chunk), infiniband);
-    buffers.erase(iter);
-    loaded = true;
-    size = chunk->bound;
+  uint64_t i = 0;
+  int r = ::read(notify_fd, &i, sizeof(i));
+  ldout(cct, 20) << __func__ << " notify_fd : " << i << " in " << my_msg.qpn << " r = " << r << dendl;
+
+  if (!active || !connected) {
+    ldout(cct, 1) << __func__ << " when ib not active or not connected." << dendl;
+    return -EAGAIN;
   }
 
-  std::vector<ibv_wc> cqe;
-  get_wc(cqe);
-  if (cqe.empty())
-    return size == 0 ? -EAGAIN : size;
+  if (buffers.empty()) {
+    std::vector<ibv_wc> cqe;
+    get_wc(cqe);
+    ldout(cct, 20) << __func__ << " poll queue got " << cqe.size() << " responses. QP: " << my_msg.qpn << dendl;
+    for (auto& response : cqe) {
+      ceph_assert(response.status == IBV_WC_SUCCESS);
+      Chunk* chunk = reinterpret_cast<Chunk *>(response.wr_id);
+      chunk->prepare_read(response.byte_len);
+      worker->perf_logger->inc(l_msgr_rdma_rx_bytes, response.byte_len);
+      if (response.byte_len == 0) {
+        dispatcher->perf_logger->inc(l_msgr_rdma_rx_fin);
+        error = ECONNRESET;
+        ldout(cct, 20) << __func__ << " got remote close msg..." << dendl;
+        dispatcher->post_chunk_to_pool(chunk);
+      } else {
+        buffers.push_back(chunk);
+      }
+    }
+    worker->perf_logger->inc(l_msgr_rdma_rx_chunks, cqe.size());
+  }
 
-  ldout(cct, 20) << __func__ << " pool completion queue got " << cqe.size() << " responses."<< dendl;
+  if (buffers.empty()) {
+    return error ? -error : -EAGAIN;
+  }
 
-  for (size_t i = 0; i < cqe.size(); ++i) {
-    response = &wc[i];
-    chunk = reinterpret_cast<Chunk*>(response->wr_id);
-    chunk->prepare_read(response->byte_len);
-    if (!loaded && i == 0) {
-      // FIXME need to handle release
-      // auto del = std::bind(&Chunk::post_srq, std::move(chunk), infiniband);
-      size = chunk->bound;
-      continue;
-    }
-    buffers.push_back(chunk);
-    iter++;
+  // hand over the unread part of the first chunk, it goes back to the pool
+  // once the messenger is done with it
+  Chunk *chunk = buffers.front();
+  buffers.erase(buffers.begin());
+  const uint32_t len = chunk->get_bound() - chunk->get_offset();
+  char *p = chunk->buffer + chunk->get_offset();
+  if (dispatcher->hold_zero_copy_rx_chunk()) {
+    // ~RDMAStack waits for these, so the dispatcher outlives them
+    RDMADispatcher *d = dispatcher;
+    data = buffer::claim_buffer(len, p, make_deleter([d, chunk]() {
+      d->release_zero_copy_rx_chunk(chunk);
+    }));
+  } else {
+    data = buffer::copy(p, len);
+    dispatcher->post_chunk_to_pool(chunk);
   }
+  update_post_backlog();
+  ldout(cct, 25) << __func__ << " got " << len << " bytes, buffers size: " << buffers.size() << dendl;
 
-  if (size == 0)
-    return -EAGAIN;
-  return size;
+  if (!buffers.empty()) {
+    notify();
+  }
+  return len;
 }
 
 ssize_t RDMAConnectedSocketImpl::send(bufferlist &bl, bool more)
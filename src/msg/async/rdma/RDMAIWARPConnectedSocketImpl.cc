@@ -157,7 +157,7 @@ void RDMAIWARPConnectedSocketImpl::activate() {
 int RDMAIWARPConnectedSocketImpl::alloc_resource() {
   ldout(cct, 30) << __func__ << dendl;
   qp = infiniband->create_queue_pair(cct, dispatcher->get_tx_cq(),
-      dispatcher->get_rx_cq(), IBV_QPT_RC, cm_id);
+      worker->get_rx_cq(), IBV_QPT_RC, cm_id);
   if (!qp) {
     return -1;
   }
@@ -53,6 +53,8 @@ RDMADispatcher::RDMADispatcher(CephContext* c, RDMAStack* s)
   plb.add_u64_counter(l_msgr_rdma_inflight_tx_chunks, "inflight_tx_chunks", "The number of inflight tx chunks");
   plb.add_u64_counter(l_msgr_rdma_rx_bufs_in_use, "rx_bufs_in_use", "The number of rx buffers that are holding data and being processed");
   plb.add_u64_counter(l_msgr_rdma_rx_bufs_total, "rx_bufs_total", "The total number of rx buffers");
+  plb.add_u64(l_msgr_rdma_rx_zero_copy_bufs, "rx_zero_copy_bufs", "The number of rx buffers held by received messages");
+  plb.add_u64_counter(l_msgr_rdma_rx_copied_bufs, "rx_copied_bufs", "The number of rx buffers copied because too many were held by received messages");
 
   plb.add_u64_counter(l_msgr_rdma_tx_total_wc, "tx_total_wc", "The number of tx work comletions");
   plb.add_u64_counter(l_msgr_rdma_tx_total_wc_errors, "tx_total_wc_errors", "The number of tx errors");
@@ -96,6 +98,25 @@ void RDMADispatcher::polling_start()
   rx_cq = get_stack()->get_infiniband().create_comp_queue(cct, rx_cc);
   ceph_assert(rx_cq);
 
+  if (cct->_conf.get_val<bool>("ms_async_rdma_worker_rx_cq")) {
+    for (unsigned i = 0; i < stack->get_num_worker(); ++i) {
+      static_cast<RDMAWorker*>(stack->get_worker(i))->create_rx_cq();
+    }
+  }
+
+  // keep enough rx buffers out of messages' hands to refill the receive
+  // queue
+  zero_copy_rx_max = cct->_conf.get_val<uint64_t>("ms_async_rdma_zero_copy_rx_buffers");
+  if (cct->_conf->ms_async_rdma_receive_buffers > 0) {
+    const uint64_t spare = cct->_conf->ms_async_rdma_receive_buffers -
+      get_stack()->get_infiniband().get_rx_queue_len();
+    if (zero_copy_rx_max > spare) {
+      ldout(cct, 1) << __func__ << " limiting zero copy rx buffers to "
+		    << spare << dendl;
+      zero_copy_rx_max = spare;
+    }
+  }
+
   t = std::thread(&RDMADispatcher::polling, this);
   ceph_pthread_setname(t.native_handle(), "rdma-polling");
 }
@@ -171,15 +192,45 @@ int RDMADispatcher::post_chunks_to_rq(int num, ibv_qp *qp)
   return get_stack()->get_infiniband().post_chunks_to_rq(num, qp);
 }
 
+bool RDMADispatcher::hold_zero_copy_rx_chunk()
+{
+  if (zero_copy_rx_chunks.fetch_add(1) >= zero_copy_rx_max) {
+    --zero_copy_rx_chunks;
+    perf_logger->inc(l_msgr_rdma_rx_copied_bufs);
+    return false;
+  }
+  perf_logger->inc(l_msgr_rdma_rx_zero_copy_bufs);
+  return true;
+}
+
+void RDMADispatcher::release_zero_copy_rx_chunk(Chunk* chunk)
+{
+  Mutex::Locker l(lock);
+  get_stack()->get_infiniband().post_chunk_to_pool(chunk);
+  perf_logger->dec(l_msgr_rdma_rx_bufs_in_use);
+  perf_logger->dec(l_msgr_rdma_rx_zero_copy_bufs);
+  // the stack may go as soon as the last one is back
+  if (--zero_copy_rx_chunks == 0)
+    zero_copy_rx_cond.Signal();
+}
+
+void RDMADispatcher::wait_zero_copy_rx_chunks()
+{
+  Mutex::Locker l(lock);
+  while (zero_copy_rx_chunks) {
+    ldout(cct, 1) << __func__ << " waiting for " << zero_copy_rx_chunks
+		  << " rx buffers still held by messages" << dendl;
+    zero_copy_rx_cond.WaitInterval(lock, utime_t(1, 0));
+  }
+}
+
 void RDMADispatcher::polling()
 {
   static int MAX_COMPLETIONS = 32;
   ibv_wc wc[MAX_COMPLETIONS];
 
-  std::map<RDMAConnectedSocketImpl*, std::vector<ibv_wc> > polled;
   std::vector<ibv_wc> tx_cqe;
   ldout(cct, 20) << __func__ << " going to poll tx cq: " << tx_cq << " rx cq: " << rx_cq << dendl;
-  RDMAConnectedSocketImpl *conn = nullptr;
   uint64_t last_inactive = Cycles::rdtsc();
   bool rearmed = false;
   int r = 0;
@@ -196,43 +247,7 @@ void RDMADispatcher::polling()
     if (rx_ret > 0) {
       ldout(cct, 20) << __func__ << " rx completion queue got " << rx_ret
                      << " responses."<< dendl;
-      perf_logger->inc(l_msgr_rdma_rx_total_wc, rx_ret);
-      perf_logger->inc(l_msgr_rdma_rx_bufs_in_use, rx_ret);
-
-      Mutex::Locker l(lock);//make sure connected socket alive when pass wc
-
-      for (int i = 0; i < rx_ret; ++i) {
-        ibv_wc* response = &wc[i];
-        Chunk* chunk = reinterpret_cast<Chunk *>(response->wr_id);
-
-        if (response->status == IBV_WC_SUCCESS) {
-          ceph_assert(wc[i].opcode == IBV_WC_RECV);
-          conn = get_conn_lockless(response->qp_num);
-          if (!conn) {
-            ldout(cct, 1) << __func__ << " csi with qpn " << response->qp_num << " may be dead. chunk " << chunk << " will be back ? " << r << dendl;
-            get_stack()->get_infiniband().post_chunk_to_pool(chunk);
-            perf_logger->dec(l_msgr_rdma_rx_bufs_in_use);
-          } else {
-            conn->post_chunks_to_rq(1);
-            polled[conn].push_back(*response);
-          }
-        } else {
-          perf_logger->inc(l_msgr_rdma_rx_total_wc_errors);
-          ldout(cct, 1) << __func__ << " work request returned error for buffer(" << chunk
-              << ") status(" << response->status << ":"
-              << get_stack()->get_infiniband().wc_status_to_string(response->status) << ")" << dendl;
-          if (response->status != IBV_WC_WR_FLUSH_ERR) {
-            conn = get_conn_lockless(response->qp_num);
-            if (conn && conn->is_connected())
-              conn->fault();
-          }
-          get_stack()->get_infiniband().post_chunk_to_pool(chunk);
-          perf_logger->dec(l_msgr_rdma_rx_bufs_in_use);
-        }
-      }
-      for (auto &&i : polled)
-        i.first->pass_wc(std::move(i.second));
-      polled.clear();
+      handle_rx_event(wc, rx_ret);
     }
 
     if (!tx_ret && !rx_ret) {
@@ -428,6 +443,49 @@ void RDMADispatcher::handle_tx_event(ibv_wc *cqe, int n)
   post_tx_buffer(tx_chunks);
 }
 
+void RDMADispatcher::handle_rx_event(ibv_wc *cqe, int n)
+{
+  std::map<RDMAConnectedSocketImpl*, std::vector<ibv_wc> > polled;
+  RDMAConnectedSocketImpl *conn = nullptr;
+
+  perf_logger->inc(l_msgr_rdma_rx_total_wc, n);
+  perf_logger->inc(l_msgr_rdma_rx_bufs_in_use, n);
+
+  Mutex::Locker l(lock);//make sure connected socket alive when pass wc
+
+  for (int i = 0; i < n; ++i) {
+    ibv_wc* response = &cqe[i];
+    Chunk* chunk = reinterpret_cast<Chunk *>(response->wr_id);
+
+    if (response->status == IBV_WC_SUCCESS) {
+      ceph_assert(response->opcode == IBV_WC_RECV);
+      conn = get_conn_lockless(response->qp_num);
+      if (!conn) {
+        ldout(cct, 1) << __func__ << " csi with qpn " << response->qp_num << " may be dead. chunk " << chunk << " will be back" << dendl;
+        get_stack()->get_infiniband().post_chunk_to_pool(chunk);
+        perf_logger->dec(l_msgr_rdma_rx_bufs_in_use);
+      } else {
+        conn->post_chunks_to_rq(1);
+        polled[conn].push_back(*response);
+      }
+    } else {
+      perf_logger->inc(l_msgr_rdma_rx_total_wc_errors);
+      ldout(cct, 1) << __func__ << " work request returned error for buffer(" << chunk
+          << ") status(" << response->status << ":"
+          << get_stack()->get_infiniband().wc_status_to_string(response->status) << ")" << dendl;
+      if (response->status != IBV_WC_WR_FLUSH_ERR) {
+        conn = get_conn_lockless(response->qp_num);
+        if (conn && conn->is_connected())
+          conn->fault();
+      }
+      get_stack()->get_infiniband().post_chunk_to_pool(chunk);
+      perf_logger->dec(l_msgr_rdma_rx_bufs_in_use);
+    }
+  }
+  for (auto &&i : polled)
+    i.first->pass_wc(std::move(i.second));
+}
+
 /**
  * Add the given Chunks to the given free queue.
  *
@@ -451,7 +509,8 @@ void RDMADispatcher::post_tx_buffer(std::vector<Chunk*> &chunks)
 
 RDMAWorker::RDMAWorker(CephContext *c, unsigned i)
   : Worker(c, i), stack(nullptr),
-    tx_handler(new C_handle_cq_tx(this)), lock("RDMAWorker::lock")
+    tx_handler(new C_handle_cq_tx(this)), lock("RDMAWorker::lock"),
+    rx_handler(new C_handle_cq_rx(this))
 {
   // initialize perf_logger
   char name[128];
@@ -474,7 +533,9 @@ RDMAWorker::RDMAWorker(CephContext *c, unsigned i)
 
 RDMAWorker::~RDMAWorker()
 {
+  ceph_assert(!rx_cq);
   delete tx_handler;
+  delete rx_handler;
 }
 
 void RDMAWorker::initialize()
@@ -555,6 +616,53 @@ int RDMAWorker::get_reged_mem(RDMAConnectedSocketImpl *o, std::vector<Chunk*> &c
 }
 
 
+void RDMAWorker::create_rx_cq()
+{
+  ceph_assert(!rx_cq);
+  rx_cc = get_stack()->get_infiniband().create_comp_channel(cct);
+  ceph_assert(rx_cc);
+  rx_cq = get_stack()->get_infiniband().create_comp_queue(cct, rx_cc);
+  ceph_assert(rx_cq);
+  ldout(cct, 20) << __func__ << " worker " << id << " rx cq: " << rx_cq << dendl;
+  center.submit_to(center.get_id(), [this]() {
+    center.create_file_event(rx_cc->get_fd(), EVENT_READABLE, rx_handler);
+  }, true);
+}
+
+void RDMAWorker::destroy_rx_cq()
+{
+  if (!rx_cq)
+    return;
+  rx_cc->ack_events();
+  delete rx_cq;
+  delete rx_cc;
+  rx_cq = nullptr;
+  rx_cc = nullptr;
+}
+
+Infiniband::CompletionQueue* RDMAWorker::get_rx_cq() const
+{
+  return rx_cq ? rx_cq : stack->get_dispatcher().get_rx_cq();
+}
+
+void RDMAWorker::handle_rx_event()
+{
+  static const int MAX_COMPLETIONS = 32;
+  ibv_wc wc[MAX_COMPLETIONS];
+
+  // rearm before polling so that a completion arriving after the last
+  // poll raises a new event
+  while (rx_cc->get_cq_event())
+    ;
+  rx_cq->rearm_notify();
+  int n;
+  while ((n = rx_cq->poll_cq(MAX_COMPLETIONS, wc)) > 0) {
+    ldout(cct, 20) << __func__ << " rx completion queue got " << n
+                   << " responses." << dendl;
+    dispatcher->handle_rx_event(wc, n);
+  }
+}
+
 void RDMAWorker::handle_pending_message()
 {
   ldout(cct, 20) << __func__ << " pending conns " << pending_sent_conns.size() << dendl;
@@ -578,7 +686,8 @@ void RDMAWorker::handle_pending_message()
 }
 
 RDMAStack::RDMAStack(CephContext *cct, const string &t)
-  : NetworkStack(cct, t), ib(cct), dispatcher(cct, this)
+  : NetworkStack(cct, t), ib(cct), dispatcher(cct, this),
+    zero_copy_rx(cct->_conf.get_val<uint64_t>("ms_async_rdma_zero_copy_rx_buffers") > 0)
 {
   ldout(cct, 20) << __func__ << " constructing RDMAStack..." << dendl;
 
@@ -595,6 +704,14 @@ RDMAStack::~RDMAStack()
   if (cct->_conf->ms_async_rdma_enable_hugepage) {
     unsetenv("RDMAV_HUGEPAGES_SAFE");	//remove env variable on destruction
   }
+  // zero copy reads handed out buffers in the rx chunks, which go with
+  // the stack, and whose deleters call back into the dispatcher
+  dispatcher.wait_zero_copy_rx_chunks();
+  // the workers' completion queues can go once all queue pairs are gone
+  dispatcher.polling_stop();
+  for (unsigned i = 0; i < get_num_worker(); ++i) {
+    static_cast<RDMAWorker*>(get_worker(i))->destroy_rx_cq();
+  }
 }
 
 void RDMAStack::spawn_worker(unsigned i, std::function<void ()> &&func)
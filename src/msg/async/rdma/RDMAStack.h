@@ -24,6 +24,7 @@
 #include <thread>
 
 #include "common/ceph_context.h"
+#include "common/Cond.h"
 #include "common/debug.h"
 #include "common/errno.h"
 #include "msg/async/Stack.h"
@@ -70,6 +71,12 @@ class RDMADispatcher {
   /// no outstanding transmit buffers to be lost.
   std::vector<QueuePair*> dead_queue_pairs;
 
+  /// rx chunks handed to the messenger by zero_copy_read() and not
+  /// released yet, see ms_async_rdma_zero_copy_rx_buffers
+  std::atomic<uint64_t> zero_copy_rx_chunks = {0};
+  uint64_t zero_copy_rx_max = 0;
+  Cond zero_copy_rx_cond; // signalled under `lock` when the last is released
+
   std::atomic<uint64_t> num_pending_workers = {0};
   Mutex w_lock; // protect pending workers
   // fixme: lockfree
@@ -114,12 +121,20 @@ class RDMADispatcher {
   Infiniband::CompletionQueue* get_rx_cq() const { return rx_cq; }
   void notify_pending_workers();
   void handle_tx_event(ibv_wc *cqe, int n);
+  void handle_rx_event(ibv_wc *cqe, int n);
   void post_tx_buffer(std::vector<Chunk*> &chunks);
 
   std::atomic<uint64_t> inflight = {0};
 
   void post_chunk_to_pool(Chunk* chunk);
   int post_chunks_to_rq(int num, ibv_qp *qp=NULL);
+  // account for an rx chunk held by a received message, false if too
+  // many are held already and the chunk should be copied instead
+  bool hold_zero_copy_rx_chunk();
+  void release_zero_copy_rx_chunk(Chunk* chunk);
+  // wait for the messenger to release every rx chunk it holds, which live
+  // in memory owned by the stack
+  void wait_zero_copy_rx_chunks();
 };
 
 class RDMAWorker : public Worker {
@@ -133,6 +148,10 @@ class RDMAWorker : public Worker {
   std::list<RDMAConnectedSocketImpl*> pending_sent_conns;
   RDMADispatcher* dispatcher = nullptr;
   Mutex lock;
+  // own receive completion queue, see ms_async_rdma_worker_rx_cq
+  CompletionChannel *rx_cc = nullptr;
+  CompletionQueue *rx_cq = nullptr;
+  EventCallbackRef rx_handler;
 
   class C_handle_cq_tx : public EventCallback {
     RDMAWorker *worker;
@@ -143,6 +162,15 @@ class RDMAWorker : public Worker {
     }
   };
 
+  class C_handle_cq_rx : public EventCallback {
+    RDMAWorker *worker;
+    public:
+    explicit C_handle_cq_rx(RDMAWorker *w): worker(w) {}
+    void do_request(uint64_t fd) {
+      worker->handle_rx_event();
+    }
+  };
+
  public:
   PerfCounters *perf_logger;
   explicit RDMAWorker(CephContext *c, unsigned i);
@@ -159,6 +187,10 @@ class RDMAWorker : public Worker {
     pending_sent_conns.remove(o);
   }
   void handle_pending_message();
+  void create_rx_cq();
+  void destroy_rx_cq();
+  CompletionQueue* get_rx_cq() const;
+  void handle_rx_event();
   void set_stack(RDMAStack *s) { stack = s; }
   void notify_worker() {
     center.dispatch_event_external(tx_handler);
@@ -341,11 +373,12 @@ class RDMAStack : public NetworkStack {
   RDMADispatcher dispatcher;
 
   std::atomic<bool> fork_finished = {false};
+  const bool zero_copy_rx;
 
  public:
   explicit RDMAStack(CephContext *cct, const string &t);
   virtual ~RDMAStack();
-  virtual bool support_zero_copy_read() const override { return false; }
+  virtual bool support_zero_copy_read() const override { return zero_copy_rx; }
   virtual bool nonblock_connect_need_writable_event() const override { return false; }
 
   virtual void spawn_worker(unsigned i, std::function<void ()> &&func) override;
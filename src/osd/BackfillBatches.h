@@ -0,0 +1,109 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_OSD_BACKFILLBATCHES_H
+#define CEPH_OSD_BACKFILLBATCHES_H
+
+#include <map>
+
+#include "common/hobject.h"
+#include "include/ceph_assert.h"
+
+/**
+ * BackfillBatches - small backfill pushes sharing a recovery op
+ *
+ * recover_backfill() charges a batch of small objects as a single op
+ * against osd_recovery_max_active.  A batch is started as one recovery
+ * op, keyed by its first object, and that op is finished once the last
+ * object of the batch is recovered or given up on.  Any other object is
+ * its own recovery op.
+ */
+class BackfillBatches {
+  uint64_t max_objects = 0;  ///< osd_backfill_batch_objects
+  uint64_t object_size = 0;  ///< osd_backfill_batch_object_size
+  uint64_t max_bytes = 0;    ///< osd_max_push_cost
+
+  // the batch being filled
+  hobject_t open;
+  uint64_t open_objects = 0, open_bytes = 0;
+
+  std::map<hobject_t, hobject_t> batch_of;  ///< object -> its batch
+  std::map<hobject_t, unsigned> in_flight;  ///< batch -> objects left
+
+public:
+  /// start a new round of recover_backfill(), with fresh batch limits
+  void new_round(uint64_t max_objects_, uint64_t object_size_,
+		 uint64_t max_bytes_) {
+    max_objects = max_objects_;
+    object_size = object_size_;
+    max_bytes = max_bytes_;
+    open_objects = open_bytes = 0;
+  }
+
+  /**
+   * start pushing an object
+   *
+   * @param oid object being pushed
+   * @param size its size
+   * @param op [out] the recovery op the object is part of
+   * @return true if the caller starts *op, false if *op already runs
+   */
+  bool start(const hobject_t &oid, uint64_t size, hobject_t *op) {
+    if (max_objects <= 1 || size > object_size) {
+      *op = oid;
+      return true;
+    }
+    // a batch whose objects are all done already has its op finished
+    bool fresh = open_objects == 0 || !in_flight.count(open);
+    if (fresh) {
+      open = oid;
+      open_objects = open_bytes = 0;
+    }
+    *op = open;
+    batch_of[oid] = open;
+    ++in_flight[open];
+    ++open_objects;
+    open_bytes += size;
+    if (open_objects >= max_objects || open_bytes >= max_bytes) {
+      open_objects = open_bytes = 0;
+    }
+    return fresh;
+  }
+
+  /**
+   * an object is recovered or given up on
+   *
+   * @param oid the object
+   * @param op [out] the recovery op the object was part of
+   * @return true if the caller finishes *op
+   */
+  bool finish(const hobject_t &oid, hobject_t *op) {
+    auto p = batch_of.find(oid);
+    if (p == batch_of.end()) {
+      *op = oid;
+      return true;
+    }
+    *op = p->second;
+    batch_of.erase(p);
+    auto q = in_flight.find(*op);
+    ceph_assert(q != in_flight.end() && q->second > 0);
+    if (--q->second > 0) {
+      return false;
+    }
+    in_flight.erase(q);
+    return true;
+  }
+
+  /// batches in flight, each holding one recovery op
+  size_t num_batches() const {
+    return in_flight.size();
+  }
+
+  void clear() {
+    open_objects = open_bytes = 0;
+    batch_of.clear();
+    in_flight.clear();
+  }
+};
+
+#endif
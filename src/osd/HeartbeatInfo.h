@@ -0,0 +1,120 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_OSD_HEARTBEATINFO_H
+#define CEPH_OSD_HEARTBEATINFO_H
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "common/config_proxy.h"
+#include "include/ceph_assert.h"
+#include "include/types.h"
+#include "include/utime.h"
+#include "msg/Connection.h"
+#include "osd/HeartbeatRTT.h"
+
+/// information about a heartbeat peer
+struct HeartbeatInfo {
+  int peer;           ///< peer
+  ConnectionRef con_front;   ///< peer connection (front)
+  ConnectionRef con_back;    ///< peer connection (back)
+  utime_t first_tx;   ///< time we sent our first ping request
+  utime_t last_tx;    ///< last time we sent a ping request
+  utime_t last_rx_front;  ///< last time we got a ping reply on the front side
+  utime_t last_rx_back;   ///< last time we got a ping reply on the back side
+  epoch_t epoch;      ///< most recent epoch we wanted this peer
+  /// number of connections we send and receive heartbeat pings/replies
+  static constexpr int HEARTBEAT_MAX_CONN = 2;
+  /// history of inflight pings, arranging by timestamp we sent
+  /// send time -> deadline -> remaining replies
+  std::map<utime_t, std::pair<utime_t, int>> ping_history;
+  /// ping round trip times on the back and front connections
+  HeartbeatRTT rtt_back, rtt_front;
+
+  /// how long a ping may go unanswered in fast heartbeat mode
+  double get_fast_grace(const ConfigProxy& conf) const {
+    double max_grace = conf->osd_heartbeat_grace;
+    double g = rtt_back.get_grace(conf->osd_heartbeat_fast_grace_rtt_multiple,
+				  conf->osd_heartbeat_fast_grace,
+				  max_grace);
+    if (con_front) {
+      g = std::max(g, rtt_front.get_grace(
+		     conf->osd_heartbeat_fast_grace_rtt_multiple,
+		     conf->osd_heartbeat_fast_grace,
+		     max_grace));
+    }
+    return g;
+  }
+
+  /// record the pings sent at @now, to be answered by @deadline
+  void sent_ping(utime_t now, utime_t deadline) {
+    last_tx = now;
+    if (first_tx == utime_t())
+      first_tx = now;
+    ping_history[now] = std::make_pair(deadline, HEARTBEAT_MAX_CONN);
+  }
+
+  /**
+   * account for a reply received at @now on @con to the ping sent at
+   * @stamp
+   *
+   * Once both connections answered, that ping and every older one are
+   * dropped from the history.
+   *
+   * @return false if the ping is no longer pending, i.e. the reply is
+   *         covered by a newer one
+   */
+  bool handle_reply(const Connection *con, utime_t stamp, utime_t now) {
+    auto acked = ping_history.find(stamp);
+    if (acked == ping_history.end()) {
+      return false;
+    }
+    int &unacknowledged = acked->second.second;
+    if (con == con_back.get()) {
+      last_rx_back = now;
+      rtt_back.add(now - stamp);
+      ceph_assert(unacknowledged > 0);
+      --unacknowledged;
+      // if there is no front con, set both stamps.
+      if (!con_front) {
+	last_rx_front = now;
+	ceph_assert(unacknowledged > 0);
+	--unacknowledged;
+      }
+    } else if (con == con_front.get()) {
+      last_rx_front = now;
+      rtt_front.add(now - stamp);
+      ceph_assert(unacknowledged > 0);
+      --unacknowledged;
+    }
+    if (unacknowledged == 0) {
+      // succeeded in getting all replies
+      ping_history.erase(ping_history.begin(), ++acked);
+    }
+    return true;
+  }
+
+  bool is_unhealthy(utime_t now) {
+    if (ping_history.empty()) {
+      /// we haven't sent a ping yet or we have got all replies,
+      /// in either way we are safe and healthy for now
+      return false;
+    }
+
+    utime_t oldest_deadline = ping_history.begin()->second.first;
+    return now > oldest_deadline;
+  }
+
+  bool is_healthy(utime_t now) {
+    if (last_rx_front == utime_t() || last_rx_back == utime_t()) {
+      // only declare to be healthy until we have received the first
+      // replies from both front/back connections
+      return false;
+    }
+    return !is_unhealthy(now);
+  }
+};
+
+#endif
@@ -0,0 +1,87 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_OSD_HEARTBEATRTT_H
+#define CEPH_OSD_HEARTBEATRTT_H
+
+#include <algorithm>
+
+#include "common/Formatter.h"
+#include "common/histogram.h"
+#include "include/utime.h"
+
+/// Round trip times of the heartbeat pings to one peer over one
+/// connection, kept as a power-of-two histogram of microseconds.  The
+/// histogram is halved every DECAY_SAMPLES samples so that it follows
+/// the peer's recent behaviour.
+class HeartbeatRTT {
+  pow2_hist_t hist;
+  unsigned samples = 0;
+  utime_t last;
+
+public:
+  static constexpr unsigned DECAY_SAMPLES = 256;
+  /// samples needed before the histogram is trusted to set a grace
+  static constexpr unsigned MIN_SAMPLES = 16;
+
+  void add(utime_t rtt) {
+    int64_t usec = std::max<int64_t>(0, rtt.to_nsec() / 1000);
+    hist.add(std::min<int64_t>(usec, INT32_MAX));
+    last = rtt;
+    if (++samples % DECAY_SAMPLES == 0) {
+      hist.decay();
+    }
+  }
+
+  unsigned get_samples() const {
+    return samples;
+  }
+  utime_t get_last() const {
+    return last;
+  }
+
+  /// upper bound of the bin holding the p'th fraction of the samples
+  utime_t percentile(double p) const {
+    uint64_t total = 0;
+    for (auto n : hist.h) {
+      total += n;
+    }
+    if (!total) {
+      return utime_t();
+    }
+    uint64_t want = std::max<uint64_t>(1, p * total + .5);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < hist.h.size(); ++i) {
+      seen += hist.h[i];
+      if (seen >= want) {
+	utime_t t;
+	t.set_from_double((double)(1ull << i) / 1000000.0);
+	return t;
+      }
+    }
+    return utime_t();
+  }
+
+  /// how long a ping to this peer may go unanswered: multiple times
+  /// the 99th percentile round trip time, within [min_grace,
+  /// max_grace], or max_grace until we have seen enough replies
+  double get_grace(double multiple, double min_grace, double max_grace) const {
+    if (samples < MIN_SAMPLES) {
+      return max_grace;
+    }
+    double g = (double)percentile(.99) * multiple;
+    return std::min(std::max(g, min_grace), max_grace);
+  }
+
+  void dump(ceph::Formatter *f) const {
+    f->dump_unsigned("samples", samples);
+    f->dump_float("last_ms", (double)last * 1000.0);
+    f->dump_float("p50_ms", (double)percentile(.5) * 1000.0);
+    f->dump_float("p99_ms", (double)percentile(.99) * 1000.0);
+    f->open_object_section("histogram_usec");
+    hist.dump(f);
+    f->close_section();
+  }
+};
+
+#endif
@@ -0,0 +1,369 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "HotObjectCache.h"
+#include "common/Clock.h"
+#include "common/ceph_context.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "common/perf_counters.h"
+#include "common/safe_io.h"
+#include "include/Context.h"
+#include "include/crc32c.h"
+#include "include/intarith.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix *_dout << "hot_object_cache "
+
+// expected distinct objects read per hit set; more only raises the
+// false positive rate
+static constexpr unsigned HIT_SET_TARGET_SIZE = 100000;
+
+HotObjectCache::HotObjectCache(CephContext *cct)
+  : cct(cct)
+{
+  PerfCountersBuilder b(cct, "hot_object_cache",
+			l_hot_object_cache_first, l_hot_object_cache_last);
+  b.add_u64_counter(l_hot_object_cache_hit, "hit",
+		    "Reads served from the cache", "hit",
+		    PerfCountersBuilder::PRIO_USEFUL);
+  b.add_u64_counter(l_hot_object_cache_miss, "miss",
+		    "Reads not served from the cache", "miss",
+		    PerfCountersBuilder::PRIO_USEFUL);
+  b.add_u64_counter(l_hot_object_cache_stale, "stale",
+		    "Cached copies dropped as outdated or overwritten");
+  b.add_u64_counter(l_hot_object_cache_promote, "promote",
+		    "Objects promoted into the cache");
+  b.add_u64_counter(l_hot_object_cache_promote_bytes, "promote_bytes",
+		    "Bytes written to the cache by promotions", NULL, 0,
+		    unit_t(UNIT_BYTES));
+  b.add_time_avg(l_hot_object_cache_promote_lat, "promote_lat",
+		 "Time spent writing promotions to the cache");
+  b.add_u64_counter(l_hot_object_cache_evict, "evict",
+		    "Objects evicted from the cache");
+  b.add_u64(l_hot_object_cache_bytes, "bytes", "Bytes held in the cache",
+	    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64(l_hot_object_cache_objects, "objects",
+	    "Objects held in the cache");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+HotObjectCache::~HotObjectCache()
+{
+  close();
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
+}
+
+int HotObjectCache::open(const std::string& path, uint64_t sz)
+{
+  ceph_assert(fd < 0);
+  int r = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (r < 0) {
+    r = -errno;
+    lderr(cct) << __func__ << " " << path << ": " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  fd = r;
+  struct stat st;
+  r = ::fstat(fd, &st);
+  if (r == 0 && S_ISREG(st.st_mode) && (uint64_t)st.st_size < sz) {
+    r = ::ftruncate(fd, sz);
+  }
+  if (r < 0) {
+    r = -errno;
+    lderr(cct) << __func__ << " " << path << ": " << cpp_strerror(r) << dendl;
+    close();
+    return r;
+  }
+  size = sz;
+  unsigned num_shards = std::max<uint64_t>(
+    1, cct->_conf.get_val<uint64_t>("osd_hot_object_cache_shards"));
+  uint64_t shard_size = size / num_shards;
+  for (unsigned i = 0; i < num_shards; ++i) {
+    shards.emplace_back(new Shard);
+    shards.back()->start = i * shard_size;
+    shards.back()->size = shard_size;
+  }
+  max_object_size = std::min<uint64_t>(
+    shard_size,
+    cct->_conf.get_val<Option::size_t>("osd_hot_object_cache_max_object_size"));
+  min_read_recency = cct->_conf.get_val<uint64_t>(
+    "osd_hot_object_cache_min_read_recency");
+  hit_set_count = std::max<unsigned>(
+    min_read_recency,
+    cct->_conf.get_val<uint64_t>("osd_hot_object_cache_hit_set_count"));
+  hit_set_period = cct->_conf.get_val<double>(
+    "osd_hot_object_cache_hit_set_period");
+  promote_finisher.reset(new Finisher(cct, "hot_object_cache_promote",
+				      "hot_promote"));
+  promote_finisher->start();
+  dout(1) << __func__ << " " << path << " size " << size
+	  << " shards " << num_shards
+	  << " max_object_size " << max_object_size << dendl;
+  return 0;
+}
+
+void HotObjectCache::close()
+{
+  if (promote_finisher) {
+    promote_finisher->wait_for_empty();
+    promote_finisher->stop();
+    promote_finisher.reset();
+  }
+  if (fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    fd = -1;
+  }
+  shards.clear();
+  bytes = 0;
+  objects = 0;
+}
+
+void HotObjectCache::update_usage()
+{
+  logger->set(l_hot_object_cache_bytes, bytes);
+  logger->set(l_hot_object_cache_objects, objects);
+}
+
+bool HotObjectCache::note_read(const hobject_t& soid, uint64_t object_size,
+			       utime_t now)
+{
+  Shard& s = get_shard(soid);
+  std::lock_guard l(s.lock);
+  if (s.hit_sets.empty() || now - s.hit_set_start >= hit_set_period) {
+    s.hit_sets.emplace_front(new BloomHitSet(
+      std::max<unsigned>(1, HIT_SET_TARGET_SIZE / shards.size()), .01, 0));
+    if (s.hit_sets.size() > hit_set_count) {
+      s.hit_sets.pop_back();
+    }
+    s.hit_set_start = now;
+  }
+  s.hit_sets.front()->insert(soid);
+  if (object_size == 0 || object_size > max_object_size) {
+    return false;
+  }
+  unsigned recency = 0;
+  for (auto& h : s.hit_sets) {
+    if (h->contains(soid) && ++recency >= min_read_recency) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void HotObjectCache::_evict(Shard& s,
+			    std::map<uint64_t, hobject_t>::iterator p)
+{
+  auto i = s.index.find(p->second);
+  ceph_assert(i != s.index.end());
+  bytes -= i->second.length;
+  --objects;
+  s.index.erase(i);
+  s.by_offset.erase(p);
+}
+
+void HotObjectCache::_erase(Shard& s, const hobject_t& soid)
+{
+  auto i = s.index.find(soid);
+  if (i == s.index.end()) {
+    return;
+  }
+  auto p = s.by_offset.find(i->second.offset);
+  ceph_assert(p != s.by_offset.end());
+  _evict(s, p);
+}
+
+int HotObjectCache::read(const hobject_t& soid, eversion_t v,
+			 uint64_t off, uint64_t len,
+			 ceph::buffer::list *out)
+{
+  Shard& s = get_shard(soid);
+  uint64_t offset, length;
+  std::vector<uint32_t> crcs;
+  {
+    std::lock_guard l(s.lock);
+    auto i = s.index.find(soid);
+    if (i == s.index.end()) {
+      logger->inc(l_hot_object_cache_miss);
+      return -ENOENT;
+    }
+    if (i->second.version != v) {
+      // the object has been modified since it was promoted
+      _erase(s, soid);
+      logger->inc(l_hot_object_cache_stale);
+      logger->inc(l_hot_object_cache_miss);
+      update_usage();
+      return -ENOENT;
+    }
+    if (off >= i->second.length) {
+      logger->inc(l_hot_object_cache_hit);
+      return 0;
+    }
+    len = std::min<uint64_t>(len, i->second.length - off);
+    if (len == 0) {
+      logger->inc(l_hot_object_cache_hit);
+      return 0;
+    }
+    offset = i->second.offset;
+    length = i->second.length;
+    crcs.assign(i->second.crcs.begin() + off / CRC_BLOCK,
+		i->second.crcs.begin() + (off + len - 1) / CRC_BLOCK + 1);
+  }
+
+  // read and check the blocks we need; the slot may be overwritten by
+  // a promotion while we read it
+  uint64_t start = p2align<uint64_t>(off, CRC_BLOCK);
+  uint64_t end = std::min<uint64_t>(start + crcs.size() * CRC_BLOCK, length);
+  ceph::buffer::ptr bp = ceph::buffer::create_page_aligned(end - start);
+  int r = safe_pread_exact(fd, bp.c_str(), end - start,
+			   s.start + offset + start);
+  for (unsigned b = 0; r >= 0 && b < crcs.size(); ++b) {
+    uint64_t o = b * CRC_BLOCK;
+    uint64_t l = std::min<uint64_t>(CRC_BLOCK, end - start - o);
+    if (ceph_crc32c(-1, (unsigned char *)bp.c_str() + o, l) != crcs[b]) {
+      r = -EIO;
+    }
+  }
+  if (r < 0) {
+    dout(10) << __func__ << " " << soid << " at " << offset
+	     << " is gone: " << r << dendl;
+    std::lock_guard l(s.lock);
+    auto i = s.index.find(soid);
+    if (i != s.index.end() && i->second.offset == offset) {
+      _erase(s, soid);
+    }
+    logger->inc(l_hot_object_cache_stale);
+    logger->inc(l_hot_object_cache_miss);
+    update_usage();
+    return -ENOENT;
+  }
+  out->append(bp, off - start, len);
+  logger->inc(l_hot_object_cache_hit);
+  return len;
+}
+
+void HotObjectCache::promote(const hobject_t& soid, eversion_t v,
+			     const ceph::buffer::list& data)
+{
+  uint64_t len = data.length();
+  if (len == 0 || len > max_object_size) {
+    return;
+  }
+  utime_t start = ceph_clock_now();
+  Shard& s = get_shard(soid);
+
+  // reserve a region at the head, evicting what it overwrites
+  uint64_t offset, my_lap;
+  {
+    std::lock_guard l(s.lock);
+    auto i = s.index.find(soid);
+    if (i != s.index.end() && i->second.version >= v) {
+      return;
+    }
+    _erase(s, soid);
+    if (s.head + len > s.size) {
+      s.head = 0;
+      ++s.lap;
+    }
+    offset = s.head;
+    my_lap = s.lap;
+    s.head += len;
+    auto p = s.by_offset.lower_bound(offset);
+    while (p != s.by_offset.end() && p->first < offset + len) {
+      _evict(s, p++);
+      logger->inc(l_hot_object_cache_evict);
+    }
+  }
+
+  ceph::buffer::list bl = data;
+  int r = bl.write_fd(fd, s.start + offset);
+  if (r < 0) {
+    derr << __func__ << " " << soid << " write at " << s.start + offset
+	 << ": " << cpp_strerror(r) << dendl;
+    return;
+  }
+
+  std::vector<uint32_t> crcs;
+  for (uint64_t o = 0; o < len; o += CRC_BLOCK) {
+    ceph::buffer::list block;
+    block.substr_of(bl, o, std::min<uint64_t>(CRC_BLOCK, len - o));
+    crcs.push_back(block.crc32c(-1));
+  }
+
+  std::lock_guard l(s.lock);
+  // another promotion may have lapped us while we were writing
+  if (overwritten(my_lap, offset, s.lap, s.head)) {
+    return;
+  }
+  auto i = s.index.find(soid);
+  if (i != s.index.end()) {
+    // promoted concurrently; keep the newer copy
+    if (i->second.version >= v) {
+      return;
+    }
+    _erase(s, soid);
+  }
+  Entry& e = s.index[soid];
+  e.offset = offset;
+  e.length = len;
+  e.crcs = std::move(crcs);
+  e.version = v;
+  s.by_offset[offset] = soid;
+  bytes += len;
+  ++objects;
+  logger->inc(l_hot_object_cache_promote);
+  logger->inc(l_hot_object_cache_promote_bytes, len);
+  logger->tinc(l_hot_object_cache_promote_lat, ceph_clock_now() - start);
+  update_usage();
+  dout(20) << __func__ << " " << soid << " v " << v << " at "
+	   << s.start + offset << "~" << len << dendl;
+}
+
+void HotObjectCache::queue_promote(
+  const hobject_t& soid, eversion_t v,
+  std::function<int(ceph::buffer::list*)>&& get_data)
+{
+  if (queued_promotions >= MAX_QUEUED_PROMOTIONS) {
+    dout(20) << __func__ << " " << soid << " too many queued" << dendl;
+    return;
+  }
+  {
+    Shard& s = get_shard(soid);
+    std::lock_guard l(s.lock);
+    if (!s.promoting.insert(soid).second) {
+      return;
+    }
+  }
+  ++queued_promotions;
+  promote_finisher->queue(new FunctionContext(
+    [this, soid, v, get_data=std::move(get_data)](int) {
+      ceph::buffer::list data;
+      int r = get_data(&data);
+      if (r < 0) {
+	dout(10) << "queue_promote " << soid << " v " << v << " got " << r
+		 << dendl;
+      } else {
+	promote(soid, v, data);
+      }
+      {
+	Shard& s = get_shard(soid);
+	std::lock_guard l(s.lock);
+	s.promoting.erase(soid);
+      }
+      --queued_promotions;
+    }));
+}
+
+void HotObjectCache::wait_for_promotions()
+{
+  if (promote_finisher) {
+    promote_finisher->wait_for_empty();
+  }
+}
@@ -0,0 +1,160 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_OSD_HOTOBJECTCACHE_H
+#define CEPH_OSD_HOTOBJECTCACHE_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "common/Finisher.h"
+#include "common/hobject.h"
+#include "include/buffer.h"
+#include "include/unordered_map.h"
+#include "osd/HitSet.h"
+#include "osd/osd_types.h"
+
+class CephContext;
+class PerfCounters;
+
+enum {
+  l_hot_object_cache_first = 93000,
+  l_hot_object_cache_hit,
+  l_hot_object_cache_miss,
+  l_hot_object_cache_stale,
+  l_hot_object_cache_promote,
+  l_hot_object_cache_promote_bytes,
+  l_hot_object_cache_promote_lat,
+  l_hot_object_cache_evict,
+  l_hot_object_cache_bytes,
+  l_hot_object_cache_objects,
+  l_hot_object_cache_last
+};
+
+/**
+ * HotObjectCache - copies of frequently read objects in a local file
+ *
+ * Reads are tracked in a ring of bloom filter hit sets, like a cache
+ * tier pool's hit sets; an object read in enough recent hit sets is
+ * promoted by the caller, in the background with queue_promote().
+ *
+ * The file is split into osd_hot_object_cache_shards regions, each
+ * with its own lock, hit sets and index of the objects hashing to it.
+ * Each region is written as a ring: each promotion is appended at the
+ * head, evicting whatever it overwrites, so writes to the cache device
+ * are sequential and the oldest promotions go first.  Entries are tied
+ * to the object version they were promoted at and carry crcs, so a
+ * modified object is never served and a slot overwritten under a
+ * concurrent reader is detected.  Nothing is persisted: the cache
+ * starts empty when the OSD starts.
+ */
+class HotObjectCache {
+  /// crcs cover blocks of this size, so that a partial read only
+  /// needs to read and check the blocks it touches
+  static constexpr uint32_t CRC_BLOCK = 64 << 10;
+  /// promotions queued beyond this are dropped
+  static constexpr unsigned MAX_QUEUED_PROMOTIONS = 64;
+
+  struct Entry {
+    uint64_t offset = 0;
+    uint32_t length = 0;
+    std::vector<uint32_t> crcs;  ///< one per CRC_BLOCK
+    eversion_t version;
+  };
+
+  struct Shard {
+    std::mutex lock;
+    uint64_t start = 0;  ///< where the shard's region of the file starts
+    uint64_t size = 0;
+    ceph::unordered_map<hobject_t, Entry> index;
+    std::map<uint64_t, hobject_t> by_offset;
+    uint64_t head = 0;   ///< where the next promotion is written
+    uint64_t lap = 0;    ///< times head has wrapped around
+    std::set<hobject_t> promoting;  ///< queued for promotion
+
+    std::deque<std::unique_ptr<BloomHitSet>> hit_sets;  ///< newest first
+    utime_t hit_set_start;
+  };
+
+  CephContext *cct;
+  PerfCounters *logger = nullptr;
+  int fd = -1;
+  uint64_t size = 0;
+
+  // options, read at open()
+  uint64_t max_object_size = 0;
+  unsigned min_read_recency = 0;
+  unsigned hit_set_count = 0;
+  double hit_set_period = 0;
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::atomic<uint64_t> bytes = {0};    ///< bytes held by indexed entries
+  std::atomic<uint64_t> objects = {0};  ///< indexed entries
+  std::unique_ptr<Finisher> promote_finisher;
+  std::atomic<unsigned> queued_promotions = {0};
+
+  Shard& get_shard(const hobject_t& soid) {
+    return *shards[std::hash<hobject_t>()(soid) % shards.size()];
+  }
+  void _evict(Shard& s, std::map<uint64_t, hobject_t>::iterator p);
+  void _erase(Shard& s, const hobject_t& soid);
+  void update_usage();
+
+public:
+  explicit HotObjectCache(CephContext *cct);
+  ~HotObjectCache();
+
+  /// open (and size) the cache file at path
+  int open(const std::string& path, uint64_t size);
+  void close();
+
+  /// record a read that missed the cache; true if soid is now hot
+  /// enough, and small enough, to promote
+  bool note_read(const hobject_t& soid, uint64_t object_size, utime_t now);
+
+  /**
+   * read [off, off+len) of soid as of version v from the cache
+   *
+   * @return bytes read, or -ENOENT if we do not have that version
+   */
+  int read(const hobject_t& soid, eversion_t v, uint64_t off, uint64_t len,
+	   ceph::buffer::list *out);
+
+  /// keep a copy of soid, whose full content at version v is data
+  void promote(const hobject_t& soid, eversion_t v,
+	       const ceph::buffer::list& data);
+
+  /**
+   * promote soid in the background
+   *
+   * get_data fills in the full content of soid at version v, or
+   * returns an error if it can no longer tell it.  It runs on the
+   * cache's own thread, so it must not need the caller's locks.
+   */
+  void queue_promote(const hobject_t& soid, eversion_t v,
+		     std::function<int(ceph::buffer::list*)>&& get_data);
+  /// wait for the queued promotions to finish
+  void wait_for_promotions();
+
+  /**
+   * whether a promotion that reserved [offset, ...) of a region on
+   * lap my_lap was overwritten by the ones reserved after it, which
+   * moved the region to lap and head
+   */
+  static bool overwritten(uint64_t my_lap, uint64_t offset,
+			  uint64_t lap, uint64_t head) {
+    return lap != my_lap && (lap != my_lap + 1 || head > offset);
+  }
+
+  PerfCounters *get_logger() const {
+    return logger;
+  }
+};
+
+#endif
@@ -131,6 +131,7 @@
 #include "common/HeartbeatMap.h"
 #include "common/admin_socket.h"
 #include "common/ceph_context.h"
+#include "common/Thread.h"
 
 #include "global/signal_handler.h"
 #include "global/pidfile.h"
@@ -1237,6 +1238,113 @@ void OSDService::dec_scrubs_active()
   sched_scrub_lock.Unlock();
 }
 
+int OSDService::get_device_io_ticks(const string& dev, uint64_t *io_ticks,
+				    const string& sysfs)
+{
+  // whole disks (and dm devices) have a /sys/block entry; partitions
+  // only show up under /sys/class/block
+  for (auto dir : {"/block/", "/class/block/"}) {
+    std::ifstream f(sysfs + dir + dev + "/stat");
+    if (!f.is_open()) {
+      continue;
+    }
+    // the 10th field is io_ticks, the number of milliseconds the device
+    // had I/O in flight
+    uint64_t fields[10];
+    for (auto& i : fields) {
+      f >> i;
+    }
+    if (!f) {
+      return -EINVAL;
+    }
+    *io_ticks = fields[9];
+    return 0;
+  }
+  return -ENOENT;
+}
+
+void OSDService::sample_device_util(const set<string>& devnames)
+{
+  utime_t now = ceph_clock_now();
+  double elapsed_ms = device_sample_stamp.is_zero() ? 0 :
+    (double)(now - device_sample_stamp) * 1000.0;
+  float util = 0;
+  map<string, uint64_t> io_ticks_by_dev;
+  for (auto& dev : devnames) {
+    uint64_t io_ticks;
+    int r = get_device_io_ticks(dev, &io_ticks);
+    if (r < 0) {
+      // not a block device we can see (e.g. a file-backed store); it
+      // does not count towards the utilisation
+      dout(20) << __func__ << " no io stats for " << dev << ": "
+	       << cpp_strerror(r) << dendl;
+      continue;
+    }
+    auto p = device_io_ticks.find(dev);
+    if (p != device_io_ticks.end() && elapsed_ms > 0 &&
+	io_ticks >= p->second) {
+      util = std::max(util, (float)std::min(
+	1.0, (double)(io_ticks - p->second) / elapsed_ms));
+    }
+    io_ticks_by_dev[dev] = io_ticks;
+  }
+  device_io_ticks.swap(io_ticks_by_dev);
+  device_sample_stamp = now;
+  device_util = util;
+}
+
+bool OSDService::scrub_idle(double window, unsigned queued,
+			    unsigned max_queued, double idle,
+			    float util, float max_util, ostream *why)
+{
+  if (window <= 0) {
+    return true;
+  }
+  if (queued > max_queued) {
+    *why << queued << " client ops queued";
+    return false;
+  }
+  if (idle < window) {
+    *why << "last client op " << idle << "s ago";
+    return false;
+  }
+  if (util > max_util) {
+    *why << "device util " << util;
+    return false;
+  }
+  return true;
+}
+
+OSDService::scrub_yield_t OSDService::scrub_yield(double held,
+						 double max_wait,
+						 bool started)
+{
+  if (max_wait <= 0 || held < max_wait) {
+    return scrub_yield_t::YIELD;
+  }
+  return started ? scrub_yield_t::PROCEED : scrub_yield_t::GIVE_UP;
+}
+
+bool OSDService::scrub_idle_window(ostream *why)
+{
+  double window = cct->_conf->osd_scrub_idle_window;
+  if (window <= 0) {
+    return true;
+  }
+  unsigned queued = 0;
+  for (auto shard : osd->shards) {
+    queued += shard->client_ops_queued;
+  }
+  int64_t idle_ns = (int64_t)ceph::mono_clock::now().time_since_epoch().count() -
+    (int64_t)last_client_op_ns.load();
+  return scrub_idle(window, queued,
+		    cct->_conf->osd_scrub_idle_max_queued_ops,
+		    (double)idle_ns / 1000000000.0,
+		    device_util,
+		    cct->_conf->osd_scrub_idle_max_device_util,
+		    why);
+}
+
 void OSDService::retrieve_epochs(epoch_t *_boot_epoch, epoch_t *_up_epoch,
                                  epoch_t *_bind_epoch) const
 {
@@ -2150,6 +2258,7 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
                                            cct->_conf->osd_op_history_duration);
   op_tracker.set_history_slow_op_size_and_threshold(cct->_conf->osd_op_history_slow_op_size,
                                                     cct->_conf->osd_op_history_slow_op_threshold);
+  op_tracker.set_lightweight(cct->_conf->osd_op_tracker_lightweight);
   ObjectCleanRegions::set_max_num_intervals(cct->_conf->osd_object_clean_region_max_num_intervals);
 #ifdef WITH_BLKIN
   std::stringstream ss;
@@ -2500,6 +2609,8 @@ will start to track new ops received afterwards.";
     store->get_db_statistics(f);
   } else if (admin_command == "dump_scrubs") {
     service.dumps_scrub(f);
+  } else if (admin_command == "dump_heartbeat_rtt") {
+    dump_heartbeat_rtt(f);
   } else if (admin_command == "calc_objectstore_db_histogram") {
     store->generate_db_histogram(f);
   } else if (admin_command == "flush_store_cache") {
@@ -2894,6 +3005,21 @@ int OSD::init()
 
   create_logger();
 
+  {
+    string path = cct->_conf.get_val<string>("osd_hot_object_cache_path");
+    if (!path.empty()) {
+      service.hot_object_cache.reset(new HotObjectCache(cct));
+      r = service.hot_object_cache->open(
+	path,
+	cct->_conf.get_val<Option::size_t>("osd_hot_object_cache_size"));
+      if (r < 0) {
+	derr << __func__ << " unable to open hot object cache " << path
+	     << ": " << cpp_strerror(r) << dendl;
+	service.hot_object_cache.reset();
+      }
+    }
+  }
+
   // prime osd stats
   {
     struct store_statfs_t stbuf;
@@ -2957,39 +3083,6 @@ int OSD::init()
   service.publish_superblock(superblock);
   service.max_oldest_map = superblock.oldest_map;
 
-  for (auto& shard : shards) {
-    // put PGs in a temporary set because we may modify pg_slots
-    // unordered_map below.
-    set<PGRef> pgs;
-    for (auto& i : shard->pg_slots) {
-      PGRef pg = i.second->pg;
-      if (!pg) {
-	continue;
-      }
-      pgs.insert(pg);
-    }
-    for (auto pg : pgs) {
-      pg->lock();
-      set<pair<spg_t,epoch_t>> new_children;
-      set<pair<spg_t,epoch_t>> merge_pgs;
-      service.identify_splits_and_merges(pg->get_osdmap(), osdmap, pg->pg_id,
-					 &new_children, &merge_pgs);
-      if (!new_children.empty()) {
-	for (auto shard : shards) {
-	  shard->prime_splits(osdmap, &new_children);
-	}
-	assert(new_children.empty());
-      }
-      if (!merge_pgs.empty()) {
-	for (auto shard : shards) {
-	  shard->prime_merges(osdmap, &merge_pgs);
-	}
-	assert(merge_pgs.empty());
-      }
-      pg->unlock();
-    }
-  }
-
   osd_op_tp.start();
   command_tp.start();
 
@@ -3068,6 +3161,7 @@ int OSD::init()
   return 0;
 
 out:
+  join_pg_load_threads();
   enable_disable_fuse(true);
   store->umount();
   delete store;
@@ -3181,6 +3275,12 @@ void OSD::final_init()
 				     "print scheduled scrubs");
   ceph_assert(r == 0);
 
+  r = admin_socket->register_command("dump_heartbeat_rtt",
+				     "dump_heartbeat_rtt",
+				     asok_hook,
+				     "print heartbeat ping round trip times and grace per peer");
+  ceph_assert(r == 0);
+
   r = admin_socket->register_command("calc_objectstore_db_histogram",
                                      "calc_objectstore_db_histogram",
                                      asok_hook,
@@ -3354,6 +3454,9 @@ int OSD::shutdown()
 
   set_state(STATE_STOPPING);
 
+  // stop loading pgs if we are still booting
+  join_pg_load_threads();
+
   // Debugging
   if (cct->_conf.get_val<bool>("osd_debug_shutdown")) {
     cct->_conf.set_val("debug_osd", "100");
@@ -3410,6 +3513,8 @@ int OSD::shutdown()
   osd_op_tp.stop();
   dout(10) << "op sharded tp stopped" << dendl;
 
+  service.hot_object_cache.reset();
+
   command_tp.drain();
   command_tp.stop();
   dout(10) << "command tp stopped" << dendl;
@@ -4006,36 +4111,147 @@ void OSD::load_pgs()
       continue;
     }
 
-    // there can be no waiters here, so we don't call _wake_pg_slot
-
-    pg->lock();
-    pg->ch = store->open_collection(pg->coll);
-
-    // read pg state, log
-    pg->read_state(store);
-
-    if (pg->dne())  {
-      dout(10) << "load_pgs " << *it << " deleting dne" << dendl;
-      pg->ch = nullptr;
-      pg->unlock();
-      recursive_remove_collection(cct, store, pgid, *it);
+    if (cct->_conf->osd_load_pgs_threads > 0) {
+      // hold anything for the pg in its slot until it is loaded
+      shards[pgid.hash_to_shard(shards.size())]->prime_load(pgid);
+      pgs_to_load.push_back(pg);
       continue;
     }
-    {
-      uint32_t shard_index = pgid.hash_to_shard(shards.size());
-      assert(NULL != shards[shard_index]);
-      store->set_collection_commit_queue(pg->coll, &(shards[shard_index]->context_queue));
+    if (_load_pg(pg)) {
+      ++num;
+    }
+  }
+  if (pgs_to_load.empty()) {
+    // only now that every pg is registered can a merge participant
+    // that isn't there be created empty
+    vector<PGRef> pgs;
+    _get_pgs(&pgs);
+    for (auto& pg : pgs) {
+      pg->lock();
+      _prime_loaded_pg(pg.get(), osdmap);
+      pg->unlock();
     }
+  } else {
+    unsigned n = std::min<size_t>(cct->_conf->osd_load_pgs_threads,
+				  pgs_to_load.size());
+    dout(0) << __func__ << " loading " << pgs_to_load.size()
+	    << " pgs in the background with " << n << " threads" << dendl;
+    pgs_to_load_pos = 0;
+    pgs_loaded = 0;
+    pg_load_min_lec = superblock.oldest_map;
+    pgs_load_pending = pgs_to_load.size();
+    for (unsigned i = 0; i < n; ++i) {
+      pg_load_threads.push_back(
+	make_named_thread("osd_pg_load", &OSD::pg_load_entry, this));
+    }
+    return;
+  }
+  dout(0) << __func__ << " opened " << num << " pgs" << dendl;
+}
+
+// read a pg's state and log from the store and register it; returns
+// false if the pg turned out not to exist and was removed
+bool OSD::_load_pg(PGRef pg)
+{
+  spg_t pgid = pg->pg_id;
+  uint32_t shard_index = pgid.hash_to_shard(shards.size());
+  assert(NULL != shards[shard_index]);
+
+  pg->lock();
+  pg->ch = store->open_collection(pg->coll);
 
-    pg->reg_next_scrub();
+  // read pg state, log
+  pg->read_state(store);
 
-    dout(10) << __func__ << " loaded " << *pg << dendl;
+  if (pg->dne())  {
+    dout(10) << __func__ << " " << pg->coll << " deleting dne" << dendl;
+    pg->ch = nullptr;
     pg->unlock();
+    recursive_remove_collection(cct, store, pgid, pg->coll);
+    if (!pgs_to_load.empty()) {
+      shards[shard_index]->unprime_load(pgid);
+    }
+    return false;
+  }
+  store->set_collection_commit_queue(pg->coll, &(shards[shard_index]->context_queue));
+
+  pg->reg_next_scrub();
 
+  dout(10) << __func__ << " loaded " << *pg << dendl;
+  pg->unlock();
+
+  _register_loaded_pg(pg);
+  return true;
+}
+
+// attach a freshly loaded pg.  pgs loaded in the background also prime
+// their splits and merges here, while load_pgs() primes the ones it
+// loads itself once they are all registered.
+void OSD::_register_loaded_pg(PGRef pg)
+{
+  std::lock_guard l(pg_load_lock);
+  if (pgs_to_load.empty()) {
+    // there can be no waiters here, so we don't call _wake_pg_slot
     register_pg(pg);
-    ++num;
+    return;
   }
-  dout(0) << __func__ << " opened " << num << " pgs" << dendl;
+  // the slots of pgs still loading are primed, so prime_merges() won't
+  // create them empty
+  auto sdata = shards[pg->pg_id.hash_to_shard(shards.size())];
+  OSDMapRef as_of_osdmap = sdata->get_osdmap();
+  sdata->register_and_wake_loaded_pg(pg.get());
+  _prime_loaded_pg(pg.get(), as_of_osdmap);
+}
+
+// prime the splits and merges between a loaded pg's map and the one the
+// shards have consumed
+void OSD::_prime_loaded_pg(PG *pg, const OSDMapRef& as_of_osdmap)
+{
+  set<pair<spg_t,epoch_t>> new_children;
+  set<pair<spg_t,epoch_t>> merge_pgs;
+  service.identify_splits_and_merges(pg->get_osdmap(), as_of_osdmap,
+				     pg->pg_id, &new_children, &merge_pgs);
+  if (!new_children.empty()) {
+    for (auto shard : shards) {
+      shard->prime_splits(as_of_osdmap, &new_children);
+    }
+    assert(new_children.empty());
+  }
+  if (!merge_pgs.empty()) {
+    for (auto shard : shards) {
+      shard->prime_merges(as_of_osdmap, &merge_pgs);
+    }
+    assert(merge_pgs.empty());
+  }
+}
+
+void OSD::pg_load_entry()
+{
+  size_t i;
+  while ((i = pgs_to_load_pos++) < pgs_to_load.size()) {
+    if (is_stopping()) {
+      break;
+    }
+    if (_load_pg(pgs_to_load[i])) {
+      ++pgs_loaded;
+    }
+    if (--pgs_load_pending == 0) {
+      dout(0) << __func__ << " opened " << pgs_loaded << " pgs" << dendl;
+    }
+  }
+}
+
+// stop the background pg loads started by load_pgs(), if any
+void OSD::join_pg_load_threads()
+{
+  if (pg_load_threads.empty()) {
+    return;
+  }
+  for (auto& t : pg_load_threads) {
+    t.join();
+  }
+  pg_load_threads.clear();
+  pgs_to_load.clear();
 }
 
 
@@ -4584,47 +4800,15 @@ void OSD::handle_osd_ping(MOSDPing *m)
     {
       map<int,HeartbeatInfo>::iterator i = heartbeat_peers.find(from);
       if (i != heartbeat_peers.end()) {
-        auto acked = i->second.ping_history.find(m->stamp);
-        if (acked != i->second.ping_history.end()) {
-          utime_t now = ceph_clock_now();
-          int &unacknowledged = acked->second.second;
-          if (m->get_connection() == i->second.con_back) {
-            dout(25) << "handle_osd_ping got reply from osd." << from
-                     << " first_tx " << i->second.first_tx
-                     << " last_tx " << i->second.last_tx
-                     << " last_rx_back " << i->second.last_rx_back << " -> " << now
-                     << " last_rx_front " << i->second.last_rx_front
-                     << dendl;
-            i->second.last_rx_back = now;
-            ceph_assert(unacknowledged > 0);
-            --unacknowledged;
-            // if there is no front con, set both stamps.
-            if (i->second.con_front == NULL) {
-              i->second.last_rx_front = now;
-              ceph_assert(unacknowledged > 0);
-              --unacknowledged;
-            }
-          } else if (m->get_connection() == i->second.con_front) {
-            dout(25) << "handle_osd_ping got reply from osd." << from
-                     << " first_tx " << i->second.first_tx
-                     << " last_tx " << i->second.last_tx
-                     << " last_rx_back " << i->second.last_rx_back
-                     << " last_rx_front " << i->second.last_rx_front << " -> " << now
-                     << dendl;
-            i->second.last_rx_front = now;
-            ceph_assert(unacknowledged > 0);
-            --unacknowledged;
-          }
-
-          if (unacknowledged == 0) {
-            // succeeded in getting all replies
-            dout(25) << "handle_osd_ping got all replies from osd." << from
-                     << " , erase pending ping(sent at " << m->stamp << ")"
-                     << " and older pending ping(s)"
-                     << dendl;
-            i->second.ping_history.erase(i->second.ping_history.begin(), ++acked);
-          }
-
+        utime_t now = ceph_clock_now();
+        dout(25) << "handle_osd_ping got reply from osd." << from
+                 << " first_tx " << i->second.first_tx
+                 << " last_tx " << i->second.last_tx
+                 << " last_rx_back " << i->second.last_rx_back
+                 << " last_rx_front " << i->second.last_rx_front
+                 << " now " << now
+                 << dendl;
+        if (i->second.handle_reply(m->get_connection().get(), m->stamp, now)) {
           if (i->second.is_healthy(now)) {
             // Cancel false reports
             auto failure_queue_entry = failure_queue.find(from);
@@ -4684,7 +4868,22 @@ void OSD::heartbeat_entry()
   while (!heartbeat_stop) {
     heartbeat();
 
-    double wait = .5 + ((float)(rand() % 10)/10.0) * (float)cct->_conf->osd_heartbeat_interval;
+    double wait;
+    if (cct->_conf->osd_heartbeat_fast_interval > 0) {
+      // check and report right away rather than on the next tick and
+      // mon report
+      if (is_active() || is_waiting_for_healthy()) {
+	heartbeat_check();
+      }
+      if (!failure_queue.empty()) {
+	heartbeat_send_failures();
+	if (is_stopping())
+	  return;
+      }
+      wait = cct->_conf->osd_heartbeat_fast_interval;
+    } else {
+      wait = .5 + ((float)(rand() % 10)/10.0) * (float)cct->_conf->osd_heartbeat_interval;
+    }
     utime_t w;
     w.set_from_double(wait);
     dout(30) << "heartbeat_entry sleeping for " << wait << dendl;
@@ -4695,6 +4894,49 @@ void OSD::heartbeat_entry()
   }
 }
 
+// called from the heartbeat thread; drops heartbeat_lock to take the
+// locks send_failures() needs in their usual order.  If a map is being
+// applied we leave the reports to the next round (or tick) rather
+// than hold up the pings.
+void OSD::heartbeat_send_failures()
+{
+  ceph_assert(heartbeat_lock.is_locked_by_me());
+  heartbeat_lock.Unlock();
+  if (is_active() && map_lock.try_get_read()) {
+    {
+      std::lock_guard l(mon_report_lock);
+      send_failures();
+    }
+    map_lock.put_read();
+  }
+  heartbeat_lock.Lock();
+}
+
+void OSD::dump_heartbeat_rtt(Formatter *f)
+{
+  std::lock_guard l(heartbeat_lock);
+  utime_t now = ceph_clock_now();
+  bool fast = cct->_conf->osd_heartbeat_fast_interval > 0;
+  f->open_array_section("peers");
+  for (auto& p : heartbeat_peers) {
+    f->open_object_section("peer");
+    f->dump_int("osd", p.first);
+    f->dump_float("grace", fast ? p.second.get_fast_grace(cct->_conf) :
+		  (double)cct->_conf->osd_heartbeat_grace);
+    f->dump_bool("healthy", p.second.is_healthy(now));
+    f->open_object_section("back");
+    p.second.rtt_back.dump(f);
+    f->close_section();
+    if (p.second.con_front) {
+      f->open_object_section("front");
+      p.second.rtt_front.dump(f);
+      f->close_section();
+    }
+    f->close_section();
+  }
+  f->close_section();
+}
+
 void OSD::heartbeat_check()
 {
   ceph_assert(heartbeat_lock.is_locked());
@@ -4787,27 +5029,39 @@ void OSD::heartbeat()
   utime_t deadline = now;
   deadline += cct->_conf->osd_heartbeat_grace;
 
+  // in fast mode only every osd_heartbeat_interval worth of pings is
+  // padded to osd_heartbeat_min_size; the rest are as small as they get
+  bool fast = cct->_conf->osd_heartbeat_fast_interval > 0;
+  uint32_t min_size = cct->_conf->osd_heartbeat_min_size;
+  if (fast) {
+    if (now - last_heartbeat_padded >= cct->_conf->osd_heartbeat_interval) {
+      last_heartbeat_padded = now;
+    } else {
+      min_size = 0;
+    }
+  }
+
   // send heartbeats
   for (map<int,HeartbeatInfo>::iterator i = heartbeat_peers.begin();
        i != heartbeat_peers.end();
        ++i) {
     int peer = i->first;
-    i->second.last_tx = now;
-    if (i->second.first_tx == utime_t())
-      i->second.first_tx = now;
-    i->second.ping_history[now] = make_pair(deadline,
-      HeartbeatInfo::HEARTBEAT_MAX_CONN);
+    if (fast) {
+      deadline = now;
+      deadline += i->second.get_fast_grace(cct->_conf);
+    }
+    i->second.sent_ping(now, deadline);
     dout(30) << "heartbeat sending ping to osd." << peer << dendl;
     i->second.con_back->send_message(new MOSDPing(monc->get_fsid(),
 					  service.get_osdmap_epoch(),
 					  MOSDPing::PING, now,
-					  cct->_conf->osd_heartbeat_min_size));
+					  min_size));
 
     if (i->second.con_front)
       i->second.con_front->send_message(new MOSDPing(monc->get_fsid(),
 					     service.get_osdmap_epoch(),
 					     MOSDPing::PING, now,
-					  cct->_conf->osd_heartbeat_min_size));
+					     min_size));
   }
 
   logger->set(l_osd_hb_to, heartbeat_peers.size());
@@ -4951,6 +5205,11 @@ void OSD::tick_without_osd_lock()
   }
 
   if (is_active()) {
+    if (cct->_conf->osd_scrub_idle_window > 0) {
+      set<string> devnames;
+      store->get_devices(&devnames);
+      service.sample_device_util(devnames);
+    }
     if (!scrub_random_backoff()) {
       sched_scrub();
     }
@@ -5778,13 +6037,19 @@ void OSD::send_failures()
     int osd = failure_queue.begin()->first;
     if (!failure_pending.count(osd)) {
       int failed_for = (int)(double)(now - failure_queue.begin()->second);
+      __u8 flags = MOSDFailure::FLAG_FAILED;
+      if (cct->_conf->osd_heartbeat_fast_interval > 0) {
+	// we already waited out the peer's (rtt based) grace
+	flags |= MOSDFailure::FLAG_FAST;
+      }
       monc->send_mon_message(
 	new MOSDFailure(
 	  monc->get_fsid(),
 	  osd,
 	  osdmap->get_addrs(osd),
 	  failed_for,
-	  osdmap->get_epoch()));
+	  osdmap->get_epoch(),
+	  flags));
       failure_pending[osd] = make_pair(failure_queue.begin()->second,
 				       osdmap->get_addrs(osd));
     }
@@ -7169,6 +7434,10 @@ MPGStats* OSD::collect_pg_stats()
 
   std::lock_guard lec{min_last_epoch_clean_lock};
   min_last_epoch_clean = osdmap->get_epoch();
+  if (pgs_load_pending > 0) {
+    // we do not know yet what the pgs still loading need
+    min_last_epoch_clean = std::min(min_last_epoch_clean, pg_load_min_lec);
+  }
   min_last_epoch_clean_pgs.clear();
 
   std::set<int64_t> pool_set;
@@ -8225,6 +8494,11 @@ void OSD::consume_map()
   service.await_reserved_maps();
   service.publish_map(osdmap);
 
+  // pgs loaded in the background attach against the shards' map, so
+  // they must not attach between identifying splits and the shards
+  // moving on to the new map
+  std::unique_lock pg_load_locker(pg_load_lock);
+
   // prime splits and merges
   set<pair<spg_t,epoch_t>> newly_split;  // splits, and when
   set<pair<spg_t,epoch_t>> merge_pgs;    // merge participants, and when
@@ -8266,6 +8540,7 @@ void OSD::consume_map()
   for (auto& shard : shards) {
     shard->consume_map(osdmap, &pushes_to_free);
   }
+  pg_load_locker.unlock();
 
   vector<spg_t> pgids;
   _get_pgids(&pgids);
@@ -9372,6 +9647,7 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_op_history_slow_op_size",
     "osd_op_history_slow_op_threshold",
     "osd_enable_op_tracker",
+    "osd_op_tracker_lightweight",
     "osd_map_cache_size",
     "osd_pg_epoch_max_lag_factor",
     "osd_pg_epoch_persisted_max_stale",
@@ -9430,6 +9706,9 @@ void OSD::handle_conf_change(const ConfigProxy& conf,
   if (changed.count("osd_enable_op_tracker")) {
       op_tracker.set_tracking(cct->_conf->osd_enable_op_tracker);
   }
+  if (changed.count("osd_op_tracker_lightweight")) {
+    op_tracker.set_lightweight(cct->_conf->osd_op_tracker_lightweight);
+  }
   if (changed.count("osd_map_cache_size")) {
     service.map_cache.set_size(cct->_conf->osd_map_cache_size);
     service.map_bl_cache.set_size(cct->_conf->osd_map_cache_size);
@@ -9897,6 +10176,11 @@ void OSDShard::consume_map(
       ++p;
       continue;
     }
+    if (slot->waiting_for_load) {
+      dout(20) << __func__ << "  " << pgid << " waiting for load" << dendl;
+      ++p;
+      continue;
+    }
     if (slot->waiting_for_merge_epoch > new_osdmap->get_epoch()) {
       dout(20) << __func__ << "  " << pgid
 	       << " waiting for merge by epoch " << slot->waiting_for_merge_epoch
@@ -10099,6 +10383,10 @@ void OSDShard::prime_merges(const OSDMapRef& as_of_osdmap,
 	       *slot->waiting_for_split.begin() < epoch) {
       dout(20) << __func__ << "  pending split on merge participant pg " << pgid
 	       << " " << slot->waiting_for_split << dendl;
+    } else if (slot->waiting_for_load) {
+      // primes its own merges once it is loaded
+      dout(20) << __func__ << "  loading merge participant pg " << pgid
+	       << dendl;
     } else {
       dout(20) << __func__ << "  creating empty merge participant " << pgid
 	       << " for merge in " << epoch << dendl;
@@ -10157,6 +10445,55 @@ void OSDShard::register_and_wake_split_child(PG *pg)
   sdata_cond.notify_one();
 }
 
+void OSDShard::prime_load(spg_t pgid)
+{
+  std::lock_guard l(shard_lock);
+  dout(10) << pgid << dendl;
+  auto r = pg_slots.emplace(pgid, make_unique<OSDShardPGSlot>());
+  ceph_assert(r.second);
+  r.first->second->waiting_for_load = true;
+}
+
+void OSDShard::register_and_wake_loaded_pg(PG *pg)
+{
+  epoch_t epoch = pg->get_osdmap_epoch();
+  {
+    std::lock_guard l(shard_lock);
+    dout(10) << pg->pg_id << " " << pg << dendl;
+    auto p = pg_slots.find(pg->pg_id);
+    ceph_assert(p != pg_slots.end());
+    auto *slot = p->second.get();
+    ceph_assert(!slot->pg);
+    ceph_assert(slot->waiting_for_load);
+    _attach_pg(slot, pg);
+    slot->waiting_for_load = false;
+    _wake_pg_slot(pg->pg_id, slot);
+  }
+
+  // the shards have consumed maps since; catch up with them
+  osd->enqueue_peering_evt(
+    pg->pg_id,
+    PGPeeringEventRef(
+      std::make_shared<PGPeeringEvent>(
+	epoch,
+	epoch,
+	NullEvt())));
+
+  std::lock_guard l{sdata_wait_lock};
+  sdata_cond.notify_one();
+}
+
+void OSDShard::unprime_load(spg_t pgid)
+{
+  std::lock_guard l(shard_lock);
+  auto p = pg_slots.find(pgid);
+  ceph_assert(p != pg_slots.end());
+  dout(10) << pgid << dendl;
+  // let the waiters find out the pg does not exist
+  _wake_pg_slot(pgid, p->second.get());
+  pg_slots.erase(p);
+}
+
 void OSDShard::unprime_split_children(spg_t parent, unsigned old_pg_num)
 {
   std::lock_guard l(shard_lock);
@@ -10268,6 +10605,10 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   }
 
   OpQueueItem item = sdata->pqueue->dequeue();
+  if (item.get_op_type() == OpQueueItem::op_type_t::client_op) {
+    --sdata->client_ops_queued;
+    osd->service.note_client_op_dequeued();
+  }
   if (osd->is_stopping()) {
     sdata->shard_lock.unlock();
     for (auto c : oncommits) {
@@ -10371,6 +10712,9 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       dout(20) << __func__ << " " << token
 	       << " splitting " << slot->waiting_for_split << dendl;
       _add_slot_waiter(token, slot, std::move(qi));
+    } else if (slot->waiting_for_load) {
+      dout(20) << __func__ << " " << token << " loading" << dendl;
+      _add_slot_waiter(token, slot, std::move(qi));
     } else if (qi.get_map_epoch() > osdmap->get_epoch()) {
       dout(20) << __func__ << " " << token
 	       << " map " << qi.get_map_epoch() << " > "
@@ -10511,6 +10855,8 @@ void OSD::ShardedOpWQ::_enqueue(OpQueueItem&& item) {
   sdata->shard_lock.lock();
 
   dout(20) << __func__ << " " << item << dendl;
+  if (item.get_op_type() == OpQueueItem::op_type_t::client_op)
+    ++sdata->client_ops_queued;
   if (priority >= osd->op_prio_cutoff)
     sdata->pqueue->enqueue_strict(
       item.get_owner(), priority, std::move(item));
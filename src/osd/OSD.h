@@ -36,6 +36,8 @@
 #include "auth/KeyRing.h"
 
 #include "osd/ClassHandler.h"
+#include "osd/HeartbeatInfo.h"
+#include "osd/HotObjectCache.h"
 
 #include "include/CompatSet.h"
 
@@ -48,6 +50,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 
 #include "include/unordered_map.h"
 
@@ -126,6 +129,9 @@ public:
   md_config_cacher_t<Option::size_t> osd_max_object_size;
   md_config_cacher_t<bool> osd_skip_data_digest;
 
+  /// copies of hot objects on a local device (osd_hot_object_cache_path)
+  std::unique_ptr<HotObjectCache> hot_object_cache;
+
   void enqueue_back(OpQueueItem&& qi);
   void enqueue_front(OpQueueItem&& qi);
 
@@ -349,6 +355,54 @@ public:
     f->close_section();
   }
 
+  // -- scrub idle windows --
+private:
+  std::atomic<uint64_t> last_client_op_ns = {0};   ///< mono clock
+  std::atomic<float> device_util = {0};   ///< busiest device, last tick
+  utime_t device_sample_stamp;
+  map<string, uint64_t> device_io_ticks;  ///< ms busy, per device
+public:
+  void note_client_op_dequeued() {
+    last_client_op_ns = ceph::mono_clock::now().time_since_epoch().count();
+  }
+  /// sample device utilisation; called from the OSD tick
+  void sample_device_util(const set<string>& devnames);
+  /// io_ticks of a block device from sysfs; -ENOENT if it has no stats
+  static int get_device_io_ticks(const string& dev, uint64_t *io_ticks,
+				 const string& sysfs = "/sys");
+  /// true if a scrub chunk may start now without competing with client I/O
+  bool scrub_idle_window(ostream *why);
+  /**
+   * the decision behind scrub_idle_window()
+   *
+   * @param window osd_scrub_idle_window, <= 0 to always allow
+   * @param queued client ops waiting in the op queues
+   * @param idle seconds since the last client op was dequeued
+   * @param util utilisation of the busiest device over the last tick
+   */
+  static bool scrub_idle(double window, unsigned queued, unsigned max_queued,
+			 double idle, float util, float max_util,
+			 ostream *why);
+  /// shortest wait before a held back scrub checks for an idle window again
+  static constexpr double SCRUB_IDLE_MIN_BACKOFF = .001;
+  enum class scrub_yield_t {
+    YIELD,    ///< hold the chunk back a little longer
+    PROCEED,  ///< scrub the chunk anyway
+    GIVE_UP,  ///< release the reservations, the scrub is scheduled again
+  };
+  /**
+   * what a scrub that is not idle does once held back for a while
+   *
+   * A scrub holds its local and replica reservations while held back,
+   * so it can't be held back for ever.  One that has not scrubbed a
+   * chunk yet gives its reservations back, one that has goes on.
+   *
+   * @param held seconds the scrub has been held back in a row
+   * @param max_wait osd_scrub_idle_max_wait, <= 0 for no limit
+   * @param started whether the scrub has started
+   */
+  static scrub_yield_t scrub_yield(double held, double max_wait, bool started);
+
   bool can_inc_scrubs_pending();
   bool inc_scrubs_pending();
   void inc_scrubs_active(bool reserved);
@@ -967,6 +1021,9 @@ struct OSDShardPGSlot {
 
   /// waiting for a merge (source or target) by this epoch
   epoch_t waiting_for_merge_epoch = 0;
+
+  /// waiting for the pg to be read from the store at startup
+  bool waiting_for_load = false;
 };
 
 struct OSDShard {
@@ -1016,6 +1073,8 @@ struct OSDShard {
 
   /// priority queue
   std::unique_ptr<OpQueue<OpQueueItem, uint64_t>> pqueue;
+  /// client ops waiting in pqueue; read without shard_lock by scrub
+  std::atomic<unsigned> client_ops_queued = {0};
 
   bool stop_waiting = false;
 
@@ -1024,6 +1083,8 @@ struct OSDShard {
   void _enqueue_front(OpQueueItem&& item, unsigned cutoff) {
     unsigned priority = item.get_priority();
     unsigned cost = item.get_cost();
+    if (item.get_op_type() == OpQueueItem::op_type_t::client_op)
+      ++client_ops_queued;
     if (priority >= cutoff)
       pqueue->enqueue_strict_front(
 	item.get_owner(),
@@ -1062,6 +1123,9 @@ struct OSDShard {
 		    set<pair<spg_t,epoch_t>> *merge_pgs);
   void register_and_wake_split_child(PG *pg);
   void unprime_split_children(spg_t parent, unsigned old_pg_num);
+  void prime_load(spg_t pgid);
+  void register_and_wake_loaded_pg(PG *pg);
+  void unprime_load(spg_t pgid);
 
   OSDShard(
     int id,
@@ -1385,42 +1449,6 @@ private:
   epoch_t latest_subscribed_epoch{0};
 
   // -- heartbeat --
-  /// information about a heartbeat peer
-  struct HeartbeatInfo {
-    int peer;           ///< peer
-    ConnectionRef con_front;   ///< peer connection (front)
-    ConnectionRef con_back;    ///< peer connection (back)
-    utime_t first_tx;   ///< time we sent our first ping request
-    utime_t last_tx;    ///< last time we sent a ping request
-    utime_t last_rx_front;  ///< last time we got a ping reply on the front side
-    utime_t last_rx_back;   ///< last time we got a ping reply on the back side
-    epoch_t epoch;      ///< most recent epoch we wanted this peer
-    /// number of connections we send and receive heartbeat pings/replies
-    static constexpr int HEARTBEAT_MAX_CONN = 2;
-    /// history of inflight pings, arranging by timestamp we sent
-    /// send time -> deadline -> remaining replies
-    map<utime_t, pair<utime_t, int>> ping_history;
-
-    bool is_unhealthy(utime_t now) {
-      if (ping_history.empty()) {
-        /// we haven't sent a ping yet or we have got all replies,
-        /// in either way we are safe and healthy for now
-        return false;
-      }
-
-      utime_t oldest_deadline = ping_history.begin()->second.first;
-      return now > oldest_deadline;
-    }
-
-    bool is_healthy(utime_t now) {
-      if (last_rx_front == utime_t() || last_rx_back == utime_t()) {
-        // only declare to be healthy until we have received the first
-        // replies from both front/back connections
-        return false;
-      }
-      return !is_unhealthy(now);
-    }
-  };
   /// state attached to outgoing heartbeat connections
   struct HeartbeatSession : public RefCountedObject {
     int peer;
@@ -1438,6 +1466,7 @@ private:
   Messenger *hb_front_server_messenger;
   Messenger *hb_back_server_messenger;
   utime_t last_heartbeat_resample;   ///< last time we chose random peers in waiting-for-healthy state
+  utime_t last_heartbeat_padded;     ///< last time we sent padded pings in fast heartbeat mode
   double daily_loadavg;
   
   void _add_heartbeat_peer(int p);
@@ -1457,6 +1486,8 @@ private:
   void heartbeat();
   void heartbeat_check();
   void heartbeat_entry();
+  void heartbeat_send_failures();
+  void dump_heartbeat_rtt(Formatter *f);
   void need_heartbeat_peer_update();
 
   void heartbeat_kick() {
@@ -1776,6 +1807,25 @@ protected:
 
   void load_pgs();
 
+  // osd_load_pgs_threads: pgs whose on-disk state (info, past
+  // intervals, log and missing set) is read in the background while
+  // the osd boots.  their slots hold any work for them until then.
+  vector<PGRef> pgs_to_load;
+  std::atomic<size_t> pgs_to_load_pos = {0};
+  std::atomic<unsigned> pgs_loaded = {0};
+  /// pgs not loaded yet; while nonzero we report no last_epoch_clean
+  /// newer than pg_load_min_lec
+  std::atomic<unsigned> pgs_load_pending = {0};
+  epoch_t pg_load_min_lec = 0;
+  std::vector<std::thread> pg_load_threads;
+  /// orders registering a loaded pg vs consume_map() priming splits
+  ceph::mutex pg_load_lock = ceph::make_mutex("OSD::pg_load_lock");
+  bool _load_pg(PGRef pg);
+  void _register_loaded_pg(PGRef pg);
+  void _prime_loaded_pg(PG *pg, const OSDMapRef& as_of_osdmap);
+  void pg_load_entry();
+  void join_pg_load_threads();
+
   /// build initial pg history and intervals on create
   void build_initial_pg_history(
     spg_t pgid,
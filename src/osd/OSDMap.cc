@@ -16,8 +16,12 @@
  */
 
 #include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <optional>
 #include <random>
+#include <thread>
 
 #include <boost/algorithm/string.hpp>
 
@@ -35,6 +39,7 @@
 
 #include "crush/CrushTreeDumper.h"
 #include "common/Clock.h"
+#include "common/Thread.h"
 #include "mon/PGMap.h"
 
 using std::list;
@@ -1308,6 +1313,9 @@ void OSDMap::set_max_osd(int m)
   }
   osd_info.resize(m);
   osd_xinfo.resize(m);
+  unshare(osd_addrs);
+  unshare(osd_uuid);
+  unshare(osd_primary_affinity);
   osd_addrs->client_addrs.resize(m);
   osd_addrs->cluster_addrs.resize(m);
   osd_addrs->hb_back_addrs.resize(m);
@@ -1507,7 +1515,7 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
   }
   mask |= CEPH_FEATURES_CRUSH;
 
-  if (!pg_upmap.empty() || !pg_upmap_items.empty())
+  if (!pg_upmap->empty() || !pg_upmap_items->empty())
     features |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
   mask |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
 
@@ -1638,62 +1646,99 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
   if (o->epoch == n->epoch)
     return;
 
-  int diff = 0;
-
-  // do addrs match?
-  if (o->max_osd != n->max_osd)
-    diff++;
-  for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
-    if ( n->osd_addrs->client_addrs[i] &&  o->osd_addrs->client_addrs[i] &&
-	*n->osd_addrs->client_addrs[i] == *o->osd_addrs->client_addrs[i])
-      n->osd_addrs->client_addrs[i] = o->osd_addrs->client_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->cluster_addrs[i] &&  o->osd_addrs->cluster_addrs[i] &&
-	*n->osd_addrs->cluster_addrs[i] == *o->osd_addrs->cluster_addrs[i])
-      n->osd_addrs->cluster_addrs[i] = o->osd_addrs->cluster_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->hb_back_addrs[i] &&  o->osd_addrs->hb_back_addrs[i] &&
-	*n->osd_addrs->hb_back_addrs[i] == *o->osd_addrs->hb_back_addrs[i])
-      n->osd_addrs->hb_back_addrs[i] = o->osd_addrs->hb_back_addrs[i];
-    else
+  // do addrs match?  n's entries are only rewritten while n holds the
+  // only reference to them.
+  if (o->osd_addrs != n->osd_addrs && n->osd_addrs.use_count() == 1) {
+    int diff = 0;
+    if (o->max_osd != n->max_osd)
       diff++;
-    if ( n->osd_addrs->hb_front_addrs[i] &&  o->osd_addrs->hb_front_addrs[i] &&
-	*n->osd_addrs->hb_front_addrs[i] == *o->osd_addrs->hb_front_addrs[i])
-      n->osd_addrs->hb_front_addrs[i] = o->osd_addrs->hb_front_addrs[i];
-    else
-      diff++;
-  }
-  if (diff == 0) {
-    // zoinks, no differences at all!
-    n->osd_addrs = o->osd_addrs;
+    for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
+      if ( n->osd_addrs->client_addrs[i] &&  o->osd_addrs->client_addrs[i] &&
+	  *n->osd_addrs->client_addrs[i] == *o->osd_addrs->client_addrs[i])
+	n->osd_addrs->client_addrs[i] = o->osd_addrs->client_addrs[i];
+      else
+	diff++;
+      if ( n->osd_addrs->cluster_addrs[i] &&  o->osd_addrs->cluster_addrs[i] &&
+	  *n->osd_addrs->cluster_addrs[i] == *o->osd_addrs->cluster_addrs[i])
+	n->osd_addrs->cluster_addrs[i] = o->osd_addrs->cluster_addrs[i];
+      else
+	diff++;
+      if ( n->osd_addrs->hb_back_addrs[i] &&  o->osd_addrs->hb_back_addrs[i] &&
+	  *n->osd_addrs->hb_back_addrs[i] == *o->osd_addrs->hb_back_addrs[i])
+	n->osd_addrs->hb_back_addrs[i] = o->osd_addrs->hb_back_addrs[i];
+      else
+	diff++;
+      if ( n->osd_addrs->hb_front_addrs[i] &&  o->osd_addrs->hb_front_addrs[i] &&
+	  *n->osd_addrs->hb_front_addrs[i] == *o->osd_addrs->hb_front_addrs[i])
+	n->osd_addrs->hb_front_addrs[i] = o->osd_addrs->hb_front_addrs[i];
+      else
+	diff++;
+    }
+    if (diff == 0) {
+      // zoinks, no differences at all!
+      n->osd_addrs = o->osd_addrs;
+    }
   }
 
   // does crush match?
-  ceph::buffer::list oc, nc;
-  encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  if (oc.contents_equal(nc)) {
-    n->crush = o->crush;
+  if (o->crush != n->crush) {
+    ceph::buffer::list oc, nc;
+    encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    if (oc.contents_equal(nc)) {
+      n->crush = o->crush;
+    }
   }
 
   // does pg_temp match?
-  if (*o->pg_temp == *n->pg_temp)
+  if (o->pg_temp != n->pg_temp &&
+      *o->pg_temp == *n->pg_temp)
     n->pg_temp = o->pg_temp;
 
   // does primary_temp match?
-  if (o->primary_temp->size() == n->primary_temp->size()) {
+  if (o->primary_temp != n->primary_temp &&
+      o->primary_temp->size() == n->primary_temp->size()) {
     if (*o->primary_temp == *n->primary_temp)
       n->primary_temp = o->primary_temp;
   }
 
+  // do upmaps match?
+  if (o->pg_upmap != n->pg_upmap &&
+      o->pg_upmap->size() == n->pg_upmap->size() &&
+      *o->pg_upmap == *n->pg_upmap)
+    n->pg_upmap = o->pg_upmap;
+  if (o->pg_upmap_items != n->pg_upmap_items &&
+      o->pg_upmap_items->size() == n->pg_upmap_items->size() &&
+      *o->pg_upmap_items == *n->pg_upmap_items)
+    n->pg_upmap_items = o->pg_upmap_items;
+
+  // does primary affinity match?
+  if (o->osd_primary_affinity && n->osd_primary_affinity &&
+      o->osd_primary_affinity != n->osd_primary_affinity &&
+      *o->osd_primary_affinity == *n->osd_primary_affinity)
+    n->osd_primary_affinity = o->osd_primary_affinity;
+
   // do uuids match?
-  if (o->osd_uuid->size() == n->osd_uuid->size() &&
+  if (o->osd_uuid != n->osd_uuid &&
+      o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
 }
 
+void OSDMap::reset_shared()
+{
+  osd_addrs = std::make_shared<addrs_s>();
+  pg_temp = std::make_shared<PGTempMap>();
+  primary_temp = std::make_shared<mempool::osdmap::map<pg_t,int32_t>>();
+  osd_primary_affinity.reset();
+  pg_upmap = std::make_shared<
+    mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>>>();
+  pg_upmap_items = std::make_shared<
+    mempool::osdmap::map<pg_t,
+			 mempool::osdmap::vector<std::pair<int32_t,int32_t>>>>();
+  osd_uuid = std::make_shared<mempool::osdmap::vector<uuid_d>>();
+}
+
 void OSDMap::clean_temps(CephContext *cct,
 			 const OSDMap& oldmap,
 			 const OSDMap& nextmap,
@@ -1785,10 +1830,10 @@ void OSDMap::maybe_remove_pg_upmaps(CephContext *cct,
   set<pg_t> to_cancel;
   map<int, map<int, float>> rule_weight_map;
 
-  for (auto& p : nextmap.pg_upmap) {
+  for (auto& p : *nextmap.pg_upmap) {
     to_check.insert(p.first);
   }
-  for (auto& p : nextmap.pg_upmap_items) {
+  for (auto& p : *nextmap.pg_upmap_items) {
     to_check.insert(p.first);
   }
   for (auto& p : pending_inc->new_pg_upmap) {
@@ -1876,10 +1921,10 @@ void OSDMap::maybe_remove_pg_upmaps(CephContext *cct,
                        << dendl;
         pending_inc->new_pg_upmap.erase(it);
       }
-      if (oldmap.pg_upmap.count(pg)) {
+      if (oldmap.pg_upmap->count(pg)) {
         ldout(cct, 10) << __func__ << " cancel invalid pg_upmap entry "
-                       << oldmap.pg_upmap.find(pg)->first << "->"
-                       << oldmap.pg_upmap.find(pg)->second
+                       << oldmap.pg_upmap->find(pg)->first << "->"
+                       << oldmap.pg_upmap->find(pg)->second
                        << dendl;
         pending_inc->old_pg_upmap.insert(pg);
       }
@@ -1893,11 +1938,11 @@ void OSDMap::maybe_remove_pg_upmaps(CephContext *cct,
                        << dendl;
         pending_inc->new_pg_upmap_items.erase(it);
       }
-      if (oldmap.pg_upmap_items.count(pg)) {
+      if (oldmap.pg_upmap_items->count(pg)) {
         ldout(cct, 10) << __func__ << " cancel invalid "
                        << "pg_upmap_items entry "
-                       << oldmap.pg_upmap_items.find(pg)->first << "->"
-                       << oldmap.pg_upmap_items.find(pg)->second
+                       << oldmap.pg_upmap_items->find(pg)->first << "->"
+                       << oldmap.pg_upmap_items->find(pg)->second
                        << dendl;
         pending_inc->old_pg_upmap_items.insert(pg);
       }
@@ -2032,6 +2077,8 @@ int OSDMap::apply_incremental(const Incremental &inc)
     if ((osd_state[osd] & CEPH_OSD_EXISTS) &&
 	(s & CEPH_OSD_EXISTS)) {
       // osd is destroyed; clear out anything interesting.
+      unshare(osd_uuid);
+      unshare(osd_addrs);
       (*osd_uuid)[osd] = uuid_d();
       osd_info[osd] = osd_info_t();
       osd_xinfo[osd] = osd_xinfo_t();
@@ -2046,6 +2093,10 @@ int OSDMap::apply_incremental(const Incremental &inc)
     }
   }
 
+  // the structures below are shared with the previous epoch (see
+  // deepish_copy_from()); only copy the ones this incremental touches.
+  if (!inc.new_up_client.empty() || !inc.new_up_cluster.empty())
+    unshare(osd_addrs);
   for (const auto &client : inc.new_up_client) {
     osd_state[client.first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
     osd_state[client.first] &= ~CEPH_OSD_STOP; // if any
@@ -2080,10 +2131,14 @@ int OSDMap::apply_incremental(const Incremental &inc)
     osd_xinfo[xinfo.first] = xinfo.second;
 
   // uuid
+  if (!inc.new_uuid.empty())
+    unshare(osd_uuid);
   for (const auto &uuid : inc.new_uuid)
     (*osd_uuid)[uuid.first] = uuid.second;
 
   // pg rebuild
+  if (!inc.new_pg_temp.empty())
+    unshare(pg_temp);
   for (const auto &pg : inc.new_pg_temp) {
     if (pg.second.empty())
       pg_temp->erase(pg.first);
@@ -2095,6 +2150,8 @@ int OSDMap::apply_incremental(const Incremental &inc)
     pg_temp->rebuild();
   }
 
+  if (!inc.new_primary_temp.empty())
+    unshare(primary_temp);
   for (const auto &pg : inc.new_primary_temp) {
     if (pg.second == -1)
       primary_temp->erase(pg.first);
@@ -2102,17 +2159,21 @@ int OSDMap::apply_incremental(const Incremental &inc)
       (*primary_temp)[pg.first] = pg.second;
   }
 
+  if (!inc.new_pg_upmap.empty() || !inc.old_pg_upmap.empty())
+    unshare(pg_upmap);
   for (auto& p : inc.new_pg_upmap) {
-    pg_upmap[p.first] = p.second;
+    (*pg_upmap)[p.first] = p.second;
   }
   for (auto& pg : inc.old_pg_upmap) {
-    pg_upmap.erase(pg);
+    pg_upmap->erase(pg);
   }
+  if (!inc.new_pg_upmap_items.empty() || !inc.old_pg_upmap_items.empty())
+    unshare(pg_upmap_items);
   for (auto& p : inc.new_pg_upmap_items) {
-    pg_upmap_items[p.first] = p.second;
+    (*pg_upmap_items)[p.first] = p.second;
   }
   for (auto& pg : inc.old_pg_upmap_items) {
-    pg_upmap_items.erase(pg);
+    pg_upmap_items->erase(pg);
   }
 
   // blacklist
@@ -2289,8 +2350,8 @@ int OSDMap::_pick_primary(const vector<int>& osds) const
 void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) const
 {
   pg_t pg = pi.raw_pg_to_pg(raw_pg);
-  auto p = pg_upmap.find(pg);
-  if (p != pg_upmap.end()) {
+  auto p = pg_upmap->find(pg);
+  if (p != pg_upmap->end()) {
     // make sure targets aren't marked out
     for (auto osd : p->second) {
       if (osd != CRUSH_ITEM_NONE && osd < max_osd && osd >= 0 &&
@@ -2303,8 +2364,8 @@ void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) co
     // continue to check and apply pg_upmap_items if any
   }
 
-  auto q = pg_upmap_items.find(pg);
-  if (q != pg_upmap_items.end()) {
+  auto q = pg_upmap_items->find(pg);
+  if (q != pg_upmap_items->end()) {
     // NOTE: this approach does not allow a bidirectional swap,
     // e.g., [[1,2],[2,1]] applied to [0,1,2] -> [0,2,1].
     for (auto& r : q->second) {
@@ -2489,7 +2550,7 @@ void OSDMap::pg_to_raw_up(pg_t pg, vector<int> *up, int *primary) const
 void OSDMap::_pg_to_up_acting_osds(
   const pg_t& pg, vector<int> *up, int *up_primary,
   vector<int> *acting, int *acting_primary,
-  bool raw_pg_to_pg) const
+  bool raw_pg_to_pg, vector<int> *raw_out) const
 {
   const pg_pool_t *pool = get_pg_pool(pg.pool());
   if (!pool ||
@@ -2502,6 +2563,8 @@ void OSDMap::_pg_to_up_acting_osds(
       acting->clear();
     if (acting_primary)
       *acting_primary = -1;
+    if (raw_out)
+      raw_out->clear();
     return;
   }
   vector<int> raw;
@@ -2528,6 +2591,8 @@ void OSDMap::_pg_to_up_acting_osds(
       up->swap(_up);
     if (up_primary)
       *up_primary = _up_primary;
+    if (raw_out)
+      raw_out->swap(raw);
   }
 
   if (acting)
@@ -2809,11 +2874,11 @@ void OSDMap::encode(ceph::buffer::list& bl, uint64_t features) const
     encode(erasure_code_profiles, bl);
 
     if (v >= 4) {
-      encode(pg_upmap, bl);
-      encode(pg_upmap_items, bl);
+      encode(*pg_upmap, bl);
+      encode(*pg_upmap_items, bl);
     } else {
-      ceph_assert(pg_upmap.empty());
-      ceph_assert(pg_upmap_items.empty());
+      ceph_assert(pg_upmap->empty());
+      ceph_assert(pg_upmap_items->empty());
     }
     if (v >= 6) {
       encode(crush_version, bl);
@@ -2926,6 +2991,8 @@ void OSDMap::decode_classic(ceph::buffer::list::const_iterator& p)
   __u16 v;
   decode(v, p);
 
+  reset_shared();
+
   // base
   decode(fsid, p);
   decode(epoch, p);
@@ -3063,6 +3130,7 @@ void OSDMap::decode(ceph::buffer::list::const_iterator& bl)
   /**
    * Since we made it past that hurdle, we can use our normal paths.
    */
+  reset_shared();
   {
     DECODE_START(9, bl); // client-usable data
     // base
@@ -3120,11 +3188,11 @@ void OSDMap::decode(ceph::buffer::list::const_iterator& bl)
     // version increased from 3 to 4 still in luminous, so same as above
     // applies.
     if (struct_v >= 4) {
-      decode(pg_upmap, bl);
-      decode(pg_upmap_items, bl);
+      decode(*pg_upmap, bl);
+      decode(*pg_upmap_items, bl);
     } else {
-      pg_upmap.clear();
-      pg_upmap_items.clear();
+      pg_upmap->clear();
+      pg_upmap_items->clear();
     }
     // again, version increased from 5 to 6 still in luminous, so above
     // applies.
@@ -3358,7 +3426,7 @@ void OSDMap::dump(Formatter *f) const
   f->close_section();
 
   f->open_array_section("pg_upmap");
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << p.first;
     f->open_array_section("osds");
@@ -3370,7 +3438,7 @@ void OSDMap::dump(Formatter *f) const
   }
   f->close_section();
   f->open_array_section("pg_upmap_items");
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << p.first;
     f->open_array_section("mappings");
@@ -3611,10 +3679,10 @@ void OSDMap::print(ostream& out) const
   }
   out << std::endl;
 
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     out << "pg_upmap " << p.first << " " << p.second << "\n";
   }
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     out << "pg_upmap_items " << p.first << " " << p.second << "\n";
   }
 
@@ -4320,7 +4388,7 @@ int OSDMap::clean_pg_upmaps(
 {
   ldout(cct, 10) << __func__ << dendl;
   int changed = 0;
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     vector<int> raw;
     int primary;
     pg_to_raw_osds(p.first, &raw, &primary);
@@ -4331,7 +4399,7 @@ int OSDMap::clean_pg_upmaps(
       ++changed;
     }
   }
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     vector<int> raw;
     int primary;
     pg_to_raw_osds(p.first, &raw, &primary);
@@ -4405,6 +4473,133 @@ bool OSDMap::try_pg_upmap(
   return true;
 }
 
+// Runs batches of independent jobs on the calling thread plus a fixed
+// set of helper threads, for the duration of one calc_pg_upmaps() call.
+class UpmapWorkers {
+  std::vector<std::thread> threads;
+  std::mutex lock;
+  std::condition_variable cond;
+  const std::function<void(size_t)> *fn = nullptr;
+  size_t next = 0, end = 0, pending = 0;
+  bool stopping = false;
+
+  // returns false if there is nothing left to start
+  bool run_one(std::unique_lock<std::mutex>& l) {
+    if (next >= end)
+      return false;
+    size_t i = next++;
+    auto f = fn;
+    l.unlock();
+    (*f)(i);
+    l.lock();
+    if (--pending == 0)
+      cond.notify_all();
+    return true;
+  }
+
+public:
+  explicit UpmapWorkers(unsigned num_threads) {
+    for (unsigned i = 1; i < num_threads; ++i) {
+      threads.push_back(make_named_thread("calc_upmaps", [this] {
+	std::unique_lock l(lock);
+	while (!stopping) {
+	  if (!run_one(l))
+	    cond.wait(l);
+	}
+      }));
+    }
+  }
+  ~UpmapWorkers() {
+    {
+      std::lock_guard l(lock);
+      stopping = true;
+      cond.notify_all();
+    }
+    for (auto& t : threads)
+      t.join();
+  }
+
+  size_t size() const {
+    return threads.size() + 1;
+  }
+
+  /// call f(i) for every i in [0, n), returning once all calls are done
+  void run(size_t n, const std::function<void(size_t)>& f) {
+    if (threads.empty()) {
+      for (size_t i = 0; i < n; ++i)
+	f(i);
+      return;
+    }
+    std::unique_lock l(lock);
+    fn = &f;
+    next = 0;
+    end = n;
+    pending = n;
+    cond.notify_all();
+    while (pending > 0) {
+      if (!run_one(l))
+	cond.wait(l);
+    }
+    fn = nullptr;
+    end = 0;
+  }
+};
+
+// The pg moves a candidate change makes, kept on the side so that
+// testing a candidate does not copy every osd's pg set.
+class PGsByOSDChange {
+  const map<int,set<pg_t>>& base;
+  map<int,set<pg_t>> added, removed;
+
+  bool in_base(int osd, pg_t pg) const {
+    auto p = base.find(osd);
+    return p != base.end() && p->second.count(pg);
+  }
+
+public:
+  explicit PGsByOSDChange(const map<int,set<pg_t>>& b) : base(b) {}
+
+  void erase(int osd, pg_t pg) {
+    auto p = added.find(osd);
+    if (p != added.end() && p->second.erase(pg))
+      return;
+    if (in_base(osd, pg))
+      removed[osd].insert(pg);
+  }
+  void insert(int osd, pg_t pg) {
+    auto p = removed.find(osd);
+    if (p != removed.end() && p->second.erase(pg))
+      return;
+    if (!in_base(osd, pg))
+      added[osd].insert(pg);
+  }
+
+  /// number of pgs osd has after the change
+  size_t size(int osd, size_t base_size) const {
+    auto a = added.find(osd);
+    auto r = removed.find(osd);
+    return base_size +
+      (a == added.end() ? 0 : a->second.size()) -
+      (r == removed.end() ? 0 : r->second.size());
+  }
+  set<int> get_osds() const {
+    set<int> osds;
+    for (auto& p : added)
+      osds.insert(p.first);
+    for (auto& p : removed)
+      osds.insert(p.first);
+    return osds;
+  }
+  void apply(map<int,set<pg_t>> *pgs_by_osd) const {
+    for (auto& p : removed)
+      for (auto& pg : p.second)
+	(*pgs_by_osd)[p.first].erase(pg);
+    for (auto& p : added)
+      for (auto& pg : p.second)
+	(*pgs_by_osd)[p.first].insert(pg);
+  }
+};
+
 int OSDMap::calc_pg_upmaps(
   CephContext *cct,
   float max_deviation_ratio,
@@ -4415,6 +4610,13 @@ int OSDMap::calc_pg_upmaps(
   ldout(cct, 10) << __func__ << " pools " << only_pools << dendl;
   OSDMap tmp;
   tmp.deepish_copy_from(*this);
+  UpmapWorkers workers(
+    std::max<uint64_t>(
+      1, cct->_conf.get_val<uint64_t>("osd_calc_pg_upmaps_threads")));
+  auto seed = cct->_conf.get_val<uint64_t>("osd_calc_pg_upmaps_seed");
+  std::default_random_engine rng(
+    seed ? (std::default_random_engine::result_type)seed :
+    std::random_device()());
   int num_changed = 0;
   map<int,set<pg_t>> pgs_by_osd;
   int total_pgs = 0;
@@ -4423,10 +4625,14 @@ int OSDMap::calc_pg_upmaps(
   for (auto& i : pools) {
     if (!only_pools.empty() && !only_pools.count(i.first))
       continue;
+    vector<vector<int>> ups(i.second.get_pg_num());
+    workers.run(ups.size(), [&](size_t ps) {
+	tmp.pg_to_up_acting_osds(pg_t(ps, i.first), &ups[ps],
+				 nullptr, nullptr, nullptr);
+      });
     for (unsigned ps = 0; ps < i.second.get_pg_num(); ++ps) {
       pg_t pg(ps, i.first);
-      vector<int> up;
-      tmp.pg_to_up_acting_osds(pg, &up, nullptr, nullptr, nullptr);
+      auto& up = ups[ps];
       ldout(cct, 20) << __func__ << " " << pg << " up " << up << dendl;
       for (auto osd : up) {
         if (osd != CRUSH_ITEM_NONE)
@@ -4477,8 +4683,8 @@ int OSDMap::calc_pg_upmaps(
   }
   float decay_factor = 1.0 / float(max);
   float stddev = 0;
-  map<int,float> osd_deviation;       // osd, deviation(pgs)
-  multimap<float,int> deviation_osd;  // deviation(pgs), osd
+  map<int,float> osd_deviation;     // osd, deviation(pgs)
+  set<pair<float,int>> deviation_osd;  // deviation(pgs), osd
   for (auto& i : pgs_by_osd) {
     // make sure osd is still there (belongs to this crush-tree)
     ceph_assert(osd_weight.count(i.first));
@@ -4564,7 +4770,7 @@ int OSDMap::calc_pg_upmaps(
 
     set<pg_t> to_unmap;
     map<pg_t, mempool::osdmap::vector<pair<int32_t,int32_t>>> to_upmap;
-    auto temp_pgs_by_osd = pgs_by_osd;
+    PGsByOSDChange temp_pgs_by_osd(pgs_by_osd);
     // always start with fullest, break if we find any changes to make
     for (auto p = deviation_osd.rbegin(); p != deviation_osd.rend(); ++p) {
       if (skip_overfull) {
@@ -4595,14 +4801,12 @@ int OSDMap::calc_pg_upmaps(
       }
       if (aggressive) {
         // shuffle PG list so they all get equal (in)attention
-        std::random_device rd;
-        std::default_random_engine rng{rd()};
         std::shuffle(pgs.begin(), pgs.end(), rng);
       }
       // look for remaps we can un-remap
       for (auto pg : pgs) {
-	auto p = tmp.pg_upmap_items.find(pg);
-        if (p == tmp.pg_upmap_items.end())
+	auto p = tmp.pg_upmap_items->find(pg);
+        if (p == tmp.pg_upmap_items->end())
           continue;
         mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
         for (auto q : p->second) {
@@ -4613,8 +4817,8 @@ int OSDMap::calc_pg_upmaps(
                            << " which remapped " << pg
                            << " into overfull osd." << osd
                            << dendl;
-            temp_pgs_by_osd[q.second].erase(pg);
-            temp_pgs_by_osd[q.first].insert(pg);
+            temp_pgs_by_osd.erase(q.second, pg);
+            temp_pgs_by_osd.insert(q.first, pg);
           } else {
             new_upmap_items.push_back(q);
           }
@@ -4640,9 +4844,10 @@ int OSDMap::calc_pg_upmaps(
       }
 
       // try upmap
+      vector<pg_t> upmap_pgs;
       for (auto pg : pgs) {
-        auto temp_it = tmp.pg_upmap.find(pg);
-        if (temp_it != tmp.pg_upmap.end()) {
+        auto temp_it = tmp.pg_upmap->find(pg);
+        if (temp_it != tmp.pg_upmap->end()) {
           // leave pg_upmap alone
           // it must be specified by admin since balancer does not
           // support pg_upmap yet
@@ -4651,61 +4856,81 @@ int OSDMap::calc_pg_upmaps(
                          << dendl;
 	  continue;
 	}
-        auto pg_pool_size = tmp.get_pg_pool_size(pg);
-        mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
-        set<int> existing;
-        auto it = tmp.pg_upmap_items.find(pg);
-        if (it != tmp.pg_upmap_items.end() &&
-            it->second.size() >= (size_t)pg_pool_size) {
+        auto it = tmp.pg_upmap_items->find(pg);
+        if (it != tmp.pg_upmap_items->end() &&
+            it->second.size() >= (size_t)tmp.get_pg_pool_size(pg)) {
           ldout(cct, 10) << " " << pg << " already has full-size pg_upmap_items "
                          << it->second << ", skipping"
                          << dendl;
           continue;
-        } else if (it != tmp.pg_upmap_items.end()) {
-          ldout(cct, 10) << " " << pg << " already has pg_upmap_items "
-                         << it->second
-                         << dendl;
-          new_upmap_items = it->second;
-          // build existing too (for dedup)
-          for (auto i : it->second) {
-            existing.insert(i.first);
-            existing.insert(i.second);
+        }
+        upmap_pgs.push_back(pg);
+      }
+      // Score candidates a batch at a time, in parallel, and take the
+      // first one (in pg order) that works, as a serial search would.
+      size_t batch = workers.size() > 1 ? workers.size() * 2 : 1;
+      for (size_t b = 0; b < upmap_pgs.size(); b += batch) {
+        size_t n = std::min(batch, upmap_pgs.size() - b);
+        vector<vector<int>> origs(n), outs(n);
+        vector<char> remapped(n);
+        workers.run(n, [&](size_t j) {
+            pg_t pg = upmap_pgs[b + j];
+            tmp.pg_to_raw_upmap(pg, &origs[j]); // including existing upmaps too
+            remapped[j] = try_pg_upmap(cct, pg, overfull, underfull,
+                                       &origs[j], &outs[j]);
+          });
+        for (size_t j = 0; j < n; ++j) {
+          pg_t pg = upmap_pgs[b + j];
+          ldout(cct, 10) << " trying " << pg << dendl;
+          if (!remapped[j]) {
+            continue;
+          }
+          auto& orig = origs[j];
+          auto& out = outs[j];
+          ldout(cct, 10) << " " << pg << " " << orig << " -> " << out << dendl;
+          if (orig.size() != out.size()) {
+            continue;
+          }
+          ceph_assert(orig != out);
+          auto pg_pool_size = tmp.get_pg_pool_size(pg);
+          mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
+          set<int> existing;
+          auto it = tmp.pg_upmap_items->find(pg);
+          if (it != tmp.pg_upmap_items->end()) {
+            ldout(cct, 10) << " " << pg << " already has pg_upmap_items "
+                           << it->second
+                           << dendl;
+            new_upmap_items = it->second;
+            // build existing too (for dedup)
+            for (auto i : it->second) {
+              existing.insert(i.first);
+              existing.insert(i.second);
+            }
+            // fall through
+            // to see if we can append more remapping pairs
+          }
+          for (unsigned i = 0; i < out.size(); ++i) {
+            if (orig[i] == out[i])
+              continue; // skip invalid remappings
+            if (existing.count(orig[i]) || existing.count(out[i]))
+              continue; // we want new remappings only!
+            ldout(cct, 10) << " will try adding new remapping pair "
+                           << orig[i] << " -> " << out[i] << " for " << pg
+                           << dendl;
+            existing.insert(orig[i]);
+            existing.insert(out[i]);
+            temp_pgs_by_osd.erase(orig[i], pg);
+            temp_pgs_by_osd.insert(out[i], pg);
+            ceph_assert(new_upmap_items.size() < (size_t)pg_pool_size);
+            new_upmap_items.push_back(make_pair(orig[i], out[i]));
+            // append new remapping pairs slowly
+            // This way we can make sure that each tiny change will
+            // definitely make distribution of PGs converging to
+            // the perfect status.
+            to_upmap[pg] = new_upmap_items;
+            goto test_change;
           }
-          // fall through
-          // to see if we can append more remapping pairs
         }
-	ldout(cct, 10) << " trying " << pg << dendl;
-	vector<int> orig, out;
-        tmp.pg_to_raw_upmap(pg, &orig); // including existing upmaps too
-	if (!try_pg_upmap(cct, pg, overfull, underfull, &orig, &out)) {
-	  continue;
-	}
-	ldout(cct, 10) << " " << pg << " " << orig << " -> " << out << dendl;
-	if (orig.size() != out.size()) {
-	  continue;
-	}
-	ceph_assert(orig != out);
-	for (unsigned i = 0; i < out.size(); ++i) {
-          if (orig[i] == out[i])
-            continue; // skip invalid remappings
-          if (existing.count(orig[i]) || existing.count(out[i]))
-            continue; // we want new remappings only!
-          ldout(cct, 10) << " will try adding new remapping pair "
-                         << orig[i] << " -> " << out[i] << " for " << pg
-                         << dendl;
-          existing.insert(orig[i]);
-          existing.insert(out[i]);
-          temp_pgs_by_osd[orig[i]].erase(pg);
-          temp_pgs_by_osd[out[i]].insert(pg);
-          ceph_assert(new_upmap_items.size() < (size_t)pg_pool_size);
-          new_upmap_items.push_back(make_pair(orig[i], out[i]));
-          // append new remapping pairs slowly
-          // This way we can make sure that each tiny change will
-          // definitely make distribution of PGs converging to
-          // the perfect status.
-          to_upmap[pg] = new_upmap_items;
-          goto test_change;
-	}
       }
     }
 
@@ -4734,8 +4959,8 @@ int OSDMap::calc_pg_upmaps(
       // look for remaps we can un-remap
       vector<pair<pg_t,
         mempool::osdmap::vector<pair<int32_t,int32_t>>>> candidates;
-      candidates.reserve(tmp.pg_upmap_items.size());
-      for (auto& i : tmp.pg_upmap_items) {
+      candidates.reserve(tmp.pg_upmap_items->size());
+      for (auto& i : *tmp.pg_upmap_items) {
         if (to_skip.count(i.first))
           continue;
         if (!only_pools.empty() && !only_pools.count(i.first.pool()))
@@ -4744,8 +4969,6 @@ int OSDMap::calc_pg_upmaps(
       }
       if (aggressive) {
         // shuffle candidates so they all get equal (in)attention
-        std::random_device rd;
-        std::default_random_engine rng{rd()};
         std::shuffle(candidates.begin(), candidates.end(), rng);
       }
       for (auto& i : candidates) {
@@ -4759,8 +4982,8 @@ int OSDMap::calc_pg_upmaps(
                            << " which remapped " << pg
                            << " out from underfull osd." << osd
                            << dendl;
-            temp_pgs_by_osd[j.second].erase(pg);
-            temp_pgs_by_osd[j.first].insert(pg);
+            temp_pgs_by_osd.erase(j.second, pg);
+            temp_pgs_by_osd.insert(j.first, pg);
           } else {
             new_upmap_items.push_back(j);
           }
@@ -4810,21 +5033,24 @@ int OSDMap::calc_pg_upmaps(
 
     // test change, apply if change is good
     ceph_assert(to_unmap.size() || to_upmap.size());
-    float new_stddev = 0;
-    map<int,float> temp_osd_deviation;
-    multimap<float,int> temp_deviation_osd;
-    for (auto& i : temp_pgs_by_osd) {
+    // the sum is redone in osd order, so that it rounds exactly as
+    // it does for the initial distribution
+    auto changed_osds = temp_pgs_by_osd.get_osds();
+    for (auto osd : changed_osds) {
       // make sure osd is still there (belongs to this crush-tree)
+      ceph_assert(pgs_by_osd.count(osd));
+    }
+    float new_stddev = 0;
+    for (auto& i : pgs_by_osd) {
       ceph_assert(osd_weight.count(i.first));
       float target = osd_weight[i.first] * pgs_per_weight;
-      float deviation = (float)i.second.size() - target;
+      size_t pgs = temp_pgs_by_osd.size(i.first, i.second.size());
+      float deviation = (float)pgs - target;
       ldout(cct, 20) << " osd." << i.first
-                     << "\tpgs " << i.second.size()
+                     << "\tpgs " << pgs
                      << "\ttarget " << target
                      << "\tdeviation " << deviation
                      << dendl;
-      temp_osd_deviation[i.first] = deviation;
-      temp_deviation_osd.insert(make_pair(deviation, i.first));
       new_stddev += deviation * deviation;
     }
     ldout(cct, 10) << " stddev " << stddev << " -> " << new_stddev << dendl;
@@ -4859,13 +5085,21 @@ int OSDMap::calc_pg_upmaps(
     // ready to go
     ceph_assert(new_stddev < stddev);
     stddev = new_stddev;
-    pgs_by_osd = temp_pgs_by_osd;
-    osd_deviation = temp_osd_deviation;
-    deviation_osd = temp_deviation_osd;
+    for (auto osd : changed_osds) {
+      deviation_osd.erase(make_pair(osd_deviation[osd], osd));
+    }
+    temp_pgs_by_osd.apply(&pgs_by_osd);
+    for (auto osd : changed_osds) {
+      float target = osd_weight[osd] * pgs_per_weight;
+      float deviation = (float)pgs_by_osd[osd].size() - target;
+      osd_deviation[osd] = deviation;
+      deviation_osd.insert(make_pair(deviation, osd));
+    }
+    unshare(tmp.pg_upmap_items);  // still shared with *this
     for (auto& i : to_unmap) {
       ldout(cct, 10) << " unmap pg " << i << dendl;
-      ceph_assert(tmp.pg_upmap_items.count(i));
-      tmp.pg_upmap_items.erase(i);
+      ceph_assert(tmp.pg_upmap_items->count(i));
+      tmp.pg_upmap_items->erase(i);
       pending_inc->old_pg_upmap_items.insert(i);
       ++num_changed;
     }
@@ -4873,7 +5107,7 @@ int OSDMap::calc_pg_upmaps(
       ldout(cct, 10) << " upmap pg " << i.first
                      << " new pg_upmap_items " << i.second
                      << dendl;
-      tmp.pg_upmap_items[i.first] = i.second;
+      (*tmp.pg_upmap_items)[i.first] = i.second;
       pending_inc->new_pg_upmap_items[i.first] = i.second;
       ++num_changed;
     }
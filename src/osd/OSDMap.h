@@ -553,8 +553,8 @@ private:
   std::shared_ptr< mempool::osdmap::vector<__u32> > osd_primary_affinity; ///< 16.16 fixed point, 0x10000 = baseline
 
   // remap (post-CRUSH, pre-up)
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>> pg_upmap; ///< remap pg
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>> pg_upmap_items; ///< remap osds in up set
+  std::shared_ptr< mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>> > pg_upmap; ///< remap pg
+  std::shared_ptr< mempool::osdmap::map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>> > pg_upmap_items; ///< remap osds in up set
 
   mempool::osdmap::map<int64_t,pg_pool_t> pools;
   mempool::osdmap::map<int64_t,std::string> pool_name;
@@ -605,6 +605,7 @@ private:
   uint32_t crush_version = 1;
 
   friend class OSDMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -615,6 +616,8 @@ private:
 	     osd_addrs(std::make_shared<addrs_s>()),
 	     pg_temp(std::make_shared<PGTempMap>()),
 	     primary_temp(std::make_shared<mempool::osdmap::map<pg_t,int32_t>>()),
+	     pg_upmap(std::make_shared<mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>>>()),
+	     pg_upmap_items(std::make_shared<mempool::osdmap::map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>>>()),
 	     osd_uuid(std::make_shared<mempool::osdmap::vector<uuid_d>>()),
 	     cluster_snapshot_epoch(0),
 	     new_blacklist_entries(false),
@@ -626,6 +629,19 @@ private:
 private:
   OSDMap(const OSDMap& other) = default;
   OSDMap& operator=(const OSDMap& other) = default;
+
+  /**
+   * The shared_ptr members above may be shared with other epochs (see
+   * deepish_copy_from() and dedup()); a map that is about to modify one
+   * must take a private copy first.
+   */
+  template<typename T>
+  static void unshare(std::shared_ptr<T>& p) {
+    if (p && p.use_count() > 1)
+      p = std::make_shared<T>(*p);
+  }
+  /// drop all shared structures ahead of a full decode
+  void reset_shared();
 public:
 
   /// return feature mask subset that is relevant to OSDMap encoding
@@ -636,16 +652,10 @@ public:
   uint64_t get_encoding_features() const;
 
   void deepish_copy_from(const OSDMap& o) {
+    // NOTE: osd_addrs, pg_temp, primary_temp, osd_primary_affinity,
+    // pg_upmap, pg_upmap_items and osd_uuid stay shared with o; they
+    // are copied on write by whichever map modifies them first.
     *this = o;
-    primary_temp.reset(new mempool::osdmap::map<pg_t,int32_t>(*o.primary_temp));
-    pg_temp.reset(new PGTempMap(*o.pg_temp));
-    osd_uuid.reset(new mempool::osdmap::vector<uuid_d>(*o.osd_uuid));
-
-    if (o.osd_primary_affinity)
-      osd_primary_affinity.reset(new mempool::osdmap::vector<__u32>(*o.osd_primary_affinity));
-
-    // NOTE: this still references shared entity_addrvec_t's.
-    osd_addrs.reset(new addrs_s(*o.osd_addrs));
 
     // NOTE: we do not copy crush.  note that apply_incremental will
     // allocate a new CrushWrapper, though.
@@ -764,6 +774,8 @@ public:
       osd_primary_affinity.reset(
 	new mempool::osdmap::vector<__u32>(
 	  max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
+    else
+      unshare(osd_primary_affinity);
     (*osd_primary_affinity)[o] = w;
   }
   unsigned get_primary_affinity(int o) const {
@@ -1152,10 +1164,12 @@ private:
 
   /**
    *  map to up and acting. Fills in whatever fields are non-NULL.
+   *  raw is only filled in if up or up_primary is requested.
    */
   void _pg_to_up_acting_osds(const pg_t& pg, std::vector<int> *up, int *up_primary,
                              std::vector<int> *acting, int *acting_primary,
-			     bool raw_pg_to_pg = true) const;
+			     bool raw_pg_to_pg = true,
+			     std::vector<int> *raw = nullptr) const;
 
 public:
   /***
@@ -1194,6 +1208,14 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /// as above, also returning the raw (CRUSH plus upmap) mapping
+  void pg_to_raw_up_acting_osds(pg_t pg, std::vector<int> *raw,
+				std::vector<int> *up, int *up_primary,
+				std::vector<int> *acting,
+				int *acting_primary) const {
+    _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary,
+			  true, raw);
+  }
   bool pg_is_ec(pg_t pg) const {
     auto i = pools.find(pg.pool());
     ceph_assert(i != pools.end());
@@ -1399,8 +1421,8 @@ public:
   int get_osds_by_bucket_name(const std::string &name, std::set<int> *osds) const;
 
   bool have_pg_upmaps(pg_t pg) const {
-    return pg_upmap.count(pg) ||
-      pg_upmap_items.count(pg);
+    return pg_upmap->count(pg) ||
+      pg_upmap_items->count(pg);
   }
 
   bool check_full(const set<pg_shard_t> &missing_on) const {
@@ -1456,8 +1478,8 @@ public:
   int validate_crush_rules(CrushWrapper *crush, std::ostream *ss) const;
 
   void clear_temp() {
-    pg_temp->clear();
-    primary_temp->clear();
+    pg_temp = std::make_shared<PGTempMap>();
+    primary_temp = std::make_shared<mempool::osdmap::map<pg_t,int32_t>>();
   }
 
 private:
@@ -8,6 +8,10 @@
 
 #include "common/debug.h"
 
+extern "C" {
+#include "crush/hash.h"
+}
+
 MEMPOOL_DEFINE_OBJECT_FACTORY(OSDMapMapping, osdmapmapping,
 			      osdmap_mapping);
 
@@ -42,6 +46,202 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
   ceph_assert(pools.size() == osdmap.get_pools().size());
 }
 
+// beyond this many reweighted osds it is cheaper to remap everything
+// than to test each pg against each of them
+static const unsigned MAX_REWEIGHTED_OSDS = 64;
+
+// whether pgs of the two pools map the same way given the same osds
+static bool same_placement(const pg_pool_t& a, const pg_pool_t& b)
+{
+  return
+    a.get_type() == b.get_type() &&
+    a.get_size() == b.get_size() &&
+    a.get_crush_rule() == b.get_crush_rule() &&
+    a.get_pg_num() == b.get_pg_num() &&
+    a.get_pgp_num() == b.get_pgp_num() &&
+    a.has_flag(pg_pool_t::FLAG_HASHPSPOOL) ==
+      b.has_flag(pg_pool_t::FLAG_HASHPSPOOL);
+}
+
+// the test crush applies to a device with the given reweight (is_out()
+// in crush/mapper.c)
+static bool crush_is_out(unsigned weight, int osd, ps_t pps)
+{
+  if (weight >= 0x10000)
+    return false;
+  if (weight == 0)
+    return true;
+  return (crush_hash32_2(CRUSH_HASH_RJENKINS1, pps, osd) & 0xffff) >= weight;
+}
+
+// call f for every pg whose entry differs between two pg-keyed maps
+template<typename M, typename F>
+static void diff_pg_map(const M& a, const M& b, F&& f)
+{
+  auto p = a.begin();
+  auto q = b.begin();
+  while (p != a.end() || q != b.end()) {
+    if (q == b.end() || (p != a.end() && p->first < q->first)) {
+      f(p->first);
+      ++p;
+    } else if (p == a.end() || q->first < p->first) {
+      f(q->first);
+      ++q;
+    } else {
+      if (!(p->second == q->second)) {
+	f(p->first);
+      }
+      ++p;
+      ++q;
+    }
+  }
+}
+
+// Work out which pgs can map differently in osdmap than in the map of
+// the last completed update.  A pg's up and acting sets are a function
+// of its pool's placement parameters, the crush map, the reweights
+// crush tests the pg's candidate devices against, the state and
+// primary affinity of the osds it maps to, and its temp and upmap
+// entries; a pg none of those changed for keeps its mapping.
+void OSDMapMapping::_mark_dirty(const OSDMap& osdmap)
+{
+  bufferlist bl;
+  osdmap.crush->encode(bl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+  pending_crush_crc = bl.crc32c(0);
+
+  // the table is about to change; until this update completes it can't
+  // be diffed against anything
+  std::shared_ptr<OSDMap> old;
+  old.swap(prev);
+
+  auto all_dirty = [this]() {
+    for (auto& p : pools) {
+      p.second.dirty.clear();
+    }
+  };
+  int max_osd = osdmap.get_max_osd();
+  if (!old ||
+      pending_crush_crc != prev_crush_crc ||
+      old->get_max_osd() != max_osd) {
+    all_dirty();
+    return;
+  }
+
+  std::vector<bool> changed(max_osd);  // state or primary affinity
+  bool any_changed = false;
+  std::vector<int> reweighted;
+  for (int o = 0; o < max_osd; ++o) {
+    bool exists = osdmap.exists(o);
+    if (exists != old->exists(o)) {
+      if (osdmap.get_weight(o) || old->get_weight(o)) {
+	// crush may pick it, and the raw mappings we keep only include
+	// osds that existed
+	all_dirty();
+	return;
+      }
+      changed[o] = true;
+    }
+    if (osdmap.is_up(o) != old->is_up(o) ||
+	osdmap.get_primary_affinity(o) != old->get_primary_affinity(o)) {
+      changed[o] = true;
+    }
+    any_changed |= changed[o];
+    if (osdmap.get_weight(o) != old->get_weight(o)) {
+      reweighted.push_back(o);
+    }
+  }
+  if (reweighted.size() > MAX_REWEIGHTED_OSDS) {
+    all_dirty();
+    return;
+  }
+
+  for (auto& p : pools) {
+    const pg_pool_t *pi = osdmap.get_pg_pool(p.first);
+    const pg_pool_t *old_pi = old->get_pg_pool(p.first);
+    ceph_assert(pi);
+    if (!old_pi || !same_placement(*pi, *old_pi)) {
+      p.second.dirty.clear();
+      continue;
+    }
+    p.second.dirty.assign(p.second.pg_num, false);
+    for (unsigned ps = 0; ps < p.second.pg_num; ++ps) {
+      const int32_t *raw =
+	&p.second.table[p.second.row_size() * ps + p.second.raw_offset()];
+      bool dirty = raw[0] < 0;
+      for (int i = 0; !dirty && any_changed && i < raw[0]; ++i) {
+	dirty = raw[1 + i] >= 0 && raw[1 + i] < max_osd && changed[raw[1 + i]];
+      }
+      if (!dirty && !reweighted.empty()) {
+	ps_t pps = pi->raw_pg_to_pps(pg_t(ps, p.first));
+	for (auto o : reweighted) {
+	  if (crush_is_out(osdmap.get_weight(o), o, pps) !=
+	      crush_is_out(old->get_weight(o), o, pps)) {
+	    dirty = true;
+	    break;
+	  }
+	}
+      }
+      p.second.dirty[ps] = dirty;
+    }
+  }
+
+  auto mark = [this](pg_t pgid) {
+    auto p = pools.find(pgid.pool());
+    if (p != pools.end() && !p->second.dirty.empty() &&
+	pgid.ps() < p->second.pg_num) {
+      p->second.dirty[pgid.ps()] = true;
+    }
+  };
+  auto affected = [&](int osd) {
+    return osd >= 0 && osd < max_osd &&
+      (changed[osd] || osdmap.get_weight(osd) != old->get_weight(osd));
+  };
+  if (old->pg_temp != osdmap.pg_temp) {
+    diff_pg_map(*old->pg_temp, *osdmap.pg_temp, mark);
+  }
+  if (old->primary_temp != osdmap.primary_temp) {
+    diff_pg_map(*old->primary_temp, *osdmap.primary_temp, mark);
+  }
+  if (old->pg_upmap != osdmap.pg_upmap) {
+    diff_pg_map(*old->pg_upmap, *osdmap.pg_upmap, mark);
+  }
+  if (old->pg_upmap_items != osdmap.pg_upmap_items) {
+    diff_pg_map(*old->pg_upmap_items, *osdmap.pg_upmap_items, mark);
+  }
+  if (any_changed || !reweighted.empty()) {
+    // temp and upmap targets are filtered by state and weight
+    for (const auto& p : *osdmap.pg_temp) {
+      for (auto osd : p.second) {
+	if (affected(osd)) {
+	  mark(p.first);
+	  break;
+	}
+      }
+    }
+    for (const auto& p : *osdmap.primary_temp) {
+      if (affected(p.second)) {
+	mark(p.first);
+      }
+    }
+    for (const auto& p : *osdmap.pg_upmap) {
+      for (auto osd : p.second) {
+	if (affected(osd)) {
+	  mark(p.first);
+	  break;
+	}
+      }
+    }
+    for (const auto& p : *osdmap.pg_upmap_items) {
+      for (auto& q : p.second) {
+	if (affected(q.first) || affected(q.second)) {
+	  mark(p.first);
+	  break;
+	}
+      }
+    }
+  }
+}
+
 void OSDMapMapping::update(const OSDMap& osdmap)
 {
   _start(osdmap);
@@ -54,7 +254,12 @@ void OSDMapMapping::update(const OSDMap& osdmap)
 
 void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
 {
+  auto i = pools.find(pgid.pool());
+  ceph_assert(i != pools.end());
+  i->second.dirty.clear();
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
+  // the table no longer matches a single map
+  prev.reset();
 }
 
 void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
@@ -88,6 +293,9 @@ void OSDMapMapping::_finish(const OSDMap& osdmap)
 {
   _build_rmap(osdmap);
   epoch = osdmap.get_epoch();
+  prev = std::make_shared<OSDMap>();
+  prev->deepish_copy_from(osdmap);
+  prev_crush_crc = pending_crush_crc;
 }
 
 void OSDMapMapping::_dump()
@@ -113,13 +321,15 @@ void OSDMapMapping::_update_range(
   ceph_assert(pg_begin <= pg_end);
   ceph_assert(pg_end <= i->second.pg_num);
   for (unsigned ps = pg_begin; ps < pg_end; ++ps) {
-    std::vector<int> up, acting;
+    if (!i->second.is_dirty(ps)) {
+      continue;
+    }
+    std::vector<int> raw, up, acting;
     int up_primary, acting_primary;
-    osdmap.pg_to_up_acting_osds(
+    osdmap.pg_to_raw_up_acting_osds(
       pg_t(ps, pool),
-      &up, &up_primary, &acting, &acting_primary);
-    i->second.set(ps, std::move(up), up_primary,
-		  std::move(acting), acting_primary);
+      &raw, &up, &up_primary, &acting, &acting_primary);
+    i->second.set(ps, raw, up, up_primary, acting, acting_primary);
   }
 }
 
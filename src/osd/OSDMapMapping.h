@@ -5,6 +5,7 @@
 #ifndef CEPH_OSDMAPMAPPING_H
 #define CEPH_OSDMAPMAPPING_H
 
+#include <memory>
 #include <vector>
 #include <map>
 
@@ -180,6 +181,9 @@ private:
     bool erasure = false;
     mempool::osdmap_mapping::vector<int32_t> table;
 
+    /// pgs the next update has to recompute; empty means all of them
+    std::vector<bool> dirty;
+
     size_t row_size() const {
       return
 	1 + // acting_primary
@@ -187,7 +191,12 @@ private:
 	1 + // num acting
 	1 + // num up
 	size + // acting
-	size;  // up
+	size + // up
+	1 + // num raw, or -1 if it did not fit
+	size;  // raw (crush output)
+    }
+    size_t raw_offset() const {
+      return 4 + size + size;
     }
 
     PoolMapping(int s, int p, bool e)
@@ -223,7 +232,12 @@ private:
       }
     }
 
+    bool is_dirty(size_t ps) const {
+      return dirty.empty() || dirty[ps];
+    }
+
     void set(size_t ps,
+	     const std::vector<int>& raw,
 	     const std::vector<int>& up,
 	     int up_primary,
 	     const std::vector<int>& acting,
@@ -242,6 +256,17 @@ private:
       for (int i = 0; i < row[3]; ++i) {
 	row[4 + size + i] = up[i];
       }
+      // a truncated raw mapping can't tell which osds the pg depends
+      // on, so such a pg is recomputed on every update
+      int32_t *raw_row = row + raw_offset();
+      if (raw.size() > size) {
+	raw_row[0] = -1;
+      } else {
+	raw_row[0] = raw.size();
+	for (int i = 0; i < raw_row[0]; ++i) {
+	  raw_row[1 + i] = raw[i];
+	}
+      }
     }
   };
 
@@ -252,7 +277,14 @@ private:
   epoch_t epoch = 0;
   uint64_t num_pgs = 0;
 
+  /// the map of the last completed update, which the next update is
+  /// diffed against to find the pgs it has to recompute
+  std::shared_ptr<OSDMap> prev;
+  uint32_t prev_crush_crc = 0;
+  uint32_t pending_crush_crc = 0;
+
   void _init_mappings(const OSDMap& osdmap);
+  void _mark_dirty(const OSDMap& osdmap);
   void _update_range(
     const OSDMap& map,
     int64_t pool,
@@ -262,6 +294,7 @@ private:
 
   void _start(const OSDMap& osdmap) {
     _init_mappings(osdmap);
+    _mark_dirty(osdmap);
   }
   void _finish(const OSDMap& osdmap);
 
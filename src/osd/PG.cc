@@ -729,7 +729,9 @@ void PG::clear_recovery_state()
 
   backfill_info.clear();
   peer_backfill_info.clear();
+  peer_backfill_prefetched.clear();
   waiting_on_backfill.clear();
+  backfill_prefetching.clear();
   _clear_recovery_state();  // pg impl specific hook
 }
 
@@ -1785,6 +1787,11 @@ void PG::rebuild_missing_set_with_deletes(PGLog &pglog)
     recovery_state.get_info());
 }
 
+bool PG::load_spilled_log(PGLog &pglog, pg_info_t &info, eversion_t since)
+{
+  return pglog.load_spilled(osd->store, ch, pgmeta_oid, info, since);
+}
+
 void PG::on_activate_committed()
 {
   if (!is_primary()) {
@@ -1855,6 +1862,11 @@ void PG::_request_scrub_map(
     allow_preemption,
     scrubber.priority,
     ops_blocked_by_scrub());
+  if (deep) {
+    repscrubop->deep_since = scrubber.deep_since;
+    repscrubop->deep_seed = scrubber.deep_seed;
+    repscrubop->deep_reread_ppm = scrubber.deep_reread_ppm;
+  }
   // default priority, we want the rep scrub processed prior to any recovery
   // or client io messages (we are holding a lock!)
   osd->send_message_osd_cluster(
@@ -2256,6 +2268,11 @@ int PG::build_scrub_map_chunk(
   // start
   while (pos.empty()) {
     pos.deep = deep;
+    if (deep) {
+      pos.deep_since = scrubber.deep_since;
+      pos.deep_seed = scrubber.deep_seed;
+      pos.deep_reread_ppm = scrubber.deep_reread_ppm;
+    }
     map.valid_through = info.last_update;
 
     // objects
@@ -2391,6 +2408,9 @@ void PG::replica_scrub(
   scrubber.end = msg->end;
   scrubber.max_end = msg->end;
   scrubber.deep = msg->deep;
+  scrubber.deep_since = msg->deep_since;
+  scrubber.deep_seed = msg->deep_seed;
+  scrubber.deep_reread_ppm = msg->deep_reread_ppm;
   scrubber.epoch_start = info.history.same_interval_since;
   if (msg->priority) {
     scrubber.priority = msg->priority;
@@ -2413,10 +2433,54 @@ void PG::replica_scrub(
  */
 void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
 {
-  if (cct->_conf->osd_scrub_sleep > 0 &&
-      (scrubber.state == PG::Scrubber::NEW_CHUNK ||
-       scrubber.state == PG::Scrubber::INACTIVE) &&
-       scrubber.needs_sleep) {
+  double scrub_sleep = 0;
+  bool yield = false;
+  if (scrubber.state == PG::Scrubber::NEW_CHUNK ||
+      scrubber.state == PG::Scrubber::INACTIVE) {
+    if (cct->_conf->osd_scrub_sleep > 0 && scrubber.needs_sleep) {
+      scrub_sleep = cct->_conf->osd_scrub_sleep;
+    }
+    // no chunk is blocked between chunks, so hold the scrub back here
+    // for as long as client I/O keeps the OSD busy
+    stringstream why;
+    if (is_primary() && !scrubber.must_scrub &&
+	!pg_has_reset_since(queued) &&
+	!osd->scrub_idle_window(&why)) {
+      utime_t now = ceph_clock_now();
+      if (scrubber.yield_start == utime_t()) {
+	scrubber.yield_start = now;
+      }
+      double held = now - scrubber.yield_start;
+      switch (OSDService::scrub_yield(
+		held, cct->_conf->osd_scrub_idle_max_wait, scrubber.active)) {
+      case OSDService::scrub_yield_t::YIELD:
+	dout(20) << __func__ << " not idle (" << why.str() << "), yielding"
+		 << dendl;
+	yield = true;
+	scrub_sleep = std::max({scrub_sleep,
+				(double)cct->_conf->osd_scrub_idle_backoff,
+				OSDService::SCRUB_IDLE_MIN_BACKOFF});
+	break;
+      case OSDService::scrub_yield_t::PROCEED:
+	dout(10) << __func__ << " not idle (" << why.str() << ") for "
+		 << held << "s, scrubbing the chunk anyway" << dendl;
+	scrubber.yield_start = utime_t();
+	break;
+      case OSDService::scrub_yield_t::GIVE_UP:
+	dout(10) << __func__ << " not idle (" << why.str() << ") for "
+		 << held << "s, releasing the scrub reservations" << dendl;
+	ceph_assert(scrub_queued);
+	scrub_queued = false;
+	clear_scrub_reserved();
+	scrub_unreserve_replicas();
+	scrub_clear_state();
+	return;
+      }
+    } else {
+      scrubber.yield_start = utime_t();
+    }
+  }
+  if (scrub_sleep > 0 || yield) {
     ceph_assert(!scrubber.sleeping);
     dout(20) << __func__ << " state is INACTIVE|NEW_CHUNK, sleeping" << dendl;
 
@@ -2425,7 +2489,7 @@ void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
     spg_t pgid = get_pgid();
     int state = scrubber.state;
     auto scrub_requeue_callback =
-        new FunctionContext([osds, pgid, state](int r) {
+        new FunctionContext([osds, pgid, state, yield](int r) {
           PGRef pg = osds->osd->lookup_lock_pg(pgid);
           if (pg == nullptr) {
             lgeneric_dout(osds->osd->cct, 20)
@@ -2436,9 +2500,12 @@ void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
           }
           pg->scrubber.sleeping = false;
           pg->scrubber.needs_sleep = false;
+          utime_t slept = ceph_clock_now() - pg->scrubber.sleep_start;
+          if (yield) {
+            osds->logger->tinc(l_osd_scrub_yield, slept);
+          }
           lgeneric_dout(pg->cct, 20)
-              << "scrub_requeue_callback: slept for "
-              << ceph_clock_now() - pg->scrubber.sleep_start
+              << "scrub_requeue_callback: slept for " << slept
               << ", re-queuing scrub with state " << state << dendl;
           pg->scrub_queued = false;
           pg->requeue_scrub();
@@ -2446,8 +2513,7 @@ void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
           pg->unlock();
         });
     std::lock_guard l(osd->sleep_lock);
-    osd->sleep_timer.add_event_after(cct->_conf->osd_scrub_sleep,
-                                           scrub_requeue_callback);
+    osd->sleep_timer.add_event_after(scrub_sleep, scrub_requeue_callback);
     scrubber.sleeping = true;
     scrubber.sleep_start = ceph_clock_now();
     return;
@@ -2479,6 +2545,24 @@ void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
     ceph_assert(recovery_state.get_backfill_targets().empty());
 
     scrubber.deep = state_test(PG_STATE_DEEP_SCRUB);
+    scrubber.start_version = info.last_update;
+    if (scrubber.deep &&
+	cct->_conf->osd_deep_scrub_incremental &&
+	pool.info.is_replicated() &&
+	!scrubber.must_deep_scrub &&
+	!scrubber.must_repair &&
+	!scrubber.auto_repair &&
+	!state_test(PG_STATE_REPAIR) &&
+	info.history.last_deep_scrub != eversion_t() &&
+	info.stats.stats.sum.num_scrub_errors == 0) {
+      // objects unchanged since the last clean deep scrub were verified then
+      scrubber.deep_since = info.history.last_deep_scrub;
+      scrubber.deep_seed = rand();
+      scrubber.deep_reread_ppm =
+	cct->_conf->osd_deep_scrub_reread_ratio * 1000000;
+      dout(10) << "incremental deep scrub since " << scrubber.deep_since
+	       << ", rereading " << scrubber.deep_reread_ppm << " ppm" << dendl;
+    }
 
     dout(10) << "starting a new chunky scrub" << dendl;
   }
@@ -3208,7 +3292,9 @@ void PG::scrub_finish()
 	history.last_scrub = recovery_state.get_info().last_update;
 	history.last_scrub_stamp = now;
 	if (scrubber.deep) {
-	  history.last_deep_scrub = recovery_state.get_info().last_update;
+	  // objects modified after their chunk was scanned were not
+	  // verified, so only vouch for the versions before we started
+	  history.last_deep_scrub = scrubber.start_version;
 	  history.last_deep_scrub_stamp = now;
 	}
 
@@ -483,6 +483,8 @@ public:
   void send_pg_created(pg_t pgid) override;
 
   void rebuild_missing_set_with_deletes(PGLog &pglog) override;
+  bool load_spilled_log(
+    PGLog &pglog, pg_info_t &info, eversion_t since) override;
 
   void queue_peering_event(PGPeeringEventRef evt);
   void do_peering_event(PGPeeringEventRef evt, PeeringCtx &rcx);
@@ -672,6 +674,7 @@ protected:
 
   int recovery_ops_active;
   set<pg_shard_t> waiting_on_backfill;
+  set<pg_shard_t> backfill_prefetching;  ///< peers with a read-ahead scan out
 #ifdef DEBUG_RECOVERY_OIDS
   multiset<hobject_t> recovering_oids;
 #endif
@@ -783,6 +786,8 @@ public:
 protected:
   BackfillInterval backfill_info;
   map<pg_shard_t, BackfillInterval> peer_backfill_info;
+  /// scan windows read ahead of peer_backfill_info, oldest first
+  map<pg_shard_t, list<BackfillInterval>> peer_backfill_prefetched;
   bool backfill_reserving;
 
   // The primary's num_bytes and local num_bytes for this pg, only valid
@@ -1118,6 +1123,8 @@ public:
     bool sleeping = false;
     bool needs_sleep = true;
     utime_t sleep_start;
+    // since when the scrub is held back for client I/O
+    utime_t yield_start;
 
     // flags to indicate explicitly requested scrubs (by admin)
     bool must_scrub, must_deep_scrub, must_repair;
@@ -1193,6 +1200,12 @@ public:
     std::unique_ptr<Scrub::Store> store;
     // deep scrub
     bool deep;
+    // incremental deep scrub, see ScrubMapBuilder
+    eversion_t deep_since;
+    uint32_t deep_seed = 0;
+    uint32_t deep_reread_ppm = 0;
+    // last_update when the scrub started
+    eversion_t start_version;
     int preempt_left;
     int preempt_divisor;
 
@@ -1257,6 +1270,10 @@ public:
       fixed = 0;
       omap_stats = (const struct omap_stat_t){ 0 };
       deep = false;
+      deep_since = eversion_t();
+      deep_seed = 0;
+      deep_reread_ppm = 0;
+      start_version = eversion_t();
       run_callbacks();
       inconsistent.clear();
       missing.clear();
@@ -1270,6 +1287,7 @@ public:
       sleeping = false;
       needs_sleep = true;
       sleep_start = utime_t();
+      yield_start = utime_t();
     }
 
     void create_results(const hobject_t& obj);
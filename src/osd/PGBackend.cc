@@ -595,6 +595,10 @@ int PGBackend::be_scan_list(
       o.attrs);
 
     if (pos.deep) {
+      if (pos.data_pos == 0 && be_deep_scrub_unchanged(poid, pos, o)) {
+	// go straight to the omap
+	pos.data_pos = -1;
+      }
       r = be_deep_scrub(poid, map, pos, o);
     }
     dout(25) << __func__ << "  " << poid << dendl;
@@ -617,6 +621,35 @@ int PGBackend::be_scan_list(
   return 0;
 }
 
+bool PGBackend::be_deep_scrub_unchanged(
+  const hobject_t &poid,
+  const ScrubMapBuilder &pos,
+  ScrubMap::object &o)
+{
+  if (pos.deep_since == eversion_t())
+    return false;
+  auto i = o.attrs.find(OI_ATTR);
+  if (i == o.attrs.end())
+    return false;
+  object_info_t oi;
+  try {
+    bufferlist bl;
+    bl.push_back(i->second);
+    auto p = bl.cbegin();
+    decode(oi, p);
+  } catch (buffer::error& e) {
+    return false;
+  }
+  if (!pos.deep_unchanged(poid, oi, o.size))
+    return false;
+  dout(20) << __func__ << "  " << poid << " unchanged since " << oi.version
+	   << ", data_digest 0x" << std::hex << oi.data_digest << std::dec
+	   << dendl;
+  o.digest = oi.data_digest;
+  o.digest_present = true;
+  return true;
+}
+
 bool PGBackend::be_compare_scrub_objects(
   pg_shard_t auth_shard,
   const ScrubMap::object &auth,
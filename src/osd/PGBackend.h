@@ -571,6 +571,12 @@ typedef std::shared_ptr<const OSDMap> OSDMapRef;
    int be_scan_list(
      ScrubMap &map,
      ScrubMapBuilder &pos);
+   /// true if the object's data is unchanged since the last clean deep
+   /// scrub, in which case its digest is taken from the object_info
+   bool be_deep_scrub_unchanged(
+     const hobject_t &poid,
+     const ScrubMapBuilder &pos,
+     ScrubMap::object &o);
    bool be_compare_scrub_objects(
      pg_shard_t auth_shard,
      const ScrubMap::object &auth,
@@ -18,6 +18,7 @@
 #include "PGLog.h"
 #include "include/unordered_map.h"
 #include "common/ceph_context.h"
+#include "common/errno.h"
 
 #define dout_context cct
 #define dout_subsys ceph_subsys_osd
@@ -36,10 +37,18 @@ void PGLog::IndexedLog::split_out_child(
   unsigned split_bits,
   PGLog::IndexedLog *target)
 {
-  unindex();
+  // the child's entries are spliced out and ours stay where they are,
+  // so rather than rebuilding our whole index just drop the child's
+  // entries from it
+  unsigned mask = ~((~0)<<split_bits);
+  for (auto& e : log) {
+    if ((e.soid.get_hash() & mask) == child_pgid.m_seed) {
+      unindex(e);
+    }
+  }
+  // the child is indexed as it is built and moved into target as is,
+  // rather than copied and indexed again
   *target = IndexedLog(pg_log_t::split_out_child(child_pgid, split_bits));
-  index();
-  target->index();
   reset_rollback_info_trimmed_to_riter();
 }
 
@@ -168,6 +177,9 @@ void PGLog::clear() {
   missing.clear();
   log.clear();
   log_keys_debug.clear();
+  log_chunks.clear();
+  dup_chunks.clear();
+  spilled.clear();
   undirty();
 }
 
@@ -587,8 +599,267 @@ bool PGLog::merge_log_dups(const pg_log_t& olog) {
   return changed;
 }
 
+// -- compact log format --
+//
+// With osd_pg_log_chunk_entries set, the on-disk log (and dups) is a
+// run of chunks, each holding chunk_entries consecutive items under one
+// omap key, followed by the most recent items under individual keys.
+// Once enough individual keys accumulate they are folded into a new
+// chunk.  Chunks always cover a prefix of the on-disk items, so trimming
+// only has to remove whole chunks and rewinding only has to unfold the
+// chunks at the head.  With osd_pg_log_spill_entries set, chunks holding
+// spilled entries are kept as well (see keep_from).
+
+template <typename Chunk>
+void PGLog::clear_chunks(
+  ObjectStore::Transaction& t,
+  const coll_t& coll,
+  const ghobject_t &log_oid)
+{
+  t.omap_rmkeyrange(
+    coll, log_oid,
+    Chunk::get_key_name(eversion_t()),
+    Chunk::get_key_name(eversion_t::max()));
+}
+
+template <typename Chunk, typename List>
+void PGLog::prepare_chunks(
+  const List &items,
+  map<eversion_t, eversion_t> *chunks,
+  unsigned chunk_entries,
+  eversion_t keep_from,
+  eversion_t *dirty_to,
+  eversion_t dirty_from,
+  eversion_t *write_from,
+  set<string> *to_remove)
+{
+  if (chunks->empty())
+    return;
+  if (*dirty_to != eversion_t() || !chunk_entries) {
+    // rewriting a prefix, or converting back to one key per item:
+    // drop all chunks and write everything out again
+    chunks->clear();
+    *dirty_to = eversion_t::max();
+    return;
+  }
+
+  // fully trimmed chunks
+  if (!items.empty())
+    keep_from = std::min(keep_from, items.front().version);
+  while (!chunks->empty() && chunks->begin()->second < keep_from) {
+    to_remove->insert(Chunk::get_key_name(chunks->begin()->first));
+    chunks->erase(chunks->begin());
+  }
+
+  // rewound or rewritten chunks; whatever survives of them is written
+  // out again under individual keys (and may be folded again below)
+  eversion_t redo = std::min(dirty_from, *write_from);
+  while (!chunks->empty() && chunks->rbegin()->second >= redo) {
+    auto last = std::prev(chunks->end());
+    *write_from = std::min(*write_from, last->first);
+    to_remove->insert(Chunk::get_key_name(last->first));
+    chunks->erase(last);
+  }
+}
+
+template <typename Chunk, typename List, typename Items>
+void PGLog::fold_chunks(
+  ObjectStore::Transaction& t,
+  map<string,bufferlist> *km,
+  const coll_t& coll,
+  const ghobject_t &log_oid,
+  const List &items,
+  Items Chunk::*chunk_items,
+  map<eversion_t, eversion_t> *chunks,
+  unsigned chunk_entries)
+{
+  // items newer than the last chunk are stored under individual keys
+  size_t unfolded = 0;
+  auto p = items.rbegin();
+  for (; p != items.rend(); ++p) {
+    if (!chunks->empty() && p->version <= chunks->rbegin()->second)
+      break;
+    ++unfolded;
+  }
+  if (unfolded < chunk_entries)
+    return;
+
+  auto i = p.base();
+  string first_key = i->get_key_name();
+  while (unfolded >= chunk_entries) {
+    Chunk chunk;
+    Items &c = chunk.*chunk_items;
+    for (unsigned n = 0; n < chunk_entries; ++n, ++i) {
+      c.push_back(*i);
+      km->erase(i->get_key_name());
+    }
+    // never split the dups of one op (same version) across chunks
+    while (i != items.end() && i->version == c.back().version) {
+      c.push_back(*i);
+      km->erase(i->get_key_name());
+      ++i;
+    }
+    unfolded -= c.size();
+    (*chunks)[c.front().version] = c.back().version;
+    encode(chunk, (*km)[chunk.get_key_name()]);
+  }
+
+  typename List::value_type end;
+  end.version = eversion_t::max();
+  t.omap_rmkeyrange(
+    coll, log_oid,
+    first_key,
+    i == items.end() ? end.get_key_name() : i->get_key_name());
+}
+
+// -- spilled log entries --
+//
+// With osd_pg_log_spill_entries set, entries trimmed from the in-memory
+// log stay on disk (individually or in chunks) and only their versions
+// are remembered.  The oldest ones are removed once more than
+// spill_entries accumulate.  load_spilled() reads them back when peering
+// needs a longer log.
+
+void PGLog::prepare_spilled(eversion_t *keep_from, eversion_t *trim_to)
+{
+  // entries from here on are written out again from memory, including
+  // those of a chunk that prepare_chunks() will unfold
+  eversion_t redo = std::min(dirty_from, writeout_from);
+  eversion_t unwritten = redo;
+  for (auto p = log_chunks.rbegin();
+       p != log_chunks.rend() && p->second >= redo;
+       ++p) {
+    unwritten = std::min(unwritten, p->first);
+  }
+
+  // trimmed entries can only stay on disk if they were written before,
+  // and only while the on-disk entries are contiguous with the log
+  bool keep = spill_entries &&
+    dirty_to == eversion_t() &&
+    (chunk_entries || log_chunks.empty()) &&
+    (trimmed.empty() || *trimmed.rbegin() < unwritten) &&
+    (spilled.empty() || spilled.back() < unwritten);
+  if (!keep) {
+    if (!spilled.empty()) {
+      dout(10) << __func__ << " dropping " << spilled.size()
+	       << " spilled entries" << dendl;
+      *trim_to = log.log.empty() ?
+	eversion_t::max() : log.log.front().version;
+      spilled.clear();
+    }
+    return;
+  }
+
+  spilled.insert(spilled.end(), trimmed.begin(), trimmed.end());
+  trimmed.clear();
+  if (spilled.size() > spill_entries) {
+    eversion_t cut = *(spilled.end() - spill_entries);
+    // entries sharing a chunk with a kept one stay on disk (and tracked)
+    auto c = log_chunks.upper_bound(cut);
+    if (c != log_chunks.begin() && (--c)->second >= cut)
+      cut = c->first;
+    auto p = std::lower_bound(spilled.begin(), spilled.end(), cut);
+    if (p != spilled.begin()) {
+      spilled.erase(spilled.begin(), p);
+      *trim_to = spilled.front();
+    }
+  }
+  if (!spilled.empty())
+    *keep_from = spilled.front();
+}
+
+bool PGLog::load_spilled(
+  ObjectStore *store,
+  ObjectStore::CollectionHandle& ch,
+  const ghobject_t &pgmeta_oid,
+  pg_info_t &info,
+  eversion_t since)
+{
+  if (spilled.empty() || since >= log.tail)
+    return false;
+  if (dirty_to != eversion_t() || !trimmed.empty()) {
+    dout(10) << __func__ << " log has unwritten changes, not loading" << dendl;
+    return false;
+  }
+
+  // the newest spilled entry at or before since becomes the new tail
+  auto first = std::upper_bound(spilled.begin(), spilled.end(), since);
+  if (first != spilled.begin())
+    --first;
+  eversion_t new_tail = *first++;
+  size_t count = spilled.end() - first;
+  if (!count)
+    return false;
+  dout(10) << __func__ << " loading " << count << " entries ("
+	   << new_tail << "," << log.tail << "]" << dendl;
+
+  map<eversion_t, pg_log_entry_t> loaded;
+  auto load = [&](pg_log_entry_t &&e) {
+    if (e.version > new_tail && e.version <= log.tail)
+      loaded.emplace(e.version, std::move(e));
+  };
+  ObjectMap::ObjectMapIterator p = store->get_omap_iterator(ch, pgmeta_oid);
+  if (p) {
+    string end_key = log.tail.get_key_name();
+    for (p->lower_bound(first->get_key_name());
+	 p->valid() && p->key() <= end_key;
+	 p->next()) {
+      bufferlist bl = p->value();
+      auto bp = bl.cbegin();
+      pg_log_entry_t e;
+      e.decode_with_checksum(bp);
+      load(std::move(e));
+    }
+  }
+  set<string> chunk_keys;
+  for (auto& c : log_chunks) {
+    if (c.second > new_tail && c.first <= log.tail)
+      chunk_keys.insert(pg_log_entry_chunk_t::get_key_name(c.first));
+  }
+  if (!chunk_keys.empty()) {
+    map<string, bufferlist> values;
+    int r = store->omap_get_values(ch, pgmeta_oid, chunk_keys, &values);
+    if (r < 0) {
+      derr << __func__ << " failed to read chunks: " << cpp_strerror(r)
+	   << dendl;
+      return false;
+    }
+    for (auto& v : values) {
+      auto bp = v.second.cbegin();
+      pg_log_entry_chunk_t chunk;
+      decode(chunk, bp);
+      for (auto& e : chunk.entries)
+	load(std::move(e));
+    }
+  }
+  if (loaded.size() != count) {
+    derr << __func__ << " found " << loaded.size() << " of " << count
+	 << " spilled entries on disk, not loading" << dendl;
+    return false;
+  }
+
+  mempool::osd_pglog::list<pg_log_entry_t> entries;
+  for (auto& i : loaded)
+    entries.push_back(std::move(i.second));
+  auto old_begin = log.log.begin();
+  log.log.splice(log.log.begin(), entries);
+  for (auto i = log.log.begin(); i != old_begin; ++i)
+    log.index(*i);
+
+  // the reloaded entries supersede their dups
+  while (!log.dups.empty() && log.dups.back().version > new_tail) {
+    log.unindex(log.dups.back());
+    mark_dirty_from_dups(log.dups.back().version);
+    log.dups.pop_back();
+  }
+
+  spilled.erase(first, spilled.end());
+  info.log_tail = log.tail = new_tail;
+  return true;
+}
+
 void PGLog::check() {
-  if (!pg_log_debug)
+  if (!pg_log_debug || !log_chunks.empty())
     return;
   if (log.log.size() != log_keys_debug.size()) {
     derr << "log.log.size() != log_keys_debug.size()" << dendl;
@@ -629,7 +900,16 @@ void PGLog::write_log_and_missing(
 	     << ", trimmed: " << trimmed
 	     << ", trimmed_dups: " << trimmed_dups
 	     << ", clear_divergent_priors: " << clear_divergent_priors
+	     << ", log_chunks: " << log_chunks.size()
+	     << ", dup_chunks: " << dup_chunks.size()
+	     << ", spilled: " << spilled.size()
 	     << dendl;
+    eversion_t spilled_from = eversion_t::max();
+    eversion_t trim_spilled_to;
+    prepare_spilled(&spilled_from, &trim_spilled_to);
+    // log_keys_debug does not track chunked entries; resync it once
+    // they have been converted back to individual keys
+    bool resync_keys_debug = pg_log_debug && !log_chunks.empty();
     _write_log_and_missing(
       t, km, log, coll, log_oid,
       dirty_to,
@@ -644,8 +924,18 @@ void PGLog::write_log_and_missing(
       dirty_to_dups,
       dirty_from_dups,
       write_from_dups,
+      &log_chunks,
+      &dup_chunks,
+      chunk_entries,
+      spilled_from,
+      trim_spilled_to,
       &rebuilt_missing_with_deletes,
-      (pg_log_debug ? &log_keys_debug : nullptr));
+      (pg_log_debug && !resync_keys_debug ? &log_keys_debug : nullptr));
+    if (resync_keys_debug) {
+      log_keys_debug.clear();
+      for (auto &e : log.log)
+	log_keys_debug.insert(e.get_key_name());
+    }
     undirty();
   } else {
     dout(10) << "log is not dirty" << dendl;
@@ -692,6 +982,8 @@ void PGLog::write_log_and_missing(
     eversion_t::max(),
     eversion_t(),
     eversion_t(),
+    nullptr, nullptr, 0,
+    eversion_t::max(), eversion_t(),
     rebuilt_missing_with_deletes, nullptr);
 }
 
@@ -717,6 +1009,10 @@ void PGLog::_write_log_and_missing_wo_missing(
   // dout(10) << "write_log_and_missing, clearing up to " << dirty_to << dendl;
   if (touch_log)
     t.touch(coll, log_oid);
+  if (dirty_to == eversion_t::max())
+    clear_chunks<pg_log_entry_chunk_t>(t, coll, log_oid);
+  if (dirty_to_dups == eversion_t::max())
+    clear_chunks<pg_log_dup_chunk_t>(t, coll, log_oid);
   if (dirty_to != eversion_t()) {
     t.omap_rmkeyrange(
       coll, log_oid,
@@ -828,12 +1124,37 @@ void PGLog::_write_log_and_missing(
   eversion_t dirty_to_dups,
   eversion_t dirty_from_dups,
   eversion_t write_from_dups,
+  map<eversion_t, eversion_t> *log_chunks,
+  map<eversion_t, eversion_t> *dup_chunks,
+  unsigned chunk_entries,
+  eversion_t spilled_from,
+  eversion_t trim_spilled_to,
   bool *rebuilt_missing_with_deletes, // in/out param
   set<string> *log_keys_debug
   ) {
+  // trimmed items that were folded into a chunk have no key of their own
+  eversion_t log_chunked_to, dup_chunked_to;
+  if (log_chunks && !log_chunks->empty())
+    log_chunked_to = log_chunks->rbegin()->second;
+  if (dup_chunks && !dup_chunks->empty())
+    dup_chunked_to = dup_chunks->rbegin()->second;
+
   set<string> to_remove;
-  to_remove.swap(trimmed_dups);
+  if (dup_chunked_to == eversion_t()) {
+    to_remove.swap(trimmed_dups);
+  } else {
+    pg_log_dup_t chunked_to;
+    chunked_to.version = dup_chunked_to;
+    string chunked_to_key = chunked_to.get_key_name();
+    for (auto& key : trimmed_dups) {
+      if (key > chunked_to_key)
+	to_remove.insert(key);
+    }
+    trimmed_dups.clear();
+  }
   for (auto& t : trimmed) {
+    if (t <= log_chunked_to)
+      continue;
     string key = t.get_key_name();
     if (log_keys_debug) {
       auto it = log_keys_debug->find(key);
@@ -844,13 +1165,33 @@ void PGLog::_write_log_and_missing(
   }
   trimmed.clear();
 
+  if (log_chunks) {
+    prepare_chunks<pg_log_entry_chunk_t>(
+      log.log, log_chunks, chunk_entries, spilled_from,
+      &dirty_to, dirty_from, &writeout_from, &to_remove);
+  }
+  if (dup_chunks) {
+    prepare_chunks<pg_log_dup_chunk_t>(
+      log.dups, dup_chunks, chunk_entries, eversion_t::max(),
+      &dirty_to_dups, dirty_from_dups, &write_from_dups, &to_remove);
+  }
+
   if (touch_log)
     t.touch(coll, log_oid);
+  if (dirty_to == eversion_t::max())
+    clear_chunks<pg_log_entry_chunk_t>(t, coll, log_oid);
+  if (dirty_to_dups == eversion_t::max())
+    clear_chunks<pg_log_dup_chunk_t>(t, coll, log_oid);
   if (dirty_to != eversion_t()) {
     t.omap_rmkeyrange(
       coll, log_oid,
       eversion_t().get_key_name(), dirty_to.get_key_name());
     clear_up_to(log_keys_debug, dirty_to.get_key_name());
+  } else if (trim_spilled_to != eversion_t()) {
+    // spilled entries that fell out of osd_pg_log_spill_entries
+    t.omap_rmkeyrange(
+      coll, log_oid,
+      eversion_t().get_key_name(), trim_spilled_to.get_key_name());
   }
   if (dirty_to != eversion_t::max() && dirty_from != eversion_t::max()) {
     //   dout(10) << "write_log_and_missing, clearing from " << dirty_from << dendl;
@@ -925,6 +1266,17 @@ void PGLog::_write_log_and_missing(
     (*km)[p->get_key_name()].claim(bl);
   }
 
+  if (chunk_entries && log_chunks) {
+    fold_chunks<pg_log_entry_chunk_t>(
+      t, km, coll, log_oid, log.log, &pg_log_entry_chunk_t::entries,
+      log_chunks, chunk_entries);
+  }
+  if (chunk_entries && dup_chunks) {
+    fold_chunks<pg_log_dup_chunk_t>(
+      t, km, coll, log_oid, log.dups, &pg_log_dup_chunk_t::dups,
+      dup_chunks, chunk_entries);
+  }
+
   if (clear_divergent_priors) {
     //dout(10) << "write_log_and_missing: writing divergent_priors" << dendl;
     to_remove.insert("divergent_priors");
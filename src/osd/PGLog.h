@@ -21,6 +21,7 @@
 #include "osd_types.h"
 #include "os/ObjectStore.h"
 #include <list>
+#include <deque>
 
 constexpr auto PGLOG_INDEXED_OBJECTS          = 1 << 0;
 constexpr auto PGLOG_INDEXED_CALLER_OPS       = 1 << 1;
@@ -44,6 +45,10 @@ struct PGLog : DoutPrefixProvider {
     return cct;
   }
 
+  /// versions of spilled log entries, oldest first
+  typedef std::deque<eversion_t,
+		     mempool::osd_pglog::pool_allocator<eversion_t>> spilled_t;
+
   ////////////////////////////// sub classes //////////////////////////////
   struct LogEntryHandler {
     virtual void rollback(
@@ -146,12 +151,61 @@ public:
       index(rhs.indexed_data);
     }
 
+    // moving the lists keeps their entries where they are, so the
+    // index comes along as is
+    IndexedLog(IndexedLog &&rhs) :
+      pg_log_t(std::move(rhs)),
+      objects(std::move(rhs.objects)),
+      caller_ops(std::move(rhs.caller_ops)),
+      extra_caller_ops(std::move(rhs.extra_caller_ops)),
+      dup_index(std::move(rhs.dup_index)),
+      complete_to(rhs.complete_to == rhs.log.end() ?
+		  log.end() : rhs.complete_to),
+      last_requested(rhs.last_requested),
+      indexed_data(rhs.indexed_data),
+      rollback_info_trimmed_to_riter(log.rbegin())
+    {
+      reset_rollback_info_trimmed_to_riter();
+      rhs.clear_moved_from();
+    }
+
     IndexedLog &operator=(const IndexedLog &rhs) {
       this->~IndexedLog();
       new (this) IndexedLog(rhs);
       return *this;
     }
 
+    IndexedLog &operator=(IndexedLog &&rhs) {
+      bool complete = rhs.complete_to == rhs.log.end();
+      pg_log_t::operator=(std::move(rhs));
+      objects = std::move(rhs.objects);
+      caller_ops = std::move(rhs.caller_ops);
+      extra_caller_ops = std::move(rhs.extra_caller_ops);
+      dup_index = std::move(rhs.dup_index);
+      complete_to = complete ? log.end() : rhs.complete_to;
+      last_requested = rhs.last_requested;
+      indexed_data = rhs.indexed_data;
+      reset_rollback_info_trimmed_to_riter();
+      rhs.clear_moved_from();
+      return *this;
+    }
+
+  private:
+    // leave a moved-from log empty and usable
+    void clear_moved_from() {
+      pg_log_t::clear();
+      objects.clear();
+      caller_ops.clear();
+      extra_caller_ops.clear();
+      dup_index.clear();
+      complete_to = log.end();
+      last_requested = 0;
+      indexed_data = 0;
+      reset_rollback_info_trimmed_to_riter();
+    }
+
+  public:
+
     void trim_rollback_info_to(eversion_t to, LogEntryHandler *h) {
       advance_can_rollback_to(
 	to,
@@ -567,6 +621,18 @@ protected:
   bool clear_divergent_priors;
   bool rebuilt_missing_with_deletes = false;
 
+  /// compact log format: on-disk log and dup chunks, first -> last version
+  map<eversion_t, eversion_t> log_chunks;
+  map<eversion_t, eversion_t> dup_chunks;
+  /// items per chunk, 0 to store one omap key per item
+  unsigned chunk_entries;
+
+  /// spill mode: versions of entries trimmed from memory but still on
+  /// disk, oldest first
+  spilled_t spilled;
+  /// trimmed entries to keep on disk, 0 to remove them on trim
+  unsigned spill_entries;
+
   void mark_dirty_to(eversion_t to) {
     if (to > dirty_to)
       dirty_to = to;
@@ -635,6 +701,7 @@ protected:
   }
 
   void check();
+  void prepare_spilled(eversion_t *keep_from, eversion_t *trim_to);
   void undirty() {
     dirty_to = eversion_t();
     dirty_from = eversion_t::max();
@@ -659,8 +726,14 @@ public:
     cct(cct),
     pg_log_debug(!(cct && !(cct->_conf->osd_debug_pg_log_writeout))),
     touched_log(false),
-    clear_divergent_priors(false)
-  { }
+    clear_divergent_priors(false),
+    chunk_entries(cct ? cct->_conf->osd_pg_log_chunk_entries : 0),
+    spill_entries(cct ? cct->_conf->osd_pg_log_spill_entries : 0)
+  {
+    // the key tracking below has no notion of chunks or spilled entries
+    if (chunk_entries || spill_entries)
+      pg_log_debug = false;
+  }
 
   void reset_backfill();
 
@@ -705,6 +778,24 @@ public:
 
   void reset_recovery_pointers() { log.reset_recovery_pointers(); }
 
+  //////////////////// spilled log entries ////////////////////
+
+  bool has_spilled() const { return !spilled.empty(); }
+
+  /// oldest version the log can be extended back to
+  eversion_t get_spilled_tail() const {
+    return spilled.empty() ? log.tail : spilled.front();
+  }
+
+  /// read spilled entries back into the log, extending its tail to
+  /// (at most) since; returns true if the log (and info) changed
+  bool load_spilled(
+    ObjectStore *store,
+    ObjectStore::CollectionHandle& ch,
+    const ghobject_t &pgmeta_oid,
+    pg_info_t &info,
+    eversion_t since);
+
   static void clear_info_log(
     spg_t pgid,
     ObjectStore::Transaction *t);
@@ -1261,6 +1352,34 @@ public:
     bool require_rollback,
     bool *rebuilt_missing_set_with_deletes);
 
+  template <typename Chunk>
+  static void clear_chunks(
+    ObjectStore::Transaction& t,
+    const coll_t& coll,
+    const ghobject_t &log_oid);
+
+  template <typename Chunk, typename List>
+  static void prepare_chunks(
+    const List &items,
+    map<eversion_t, eversion_t> *chunks,
+    unsigned chunk_entries,
+    eversion_t keep_from,
+    eversion_t *dirty_to,
+    eversion_t dirty_from,
+    eversion_t *write_from,
+    set<string> *to_remove);
+
+  template <typename Chunk, typename List, typename Items>
+  static void fold_chunks(
+    ObjectStore::Transaction& t,
+    map<string,bufferlist> *km,
+    const coll_t& coll,
+    const ghobject_t &log_oid,
+    const List &items,
+    Items Chunk::*chunk_items,
+    map<eversion_t, eversion_t> *chunks,
+    unsigned chunk_entries);
+
   static void _write_log_and_missing_wo_missing(
     ObjectStore::Transaction& t,
     map<string,bufferlist>* km,
@@ -1296,6 +1415,11 @@ public:
     eversion_t dirty_to_dups,
     eversion_t dirty_from_dups,
     eversion_t write_from_dups,
+    map<eversion_t, eversion_t> *log_chunks,
+    map<eversion_t, eversion_t> *dup_chunks,
+    unsigned chunk_entries,
+    eversion_t spilled_from,
+    eversion_t trim_spilled_to,
     bool *rebuilt_missing_with_deletes,
     set<string> *log_keys_debug
     );
@@ -1309,14 +1433,26 @@ public:
     bool tolerate_divergent_missing_log,
     bool debug_verify_stored_missing = false
     ) {
-    return read_log_and_missing(
+    read_log_and_missing(
       store, ch, pgmeta_oid, info,
       log, missing, oss,
       tolerate_divergent_missing_log,
       &clear_divergent_priors,
       this,
       (pg_log_debug ? &log_keys_debug : nullptr),
-      debug_verify_stored_missing);
+      debug_verify_stored_missing,
+      &log_chunks,
+      &dup_chunks,
+      &spilled);
+    if (!spill_entries && !spilled.empty()) {
+      // left behind by spill mode; remove them with the next write
+      for (auto& v : spilled) {
+	trimmed.insert(v);
+	if (pg_log_debug)
+	  log_keys_debug.insert(v.get_key_name());
+      }
+      spilled.clear();
+    }
   }
 
   template <typename missing_type>
@@ -1332,7 +1468,10 @@ public:
     bool *clear_divergent_priors = nullptr,
     const DoutPrefixProvider *dpp = nullptr,
     set<string> *log_keys_debug = nullptr,
-    bool debug_verify_stored_missing = false
+    bool debug_verify_stored_missing = false,
+    map<eversion_t, eversion_t> *log_chunks = nullptr,
+    map<eversion_t, eversion_t> *dup_chunks = nullptr,
+    spilled_t *spilled = nullptr
     ) {
     ldpp_dout(dpp, 20) << "read_log_and_missing coll " << ch->cid
 		       << " " << pgmeta_oid << dendl;
@@ -1353,6 +1492,16 @@ public:
     missing.may_include_deletes = false;
     list<pg_log_entry_t> entries;
     list<pg_log_dup_t> dups;
+    // compact log format: chunks sort after the individual keys but
+    // hold the older items
+    list<pg_log_entry_t> chunked_entries;
+    list<pg_log_dup_t> chunked_dups;
+    if (log_chunks)
+      log_chunks->clear();
+    if (dup_chunks)
+      dup_chunks->clear();
+    // entries at or before the tail were spilled (see osd_pg_log_spill_entries)
+    vector<eversion_t> spilled_versions;
     if (p) {
       for (p->seek_to_first(); p->valid() ; p->next()) {
 	// non-log pgmeta_oid keys are prefixed with _; skip those
@@ -1388,9 +1537,47 @@ public:
 	    ceph_assert(dups.back().version < dup.version);
 	  }
 	  dups.push_back(dup);
+	} else if (pg_log_entry_chunk_t::is_key_name(p->key())) {
+	  pg_log_entry_chunk_t chunk;
+	  decode(chunk, bp);
+	  ceph_assert(!chunk.entries.empty());
+	  ldpp_dout(dpp, 20) << "read_log_and_missing chunk "
+			     << chunk.entries.front().version << "~"
+			     << chunk.entries.back().version << dendl;
+	  if (log_chunks)
+	    (*log_chunks)[chunk.entries.front().version] =
+	      chunk.entries.back().version;
+	  for (auto &e : chunk.entries) {
+	    // a chunk is only removed once all of its entries are trimmed
+	    if (e.version <= info.log_tail) {
+	      spilled_versions.push_back(e.version);
+	      continue;
+	    }
+	    ldpp_dout(dpp, 20) << "read_log_and_missing " << e << dendl;
+	    if (!chunked_entries.empty()) {
+	      ceph_assert(chunked_entries.back().version.version < e.version.version);
+	      ceph_assert(chunked_entries.back().version.epoch <= e.version.epoch);
+	    }
+	    chunked_entries.push_back(std::move(e));
+	  }
+	} else if (pg_log_dup_chunk_t::is_key_name(p->key())) {
+	  pg_log_dup_chunk_t chunk;
+	  decode(chunk, bp);
+	  ceph_assert(!chunk.dups.empty());
+	  if (dup_chunks)
+	    (*dup_chunks)[chunk.dups.front().version] =
+	      chunk.dups.back().version;
+	  if (!chunked_dups.empty()) {
+	    ceph_assert(chunked_dups.back().version < chunk.dups.front().version);
+	  }
+	  chunked_dups.splice(chunked_dups.end(), chunk.dups);
 	} else {
 	  pg_log_entry_t e;
 	  e.decode_with_checksum(bp);
+	  if (e.version <= info.log_tail) {
+	    spilled_versions.push_back(e.version);
+	    continue;
+	  }
 	  ldpp_dout(dpp, 20) << "read_log_and_missing " << e << dendl;
 	  if (!entries.empty()) {
 	    pg_log_entry_t last_e(entries.back());
@@ -1403,6 +1590,24 @@ public:
 	}
       }
     }
+    if (!chunked_entries.empty()) {
+      if (!entries.empty()) {
+	ceph_assert(chunked_entries.back().version < entries.front().version);
+      }
+      entries.splice(entries.begin(), chunked_entries);
+    }
+    if (!chunked_dups.empty()) {
+      if (!dups.empty()) {
+	ceph_assert(chunked_dups.back().version < dups.front().version);
+      }
+      dups.splice(dups.begin(), chunked_dups);
+    }
+    if (spilled) {
+      std::sort(spilled_versions.begin(), spilled_versions.end());
+      spilled->assign(spilled_versions.begin(), spilled_versions.end());
+      ldpp_dout(dpp, 10) << "read_log_and_missing " << spilled->size()
+			 << " spilled entries" << dendl;
+    }
     log = IndexedLog(
       info.last_update,
       info.log_tail,
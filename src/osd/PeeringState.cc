@@ -1787,6 +1787,24 @@ bool PeeringState::choose_acting(pg_shard_t &auth_log_shard_id,
 				 bool restrict_to_up_acting,
 				 bool *history_les_bound)
 {
+  if (pg_log.has_spilled()) {
+    // extend our log with spilled entries if that lets a peer recover
+    // from the log instead of by backfill
+    eversion_t since = info.log_tail;
+    for (auto &p : peer_info) {
+      if (!p.second.is_incomplete() &&
+	  p.second.last_update >= pg_log.get_spilled_tail() &&
+	  p.second.last_update < since)
+	since = p.second.last_update;
+    }
+    if (since < info.log_tail &&
+	pl->load_spilled_log(pg_log, info, since)) {
+      psdout(10) << __func__ << " loaded spilled log entries, log_tail now "
+		 << info.log_tail << dendl;
+      dirty_info = true;
+    }
+  }
+
   map<pg_shard_t, pg_info_t> all_info(peer_info.begin(), peer_info.end());
   all_info[pg_whoami] = info;
 
@@ -209,6 +209,8 @@ public:
 
     // ============ On disk representation changes ==============
     virtual void rebuild_missing_set_with_deletes(PGLog &pglog) = 0;
+    virtual bool load_spilled_log(
+      PGLog &pglog, pg_info_t &info, eversion_t since) = 0;
 
     // ======================= Logging ==========================
     virtual PerfCounters &get_peering_perf() = 0;
@@ -463,7 +463,7 @@ void PrimaryLogPG::on_global_recover(
   backfills_in_flight.erase(soid);
 
   recovering.erase(i);
-  finish_recovery_op(soid);
+  finish_object_recovery_op(soid);
   release_backoffs(soid);
   auto degraded_object_entry = waiting_for_degraded_object.find(soid);
   if (degraded_object_entry != waiting_for_degraded_object.end()) {
@@ -4066,6 +4066,21 @@ void PrimaryLogPG::do_scan(
       // Check that from is in backfill_targets vector
       ceph_assert(is_backfill_target(from));
 
+      if (backfill_prefetching.erase(from)) {
+	BackfillInterval bi;
+	bi.begin = m->begin;
+	bi.end = m->end;
+	auto p = m->get_data().cbegin();
+	::decode_noclear(bi.objects, p);
+	dout(20) << __func__ << " read-ahead " << bi << dendl;
+	peer_backfill_prefetched[from].push_back(std::move(bi));
+	if (state_test(PG_STATE_BACKFILLING)) {
+	  // keep reading ahead while the pushes are in flight
+	  prefetch_backfill_scans();
+	}
+	break;
+      }
+
       BackfillInterval& bi = peer_backfill_info[from];
       bi.begin = m->begin;
       bi.end = m->end;
@@ -4197,10 +4212,13 @@ void PrimaryLogPG::do_backfill_remove(OpRequestRef op)
 }
 
 int PrimaryLogPG::trim_object(
-  bool first, const hobject_t &coid, PrimaryLogPG::OpContextUPtr *ctxp)
+  bool first, const hobject_t &coid, PrimaryLogPG::OpContextUPtr *ctxp,
+  map<hobject_t, ObjectContextRef> *heads)
 {
-  *ctxp = NULL;
-
+  // with a non-null *ctxp (bulk snap trim) the clone is trimmed as part
+  // of that op, otherwise a new op is created.  With heads, the head is
+  // only added there, for the caller to rewrite once with trim_head()
+  // after trimming all of its clones.
   // load clone info
   bufferlist bl;
   ObjectContextRef obc = get_object_context(coid, false, NULL);
@@ -4258,30 +4276,50 @@ int PrimaryLogPG::trim_object(
     }
   }
 
-  OpContextUPtr ctx = simple_opc_create(obc);
-  ctx->head_obc = head_obc;
+  if (*ctxp) {
+    OpContextUPtr &ctx = *ctxp;
+    // a lock we fail to get here is released along with the others
+    // when the op completes
+    if (!ctx->lock_manager.is_locked(coid) &&
+	!ctx->lock_manager.get_snaptrimmer_write(coid, obc, first)) {
+      dout(10) << __func__ << ": Unable to get a wlock on " << coid << dendl;
+      return -ENOLCK;
+    }
+    if (!ctx->lock_manager.is_locked(head_oid) &&
+	!ctx->lock_manager.get_snaptrimmer_write(head_oid, head_obc, first)) {
+      dout(10) << __func__ << ": Unable to get a wlock on " << head_oid << dendl;
+      return -ENOLCK;
+    }
+  } else {
+    OpContextUPtr ctx = simple_opc_create(obc);
+    ctx->head_obc = head_obc;
 
-  if (!ctx->lock_manager.get_snaptrimmer_write(
-	coid,
-	obc,
-	first)) {
-    close_op_ctx(ctx.release());
-    dout(10) << __func__ << ": Unable to get a wlock on " << coid << dendl;
-    return -ENOLCK;
-  }
+    if (!ctx->lock_manager.get_snaptrimmer_write(
+	  coid,
+	  obc,
+	  first)) {
+      close_op_ctx(ctx.release());
+      dout(10) << __func__ << ": Unable to get a wlock on " << coid << dendl;
+      return -ENOLCK;
+    }
 
-  if (!ctx->lock_manager.get_snaptrimmer_write(
-	head_oid,
-	head_obc,
-	first)) {
-    close_op_ctx(ctx.release());
-    dout(10) << __func__ << ": Unable to get a wlock on " << head_oid << dendl;
-    return -ENOLCK;
-  }
+    if (!ctx->lock_manager.get_snaptrimmer_write(
+	  head_oid,
+	  head_obc,
+	  first)) {
+      close_op_ctx(ctx.release());
+      dout(10) << __func__ << ": Unable to get a wlock on " << head_oid << dendl;
+      return -ENOLCK;
+    }
 
-  ctx->at_version = get_next_version();
+    ctx->at_version = get_next_version();
+    *ctxp = std::move(ctx);
+  }
 
+  OpContext *ctx = ctxp->get();
   PGTransaction *t = ctx->op_t.get();
+  t->add_obc(obc);
+  t->add_obc(head_obc);
  
   if (new_snaps.empty()) {
     // remove clone
@@ -4336,7 +4374,7 @@ int PrimaryLogPG::trim_object(
 	pg_log_entry_t::DELETE,
 	coid,
 	ctx->at_version,
-	ctx->obs->oi.version,
+	coi.version,
 	0,
 	osd_reqid_t(),
 	ctx->mtime,
@@ -4384,8 +4422,24 @@ int PrimaryLogPG::trim_object(
       new_snaps);
   }
 
+  if (heads) {
+    (*heads)[head_oid] = head_obc;
+  } else {
+    trim_head(ctx, head_obc);
+  }
+  return 0;
+}
+
+void PrimaryLogPG::trim_head(OpContext *ctx, ObjectContextRef head_obc)
+{
   // save head snapset
-  dout(10) << coid << " new snapset " << snapset << " on "
+  const hobject_t head_oid = head_obc->obs.oi.soid;
+  ceph_assert(head_obc->ssc);
+  SnapSet& snapset = head_obc->ssc->snapset;
+  PGTransaction *t = ctx->op_t.get();
+  bufferlist bl;
+
+  dout(10) << head_oid << " new snapset " << snapset << " on "
 	   << head_obc->obs.oi << dendl;
   if (snapset.clones.empty() &&
       (head_obc->obs.oi.is_whiteout() &&
@@ -4395,7 +4449,7 @@ int PrimaryLogPG::trim_object(
     // tiering agent if this is a cache tier since a snap trim event
     // is effectively evicting a whiteout we might otherwise want to
     // keep around.
-    dout(10) << coid << " removing " << head_oid << dendl;
+    dout(10) << __func__ << " removing " << head_oid << dendl;
     ctx->log.push_back(
       pg_log_entry_t(
 	pg_log_entry_t::DELETE,
@@ -4422,15 +4476,15 @@ int PrimaryLogPG::trim_object(
     if (oi.is_cache_pinned()) {
       ctx->delta_stats.num_objects_pinned--;
     }
-    if (coi.has_manifest())
+    if (oi.has_manifest())
       ctx->delta_stats.num_objects_manifest--;
     head_obc->obs.exists = false;
     head_obc->obs.oi = object_info_t(head_oid);
     t->remove(head_oid);
   } else {
-    dout(10) << coid << " filtering snapset on " << head_oid << dendl;
+    dout(10) << __func__ << " filtering snapset on " << head_oid << dendl;
     snapset.filter(pool.info);
-    dout(10) << coid << " writing updated snapset on " << head_oid
+    dout(10) << __func__ << " writing updated snapset on " << head_oid
 	     << ", snapset is " << snapset << dendl;
     ctx->log.push_back(
       pg_log_entry_t(
@@ -4458,9 +4512,6 @@ int PrimaryLogPG::trim_object(
     attrs[OI_ATTR].claim(bl);
     t->setattrs(head_oid, attrs);
   }
-
-  *ctxp = std::move(ctx);
-  return 0;
 }
 
 void PrimaryLogPG::kick_snap_trim()
@@ -5393,22 +5444,38 @@ int PrimaryLogPG::do_read(OpContext *ctx, OSDOp& osd_op) {
     ctx->op_finishers[ctx->current_osd_subop_num].reset(
       new ReadFinisher(osd_op));
   } else {
-    int r = pgbackend->objects_read_sync(
-      soid, op.extent.offset, op.extent.length, op.flags, &osd_op.outdata);
-    // whole object?  can we verify the checksum?
-    if (r >= 0 && op.extent.offset == 0 &&
-        (uint64_t)r == oi.size && oi.is_data_digest()) {
-      uint32_t crc = osd_op.outdata.crc32c(-1);
-      if (oi.data_digest != crc) {
-        osd->clog->error() << info.pgid << std::hex
-                           << " full-object read crc 0x" << crc
-                           << " != expected 0x" << oi.data_digest
-                           << std::dec << " on " << soid;
-        r = -EIO; // try repair later
+    int r = -ENOENT;
+    bool promote = false;
+    auto& hot_cache = osd->hot_object_cache;
+    if (hot_cache && ctx->op && !ctx->op->may_write()) {
+      r = hot_cache->read(soid, oi.version, op.extent.offset,
+			  op.extent.length, &osd_op.outdata);
+      if (r < 0 &&
+	  !(op.flags & (CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+			CEPH_OSD_OP_FLAG_FADVISE_NOCACHE))) {
+	promote = hot_cache->note_read(soid, oi.size, ceph_clock_now());
       }
     }
-    if (r == -EIO) {
-      r = rep_repair_primary_object(soid, ctx);
+    if (r < 0) {
+      r = pgbackend->objects_read_sync(
+	soid, op.extent.offset, op.extent.length, op.flags, &osd_op.outdata);
+      // whole object?  can we verify the checksum?
+      if (r >= 0 && op.extent.offset == 0 &&
+	  (uint64_t)r == oi.size && oi.is_data_digest()) {
+	uint32_t crc = osd_op.outdata.crc32c(-1);
+	if (oi.data_digest != crc) {
+	  osd->clog->error() << info.pgid << std::hex
+			     << " full-object read crc 0x" << crc
+			     << " != expected 0x" << oi.data_digest
+			     << std::dec << " on " << soid;
+	  r = -EIO; // try repair later
+	}
+      }
+      if (r == -EIO) {
+	r = rep_repair_primary_object(soid, ctx);
+      } else if (r >= 0 && promote) {
+	promote_hot_object(oi, op.extent.offset, osd_op.outdata);
+      }
     }
     if (r >= 0)
       op.extent.length = r;
@@ -5428,6 +5495,45 @@ int PrimaryLogPG::do_read(OpContext *ctx, OSDOp& osd_op) {
   return result;
 }
 
+// copy an object that has become hot into the OSD's hot object cache;
+// read is what the client read at off.  the copy is written, and the
+// rest of the object read, by the cache's thread without the pg lock;
+// the cache will not serve it once the object moves past oi.version.
+void PrimaryLogPG::promote_hot_object(const object_info_t& oi, uint64_t off,
+				      const bufferlist& read)
+{
+  dout(20) << __func__ << " " << oi.soid << " " << oi.version << dendl;
+  if (off == 0 && read.length() == oi.size) {
+    osd->hot_object_cache->queue_promote(
+      oi.soid, oi.version,
+      [read](bufferlist *full) {
+	*full = read;
+	return 0;
+      });
+    return;
+  }
+  ObjectStore *store = osd->store;
+  ObjectStore::CollectionHandle c = ch;
+  ghobject_t goid(oi.soid);
+  uint64_t size = oi.size;
+  bool has_digest = oi.is_data_digest();
+  uint32_t digest = oi.data_digest;
+  osd->hot_object_cache->queue_promote(
+    oi.soid, oi.version,
+    [store, c, goid, size, has_digest, digest](bufferlist *full) {
+      int r = store->read(c, goid, 0, size, *full);
+      if (r < 0) {
+	return r;
+      }
+      if ((uint64_t)r != size ||
+	  (has_digest && full->crc32c(-1) != digest)) {
+	// modified since we queued it
+	return -ESTALE;
+      }
+      return 0;
+    });
+}
+
 int PrimaryLogPG::do_sparse_read(OpContext *ctx, OSDOp& osd_op) {
   dout(20) << __func__ << dendl;
   auto& op = osd_op.op;
@@ -11472,7 +11578,7 @@ void PrimaryLogPG::on_failed_pull(
 	  << ", reps on " << recovery_state.get_missing_loc().get_locations(soid)
 	  << " unfound? " << recovery_state.get_missing_loc().is_unfound(soid)
 	  << dendl;
-  finish_recovery_op(soid);  // close out this attempt,
+  finish_object_recovery_op(soid);  // close out this attempt,
   finish_degraded_object(soid);
 
   if (from.count(pg_whoami)) {
@@ -12120,6 +12226,7 @@ void PrimaryLogPG::_clear_recovery_state()
     }
   }
   ceph_assert(backfills_in_flight.empty());
+  backfill_batches.clear();
   pending_backfill_updates.clear();
   ceph_assert(recovering.empty());
   pgbackend->clear_recovery_state();
@@ -12136,7 +12243,7 @@ void PrimaryLogPG::cancel_pull(const hobject_t &soid)
     requeue_ops(blocked_ops);
   }
   recovering.erase(soid);
-  finish_recovery_op(soid);
+  finish_object_recovery_op(soid);
   release_backoffs(soid);
   if (waiting_for_degraded_object.count(soid)) {
     dout(20) << " kicking degraded waiters on " << soid << dendl;
@@ -12782,6 +12889,8 @@ uint64_t PrimaryLogPG::recover_backfill(
 
     backfills_in_flight.clear();
     pending_backfill_updates.clear();
+    peer_backfill_prefetched.clear();
+    backfill_prefetching.clear();
   }
 
   for (set<pg_shard_t>::const_iterator i = get_backfill_targets().begin();
@@ -12813,6 +12922,12 @@ uint64_t PrimaryLogPG::recover_backfill(
   }
   backfill_info.trim_to(last_backfill_started);
 
+  // small objects are pushed in batches that count as a single recovery
+  // op against max, so that they share MOSDPGPush messages
+  backfill_batches.new_round(cct->_conf->osd_backfill_batch_objects,
+			     cct->_conf->osd_backfill_batch_object_size,
+			     cct->_conf->osd_max_push_cost);
+
   PGBackend::RecoveryHandle *h = pgbackend->open_recovery_op();
   while (ops < max) {
     if (backfill_info.begin <= earliest_peer_backfill() &&
@@ -12834,8 +12949,26 @@ uint64_t PrimaryLogPG::recover_backfill(
       BackfillInterval& pbi = peer_backfill_info[bt];
 
       dout(20) << " peer shard " << bt << " backfill " << pbi << dendl;
+      auto& prefetched = peer_backfill_prefetched[bt];
+      while (pbi.begin <= backfill_info.begin &&
+	     !pbi.extends_to_end() && pbi.empty() && !prefetched.empty()) {
+	dout(10) << " using read-ahead scan of peer osd." << bt
+		 << " from " << pbi.end << dendl;
+	ceph_assert(prefetched.front().begin == pbi.end);
+	pbi = std::move(prefetched.front());
+	prefetched.pop_front();
+      }
       if (pbi.begin <= backfill_info.begin &&
 	  !pbi.extends_to_end() && pbi.empty()) {
+	if (backfill_prefetching.erase(bt)) {
+	  // the scan we need is already on its way; wait for it
+	  dout(10) << " waiting for read-ahead scan of peer osd." << bt
+		   << " from " << pbi.end << dendl;
+	  ceph_assert(waiting_on_backfill.find(bt) == waiting_on_backfill.end());
+	  waiting_on_backfill.insert(bt);
+	  sent_scan = true;
+	  continue;
+	}
 	dout(10) << " scanning peer osd." << bt << " from " << pbi.end << dendl;
 	epoch_t e = get_osdmap_epoch();
 	MOSDPGScan *m = new MOSDPGScan(
@@ -12951,13 +13084,17 @@ uint64_t PrimaryLogPG::recover_backfill(
 	  all_push.insert(all_push.end(), missing_targs.begin(), missing_targs.end());
 
 	  handle.reset_tp_timeout();
-	  int r = prep_backfill_object_push(backfill_info.begin, obj_v, obc, all_push, h);
+	  bool new_op = false;
+	  int r = prep_backfill_object_push(backfill_info.begin, obj_v, obc,
+					    all_push, h, &new_op);
+	  if (new_op) {
+	    ops++;
+	  }
 	  if (r < 0) {
 	    *work_started = true;
 	    dout(0) << __func__ << " Error " << r << " trying to backfill " << backfill_info.begin << dendl;
 	    break;
 	  }
-	  ops++;
 	} else {
 	  *work_started = true;
 	  dout(20) << "backfill blocking on " << backfill_info.begin
@@ -13025,6 +13162,8 @@ uint64_t PrimaryLogPG::recover_backfill(
 
   pgbackend->run_recovery_op(h, get_recovery_op_priority());
 
+  prefetch_backfill_scans();
+
   dout(5) << "backfill_pos is " << backfill_pos << dendl;
   for (set<hobject_t>::iterator i = backfills_in_flight.begin();
        i != backfills_in_flight.end();
@@ -13103,11 +13242,45 @@ uint64_t PrimaryLogPG::recover_backfill(
   return ops;
 }
 
+void PrimaryLogPG::prefetch_backfill_scans()
+{
+  // keep up to osd_backfill_scan_readahead scan windows per peer queued
+  // behind peer_backfill_info so that we rarely stop to wait for a scan
+  unsigned readahead = cct->_conf->osd_backfill_scan_readahead;
+  if (!readahead) {
+    return;
+  }
+  for (auto& bt : get_backfill_targets()) {
+    if (waiting_on_backfill.count(bt) || backfill_prefetching.count(bt)) {
+      continue;
+    }
+    BackfillInterval& pbi = peer_backfill_info[bt];
+    if (pbi.empty()) {
+      continue;
+    }
+    auto& prefetched = peer_backfill_prefetched[bt];
+    const hobject_t& next =
+      prefetched.empty() ? pbi.end : prefetched.back().end;
+    if (next.is_max() || prefetched.size() >= readahead) {
+      continue;
+    }
+    dout(10) << __func__ << " scanning peer osd." << bt << " from " << next
+	     << dendl;
+    MOSDPGScan *m = new MOSDPGScan(
+      MOSDPGScan::OP_SCAN_GET_DIGEST, pg_whoami, get_osdmap_epoch(),
+      get_last_peering_reset(), spg_t(info.pgid.pgid, bt.shard),
+      next, hobject_t());
+    osd->send_message_osd_cluster(bt.osd, m, get_osdmap_epoch());
+    backfill_prefetching.insert(bt);
+  }
+}
+
 int PrimaryLogPG::prep_backfill_object_push(
   hobject_t oid, eversion_t v,
   ObjectContextRef obc,
   vector<pg_shard_t> peers,
-  PGBackend::RecoveryHandle *h)
+  PGBackend::RecoveryHandle *h,
+  bool *new_op)
 {
   dout(10) << __func__ << " " << oid << " v " << v << " to peers " << peers << dendl;
   ceph_assert(!peers.empty());
@@ -13117,7 +13290,14 @@ int PrimaryLogPG::prep_backfill_object_push(
 
   ceph_assert(!recovering.count(oid));
 
-  start_recovery_op(oid);
+  hobject_t op;
+  *new_op = backfill_batches.start(oid, obc->obs.oi.size, &op);
+  if (*new_op) {
+    start_recovery_op(op);
+  } else {
+    dout(20) << __func__ << " " << oid << " joins the batch of " << op
+	     << dendl;
+  }
   recovering.insert(make_pair(oid, obc));
 
   // We need to take the read_lock here in order to flush in-progress writes
@@ -13134,6 +13314,14 @@ int PrimaryLogPG::prep_backfill_object_push(
   return r;
 }
 
+void PrimaryLogPG::finish_object_recovery_op(const hobject_t& soid)
+{
+  hobject_t op;
+  if (backfill_batches.finish(soid, &op)) {
+    finish_recovery_op(op);
+  }
+}
+
 void PrimaryLogPG::update_range(
   BackfillInterval *bi,
   ThreadPool::TPHandle &handle)
@@ -15095,7 +15283,9 @@ boost::statechart::result PrimaryLogPG::AwaitAsyncWork::react(const DoSnapWork&)
   ldout(pg->cct, 10) << "AwaitAsyncWork: trimming snap " << snap_to_trim << dendl;
 
   vector<hobject_t> to_trim;
-  unsigned max = pg->cct->_conf->osd_pg_max_concurrent_snap_trims;
+  unsigned batch = pg->cct->_conf->osd_snap_trim_batch_objects;
+  unsigned max = batch > 1 ? batch :
+    pg->cct->_conf->osd_pg_max_concurrent_snap_trims;
   to_trim.reserve(max);
   int r = pg->snap_mapper.get_next_objects_to_trim(
     snap_to_trim,
@@ -15134,6 +15324,66 @@ boost::statechart::result PrimaryLogPG::AwaitAsyncWork::react(const DoSnapWork&)
   }
   ceph_assert(!to_trim.empty());
 
+  if (batch > 1) {
+    // bulk mode: trim the whole batch as a single op
+    OpContextUPtr ctx;
+    vector<hobject_t> trimmed;
+    map<hobject_t, ObjectContextRef> heads;
+    int error = 0;
+    for (auto &&object: to_trim) {
+      ldout(pg->cct, 10) << "AwaitAsyncWork react bulk trimming " << object
+			 << dendl;
+      error = pg->trim_object(!ctx, object, &ctx, &heads);
+      if (error) {
+	break;
+      }
+      trimmed.push_back(object);
+    }
+    // one SnapSet/object_info rewrite and log entry per head
+    for (auto i = heads.begin(); i != heads.end(); ++i) {
+      if (i != heads.begin()) {
+	ctx->at_version.version++;
+      }
+      pg->trim_head(ctx.get(), i->second);
+    }
+    if (error == -ENOLCK) {
+      ldout(pg->cct, 10) << "could not get write lock on obj "
+			 << to_trim[trimmed.size()] << dendl;
+    } else if (error) {
+      pg->state_set(PG_STATE_SNAPTRIM_ERROR);
+      ldout(pg->cct, 10) << "Snaptrim error=" << error << dendl;
+    }
+    if (!ctx) {
+      if (error == -ENOLCK) {
+	ldout(pg->cct, 10) << "waiting for it to clear" << dendl;
+	return transit< WaitRWLock >();
+      }
+      return transit< NotTrimming >();
+    }
+
+    // objects that were locked are retried in the next round
+    context<Trimming>().batch_bytes =
+      std::max<int64_t>(0, -ctx->delta_stats.num_bytes);
+    ldout(pg->cct, 10) << "trimming " << trimmed.size() << " clones, "
+		       << context<Trimming>().batch_bytes << " bytes"
+		       << dendl;
+    in_flight.insert(trimmed.begin(), trimmed.end());
+    ctx->register_on_success(
+      [pg, trimmed, &in_flight]() {
+	for (auto &object : trimmed) {
+	  ceph_assert(in_flight.find(object) != in_flight.end());
+	  in_flight.erase(object);
+	}
+	if (pg->state_test(PG_STATE_SNAPTRIM_ERROR)) {
+	  pg->snap_trimmer_machine.process_event(Reset());
+	} else {
+	  pg->snap_trimmer_machine.process_event(RepopsComplete());
+	}
+      });
+    pg->simple_opc_submit(std::move(ctx));
+    return transit< WaitRepops >();
+  }
+
   for (auto &&object: to_trim) {
     // Get next
     ldout(pg->cct, 10) << "AwaitAsyncWork react trimming " << object << dendl;
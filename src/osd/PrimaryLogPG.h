@@ -30,6 +30,7 @@
 #include "common/shared_cache.hpp"
 #include "ReplicatedBackend.h"
 #include "PGTransaction.h"
+#include "BackfillBatches.h"
 #include "cls/cas/cls_cas_ops.h"
 
 class CopyFromCallback;
@@ -1080,6 +1081,8 @@ protected:
    */
   set<hobject_t> backfills_in_flight;
   map<hobject_t, pg_stat_t> pending_backfill_updates;
+  /// small objects in backfills_in_flight sharing a recovery op
+  BackfillBatches backfill_batches;
 
   void dump_recovery_info(Formatter *f) const override {
     f->open_array_section("waiting_on_backfill");
@@ -1296,10 +1299,16 @@ protected:
     ThreadPool::TPHandle &handle ///< [in] tp handle
     );
 
+  /// send read-ahead scans to backfill targets
+  void prefetch_backfill_scans();
+
   int prep_backfill_object_push(
     hobject_t oid, eversion_t v, ObjectContextRef obc,
     vector<pg_shard_t> peers,
-    PGBackend::RecoveryHandle *h);
+    PGBackend::RecoveryHandle *h,
+    bool *new_op);
+  /// finish the recovery op of soid, or of the backfill batch it is in
+  void finish_object_recovery_op(const hobject_t& soid);
   void send_remove_op(const hobject_t& oid, eversion_t v, pg_shard_t peer);
 
 
@@ -1406,6 +1415,8 @@ protected:
   friend class C_ExtentCmpRead;
 
   int do_read(OpContext *ctx, OSDOp& osd_op);
+  void promote_hot_object(const object_info_t& oi, uint64_t off,
+			  const bufferlist& read);
   int do_sparse_read(OpContext *ctx, OSDOp& osd_op);
   int do_writesame(OpContext *ctx, OSDOp& osd_op);
 
@@ -1496,7 +1507,9 @@ public:
 
   void handle_backoff(OpRequestRef& op);
 
-  int trim_object(bool first, const hobject_t &coid, OpContextUPtr *ctxp);
+  int trim_object(bool first, const hobject_t &coid, OpContextUPtr *ctxp,
+		  map<hobject_t, ObjectContextRef> *heads = nullptr);
+  void trim_head(OpContext *ctx, ObjectContextRef head_obc);
   void snap_trimmer(epoch_t e) override;
   void kick_snap_trim() override;
   void snap_trimmer_scrub_complete() override;
@@ -1615,6 +1628,7 @@ private:
 
     set<hobject_t> in_flight;
     snapid_t snap_to_trim;
+    uint64_t batch_bytes = 0;  ///< freed by the last bulk trim
 
     explicit Trimming(my_context ctx)
       : my_base(ctx),
@@ -1658,10 +1672,18 @@ private:
 	}
       };
       auto *pg = context< SnapTrimmer >().pg;
-      if (pg->cct->_conf->osd_snap_trim_sleep > 0) {
+      double sleep = pg->cct->_conf->osd_snap_trim_sleep;
+      // bulk trims are paced by the bytes they free
+      uint64_t &batch_bytes = context<Trimming>().batch_bytes;
+      if (batch_bytes && pg->cct->_conf->osd_snap_trim_batch_bytes_per_sec) {
+	sleep += (double)batch_bytes /
+	  pg->cct->_conf->osd_snap_trim_batch_bytes_per_sec;
+      }
+      batch_bytes = 0;
+      if (sleep > 0) {
 	std::lock_guard l(pg->osd->sleep_lock);
 	wakeup = pg->osd->sleep_timer.add_event_after(
-	  pg->cct->_conf->osd_snap_trim_sleep,
+	  sleep,
 	  new OnTimer{pg, pg->get_osdmap_epoch()});
       } else {
 	post_event(SnapTrimTimerReady());
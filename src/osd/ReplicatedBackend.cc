@@ -1906,10 +1906,15 @@ void ReplicatedBackend::send_pushes(int prio, map<pg_shard_t, vector<PushOp> > &
       get_osdmap_epoch());
     if (!con)
       continue;
+    // complete pushes of small objects (batched backfill) are packed
+    // up to osd_backfill_batch_objects per message
+    uint64_t max_small = std::max(cct->_conf->osd_max_push_objects,
+				  cct->_conf->osd_backfill_batch_objects);
     vector<PushOp>::iterator j = i->second.begin();
     while (j != i->second.end()) {
       uint64_t cost = 0;
       uint64_t pushes = 0;
+      uint64_t small_pushes = 0;
       MOSDPGPush *msg = new MOSDPGPush();
       msg->from = get_parent()->whoami_shard();
       msg->pgid = get_parent()->primary_spg_t();
@@ -1920,12 +1925,20 @@ void ReplicatedBackend::send_pushes(int prio, map<pg_shard_t, vector<PushOp> > &
       for (;
            (j != i->second.end() &&
 	    cost < cct->_conf->osd_max_push_cost &&
-	    pushes < cct->_conf->osd_max_push_objects) ;
+	    pushes < cct->_conf->osd_max_push_objects &&
+	    small_pushes < max_small) ;
 	   ++j) {
 	dout(20) << __func__ << ": sending push " << *j
 		 << " to osd." << i->first << dendl;
 	cost += j->cost(cct);
-	pushes += 1;
+	if (j->before_progress.first &&
+	    j->after_progress.data_complete &&
+	    j->after_progress.omap_complete &&
+	    j->data.length() <= cct->_conf->osd_backfill_batch_object_size) {
+	  small_pushes += 1;
+	} else {
+	  pushes += 1;
+	}
 	msg->pushes.push_back(*j);
       }
       msg->set_cost(cost);
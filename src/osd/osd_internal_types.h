@@ -360,6 +360,9 @@ public:
   bool empty() const {
     return locks.empty();
   }
+  bool is_locked(const hobject_t &hoid) const {
+    return locks.count(hoid);
+  }
   bool get_lock_type(
     ObjectContext::RWState::State type,
     const hobject_t &hoid,
@@ -276,6 +276,10 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_time_avg(
+    l_osd_scrub_yield, "scrub_yield",
+    "Time scrub chunks were held back for client I/O");
+
   return osd_plb.create_perf_counters();
 }
  
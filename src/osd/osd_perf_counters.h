@@ -117,6 +117,8 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_scrub_yield,
+
   l_osd_last,
 };
 
@@ -177,10 +177,8 @@ string ceph_osd_alloc_hint_flag_string(unsigned flags)
 
 void pg_shard_t::encode(ceph::buffer::list &bl) const
 {
-  ENCODE_START(1, 1, bl);
-  encode(osd, bl);
-  encode(shard, bl);
-  ENCODE_FINISH(bl);
+  auto p = bl.get_contiguous_appender(ENCODED_SIZE);
+  encode(p);
 }
 void pg_shard_t::decode(ceph::buffer::list::const_iterator &bl)
 {
@@ -4668,6 +4666,301 @@ std::ostream& operator<<(std::ostream& out, const pg_log_dup_t& e) {
 }
 
 
+// -- pg_log_entry_chunk_t, pg_log_dup_chunk_t --
+
+namespace {
+
+// zigzag + base-128 varint, used for the deltas inside a log chunk
+void encode_chunk_varint(int64_t v, ceph::buffer::list &bl)
+{
+  uint64_t u = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+  char buf[10];
+  unsigned n = 0;
+  do {
+    buf[n] = u & 0x7f;
+    u >>= 7;
+    if (u)
+      buf[n] |= 0x80;
+    ++n;
+  } while (u);
+  bl.append(buf, n);
+}
+
+int64_t decode_chunk_varint(ceph::buffer::list::const_iterator &p)
+{
+  uint64_t u = 0;
+  for (unsigned shift = 0; ; shift += 7) {
+    if (shift > 63)
+      throw ceph::buffer::malformed_input("bad varint in pg log chunk");
+    __u8 byte;
+    p.copy(1, (char*)&byte);
+    u |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      break;
+  }
+  return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+enum {
+  CHUNK_SAME_REQID_SOURCE = 1,  ///< reqid name and inc match previous entry
+  CHUNK_SAME_SOID = 2,          ///< soid matches previous entry
+};
+
+// version and reqid of an item relative to the preceding one
+void encode_chunk_delta(const eversion_t &prev_version,
+			const osd_reqid_t &prev_reqid,
+			const eversion_t &version,
+			const osd_reqid_t &reqid,
+			ceph::buffer::list &bl)
+{
+  using ceph::encode;
+  encode_chunk_varint((int64_t)version.epoch - (int64_t)prev_version.epoch, bl);
+  encode_chunk_varint(version.version - prev_version.version, bl);
+  if (reqid.name == prev_reqid.name && reqid.inc == prev_reqid.inc) {
+    encode_chunk_varint(reqid.tid - prev_reqid.tid, bl);
+  } else {
+    encode(reqid, bl);
+  }
+}
+
+void decode_chunk_delta(const eversion_t &prev_version,
+			const osd_reqid_t &prev_reqid,
+			bool same_reqid_source,
+			eversion_t *version,
+			osd_reqid_t *reqid,
+			ceph::buffer::list::const_iterator &p)
+{
+  using ceph::decode;
+  version->epoch = prev_version.epoch + decode_chunk_varint(p);
+  version->version = prev_version.version + decode_chunk_varint(p);
+  if (same_reqid_source) {
+    *reqid = prev_reqid;
+    reqid->tid = prev_reqid.tid + decode_chunk_varint(p);
+  } else {
+    decode(*reqid, p);
+  }
+}
+
+} // anonymous namespace
+
+string pg_log_entry_chunk_t::get_key_name(const eversion_t &first)
+{
+  return string("chunk_") + first.get_key_name();
+}
+
+void pg_log_entry_chunk_t::encode(ceph::buffer::list &bl) const
+{
+  using ceph::encode;
+  ENCODE_START(1, 1, bl);
+  ceph::buffer::list ebl;
+  encode((uint32_t)entries.size(), ebl);
+  pg_log_entry_t empty;
+  const pg_log_entry_t *prev = &empty;
+  for (const auto &e : entries) {
+    __u8 flags = 0;
+    if (e.reqid.name == prev->reqid.name && e.reqid.inc == prev->reqid.inc)
+      flags |= CHUNK_SAME_REQID_SOURCE;
+    if (prev != &empty && e.soid == prev->soid)
+      flags |= CHUNK_SAME_SOID;
+    encode(flags, ebl);
+    encode_chunk_delta(prev->version, prev->reqid, e.version, e.reqid, ebl);
+    encode_chunk_varint(e.op, ebl);
+    if (!(flags & CHUNK_SAME_SOID))
+      encode(e.soid, ebl);
+    encode_chunk_varint(e.prior_version.epoch, ebl);
+    encode_chunk_varint(e.prior_version.version, ebl);
+    if (e.op == pg_log_entry_t::LOST_REVERT) {
+      encode_chunk_varint(e.reverting_to.epoch, ebl);
+      encode_chunk_varint(e.reverting_to.version, ebl);
+    }
+    encode_chunk_varint(e.user_version - e.version.version, ebl);
+    encode(e.mtime, ebl);
+    encode_chunk_varint(e.return_code, ebl);
+    encode(e.snaps, ebl);
+    encode(e.mod_desc, ebl);
+    encode(e.extra_reqids, ebl);
+    if (!e.extra_reqids.empty())
+      encode(e.extra_reqid_return_codes, ebl);
+    encode(e.clean_regions, ebl);
+    prev = &e;
+  }
+  __u32 crc = ebl.crc32c(0);
+  encode(ebl, bl);
+  encode(crc, bl);
+  ENCODE_FINISH(bl);
+}
+
+void pg_log_entry_chunk_t::decode(ceph::buffer::list::const_iterator &bl)
+{
+  using ceph::decode;
+  DECODE_START(1, bl);
+  ceph::buffer::list ebl;
+  decode(ebl, bl);
+  __u32 crc;
+  decode(crc, bl);
+  if (crc != ebl.crc32c(0))
+    throw ceph::buffer::malformed_input("bad checksum on pg_log_entry_chunk_t");
+  auto p = ebl.cbegin();
+  uint32_t n;
+  decode(n, p);
+  entries.clear();
+  pg_log_entry_t empty;
+  const pg_log_entry_t *prev = &empty;
+  while (n--) {
+    entries.emplace_back();
+    pg_log_entry_t &e = entries.back();
+    __u8 flags;
+    decode(flags, p);
+    decode_chunk_delta(prev->version, prev->reqid,
+		       flags & CHUNK_SAME_REQID_SOURCE,
+		       &e.version, &e.reqid, p);
+    e.op = decode_chunk_varint(p);
+    if (flags & CHUNK_SAME_SOID)
+      e.soid = prev->soid;
+    else
+      decode(e.soid, p);
+    e.prior_version.epoch = decode_chunk_varint(p);
+    e.prior_version.version = decode_chunk_varint(p);
+    if (e.op == pg_log_entry_t::LOST_REVERT) {
+      e.reverting_to.epoch = decode_chunk_varint(p);
+      e.reverting_to.version = decode_chunk_varint(p);
+    }
+    e.user_version = e.version.version + decode_chunk_varint(p);
+    decode(e.mtime, p);
+    e.return_code = decode_chunk_varint(p);
+    decode(e.snaps, p);
+    // ensure snaps does not pin the whole chunk in memory
+    e.snaps.rebuild();
+    e.snaps.reassign_to_mempool(mempool::mempool_osd_pglog);
+    decode(e.mod_desc, p);
+    decode(e.extra_reqids, p);
+    if (!e.extra_reqids.empty())
+      decode(e.extra_reqid_return_codes, p);
+    decode(e.clean_regions, p);
+    prev = &e;
+  }
+  DECODE_FINISH(bl);
+}
+
+void pg_log_entry_chunk_t::dump(Formatter *f) const
+{
+  f->open_array_section("entries");
+  for (const auto &e : entries) {
+    f->open_object_section("entry");
+    e.dump(f);
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void pg_log_entry_chunk_t::generate_test_instances(
+  list<pg_log_entry_chunk_t*>& o)
+{
+  o.push_back(new pg_log_entry_chunk_t());
+  o.push_back(new pg_log_entry_chunk_t());
+  hobject_t oid(object_t("objname"), "key", 123, 456, 0, "");
+  osd_reqid_t reqid(entity_name_t::CLIENT(777), 8, 999);
+  o.back()->entries.push_back(
+    pg_log_entry_t(pg_log_entry_t::MODIFY, oid, eversion_t(1,2),
+		   eversion_t(1,1), 2, reqid, utime_t(8,9), 0));
+  reqid.tid++;
+  o.back()->entries.push_back(
+    pg_log_entry_t(pg_log_entry_t::MODIFY, oid, eversion_t(1,3),
+		   eversion_t(1,2), 3, reqid, utime_t(8,10), 0));
+  o.back()->entries.push_back(
+    pg_log_entry_t(pg_log_entry_t::ERROR, oid, eversion_t(2,4),
+		   eversion_t(1,3), 4,
+		   osd_reqid_t(entity_name_t::CLIENT(778), 1, 5),
+		   utime_t(8,11), -ENOENT));
+}
+
+string pg_log_dup_chunk_t::get_key_name(const eversion_t &first)
+{
+  return string("dupchunk_") + first.get_key_name();
+}
+
+void pg_log_dup_chunk_t::encode(ceph::buffer::list &bl) const
+{
+  using ceph::encode;
+  ENCODE_START(1, 1, bl);
+  ceph::buffer::list ebl;
+  encode((uint32_t)dups.size(), ebl);
+  pg_log_dup_t empty;
+  const pg_log_dup_t *prev = &empty;
+  for (const auto &d : dups) {
+    __u8 flags = 0;
+    if (d.reqid.name == prev->reqid.name && d.reqid.inc == prev->reqid.inc)
+      flags |= CHUNK_SAME_REQID_SOURCE;
+    encode(flags, ebl);
+    encode_chunk_delta(prev->version, prev->reqid, d.version, d.reqid, ebl);
+    encode_chunk_varint(d.user_version - d.version.version, ebl);
+    encode_chunk_varint(d.return_code, ebl);
+    prev = &d;
+  }
+  __u32 crc = ebl.crc32c(0);
+  encode(ebl, bl);
+  encode(crc, bl);
+  ENCODE_FINISH(bl);
+}
+
+void pg_log_dup_chunk_t::decode(ceph::buffer::list::const_iterator &bl)
+{
+  using ceph::decode;
+  DECODE_START(1, bl);
+  ceph::buffer::list ebl;
+  decode(ebl, bl);
+  __u32 crc;
+  decode(crc, bl);
+  if (crc != ebl.crc32c(0))
+    throw ceph::buffer::malformed_input("bad checksum on pg_log_dup_chunk_t");
+  auto p = ebl.cbegin();
+  uint32_t n;
+  decode(n, p);
+  dups.clear();
+  pg_log_dup_t empty;
+  const pg_log_dup_t *prev = &empty;
+  while (n--) {
+    dups.emplace_back();
+    pg_log_dup_t &d = dups.back();
+    __u8 flags;
+    decode(flags, p);
+    decode_chunk_delta(prev->version, prev->reqid,
+		       flags & CHUNK_SAME_REQID_SOURCE,
+		       &d.version, &d.reqid, p);
+    d.user_version = d.version.version + decode_chunk_varint(p);
+    d.return_code = decode_chunk_varint(p);
+    prev = &d;
+  }
+  DECODE_FINISH(bl);
+}
+
+void pg_log_dup_chunk_t::dump(Formatter *f) const
+{
+  f->open_array_section("dups");
+  for (const auto &d : dups) {
+    f->open_object_section("dup");
+    d.dump(f);
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void pg_log_dup_chunk_t::generate_test_instances(
+  list<pg_log_dup_chunk_t*>& o)
+{
+  o.push_back(new pg_log_dup_chunk_t());
+  o.push_back(new pg_log_dup_chunk_t());
+  osd_reqid_t reqid(entity_name_t::CLIENT(777), 8, 999);
+  o.back()->dups.push_back(pg_log_dup_t(eversion_t(1,2), 2, reqid, 0));
+  reqid.tid++;
+  o.back()->dups.push_back(pg_log_dup_t(eversion_t(1,3), 3, reqid, 0));
+  // extra reqids share the version of the outer op
+  o.back()->dups.push_back(
+    pg_log_dup_t(eversion_t(1,3), 1,
+		 osd_reqid_t(entity_name_t::CLIENT(778), 1, 5), -ENOENT));
+}
+
+
 // -- pg_log_t --
 
 // out: pg_log_t that only has entries that apply to import_pgid using curmap
@@ -6405,6 +6698,22 @@ void ScrubMap::object::generate_test_instances(list<object*>& o)
   o.back()->attrs["bar"] = ceph::buffer::copy("barval", 6);
 }
 
+// -- ScrubMapBuilder --
+
+bool ScrubMapBuilder::deep_unchanged(const hobject_t& poid,
+				     const object_info_t& oi,
+				     uint64_t size) const
+{
+  if (deep_since == eversion_t() ||
+      oi.version > deep_since ||
+      !oi.is_data_digest() ||
+      oi.size != size)
+    return false;
+  // re-read some share of the unchanged objects to catch media errors
+  return crush_hash32_2(CRUSH_HASH_RJENKINS1, poid.get_hash(), deep_seed) %
+    1000000 >= deep_reread_ppm;
+}
+
 // -- OSDOp --
 
 ostream& operator<<(ostream& out, const OSDOp& op)
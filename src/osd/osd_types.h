@@ -178,6 +178,16 @@ struct pg_shard_t {
     return osd == -1;
   }
   std::string get_osd() const { return (osd == NO_OSD ? "NONE" : std::to_string(osd)); }
+  DENC_HELPERS
+  static constexpr size_t ENCODED_SIZE = 6 + sizeof(int32_t) + sizeof(int8_t);
+  // same bytes as encode(bufferlist&), for callers batching fixed-size
+  // fields into one contiguous appender
+  void encode(ceph::buffer::list::contiguous_appender& p) const {
+    DENC_START(1, 1, p);
+    denc(osd, p);
+    denc(shard.id, p);
+    DENC_FINISH(p);
+  }
   void encode(ceph::buffer::list &bl) const;
   void decode(ceph::buffer::list::const_iterator &bl);
   void dump(ceph::Formatter *f) const {
@@ -454,13 +464,17 @@ struct pg_t {
   hobject_t get_hobj_start() const;
   hobject_t get_hobj_end(unsigned pg_num) const;
 
+  static constexpr size_t ENCODED_SIZE =
+    sizeof(__u8) + sizeof(m_pool) + sizeof(m_seed) + sizeof(int32_t);
+  void encode(ceph::buffer::list::contiguous_appender& p) const {
+    denc((__u8)1, p);
+    denc(m_pool, p);
+    denc(m_seed, p);
+    denc((int32_t)-1, p); // was preferred
+  }
   void encode(ceph::buffer::list& bl) const {
-    using ceph::encode;
-    __u8 v = 1;
-    encode(v, bl);
-    encode(m_pool, bl);
-    encode(m_seed, bl);
-    encode((int32_t)-1, bl); // was preferred
+    auto p = bl.get_contiguous_appender(ENCODED_SIZE);
+    encode(p);
   }
   void decode(ceph::buffer::list::const_iterator& bl) {
     using ceph::decode;
@@ -586,11 +600,18 @@ struct spg_t {
     return ghobject_t::make_pgmeta(pgid.pool(), pgid.ps(), shard);
   }
 
+  DENC_HELPERS
+  static constexpr size_t ENCODED_SIZE =
+    6 + pg_t::ENCODED_SIZE + sizeof(int8_t);
+  void encode(ceph::buffer::list::contiguous_appender& p) const {
+    DENC_START(1, 1, p);
+    pgid.encode(p);
+    denc(shard.id, p);
+    DENC_FINISH(p);
+  }
   void encode(ceph::buffer::list &bl) const {
-    ENCODE_START(1, 1, bl);
-    encode(pgid, bl);
-    encode(shard, bl);
-    ENCODE_FINISH(bl);
+    auto p = bl.get_contiguous_appender(ENCODED_SIZE);
+    encode(p);
   }
   void decode(ceph::buffer::list::const_iterator& bl) {
     DECODE_START(1, bl);
@@ -862,6 +883,11 @@ public:
     ritoa<uint32_t, 10, 10>(epoch, key + 10);
   }
 
+  static constexpr size_t ENCODED_SIZE = sizeof(version_t) + sizeof(epoch_t);
+  void encode(ceph::buffer::list::contiguous_appender& p) const {
+    denc(version, p);
+    denc(epoch, p);
+  }
   void encode(ceph::buffer::list &bl) const {
 #if defined(CEPH_LITTLE_ENDIAN)
     bl.append((char *)this, sizeof(version_t) + sizeof(epoch_t));
@@ -3969,6 +3995,57 @@ WRITE_CLASS_ENCODER(pg_log_dup_t)
 
 std::ostream& operator<<(std::ostream& out, const pg_log_dup_t& e);
 
+/**
+ * pg_log_entry_chunk_t - run of consecutive pg log entries
+ *
+ * Used by the compact pg log format (osd_pg_log_chunk_entries) to
+ * store several log entries under a single pgmeta omap key.  Versions,
+ * reqids and user_versions are delta encoded against the preceding
+ * entry in the chunk, and the whole chunk is covered by one checksum.
+ */
+struct pg_log_entry_chunk_t {
+  std::list<pg_log_entry_t> entries;
+
+  static std::string get_key_name(const eversion_t &first);
+  std::string get_key_name() const {
+    ceph_assert(!entries.empty());
+    return get_key_name(entries.front().version);
+  }
+  static bool is_key_name(const std::string &key) {
+    return key.compare(0, 6, "chunk_") == 0;
+  }
+
+  void encode(ceph::buffer::list &bl) const;
+  void decode(ceph::buffer::list::const_iterator &bl);
+  void dump(ceph::Formatter *f) const;
+  static void generate_test_instances(std::list<pg_log_entry_chunk_t*>& o);
+};
+WRITE_CLASS_ENCODER(pg_log_entry_chunk_t)
+
+/**
+ * pg_log_dup_chunk_t - run of consecutive pg log dup entries
+ *
+ * Dup counterpart of pg_log_entry_chunk_t.
+ */
+struct pg_log_dup_chunk_t {
+  std::list<pg_log_dup_t> dups;
+
+  static std::string get_key_name(const eversion_t &first);
+  std::string get_key_name() const {
+    ceph_assert(!dups.empty());
+    return get_key_name(dups.front().version);
+  }
+  static bool is_key_name(const std::string &key) {
+    return key.compare(0, 9, "dupchunk_") == 0;
+  }
+
+  void encode(ceph::buffer::list &bl) const;
+  void decode(ceph::buffer::list::const_iterator &bl);
+  void dump(ceph::Formatter *f) const;
+  static void generate_test_instances(std::list<pg_log_dup_chunk_t*>& o);
+};
+WRITE_CLASS_ENCODER(pg_log_dup_chunk_t)
+
 /**
  * pg_log_t - incremental log of recent pg changes.
  *
@@ -4041,20 +4118,19 @@ public:
 
 
   pg_log_t split_out_child(pg_t child_pgid, unsigned split_bits) {
-    mempool::osd_pglog::list<pg_log_entry_t> oldlog, childlog;
-    oldlog.swap(log);
+    mempool::osd_pglog::list<pg_log_entry_t> childlog;
 
-    eversion_t old_tail;
+    // move the child's entries over without copying them; the entries
+    // we keep stay put, so pointers and iterators to them remain valid
     unsigned mask = ~((~0)<<split_bits);
-    for (auto i = oldlog.begin();
-	 i != oldlog.end();
+    for (auto i = log.begin();
+	 i != log.end();
       ) {
       if ((i->soid.get_hash() & mask) == child_pgid.m_seed) {
-	childlog.push_back(*i);
+	childlog.splice(childlog.end(), log, i++);
       } else {
-	log.push_back(*i);
+	++i;
       }
-      oldlog.erase(i++);
     }
 
     // osd_reqid is unique, so it doesn't matter if there are extra
@@ -5560,6 +5636,13 @@ WRITE_CLASS_ENCODER(ScrubMap)
 
 struct ScrubMapBuilder {
   bool deep = false;
+  /// incremental deep scrub: objects last modified at or before
+  /// deep_since may report their object_info data digest instead of
+  /// being read, except for the share selected by deep_seed and
+  /// deep_reread_ppm
+  eversion_t deep_since;
+  uint32_t deep_seed = 0;
+  uint32_t deep_reread_ppm = 0;
   std::vector<hobject_t> ls;
   size_t pos = 0;
   int64_t data_pos = 0;
@@ -5583,6 +5666,13 @@ struct ScrubMapBuilder {
     return data_pos < 0;
   }
 
+  /// true if an incremental deep scrub may skip reading poid, whose
+  /// object_info is oi and whose on-disk size is size, and report
+  /// oi.data_digest instead.  Depends only on poid, oi, size and the
+  /// deep_* fields, so every shard picks the same objects.
+  bool deep_unchanged(const hobject_t& poid, const object_info_t& oi,
+		      uint64_t size) const;
+
   void next_object() {
     ++pos;
     data_pos = 0;
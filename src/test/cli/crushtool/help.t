@@ -100,6 +100,8 @@
         [--simulate]       simulate placements using a random
                            number generator in place of the CRUSH
                            algorithm
+        [--bench-straw2]   time the mappings with straw2 items hashed
+                           one at a time and several at a time
      --show-utilization    show OSD usage
      --show-utilization-all
                            include zero weight items
@@ -28,7 +28,13 @@
                              max deviation from target [default: .01]
      --upmap-pool <poolname> restrict upmap balancing to 1 or more pools
      --upmap-save            write modified OSDMap with upmap changes
+     --bench-upmap           time the --upmap calculation with one thread and with
+                             osd_calc_pg_upmaps_threads, checking both agree
      --dump <format>         displays the map in plain text when <format> is 'plain', 'json' if specified format is not supported
      --tree                  displays a tree of the map
      --test-crush [--range-first <first> --range-last <last>] map pgs to acting osds
+     --bench-apply <epochs>  apply <epochs> synthetic incrementals, keeping every
+                             epoch, and report osdmap memory and apply latency
+     --bench-mapping <epochs> apply <epochs> synthetic incrementals and compare
+                             full and incremental pg mapping time per epoch
   [1]
@@ -0,0 +1,154 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Measures what op tracking costs per op: --threads threads each track
+ * --ops ops that mark --events events before completing and moving to
+ * the op history, with the regular and with the lightweight tracker.
+ * Untracked ops give the baseline.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "common/ceph_argparse.h"
+#include "common/Formatter.h"
+#include "common/TrackedOp.h"
+#include "global/global_init.h"
+
+static void usage()
+{
+  cout << "usage: ceph_bench_op_tracker [flags]\n"
+    "	 --threads\n"
+    "	       threads tracking ops (default 8)\n"
+    "	 --ops\n"
+    "	       ops per thread (default 200000)\n"
+    "	 --events\n"
+    "	       events marked per op (default 10)\n"
+    "	 --shards\n"
+    "	       op tracker shards (default 32)\n" << std::endl;
+  generic_server_usage();
+}
+
+struct Config {
+  unsigned threads = 8;
+  unsigned ops = 200000;
+  unsigned events = 10;
+  unsigned shards = 32;
+};
+
+class BenchOp : public TrackedOp {
+public:
+  BenchOp(OpTracker *tracker, const utime_t& initiated)
+    : TrackedOp(tracker, initiated) {}
+  void _dump(Formatter *f) const override {
+    dump_events(f);
+  }
+  void _dump_op_descriptor_unlocked(ostream& stream) const override {
+    stream << "bench_op";
+  }
+};
+
+// the event texts of an OSD op
+static const char *event_names[] = {
+  "queued_for_pg", "reached_pg", "started", "waiting for subops from 1,2",
+  "op_commit", "sub_op_commit_rec", "commit_sent", "op_applied",
+};
+
+static double run(const Config &cfg, bool tracking, bool lightweight)
+{
+  OpTracker tracker(g_ceph_context, tracking, cfg.shards);
+  tracker.set_lightweight(lightweight);
+  tracker.set_history_size_and_duration(20, 600);
+  tracker.set_history_slow_op_size_and_threshold(20, 10);
+
+  auto start = std::chrono::steady_clock::now();
+  vector<std::thread> workers;
+  for (unsigned t = 0; t < cfg.threads; ++t) {
+    workers.emplace_back([&] {
+	for (unsigned n = 0; n < cfg.ops; ++n) {
+	  TrackedOpRef op(new BenchOp(&tracker, ceph_clock_now()));
+	  op->tracking_start();
+	  for (unsigned e = 0; e < cfg.events; ++e) {
+	    op->mark_event(event_names[e % std::size(event_names)]);
+	  }
+	}
+      });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  double elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  if (tracking) {
+    // the history must still be complete
+    JSONFormatter f;
+    tracker.dump_historic_ops(&f);
+  }
+  tracker.on_shutdown();
+  return elapsed;
+}
+
+int main(int argc, const char **argv)
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)nullptr)) {
+      cfg.threads = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--ops", (char*)nullptr)) {
+      cfg.ops = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--events", (char*)nullptr)) {
+      cfg.events = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--shards", (char*)nullptr)) {
+      cfg.shards = atoi(val.c_str());
+    } else {
+      cerr << "Error: can't understand argument: " << *i << std::endl;
+      exit(1);
+    }
+  }
+  if (!cfg.threads || !cfg.ops || !cfg.shards) {
+    cerr << "Error: --threads, --ops and --shards must be > 0" << std::endl;
+    exit(1);
+  }
+
+  common_init_finish(g_ceph_context);
+
+  uint64_t total = (uint64_t)cfg.threads * cfg.ops;
+  cout << cfg.threads << " threads x " << cfg.ops << " ops, "
+       << cfg.events << " events each" << std::endl;
+  for (auto [name, tracking, lightweight] : {
+      std::make_tuple("untracked", false, false),
+      std::make_tuple("tracked", true, false),
+      std::make_tuple("lightweight", true, true)}) {
+    double elapsed = run(cfg, tracking, lightweight);
+    cout << "  " << name << ": " << elapsed << "s, "
+	 << elapsed * 1000000000.0 / total << " ns/op" << std::endl;
+  }
+  return 0;
+}
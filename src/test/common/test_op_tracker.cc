@@ -0,0 +1,232 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "common/Formatter.h"
+#include "common/TrackedOp.h"
+#include "global/global_context.h"
+#include "json_spirit/json_spirit.h"
+
+static std::atomic<unsigned> destroyed = {0};
+
+class TestOp : public TrackedOp {
+public:
+  TestOp(OpTracker *tracker, const utime_t& initiated)
+    : TrackedOp(tracker, initiated) {}
+  ~TestOp() override {
+    ++destroyed;
+  }
+  void _dump(Formatter *f) const override {
+    dump_events(f);
+  }
+  void _dump_op_descriptor_unlocked(ostream& stream) const override {
+    stream << "test_op";
+  }
+};
+
+// the (stamp, event) pairs op->dump() reports
+static vector<pair<string, string>> get_events(TrackedOp *op)
+{
+  JSONFormatter f;
+  f.open_object_section("op");
+  op->dump(ceph_clock_now(), &f);
+  f.close_section();
+  std::ostringstream ss;
+  f.flush(ss);
+
+  json_spirit::mValue v;
+  EXPECT_TRUE(json_spirit::read(ss.str(), v));
+  vector<pair<string, string>> events;
+  for (auto& e : v.get_obj()["type_data"].get_obj()["events"].get_array()) {
+    auto& o = e.get_obj();
+    events.emplace_back(o["time"].get_str(), o["event"].get_str());
+  }
+  return events;
+}
+
+class OpTrackerTest : public ::testing::TestWithParam<bool> {};
+
+TEST_P(OpTrackerTest, dump_events)
+{
+  OpTracker tracker(g_ceph_context, true, 4);
+  tracker.set_lightweight(GetParam());
+  utime_t start(1000, 0);
+  {
+    TrackedOpRef op(new TestOp(&tracker, start));
+    op->tracking_start();
+    utime_t t = start;
+    t += .001;
+    op->mark_event("queued_for_pg", t);
+    t += .002;
+    op->mark_event("reached_pg", t);
+
+    auto events = get_events(op.get());
+    ASSERT_EQ(3u, events.size());
+    std::ostringstream ss;
+    ss << start;
+    ASSERT_EQ(ss.str(), events[0].first);
+    ASSERT_EQ("initiated", events[0].second);
+    ASSERT_EQ("queued_for_pg", events[1].second);
+    ss.str("");
+    ss << t;
+    ASSERT_EQ(ss.str(), events[2].first);
+    ASSERT_EQ("reached_pg", events[2].second);
+    ASSERT_EQ("reached_pg", op->state_string());
+  }
+  tracker.on_shutdown();
+}
+
+TEST_P(OpTrackerTest, dump_many_events)
+{
+  OpTracker tracker(g_ceph_context, true, 4);
+  tracker.set_lightweight(GetParam());
+  {
+    TrackedOpRef op(new TestOp(&tracker, ceph_clock_now()));
+    op->tracking_start();
+    for (unsigned i = 0; i < 2 * OPTRACKER_PREALLOC_EVENTS; ++i) {
+      op->mark_event("event " + std::to_string(i));
+    }
+    auto events = get_events(op.get());
+    ASSERT_EQ("event " + std::to_string(2 * OPTRACKER_PREALLOC_EVENTS - 1),
+	      events.back().second);
+    if (GetParam()) {
+      // the last slot holds the latest event, after a note of the ones
+      // that were dropped
+      ASSERT_EQ(OPTRACKER_PREALLOC_EVENTS + 1u, events.size());
+      ASSERT_EQ("event " + std::to_string(OPTRACKER_PREALLOC_EVENTS - 2),
+		events[OPTRACKER_PREALLOC_EVENTS - 1].second);
+      ASSERT_EQ("truncated " + std::to_string(OPTRACKER_PREALLOC_EVENTS + 1) +
+		" events", events[OPTRACKER_PREALLOC_EVENTS].second);
+    } else {
+      ASSERT_EQ(2 * OPTRACKER_PREALLOC_EVENTS + 1, events.size());
+    }
+    ASSERT_EQ("event " + std::to_string(2 * OPTRACKER_PREALLOC_EVENTS - 1),
+	      op->state_string());
+  }
+  tracker.on_shutdown();
+}
+
+TEST_P(OpTrackerTest, mixed_events)
+{
+  OpTracker tracker(g_ceph_context, true, 4);
+  tracker.set_lightweight(GetParam());
+  {
+    TrackedOpRef op(new TestOp(&tracker, ceph_clock_now()));
+    op->tracking_start();
+    // names interned and text built at runtime, each kept as marked
+    for (unsigned i = 0; i < 5000; ++i) {
+      if (i % 2) {
+	op->mark_event("reached_pg");
+      } else {
+	op->mark_event("waiting for subops from " + std::to_string(i));
+      }
+    }
+    auto events = get_events(op.get());
+    for (unsigned i = 1; i < OPTRACKER_PREALLOC_EVENTS - 1; ++i) {
+      unsigned n = i - 1;
+      ASSERT_EQ(n % 2 ? std::string("reached_pg") :
+		"waiting for subops from " + std::to_string(n),
+		events[i].second);
+    }
+    ASSERT_EQ("reached_pg", events.back().second);
+    op->mark_event("sub_op_commit_rec from osd.4");
+    ASSERT_EQ("sub_op_commit_rec from osd.4", op->state_string());
+    ASSERT_EQ("sub_op_commit_rec from osd.4",
+	      get_events(op.get()).back().second);
+  }
+  tracker.on_shutdown();
+}
+
+TEST(OpTracker, lightweight_racing_events)
+{
+  OpTracker tracker(g_ceph_context, true, 4);
+  tracker.set_lightweight(true);
+  utime_t start = ceph_clock_now();
+  TrackedOpRef op(new TestOp(&tracker, start));
+  op->tracking_start();
+  for (unsigned i = 1; i < OPTRACKER_PREALLOC_EVENTS; ++i) {
+    op->mark_event("filler", start);
+  }
+  // the remaining events all land in the last slot; whatever is left
+  // there must be one whole event
+  vector<std::thread> threads;
+  for (unsigned t = 0; t < 4; ++t) {
+    threads.emplace_back([&op, start, t] {
+	utime_t stamp = start;
+	stamp += t;
+	for (unsigned i = 0; i < 10000; ++i) {
+	  op->mark_event("thread " + std::to_string(t), stamp);
+	}
+      });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto last = get_events(op.get()).back();
+  unsigned t = last.second.back() - '0';
+  ASSERT_LT(t, 4u);
+  utime_t stamp = start;
+  stamp += t;
+  std::ostringstream ss;
+  ss << stamp;
+  ASSERT_EQ(ss.str(), last.first);
+  op.reset();
+  tracker.on_shutdown();
+}
+
+TEST_P(OpTrackerTest, history)
+{
+  OpTracker tracker(g_ceph_context, true, 4);
+  tracker.set_lightweight(GetParam());
+  tracker.set_history_size_and_duration(100, 600);
+  {
+    TrackedOpRef op(new TestOp(&tracker, ceph_clock_now()));
+    op->tracking_start();
+    op->mark_event("commit_sent");
+  }
+  // completed ops reach the history from its service thread
+  string dump;
+  for (unsigned i = 0; i < 100; ++i) {
+    JSONFormatter f;
+    tracker.dump_historic_ops(&f);
+    std::ostringstream ss;
+    f.flush(ss);
+    dump = ss.str();
+    if (dump.find("commit_sent") != string::npos) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_NE(string::npos, dump.find("commit_sent"));
+  ASSERT_NE(string::npos, dump.find("\"done\""));
+  tracker.on_shutdown();
+}
+
+TEST_P(OpTrackerTest, shutdown_frees_history)
+{
+  destroyed = 0;
+  const unsigned n = 3 * OPTRACKER_HISTORY_RING_SIZE;
+  {
+    OpTracker tracker(g_ceph_context, true, 4);
+    tracker.set_lightweight(GetParam());
+    tracker.set_history_size_and_duration(n, 600);
+    for (unsigned i = 0; i < n; ++i) {
+      TrackedOpRef op(new TestOp(&tracker, ceph_clock_now()));
+      op->tracking_start();
+    }
+    // whatever is still queued for the history goes too
+    tracker.on_shutdown();
+    ASSERT_EQ(n, destroyed.load());
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(
+  OpTracker,
+  OpTrackerTest,
+  ::testing::Values(false, true));
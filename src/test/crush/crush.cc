@@ -637,3 +637,40 @@ TEST(CRUSH, straw2_reweight) {
     cout << "     vs " << estddev << std::endl;
   }
 }
+
+TEST(CRUSH, straw2_lanes) {
+  // hashing straw2 items several at a time must not change any mapping,
+  // including for sizes that are not a multiple of the lane count and
+  // for zero-weight items.
+  for (int n : {CRUSH_HASH_LANES - 1, CRUSH_HASH_LANES, 45}) {
+    std::unique_ptr<CrushWrapper> c(new CrushWrapper);
+    c->set_type_name(1, "root");
+    c->set_type_name(0, "osd");
+    vector<int> items(n), weights(n);
+    for (int i = 0; i < n; ++i) {
+      items[i] = i;
+      weights[i] = (i % 7 == 3) ? 0 : 0x10000 + (i * 0x1234 % 0x20000);
+    }
+    c->set_max_devices(n);
+    int root;
+    crush_bucket *b = crush_make_bucket(c->get_crush_map(),
+					CRUSH_BUCKET_STRAW2, CRUSH_HASH_RJENKINS1,
+					1, n, &items[0], &weights[0]);
+    ASSERT_EQ(0, crush_add_bucket(c->get_crush_map(), 0, b, &root));
+    ASSERT_EQ(0, c->set_item_name(root, "root"));
+    int rule = c->add_simple_rule("rule", "root", "osd", "",
+				  "firstn", pg_pool_t::TYPE_REPLICATED);
+    ASSERT_EQ(0, rule);
+    c->finalize();
+
+    vector<unsigned> reweight(n, 0x10000);
+    for (int x = 0; x < 10000; ++x) {
+      vector<int> one, lanes;
+      crush_straw2_lanes = 0;
+      c->do_rule(rule, x, one, 3, reweight, 0);
+      crush_straw2_lanes = 1;
+      c->do_rule(rule, x, lanes, 3, reweight, 0);
+      ASSERT_EQ(one, lanes);
+    }
+  }
+}
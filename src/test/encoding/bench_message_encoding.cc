@@ -0,0 +1,165 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <iostream>
+
+using namespace std;
+
+#include "common/ceph_argparse.h"
+#include "common/Cycles.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "include/ceph_features.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+#include "messages/MOSDPing.h"
+#include "messages/MOSDRepOp.h"
+#include "messages/MOSDRepOpReply.h"
+
+// Measures the per-message cost of encode_payload() and decode_payload()
+// for the messages on the OSD hot path.  Before timing anything each
+// message is encoded, decoded into a fresh instance and encoded again;
+// both payloads have to be byte-for-byte identical.
+
+static const uint64_t features = CEPH_FEATURES_ALL;
+
+template <class T>
+static void encode_one(T* m)
+{
+  m->clear_payload();
+  m->encode_payload(features);
+}
+
+template <class T>
+static ceph::ref_t<T> decode_one(const T* m)
+{
+  auto d = ceph::make_message<T>();
+  bufferlist payload = m->get_payload();
+  bufferlist data = m->get_data();
+  d->set_header(m->get_header());
+  d->set_payload(payload);
+  d->set_data(data);
+  d->decode_payload();
+  if constexpr (std::is_same_v<T, MOSDOp> ||
+		std::is_same_v<T, MOSDRepOp> ||
+		std::is_same_v<T, MOSDRepOpReply>) {
+    d->finish_decode();
+  }
+  return d;
+}
+
+template <class T>
+static bool run(const char* name, T* m, int count)
+{
+  encode_one(m);
+  auto d = decode_one(m);
+  encode_one(d.get());
+  if (!m->get_payload().contents_equal(d->get_payload())) {
+    cerr << " " << name << ": payload changed across decode/encode" << std::endl;
+    return false;
+  }
+
+  uint64_t start = Cycles::rdtsc();
+  for (int i = 0; i < count; i++) {
+    encode_one(m);
+  }
+  uint64_t stop = Cycles::rdtsc();
+  double encode_us = Cycles::to_microseconds(stop - start);
+
+  start = Cycles::rdtsc();
+  for (int i = 0; i < count; i++) {
+    decode_one(m);
+  }
+  stop = Cycles::rdtsc();
+  double decode_us = Cycles::to_microseconds(stop - start);
+
+  cerr << " " << name << ": " << m->get_payload().length() << " bytes, encode "
+       << (count ? encode_us * 1000 / count : 0) << "ns, decode "
+       << (count ? decode_us * 1000 / count : 0) << "ns" << std::endl;
+  return true;
+}
+
+void usage(const string &name) {
+  cerr << "Usage: " << name << " [messages] [ops]" << std::endl;
+  cerr << "       [messages]: number of times each message is encoded and decoded" << std::endl;
+  cerr << "       [ops]: number of ops in each MOSDOp and MOSDOpReply" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  if (args.size() < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const int count = atoi(args[0]);
+  const int num_ops = std::max(1, atoi(args[1]));
+
+  const hobject_t hoid(object_t("rbd_data.1234567890ab.0000000000000001"),
+		       "", CEPH_NOSNAP, 0x5a5a5a5a, 3, "");
+  spg_t pgid(pg_t(0x5a, 3), shard_id_t::NO_SHARD);
+  const osd_reqid_t reqid(entity_name_t::CLIENT(4242), 0, 1);
+  const pg_shard_t from(1, shard_id_t::NO_SHARD);
+
+  auto op = ceph::make_message<MOSDOp>(0, 1, hoid, pgid, 100,
+				       CEPH_OSD_FLAG_WRITE |
+				       CEPH_OSD_FLAG_ONDISK, features);
+  op->set_reqid(reqid);
+  op->set_mtime(ceph_clock_now());
+  for (int i = 0; i < num_ops; i++) {
+    bufferlist bl;
+    bl.append_zero(4096);
+    op->write(i * 4096, 4096, bl);
+  }
+
+  auto reply = ceph::make_message<MOSDOpReply>(op.get(), 0, 100,
+					       CEPH_OSD_FLAG_ONDISK, true);
+  reply->set_reply_versions(eversion_t(100, 12345), 12345);
+
+  auto repop = ceph::make_message<MOSDRepOp>(reqid, from, pgid, hoid,
+					     CEPH_OSD_FLAG_ONDISK, 100, 90,
+					     2, eversion_t(100, 12345));
+  repop->logbl.append_zero(512);
+  repop->get_data().append_zero(4096);
+
+  auto repop_reply = ceph::make_message<MOSDRepOpReply>(
+    repop.get(), from, 0, 100, 90, CEPH_OSD_FLAG_ONDISK);
+
+  uuid_d fsid;
+  fsid.generate_random();
+  auto ping = ceph::make_message<MOSDPing>(fsid, 100, MOSDPing::PING,
+					   ceph_clock_now(), 0);
+
+  cerr << " messages " << count << std::endl;
+  cerr << " ops " << num_ops << std::endl;
+
+  Cycles::init();
+  if (!run("MOSDOp", op.get(), count) ||
+      !run("MOSDOpReply", reply.get(), count) ||
+      !run("MOSDRepOp", repop.get(), count) ||
+      !run("MOSDRepOpReply", repop_reply.get(), count) ||
+      !run("MOSDPing", ping.get(), count)) {
+    return 1;
+  }
+  return 0;
+}
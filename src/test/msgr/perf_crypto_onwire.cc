@@ -0,0 +1,190 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <iostream>
+
+using namespace std;
+
+#include "auth/Auth.h"
+#include "common/ceph_argparse.h"
+#include "common/Cycles.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "include/ceph_features.h"
+#include "include/crc32c.h"
+#include "msg/async/crypto_onwire.h"
+#include "msg/async/frames_v2.h"
+
+using namespace ceph::msgr::v2;
+
+// Compares the per-frame CPU cost of the three ways ProtocolV2 can put a
+// message frame on the wire: crc mode, secure mode encrypting one segment
+// at a time (reset/update.../final) and secure mode encrypting the whole
+// frame with authenticated_encrypt_frame().
+
+struct frame_parts_t {
+  bufferlist preamble_and_header;
+  bufferlist front;
+  bufferlist middle;
+  bufferlist data;
+  bufferlist epilogue;
+};
+
+static bufferlist random_bl(unsigned len, unsigned chunk)
+{
+  bufferlist bl;
+  while (bl.length() < len) {
+    unsigned n = std::min(chunk, len - bl.length());
+    bufferptr bp(n);
+    for (unsigned i = 0; i < n; i++) {
+      bp.c_str()[i] = rand();
+    }
+    bl.append(std::move(bp));
+  }
+  return bl;
+}
+
+static frame_parts_t make_frame(unsigned front_len, unsigned data_len,
+				unsigned data_chunk)
+{
+  frame_parts_t f;
+  f.preamble_and_header = random_bl(FRAME_PREAMBLE_SIZE +
+				    sizeof(ceph_msg_header2), 4096);
+  f.front = random_bl(front_len, 4096);
+  f.data = random_bl(data_len, data_chunk);
+  for (auto* bl : {&f.preamble_and_header, &f.front, &f.data}) {
+    *bl = segment_onwire_bufferlist(std::move(*bl));
+  }
+  f.epilogue.append_zero(FRAME_SECURE_EPILOGUE_SIZE);
+  return f;
+}
+
+static bufferlist encode_crc(const frame_parts_t& f)
+{
+  epilogue_plain_block_t epilogue;
+  ::memset(&epilogue, 0, sizeof(epilogue));
+  epilogue.crc_values[0] = f.preamble_and_header.crc32c(-1);
+  epilogue.crc_values[1] = f.front.crc32c(-1);
+  epilogue.crc_values[2] = f.middle.crc32c(-1);
+  epilogue.crc_values[3] = f.data.crc32c(-1);
+
+  bufferlist ret;
+  for (const auto* bl : {&f.preamble_and_header, &f.front, &f.middle,
+			 &f.data}) {
+    ret.append(*bl);
+  }
+  ret.append(reinterpret_cast<const char*>(&epilogue), sizeof(epilogue));
+  return ret;
+}
+
+static bufferlist encode_secure_old(ceph::crypto::onwire::TxHandler& tx,
+				    const frame_parts_t& f)
+{
+  tx.reset_tx_handler({ f.preamble_and_header.length(), f.front.length(),
+			f.middle.length(), f.data.length() });
+  for (const auto* bl : {&f.preamble_and_header, &f.front, &f.middle,
+			 &f.data}) {
+    if (bl->length()) {
+      tx.authenticated_encrypt_update(*bl);
+    }
+  }
+  tx.authenticated_encrypt_update(f.epilogue);
+  return tx.authenticated_encrypt_final();
+}
+
+static bufferlist encode_secure_new(ceph::crypto::onwire::TxHandler& tx,
+				    const frame_parts_t& f)
+{
+  return tx.authenticated_encrypt_frame({ &f.preamble_and_header, &f.front,
+					  &f.middle, &f.data, &f.epilogue });
+}
+
+static ceph::crypto::onwire::rxtx_t make_handlers(const std::string& secret)
+{
+  AuthConnectionMeta auth_meta;
+  auth_meta.con_mode = CEPH_CON_MODE_SECURE;
+  auth_meta.connection_secret = secret;
+  return ceph::crypto::onwire::rxtx_t::create_handler_pair(
+    g_ceph_context, auth_meta, false);
+}
+
+void usage(const string &name) {
+  cerr << "Usage: " << name << " [frames] [data bytes] [data chunk bytes]" << std::endl;
+  cerr << "       [frames]: number of frames encoded in each mode" << std::endl;
+  cerr << "       [data bytes]: size of the data segment of each frame" << std::endl;
+  cerr << "       [data chunk bytes]: size of the buffers the data segment is made of" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  if (args.size() < 3) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const int frames = atoi(args[0]);
+  const unsigned data_len = atoi(args[1]);
+  const unsigned data_chunk = std::max(1, atoi(args[2]));
+
+  // the header and front of a typical MOSDOp
+  const frame_parts_t f = make_frame(256, data_len, data_chunk);
+  const std::string secret = random_bl(16 * 4, 4096).to_str();
+
+  // both handlers start from the same key and nonce and must produce the
+  // same ciphertext frame after frame.
+  auto old_handlers = make_handlers(secret);
+  auto new_handlers = make_handlers(secret);
+  for (int i = 0; i < 2; i++) {
+    if (!encode_secure_old(*old_handlers.tx, f).contents_equal(
+	  encode_secure_new(*new_handlers.tx, f))) {
+      cerr << " ciphertext mismatch between secure-old and secure-new" << std::endl;
+      return 1;
+    }
+  }
+
+  cerr << " frames " << frames << std::endl;
+  cerr << " frame bytes " << (f.preamble_and_header.length() +
+			     f.front.length() + f.data.length() +
+			     f.epilogue.length()) << std::endl;
+  cerr << " data chunk bytes " << data_chunk << std::endl;
+
+  Cycles::init();
+  auto run = [&](const char* mode, auto&& encode) {
+    uint64_t bytes = 0;
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < frames; i++) {
+      bytes += encode().length();
+    }
+    uint64_t stop = Cycles::rdtsc();
+    double us = Cycles::to_microseconds(stop - start);
+    cerr << " " << mode << ": " << us << "us, "
+	 << (frames ? us * 1000 / frames : 0) << "ns/frame, "
+	 << (us > 0 ? bytes / us : 0) << " MB/s" << std::endl;
+  };
+
+  run("crc", [&] { return encode_crc(f); });
+  run("secure-old", [&] { return encode_secure_old(*old_handlers.tx, f); });
+  run("secure-new", [&] { return encode_secure_new(*new_handlers.tx, f); });
+
+  return 0;
+}
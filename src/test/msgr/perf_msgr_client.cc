@@ -19,6 +19,7 @@
 #include <string>
 #include <unistd.h>
 #include <iostream>
+#include <sys/resource.h>
 
 using namespace std;
 
@@ -29,6 +30,7 @@ using namespace std;
 #include "msg/Messenger.h"
 #include "messages/MOSDOp.h"
 
+#include <algorithm>
 #include <atomic>
 
 class MessengerClient {
@@ -78,6 +80,8 @@ class MessengerClient {
     Mutex lock;
     Cond cond;
     uint64_t inflight;
+    vector<uint64_t> send_stamps;  ///< Cycles::rdtsc() at send, by tid
+    vector<uint64_t> latencies;    ///< in cycles
 
     ClientThread(Messenger *m, int c, ConnectionRef con, int len, int ops, int think_time_us):
         msgr(m), concurrent(c), conn(con), oid("object-name"), oloc(1, 1), msg_len(len), ops(ops),
@@ -86,6 +90,8 @@ class MessengerClient {
       bufferptr ptr(msg_len);
       memset(ptr.c_str(), 0, msg_len);
       data.append(ptr);
+      send_stamps.resize(ops);
+      latencies.reserve(ops);
     }
     void *entry() override {
       lock.Lock();
@@ -96,10 +102,11 @@ class MessengerClient {
 	hobject_t hobj(oid, oloc.key, CEPH_NOSNAP, pgid.ps(), pgid.pool(),
 		       oloc.nspace);
 	spg_t spgid(pgid);
-        MOSDOp *m = new MOSDOp(client_inc, 0, hobj, spgid, 0, 0, 0);
+        MOSDOp *m = new MOSDOp(client_inc, i, hobj, spgid, 0, 0, 0);
         bufferlist msg_data(data);
         m->write(0, msg_len, msg_data);
         inflight++;
+        send_stamps[i] = Cycles::rdtsc();
         conn->send_message(m);
         //cerr << __func__ << " send m=" << m << std::endl;
       }
@@ -149,12 +156,24 @@ class MessengerClient {
     for (uint64_t i = 0; i < msgrs.size(); ++i)
       msgrs[i]->wait();
   }
+  vector<uint64_t> latencies() {
+    vector<uint64_t> all;
+    for (auto c : clients) {
+      Mutex::Locker l(c->lock);
+      all.insert(all.end(), c->latencies.begin(), c->latencies.end());
+    }
+    return all;
+  }
 };
 
 void MessengerClient::ClientDispatcher::ms_fast_dispatch(Message *m) {
+  uint64_t now = Cycles::rdtsc();
+  ceph_tid_t tid = m->get_tid();
   usleep(think_time);
   m->put();
   Mutex::Locker l(thread->lock);
+  if (tid < thread->send_stamps.size())
+    thread->latencies.push_back(now - thread->send_stamps[tid]);
   thread->inflight--;
   thread->cond.Signal();
 }
@@ -168,6 +187,15 @@ void usage(const string &name) {
   cerr << "       [ios]: how much messages sent for each client" << std::endl;
   cerr << "       [thinktime]: sleep time when do fast dispatching(match client logic)" << std::endl;
   cerr << "       [msg length]: message data bytes" << std::endl;
+  cerr << "       --cpu: also report the CPU time used per GB sent" << std::endl;
+}
+
+static double cpu_seconds()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0 +
+    ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
 }
 
 int main(int argc, char **argv)
@@ -181,6 +209,15 @@ int main(int argc, char **argv)
   common_init_finish(g_ceph_context);
   g_ceph_context->_conf.apply_changes(nullptr);
 
+  bool report_cpu = false;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_flag(args, i, "--cpu", (char*)NULL)) {
+      report_cpu = true;
+    } else {
+      ++i;
+    }
+  }
+
   if (args.size() < 6) {
     usage(argv[0]);
     return 1;
@@ -206,10 +243,24 @@ int main(int argc, char **argv)
 
   client.ready(concurrent, numjobs, ios, len);
   Cycles::init();
+  double cpu_start = cpu_seconds();
   uint64_t start = Cycles::rdtsc();
   client.start();
   uint64_t stop = Cycles::rdtsc();
+  double cpu = cpu_seconds() - cpu_start;
   cerr << " Total op " << ios << " run time " << Cycles::to_microseconds(stop - start) << "us." << std::endl;
+  vector<uint64_t> lat = client.latencies();
+  if (!lat.empty()) {
+    std::sort(lat.begin(), lat.end());
+    cerr << " Latency p50 " << Cycles::to_microseconds(lat[lat.size() / 2])
+	 << "us p99 " << Cycles::to_microseconds(lat[lat.size() * 99 / 100])
+	 << "us" << std::endl;
+  }
+  if (report_cpu) {
+    double gb = (double)numjobs * ios * len / (1ull << 30);
+    cerr << " CPU time " << cpu << "s for " << gb << " GB sent, "
+	 << (gb > 0 ? cpu / gb : 0) << " CPU s/GB" << std::endl;
+  }
 
   return 0;
 }
@@ -0,0 +1,229 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <iostream>
+
+using namespace std;
+
+#include "auth/DummyAuth.h"
+#include "common/ceph_argparse.h"
+#include "common/Cycles.h"
+#include "common/Cond.h"
+#include "common/Mutex.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "msg/Messenger.h"
+#include "messages/MPing.h"
+#include "worker_counter.h"
+
+// Sends messages with compressible data from a client to a server
+// messenger in the same process, once for each compression algorithm
+// given ("none" turns on-wire compression off), and reports the
+// throughput, the compression ratio and the time spent compressing and
+// decompressing.  The server checks that every message arrives with its
+// data intact.
+
+class ServerDispatcher : public Dispatcher {
+  const uint32_t expected_crc;
+ public:
+  std::atomic<uint64_t> bad = {0};
+
+  explicit ServerDispatcher(uint32_t crc)
+    : Dispatcher(g_ceph_context), expected_crc(crc) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    if (m->get_data().crc32c(0) != expected_crc) {
+      ++bad;
+    }
+    m->get_connection()->send_message(new MPing);
+    m->put();
+  }
+  bool ms_dispatch(Message *m) override { return true; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+};
+
+class ClientDispatcher : public Dispatcher {
+ public:
+  Mutex lock;
+  Cond cond;
+  int inflight = 0;
+
+  ClientDispatcher()
+    : Dispatcher(g_ceph_context), lock("ClientDispatcher::lock") {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    m->put();
+    Mutex::Locker l(lock);
+    --inflight;
+    cond.Signal();
+  }
+  bool ms_dispatch(Message *m) override { return true; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+};
+
+static bool run(DummyAuthClientServer& auth, const string& alg, int count,
+		int concurrency, const bufferlist& data)
+{
+  g_ceph_context->_conf.set_val("ms_async_compress_mode",
+				alg == "none" ? "none" : "force");
+  if (alg != "none") {
+    g_ceph_context->_conf.set_val("ms_async_compress_algorithm", alg);
+  }
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  ServerDispatcher server_dispatcher(data.crc32c(0));
+  ClientDispatcher client_dispatcher;
+  Messenger *server = Messenger::create(g_ceph_context, "async+posix",
+					entity_name_t::OSD(0), "server",
+					getpid(), 0);
+  server->set_default_policy(Messenger::Policy::stateless_server(0));
+  server->set_auth_client(&auth);
+  server->set_auth_server(&auth);
+  server->set_require_authorizer(false);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1:0");
+  server->bind(bind_addr);
+  server->add_dispatcher_head(&server_dispatcher);
+  server->start();
+
+  Messenger *client = Messenger::create(g_ceph_context, "async+posix",
+					entity_name_t::CLIENT(0), "client",
+					getpid() + 1, 0);
+  client->set_default_policy(Messenger::Policy::lossless_client(0));
+  client->set_auth_client(&auth);
+  client->set_auth_server(&auth);
+  client->add_dispatcher_head(&client_dispatcher);
+  client->start();
+  ConnectionRef conn = client->connect_to_osd(server->get_myaddrs());
+
+  auto counter = [](const char *name) {
+    return worker_counter(g_ceph_context, name);
+  };
+  const uint64_t in_bytes = counter("msgr_compress_in_bytes");
+  const uint64_t out_bytes = counter("msgr_compress_out_bytes");
+  const uint64_t compress_ns = counter("msgr_compress_time");
+  const uint64_t decompress_ns = counter("msgr_decompress_time");
+  uint64_t start = Cycles::rdtsc();
+  for (int i = 0; i < count; i++) {
+    Mutex::Locker l(client_dispatcher.lock);
+    while (client_dispatcher.inflight >= concurrency) {
+      client_dispatcher.cond.Wait(client_dispatcher.lock);
+    }
+    ++client_dispatcher.inflight;
+    MPing *m = new MPing;
+    m->set_data(data);
+    conn->send_message(m);
+  }
+  {
+    Mutex::Locker l(client_dispatcher.lock);
+    while (client_dispatcher.inflight) {
+      client_dispatcher.cond.Wait(client_dispatcher.lock);
+    }
+  }
+  uint64_t stop = Cycles::rdtsc();
+  double us = Cycles::to_microseconds(stop - start);
+
+  client->shutdown();
+  client->wait();
+  server->shutdown();
+  server->wait();
+  delete client;
+  delete server;
+
+  const uint64_t compressed = counter("msgr_compress_in_bytes") - in_bytes;
+  const uint64_t wire = counter("msgr_compress_out_bytes") - out_bytes;
+  cerr << " " << alg << ": " << us << "us, "
+       << (us > 0 ? (double)data.length() * count / us : 0) << " MB/s, ratio "
+       << (compressed ? (double)wire / compressed : 1.0) << ", compress "
+       << (counter("msgr_compress_time") - compress_ns) / 1000
+       << "us, decompress "
+       << (counter("msgr_decompress_time") - decompress_ns) / 1000
+       << "us" << std::endl;
+  if (server_dispatcher.bad) {
+    cerr << " " << server_dispatcher.bad << " messages arrived corrupted"
+	 << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void usage(const string &name) {
+  cerr << "Usage: " << name << " [messages] [concurrency] [msg length] [algorithms...]" << std::endl;
+  cerr << "       [messages]: number of messages sent in each run" << std::endl;
+  cerr << "       [concurrency]: the max inflight messages" << std::endl;
+  cerr << "       [msg length]: message data bytes, e.g. 65536" << std::endl;
+  cerr << "       [algorithms]: one run per value of ms_async_compress_algorithm, or none, e.g. none snappy lz4 zstd" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  g_ceph_context->_conf.set_val("auth_cluster_required", "none");
+  g_ceph_context->_conf.set_val("auth_service_required", "none");
+  g_ceph_context->_conf.set_val("auth_client_required", "none");
+  common_init_finish(g_ceph_context);
+
+  if (args.size() < 4) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const int count = atoi(args[0]);
+  const int concurrency = std::max(1, atoi(args[1]));
+  const unsigned len = atoi(args[2]);
+
+  // text-like data: a few bits of entropy per byte
+  bufferlist data;
+  while (data.length() < len) {
+    unsigned n = std::min<unsigned>(CEPH_PAGE_SIZE, len - data.length());
+    bufferptr bp(n);
+    for (unsigned i = 0; i < n; i++) {
+      bp.c_str()[i] = 'a' + rand() % 16;
+    }
+    data.append(std::move(bp));
+  }
+
+  cerr << " messages " << count << std::endl;
+  cerr << " concurrency " << concurrency << std::endl;
+  cerr << " message data bytes " << len << std::endl;
+
+  DummyAuthClientServer auth(g_ceph_context);
+  auth.auth_registry.refresh_config();
+
+  Cycles::init();
+  for (size_t i = 3; i < args.size(); i++) {
+    if (!run(auth, args[i], count, concurrency, data)) {
+      return 1;
+    }
+  }
+  return 0;
+}
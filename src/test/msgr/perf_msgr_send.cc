@@ -0,0 +1,217 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+
+#include "auth/DummyAuth.h"
+#include "common/ceph_argparse.h"
+#include "common/Cycles.h"
+#include "common/Cond.h"
+#include "common/Mutex.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "msg/Messenger.h"
+#include "messages/MPing.h"
+#include "worker_counter.h"
+
+// Has several threads send small messages on one connection at once,
+// with ms_async_lockless_send off and then on, and reports how long
+// send_message() took on average and how long it took to deliver
+// everything.  With the lock, the senders contend with each other and
+// with the event thread for the connection's write_lock; the messenger's
+// counters show how long they waited for it, and how many lockless
+// sends went through the queue, per wakeup, or fell back to the lock.
+
+class ServerDispatcher : public Dispatcher {
+ public:
+  Mutex lock;
+  Cond cond;
+  uint64_t received = 0;
+
+  ServerDispatcher()
+    : Dispatcher(g_ceph_context), lock("ServerDispatcher::lock") {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    m->put();
+    Mutex::Locker l(lock);
+    ++received;
+    cond.Signal();
+  }
+  bool ms_dispatch(Message *m) override { return true; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+};
+
+class ClientDispatcher : public Dispatcher {
+ public:
+  ClientDispatcher() : Dispatcher(g_ceph_context) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_fast_dispatch(Message *m) override { m->put(); }
+  bool ms_dispatch(Message *m) override { return true; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+};
+
+static void run(DummyAuthClientServer& auth, bool lockless, int threads,
+		int count)
+{
+  g_ceph_context->_conf.set_val("ms_async_lockless_send",
+				lockless ? "true" : "false");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  ServerDispatcher server_dispatcher;
+  ClientDispatcher client_dispatcher;
+  Messenger *server = Messenger::create(g_ceph_context, "async+posix",
+					entity_name_t::OSD(0), "server",
+					getpid(), 0);
+  server->set_default_policy(Messenger::Policy::stateless_server(0));
+  server->set_auth_client(&auth);
+  server->set_auth_server(&auth);
+  server->set_require_authorizer(false);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1:0");
+  server->bind(bind_addr);
+  server->add_dispatcher_head(&server_dispatcher);
+  server->start();
+
+  Messenger *client = Messenger::create(g_ceph_context, "async+posix",
+					entity_name_t::CLIENT(0), "client",
+					getpid() + 1, 0);
+  client->set_default_policy(Messenger::Policy::lossless_client(0));
+  client->set_auth_client(&auth);
+  client->set_auth_server(&auth);
+  client->add_dispatcher_head(&client_dispatcher);
+  client->start();
+  ConnectionRef conn = client->connect_to_osd(server->get_myaddrs());
+
+  // the workers are shared by both runs, so only count this one
+  const char *counters[] = {
+    "msgr_send_lockless", "msgr_send_lockless_full",
+    "msgr_send_lockless_wakeups", "msgr_send_lock_wait_time",
+  };
+  map<string, uint64_t> before;
+  for (auto c : counters) {
+    before[c] = worker_counter(g_ceph_context, c);
+  }
+
+  // cycles spent inside send_message(), summed over the senders
+  std::atomic<uint64_t> send_cycles = {0};
+  uint64_t start = Cycles::rdtsc();
+  vector<std::thread> senders;
+  for (int t = 0; t < threads; t++) {
+    senders.emplace_back([&] {
+	uint64_t cycles = 0;
+	for (int i = 0; i < count; i++) {
+	  MPing *m = new MPing;
+	  uint64_t s = Cycles::rdtsc();
+	  conn->send_message(m);
+	  cycles += Cycles::rdtsc() - s;
+	}
+	send_cycles += cycles;
+      });
+  }
+  for (auto& t : senders) {
+    t.join();
+  }
+  {
+    const uint64_t total = (uint64_t)threads * count;
+    Mutex::Locker l(server_dispatcher.lock);
+    while (server_dispatcher.received < total) {
+      server_dispatcher.cond.Wait(server_dispatcher.lock);
+    }
+  }
+  uint64_t stop = Cycles::rdtsc();
+  map<string, uint64_t> delta;
+  for (auto c : counters) {
+    delta[c] = worker_counter(g_ceph_context, c) - before[c];
+  }
+
+  client->shutdown();
+  client->wait();
+  server->shutdown();
+  server->wait();
+  delete client;
+  delete server;
+
+  const uint64_t total = (uint64_t)threads * count;
+  cerr << " ms_async_lockless_send " << (lockless ? "on" : "off")
+       << ": send_message avg "
+       << Cycles::to_nanoseconds(send_cycles / std::max<uint64_t>(total, 1))
+       << "ns, delivered " << total << " messages in "
+       << Cycles::to_microseconds(stop - start) << "us" << std::endl;
+  const uint64_t locked = total - delta["msgr_send_lockless"];
+  cerr << "   " << locked << " sends took write_lock, waiting "
+       << delta["msgr_send_lock_wait_time"] / std::max<uint64_t>(locked, 1)
+       << "ns on average";
+  if (lockless) {
+    cerr << "; " << delta["msgr_send_lockless"] << " queued in "
+	 << delta["msgr_send_lockless_wakeups"] << " wakeups, "
+	 << delta["msgr_send_lockless_full"] << " found the queue full";
+  }
+  cerr << std::endl;
+}
+
+void usage(const string &name) {
+  cerr << "Usage: " << name << " [threads] [messages]" << std::endl;
+  cerr << "       [threads]: number of threads sending on the connection" << std::endl;
+  cerr << "       [messages]: number of messages each thread sends" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  g_ceph_context->_conf.set_val("auth_cluster_required", "none");
+  g_ceph_context->_conf.set_val("auth_service_required", "none");
+  g_ceph_context->_conf.set_val("auth_client_required", "none");
+  common_init_finish(g_ceph_context);
+
+  if (args.size() < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const int threads = std::max(1, atoi(args[0]));
+  const int count = std::max(1, atoi(args[1]));
+
+  cerr << " threads " << threads << std::endl;
+  cerr << " messages per thread " << count << std::endl;
+
+  DummyAuthClientServer auth(g_ceph_context);
+  auth.auth_registry.refresh_config();
+
+  Cycles::init();
+  run(auth, false, threads, count);
+  run(auth, true, threads, count);
+  return 0;
+}
@@ -18,23 +18,36 @@
 #include <stdint.h>
 #include <string>
 #include <unistd.h>
+#include <atomic>
 #include <iostream>
 
 using namespace std;
 
+#include "auth/DummyAuth.h"
 #include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "common/Cond.h"
+#include "common/Cycles.h"
 #include "common/debug.h"
 #include "common/WorkQueue.h"
 #include "global/global_init.h"
+#include "include/stringify.h"
 #include "msg/Messenger.h"
+#include "messages/MPing.h"
 #include "messages/MOSDOp.h"
 #include "messages/MOSDOpReply.h"
+#include "worker_counter.h"
 
 class ServerDispatcher : public Dispatcher {
   uint64_t think_time;
   ThreadPool op_tp;
   class OpWQ : public ThreadPool::WorkQueue<Message> {
     list<Message*> messages;
+    // time the worker threads spend in send_message, which is where they
+    // contend on a shared connection
+    static constexpr uint64_t report_interval = 100000;
+    std::atomic<uint64_t> sends = {0};
+    std::atomic<uint64_t> send_cycles = {0};
 
    public:
     OpWQ(time_t timeout, time_t suicide_timeout, ThreadPool *tp)
@@ -60,7 +73,26 @@ class ServerDispatcher : public Dispatcher {
     void _process(Message *m, ThreadPool::TPHandle &handle) override {
       MOSDOp *osd_op = static_cast<MOSDOp*>(m);
       MOSDOpReply *reply = new MOSDOpReply(osd_op, 0, 0, 0, false);
+      uint64_t start = Cycles::rdtsc();
       m->get_connection()->send_message(reply);
+      uint64_t cycles = send_cycles += Cycles::rdtsc() - start;
+      if (++sends % report_interval == 0) {
+        send_cycles -= cycles;
+        cerr << " send_message avg "
+             << Cycles::to_nanoseconds(cycles) / report_interval << "ns"
+             << ", rx data buffers allocated "
+             << worker_counter(g_ceph_context, "msgr_rx_buffer_allocs")
+             << " reused "
+             << worker_counter(g_ceph_context, "msgr_rx_buffer_reuses")
+             << ", busy poll hits "
+             << worker_counter(g_ceph_context, "msgr_busy_poll_hits")
+             << " misses "
+             << worker_counter(g_ceph_context, "msgr_busy_poll_misses")
+             << " idle "
+             << worker_counter(g_ceph_context, "msgr_busy_poll_idle_time") / 1000
+             << "us"
+             << std::endl;
+      }
       m->put();
     }
     void _process_finish(Message *m) override { }
@@ -130,11 +162,119 @@ class MessengerServer {
   }
 };
 
+class SinkDispatcher : public Dispatcher {
+ public:
+  Mutex lock;
+  Cond cond;
+  uint64_t received = 0;
+
+  explicit SinkDispatcher(CephContext *cct)
+    : Dispatcher(cct), lock("SinkDispatcher::lock") {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    // drops the data buffer, back into the pool if there is one
+    m->put();
+    Mutex::Locker l(lock);
+    ++received;
+    cond.Signal();
+  }
+  bool ms_dispatch(Message *m) override { return true; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+};
+
+// Sends count messages with len bytes of data over loopback, at most
+// window of them in flight, and reports how long they took to read and
+// how many data buffers were allocated.  Each run has a context of its
+// own, since the workers size their rx buffer pool when they are created.
+static void run_rx_buffer_pool(uint64_t pool_size, int count, unsigned len)
+{
+  constexpr int window = 128;
+  CephInitParameters iparams(CEPH_ENTITY_TYPE_CLIENT);
+  CephContext *cct = common_preinit(iparams, CODE_ENVIRONMENT_UTILITY,
+				    CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  cct->_conf.set_val("ms_async_rx_buffer_pool_size", stringify(pool_size));
+  cct->_conf.apply_changes(nullptr);
+  cct->_log->start();
+  common_init_finish(cct);
+
+  DummyAuthClientServer auth(cct);
+  auth.auth_registry.refresh_config();
+  SinkDispatcher sink(cct);
+  Messenger *server = Messenger::create(cct, "async+posix",
+					entity_name_t::OSD(0), "server",
+					getpid(), 0);
+  server->set_default_policy(Messenger::Policy::stateless_server(0));
+  server->set_auth_client(&auth);
+  server->set_auth_server(&auth);
+  server->set_require_authorizer(false);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1:0");
+  server->bind(bind_addr);
+  server->add_dispatcher_head(&sink);
+  server->start();
+
+  Messenger *client = Messenger::create(cct, "async+posix",
+					entity_name_t::CLIENT(0), "client",
+					getpid() + 1, 0);
+  client->set_default_policy(Messenger::Policy::lossless_client(0));
+  client->set_auth_client(&auth);
+  client->set_auth_server(&auth);
+  client->start();
+  ConnectionRef conn = client->connect_to_osd(server->get_myaddrs());
+
+  bufferptr bp(buffer::create_page_aligned(len));
+  bp.zero();
+  bufferlist data;
+  data.append(bp);
+  uint64_t start = Cycles::rdtsc();
+  for (int i = 0; i < count; i++) {
+    {
+      Mutex::Locker l(sink.lock);
+      while (i - sink.received >= window) {
+	sink.cond.Wait(sink.lock);
+      }
+    }
+    MPing *m = new MPing;
+    m->set_data(data);
+    conn->send_message(m);
+  }
+  {
+    Mutex::Locker l(sink.lock);
+    while (sink.received < (uint64_t)count) {
+      sink.cond.Wait(sink.lock);
+    }
+  }
+  uint64_t stop = Cycles::rdtsc();
+  const uint64_t allocs = worker_counter(cct, "msgr_rx_buffer_allocs");
+  const uint64_t reuses = worker_counter(cct, "msgr_rx_buffer_reuses");
+
+  client->shutdown();
+  client->wait();
+  server->shutdown();
+  server->wait();
+  delete client;
+  delete server;
+  cct->put();
+
+  cerr << " ms_async_rx_buffer_pool_size " << pool_size << ": read "
+       << count << " messages in " << Cycles::to_microseconds(stop - start)
+       << "us, rx data buffers allocated " << allocs << " reused " << reuses
+       << std::endl;
+}
+
 void usage(const string &name) {
   cerr << "Usage: " << name << " [bind ip:port] [server worker threads] [thinktime us]" << std::endl;
   cerr << "       [bind ip:port]: The ip:port pair to bind, client need to specify this pair to connect" << std::endl;
   cerr << "       [server worker threads]: threads will process incoming messages and reply(matching pg threads)" << std::endl;
   cerr << "       [thinktime]: sleep time when do dispatching(match fast dispatch logic in OSD.cc)" << std::endl;
+  cerr << "   or: " << name << " --rx-buffer-pool [messages] [data bytes]" << std::endl;
+  cerr << "       reads messages over loopback with ms_async_rx_buffer_pool_size 0, then with its configured value (64MB if unset)" << std::endl;
 }
 
 int main(int argc, char **argv)
@@ -148,6 +288,16 @@ int main(int argc, char **argv)
   common_init_finish(g_ceph_context);
   g_ceph_context->_conf.apply_changes(nullptr);
 
+  if (args.size() == 3 && string(args[0]) == "--rx-buffer-pool") {
+    const int count = std::max(1, atoi(args[1]));
+    const unsigned len = std::max(1, atoi(args[2]));
+    uint64_t pool_size = g_ceph_context->_conf.get_val<Option::size_t>(
+      "ms_async_rx_buffer_pool_size");
+    Cycles::init();
+    run_rx_buffer_pool(0, count, len);
+    run_rx_buffer_pool(pool_size ? pool_size : 64 << 20, count, len);
+    return 0;
+  }
   if (args.size() < 3) {
     usage(argv[0]);
     return 1;
@@ -165,6 +315,7 @@ int main(int argc, char **argv)
   cerr << "       worker threads " << worker_threads << std::endl;
   cerr << "       thinktime(us) " << think_time << std::endl;
 
+  Cycles::init();
   MessengerServer server(public_msgr_type, args[0], worker_threads, think_time);
   server.start();
 
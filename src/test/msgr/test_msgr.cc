@@ -24,6 +24,7 @@
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "common/ceph_argparse.h"
+#include "include/stringify.h"
 #include "global/global_init.h"
 #include "msg/Dispatcher.h"
 #include "msg/msg_types.h"
@@ -44,6 +45,7 @@ typedef boost::mt11213b gen_type;
 #include "include/ceph_assert.h"
 
 #include "auth/DummyAuth.h"
+#include "worker_counter.h"
 
 #define dout_subsys ceph_subsys_ms
 #undef dout_prefix
@@ -962,6 +964,375 @@ TEST_P(MessengerTest, SimpleMsgr2Test) {
   server_msgr->wait();
 }
 
+class StripeDispatcher : public Dispatcher {
+ public:
+  Mutex lock;
+  Cond cond;
+  const bool is_server;
+  const uint32_t expected_crc;
+  unsigned received = 0;
+  unsigned bad = 0;
+  unsigned accepts = 0;
+
+  StripeDispatcher(bool s, uint32_t crc)
+    : Dispatcher(g_ceph_context), lock("StripeDispatcher::lock"),
+      is_server(s), expected_crc(crc) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_handle_fast_accept(Connection *con) override {
+    Mutex::Locker l(lock);
+    ++accepts;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    if (is_server) {
+      // echo the data, striped the other way
+      MPing *reply = new MPing();
+      reply->set_data(m->get_data());
+      m->get_connection()->send_message(reply);
+    }
+    Mutex::Locker l(lock);
+    if (m->get_data().crc32c(0) != expected_crc) {
+      ++bad;
+    }
+    ++received;
+    cond.Signal();
+    m->put();
+  }
+  bool ms_dispatch(Message *m) override { return false; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+};
+
+TEST_P(MessengerTest, StripeTest) {
+  g_ceph_context->_conf.set_val("ms_async_stripe_connections", "4");
+  g_ceph_context->_conf.set_val("ms_async_stripe_min_size", "65536");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  // a partial last page, so the last stripe is short
+  bufferlist data;
+  while (data.length() < (1 << 20) + 100) {
+    bufferptr bp(CEPH_PAGE_SIZE);
+    for (unsigned i = 0; i < bp.length(); i++) {
+      bp.c_str()[i] = rand();
+    }
+    data.append(std::move(bp));
+  }
+  data.splice((1 << 20) + 100, data.length() - (1 << 20) - 100);
+  const uint32_t crc = data.crc32c(0);
+
+  StripeDispatcher cli_dispatcher(false, crc), srv_dispatcher(true, crc);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1:0");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  const unsigned count = 8;
+  for (unsigned i = 0; i < count; i++) {
+    MPing *m = new MPing();
+    m->set_data(data);
+    ASSERT_EQ(conn->send_message(m), 0);
+  }
+  {
+    Mutex::Locker l(cli_dispatcher.lock);
+    while (cli_dispatcher.received < count)
+      cli_dispatcher.cond.Wait(cli_dispatcher.lock);
+    ASSERT_EQ(0u, cli_dispatcher.bad);
+  }
+  {
+    Mutex::Locker l(srv_dispatcher.lock);
+    ASSERT_EQ(count, srv_dispatcher.received);
+    ASSERT_EQ(0u, srv_dispatcher.bad);
+    // the stripe lanes are not sessions of their own
+    ASSERT_EQ(1u, srv_dispatcher.accepts);
+  }
+
+  client_msgr->shutdown();
+  client_msgr->wait();
+  server_msgr->shutdown();
+  server_msgr->wait();
+  g_ceph_context->_conf.rm_val("ms_async_stripe_connections");
+  g_ceph_context->_conf.rm_val("ms_async_stripe_min_size");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
+class ThrottleDispatcher : public Dispatcher {
+ public:
+  Mutex lock;
+  Cond cond;
+  bool blocked = false;  ///< the dispatch thread is held in ms_dispatch
+  bool open = false;     ///< let it go
+  unsigned read_greedy = 0, read_other = 0;
+  unsigned dispatched = 0;
+  const entity_name_t other;
+
+  explicit ThrottleDispatcher(entity_name_t other)
+    : Dispatcher(g_ceph_context), lock("ThrottleDispatcher::lock"),
+      other(other) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override { return false; }
+  // called once a message got past the dispatch throttle
+  void ms_fast_preprocess(Message *m) override {
+    Mutex::Locker l(lock);
+    if (m->get_source() == other) {
+      ++read_other;
+    } else {
+      ++read_greedy;
+    }
+    cond.SignalAll();
+  }
+  bool ms_dispatch(Message *m) override {
+    Mutex::Locker l(lock);
+    // the message keeps its share of the throttle until we return
+    blocked = true;
+    cond.SignalAll();
+    while (!open) {
+      cond.Wait(lock);
+    }
+    ++dispatched;
+    cond.SignalAll();
+    m->put();
+    return true;
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+};
+
+TEST_P(MessengerTest, DispatchThrottlePerConnectionTest) {
+  // the greedy client alone could fill the throttler twice over
+  const uint64_t per_conn = 200000, msg_size = 65536;
+  const unsigned greedy_count = 32, other_count = 2;
+  g_ceph_context->_conf.set_val("ms_dispatch_throttle_bytes", "1048576");
+  g_ceph_context->_conf.set_val("ms_dispatch_throttle_bytes_per_connection",
+				stringify(per_conn));
+  g_ceph_context->_conf.apply_changes(nullptr);
+  // the dispatch queue reads these when it is created
+  delete server_msgr;
+  server_msgr = Messenger::create(g_ceph_context, string(GetParam()), entity_name_t::OSD(0), "server", getpid(), 0);
+  server_msgr->set_default_policy(Messenger::Policy::stateless_server(0));
+  server_msgr->set_auth_client(&dummy_auth);
+  server_msgr->set_auth_server(&dummy_auth);
+  server_msgr->set_require_authorizer(false);
+  Messenger *other_msgr = Messenger::create(g_ceph_context, string(GetParam()), entity_name_t::CLIENT(1), "other", getpid(), 0);
+  other_msgr->set_default_policy(Messenger::Policy::lossy_client(0));
+  other_msgr->set_auth_client(&dummy_auth);
+  other_msgr->set_auth_server(&dummy_auth);
+
+  ThrottleDispatcher srv_dispatcher(entity_name_t::CLIENT(1));
+  FakeDispatcher cli_dispatcher(false), other_dispatcher(false);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1:0");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+  other_msgr->add_dispatcher_head(&other_dispatcher);
+  other_msgr->start();
+
+  bufferlist data;
+  data.append_zero(msg_size);
+  utime_t t;
+  t += 1000*1000*500;
+  ConnectionRef greedy = client_msgr->connect_to(server_msgr->get_mytype(),
+						 server_msgr->get_myaddrs());
+  for (unsigned i = 0; i < greedy_count; i++) {
+    MPing *m = new MPing();
+    m->set_data(data);
+    ASSERT_EQ(greedy->send_message(m), 0);
+  }
+  {
+    Mutex::Locker l(srv_dispatcher.lock);
+    while (!srv_dispatcher.blocked)
+      srv_dispatcher.cond.Wait(srv_dispatcher.lock);
+  }
+
+  // nothing is dispatched now, yet the other client still gets its
+  // messages read
+  ConnectionRef conn = other_msgr->connect_to(server_msgr->get_mytype(),
+					      server_msgr->get_myaddrs());
+  for (unsigned i = 0; i < other_count; i++) {
+    MPing *m = new MPing();
+    m->set_data(data);
+    ASSERT_EQ(conn->send_message(m), 0);
+  }
+  unsigned read_other, read_greedy;
+  {
+    Mutex::Locker l(srv_dispatcher.lock);
+    for (int i = 0; i < 20 && srv_dispatcher.read_other < other_count; i++)
+      srv_dispatcher.cond.WaitInterval(srv_dispatcher.lock, t);
+    read_other = srv_dispatcher.read_other;
+    read_greedy = srv_dispatcher.read_greedy;
+    srv_dispatcher.open = true;
+    srv_dispatcher.cond.SignalAll();
+  }
+  ASSERT_EQ(other_count, read_other);
+  // while the greedy one stopped at its share
+  ASSERT_LE(read_greedy, per_conn / msg_size + 1);
+
+  {
+    Mutex::Locker l(srv_dispatcher.lock);
+    while (srv_dispatcher.dispatched < greedy_count + other_count)
+      srv_dispatcher.cond.Wait(srv_dispatcher.lock);
+    ASSERT_EQ(greedy_count, srv_dispatcher.read_greedy);
+  }
+
+  client_msgr->shutdown();
+  client_msgr->wait();
+  other_msgr->shutdown();
+  other_msgr->wait();
+  server_msgr->shutdown();
+  server_msgr->wait();
+  delete other_msgr;
+  g_ceph_context->_conf.rm_val("ms_dispatch_throttle_bytes");
+  g_ceph_context->_conf.rm_val("ms_dispatch_throttle_bytes_per_connection");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
+class CompressDispatcher : public Dispatcher {
+ public:
+  Mutex lock;
+  Cond cond;
+  uint32_t expected_crc = 0;
+  unsigned received = 0;
+  unsigned bad = 0;
+  int con_mode = CEPH_CON_MODE_UNKNOWN;
+
+  CompressDispatcher()
+    : Dispatcher(g_ceph_context), lock("CompressDispatcher::lock") {}
+  void reset(uint32_t crc) {
+    Mutex::Locker l(lock);
+    expected_crc = crc;
+    received = bad = 0;
+    con_mode = CEPH_CON_MODE_UNKNOWN;
+  }
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    Mutex::Locker l(lock);
+    if (m->get_data().crc32c(0) != expected_crc) {
+      ++bad;
+    }
+    con_mode = m->get_connection()->get_con_mode();
+    ++received;
+    cond.Signal();
+    m->put();
+  }
+  bool ms_dispatch(Message *m) override { return false; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+};
+
+TEST_P(MessengerTest, CompressTest) {
+  g_ceph_context->_conf.set_val("ms_async_compress_mode", "force");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  CompressDispatcher cli_dispatcher, srv_dispatcher;
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1:0");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  const unsigned count = 8;
+  bufferlist text, noise;
+  while (text.length() < 256 * 1024) {
+    text.append("the quick brown fox jumps over the lazy dog ");
+  }
+  {
+    bufferptr bp(64 * 1024);
+    for (unsigned i = 0; i < bp.length(); i++) {
+      bp.c_str()[i] = rand();
+    }
+    noise.append(std::move(bp));
+  }
+  // the client and server share their workers, and only the client
+  // sends anything compressible
+  auto counter = [](const char *name) {
+    return worker_counter(g_ceph_context, name);
+  };
+  // sends count messages with data on a new connection, returns the
+  // bytes compressed and the segments sent as is
+  auto send = [&](const bufferlist& data, int expected_mode,
+		  uint64_t *compressed, uint64_t *rejected) {
+    const uint64_t in_bytes = counter("msgr_compress_in_bytes");
+    const uint64_t decompressed = counter("msgr_decompress_out_bytes");
+    const uint64_t as_is = counter("msgr_compress_rejected");
+    srv_dispatcher.reset(data.crc32c(0));
+    ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+						 server_msgr->get_myaddrs());
+    for (unsigned i = 0; i < count; i++) {
+      MPing *m = new MPing();
+      m->set_data(data);
+      ASSERT_EQ(conn->send_message(m), 0);
+    }
+    {
+      Mutex::Locker l(srv_dispatcher.lock);
+      while (srv_dispatcher.received < count)
+	srv_dispatcher.cond.Wait(srv_dispatcher.lock);
+      ASSERT_EQ(0u, srv_dispatcher.bad);
+      ASSERT_EQ(expected_mode, srv_dispatcher.con_mode);
+    }
+    conn->mark_down();
+    *compressed = counter("msgr_compress_in_bytes") - in_bytes;
+    *rejected = counter("msgr_compress_rejected") - as_is;
+    ASSERT_EQ(*compressed, counter("msgr_decompress_out_bytes") - decompressed);
+  };
+
+  uint64_t compressed, rejected;
+  // crc mode
+  send(text, CEPH_CON_MODE_CRC, &compressed, &rejected);
+  ASSERT_EQ(count * text.length(), compressed);
+  // what does not shrink is sent as is
+  send(noise, CEPH_CON_MODE_CRC, &compressed, &rejected);
+  ASSERT_EQ(0u, compressed);
+  ASSERT_EQ(count, rejected);
+
+  // secure mode only compresses when asked to
+  dummy_auth.secure = true;
+  send(text, CEPH_CON_MODE_SECURE, &compressed, &rejected);
+  ASSERT_EQ(0u, compressed);
+  ASSERT_EQ(0u, rejected);
+  g_ceph_context->_conf.set_val("ms_async_compress_secure", "true");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  send(text, CEPH_CON_MODE_SECURE, &compressed, &rejected);
+  ASSERT_EQ(count * text.length(), compressed);
+  dummy_auth.secure = false;
+
+  // a peer without the feature bit gets everything uncompressed
+  g_ceph_context->_conf.set_val("ms_inject_msgr2_features_off",
+				stringify(CEPH_MSGR2_FEATURE_COMPRESSION));
+  g_ceph_context->_conf.apply_changes(nullptr);
+  send(text, CEPH_CON_MODE_CRC, &compressed, &rejected);
+  ASSERT_EQ(0u, compressed);
+  ASSERT_EQ(0u, rejected);
+
+  client_msgr->shutdown();
+  client_msgr->wait();
+  server_msgr->shutdown();
+  server_msgr->wait();
+  g_ceph_context->_conf.rm_val("ms_async_compress_mode");
+  g_ceph_context->_conf.rm_val("ms_async_compress_secure");
+  g_ceph_context->_conf.rm_val("ms_inject_msgr2_features_off");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
 TEST_P(MessengerTest, NameAddrTest) {
   FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
   entity_addr_t bind_addr;
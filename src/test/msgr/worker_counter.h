@@ -0,0 +1,40 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_TEST_MSGR_WORKER_COUNTER_H
+#define CEPH_TEST_MSGR_WORKER_COUNTER_H
+
+#include <string>
+
+#include "common/ceph_context.h"
+#include "common/perf_counters_collection.h"
+
+// sum of a counter over the async messenger workers of cct
+static inline uint64_t worker_counter(CephContext *cct,
+				      const std::string& name)
+{
+  uint64_t sum = 0;
+  cct->get_perfcounters_collection()->with_counters(
+    [&](const PerfCountersCollectionImpl::CounterMap& by_path) {
+      for (auto& [path, ref] : by_path) {
+	if (path.compare(0, 23, "AsyncMessenger::Worker-") == 0 &&
+	    path.size() > name.size() &&
+	    path.compare(path.size() - name.size() - 1, std::string::npos,
+			 "." + name) == 0) {
+	  sum += ref.data->u64;
+	}
+      }
+    });
+  return sum;
+}
+
+#endif
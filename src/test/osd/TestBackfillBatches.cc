@@ -0,0 +1,123 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <deque>
+
+#include <gtest/gtest.h>
+
+#include "include/stringify.h"
+#include "osd/BackfillBatches.h"
+
+static hobject_t make_oid(unsigned n)
+{
+  return hobject_t(object_t("obj" + stringify(n)), "", CEPH_NOSNAP, n, 1, "");
+}
+
+TEST(BackfillBatches, batch) {
+  BackfillBatches b;
+  b.new_round(3, 4096, 1 << 20);
+  hobject_t op;
+  // the first small object starts the batch's op, the next two join it
+  ASSERT_TRUE(b.start(make_oid(0), 100, &op));
+  ASSERT_EQ(make_oid(0), op);
+  ASSERT_FALSE(b.start(make_oid(1), 100, &op));
+  ASSERT_EQ(make_oid(0), op);
+  ASSERT_FALSE(b.start(make_oid(2), 100, &op));
+  // full, so the next one starts a new batch
+  ASSERT_TRUE(b.start(make_oid(3), 100, &op));
+  ASSERT_EQ(make_oid(3), op);
+  // a large object is its own op
+  ASSERT_TRUE(b.start(make_oid(4), 8192, &op));
+  ASSERT_EQ(make_oid(4), op);
+  ASSERT_EQ(2u, b.num_batches());
+
+  // the batch's op ends with its last object, in any order
+  ASSERT_FALSE(b.finish(make_oid(1), &op));
+  ASSERT_FALSE(b.finish(make_oid(0), &op));
+  ASSERT_TRUE(b.finish(make_oid(2), &op));
+  ASSERT_EQ(make_oid(0), op);
+  ASSERT_TRUE(b.finish(make_oid(4), &op));
+  ASSERT_EQ(make_oid(4), op);
+  ASSERT_TRUE(b.finish(make_oid(3), &op));
+  ASSERT_EQ(make_oid(3), op);
+  ASSERT_EQ(0u, b.num_batches());
+}
+
+TEST(BackfillBatches, bytes) {
+  BackfillBatches b;
+  b.new_round(64, 4096, 8192);
+  hobject_t op;
+  ASSERT_TRUE(b.start(make_oid(0), 4096, &op));
+  ASSERT_FALSE(b.start(make_oid(1), 4096, &op));
+  // osd_max_push_cost reached
+  ASSERT_TRUE(b.start(make_oid(2), 4096, &op));
+}
+
+TEST(BackfillBatches, done_batch) {
+  BackfillBatches b;
+  b.new_round(64, 4096, 1 << 20);
+  hobject_t op;
+  ASSERT_TRUE(b.start(make_oid(0), 100, &op));
+  // given up on right away, which finishes the op
+  ASSERT_TRUE(b.finish(make_oid(0), &op));
+  // so the next object can't join it
+  ASSERT_TRUE(b.start(make_oid(1), 100, &op));
+  ASSERT_EQ(make_oid(1), op);
+}
+
+TEST(BackfillBatches, unbatched) {
+  BackfillBatches b;
+  b.new_round(1, 4096, 1 << 20);
+  hobject_t op;
+  ASSERT_TRUE(b.start(make_oid(0), 100, &op));
+  ASSERT_TRUE(b.start(make_oid(1), 100, &op));
+  ASSERT_EQ(0u, b.num_batches());
+  // objects recovered outside of backfill finish their own op
+  ASSERT_TRUE(b.finish(make_oid(2), &op));
+  ASSERT_EQ(make_oid(2), op);
+}
+
+// mirror recover_backfill(): each round may start as many ops as are
+// left of osd_recovery_max_active, and pushes complete in between
+TEST(BackfillBatches, max_active) {
+  const unsigned max_active = 3;
+  BackfillBatches b;
+  unsigned active = 0;
+  unsigned next = 0;
+  std::deque<hobject_t> pushed;
+  for (unsigned round = 0; round < 100; ++round) {
+    b.new_round(64, 4096, 1 << 20);
+    unsigned ops = 0;
+    while (ops < max_active - active) {
+      hobject_t oid = make_oid(next);
+      // every tenth object is large
+      uint64_t size = next % 10 == 9 ? 65536 : 4096;
+      ++next;
+      hobject_t op;
+      if (b.start(oid, size, &op)) {
+	++ops;
+      }
+      pushed.push_back(oid);
+    }
+    active += ops;
+    ASSERT_LE(active, max_active);
+    // about half of the pushes complete before the next round
+    for (size_t n = pushed.size() / 2 + 1; n > 0 && !pushed.empty(); --n) {
+      hobject_t op;
+      if (b.finish(pushed.front(), &op)) {
+	ASSERT_GT(active, 0u);
+	--active;
+      }
+      pushed.pop_front();
+    }
+  }
+  while (!pushed.empty()) {
+    hobject_t op;
+    if (b.finish(pushed.front(), &op)) {
+      --active;
+    }
+    pushed.pop_front();
+  }
+  ASSERT_EQ(0u, active);
+  ASSERT_EQ(0u, b.num_batches());
+}
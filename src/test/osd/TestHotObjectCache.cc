@@ -0,0 +1,164 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "common/ceph_context.h"
+#include "common/perf_counters.h"
+#include "global/global_context.h"
+#include "osd/HotObjectCache.h"
+
+class HotObjectCacheTest : public ::testing::Test {
+protected:
+  std::string path;
+  HotObjectCache cache{g_ceph_context};
+
+  void SetUp() override {
+    char p[] = "/tmp/unittest_hot_object_cache.XXXXXX";
+    int fd = mkstemp(p);
+    ASSERT_GE(fd, 0);
+    ::close(fd);
+    path = p;
+    g_ceph_context->_conf.set_val("osd_hot_object_cache_shards", "1");
+  }
+  void TearDown() override {
+    cache.close();
+    ::unlink(path.c_str());
+    g_ceph_context->_conf.rm_val("osd_hot_object_cache_shards");
+  }
+
+  static hobject_t obj(const std::string& name) {
+    return hobject_t(object_t(name), "", CEPH_NOSNAP, 0, 1, "");
+  }
+  static bufferlist data(unsigned len, char c) {
+    bufferlist bl;
+    bl.append(std::string(len, c));
+    return bl;
+  }
+  uint64_t counter(int idx) {
+    return cache.get_logger()->get(idx);
+  }
+};
+
+TEST_F(HotObjectCacheTest, version)
+{
+  ASSERT_EQ(0, cache.open(path, 1 << 20));
+  hobject_t a = obj("a");
+  cache.promote(a, eversion_t(1, 1), data(8192, 'a'));
+
+  bufferlist bl;
+  ASSERT_EQ(100, cache.read(a, eversion_t(1, 1), 4000, 100, &bl));
+  ASSERT_TRUE(bl.contents_equal(data(100, 'a')));
+  bl.clear();
+  // reads are clipped to the object
+  ASSERT_EQ(192, cache.read(a, eversion_t(1, 1), 8000, 1000, &bl));
+  ASSERT_EQ(0, cache.read(a, eversion_t(1, 1), 9000, 1000, &bl));
+
+  // the object was modified: the copy is dropped, not served
+  ASSERT_EQ(-ENOENT, cache.read(a, eversion_t(1, 2), 0, 100, &bl));
+  ASSERT_EQ(1u, counter(l_hot_object_cache_stale));
+  ASSERT_EQ(-ENOENT, cache.read(a, eversion_t(1, 1), 0, 100, &bl));
+  ASSERT_EQ(0u, counter(l_hot_object_cache_objects));
+
+  // a concurrent promotion of an older version does not replace a newer
+  cache.promote(a, eversion_t(1, 3), data(4096, 'b'));
+  cache.promote(a, eversion_t(1, 2), data(4096, 'c'));
+  bl.clear();
+  ASSERT_EQ(4096, cache.read(a, eversion_t(1, 3), 0, 4096, &bl));
+  ASSERT_TRUE(bl.contents_equal(data(4096, 'b')));
+}
+
+TEST_F(HotObjectCacheTest, stale_slot)
+{
+  ASSERT_EQ(0, cache.open(path, 1 << 20));
+  hobject_t a = obj("a");
+  cache.promote(a, eversion_t(1, 1), data(4096, 'a'));
+
+  // scribble over the slot behind the cache's back, as a racing
+  // promotion would
+  int fd = ::open(path.c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(10, ::pwrite(fd, "xxxxxxxxxx", 10, 100));
+  ::close(fd);
+
+  bufferlist bl;
+  ASSERT_EQ(-ENOENT, cache.read(a, eversion_t(1, 1), 0, 4096, &bl));
+  ASSERT_EQ(1u, counter(l_hot_object_cache_stale));
+  ASSERT_EQ(0u, counter(l_hot_object_cache_bytes));
+}
+
+TEST_F(HotObjectCacheTest, lap)
+{
+  ASSERT_EQ(0, cache.open(path, 3 * 4096));
+  cache.promote(obj("a"), eversion_t(1, 1), data(4096, 'a'));
+  cache.promote(obj("b"), eversion_t(1, 1), data(4096, 'b'));
+  cache.promote(obj("c"), eversion_t(1, 1), data(4096, 'c'));
+  ASSERT_EQ(0u, counter(l_hot_object_cache_evict));
+
+  // the ring wraps and the oldest promotion goes
+  cache.promote(obj("d"), eversion_t(1, 1), data(4096, 'd'));
+  ASSERT_EQ(1u, counter(l_hot_object_cache_evict));
+  ASSERT_EQ(3u, counter(l_hot_object_cache_objects));
+  bufferlist bl;
+  ASSERT_EQ(-ENOENT, cache.read(obj("a"), eversion_t(1, 1), 0, 4096, &bl));
+  for (auto n : {"b", "c", "d"}) {
+    bl.clear();
+    ASSERT_EQ(4096, cache.read(obj(n), eversion_t(1, 1), 0, 4096, &bl));
+    ASSERT_TRUE(bl.contents_equal(data(4096, n[0])));
+  }
+}
+
+TEST(HotObjectCache, overwritten)
+{
+  // reserved [100, ...) on lap 3
+  ASSERT_FALSE(HotObjectCache::overwritten(3, 100, 3, 5000));
+  // wrapped, but not back to us yet
+  ASSERT_FALSE(HotObjectCache::overwritten(3, 100, 4, 50));
+  ASSERT_FALSE(HotObjectCache::overwritten(3, 100, 4, 100));
+  ASSERT_TRUE(HotObjectCache::overwritten(3, 100, 4, 101));
+  ASSERT_TRUE(HotObjectCache::overwritten(3, 100, 5, 0));
+}
+
+TEST_F(HotObjectCacheTest, note_read)
+{
+  ASSERT_EQ(0, cache.open(path, 1 << 20));
+  const double period = g_conf().get_val<double>(
+    "osd_hot_object_cache_hit_set_period");
+  hobject_t a = obj("a");
+  utime_t now(1000, 0);
+  ASSERT_FALSE(cache.note_read(a, 4096, now));
+  // the same hit set only counts once
+  ASSERT_FALSE(cache.note_read(a, 4096, now));
+  now += period;
+  ASSERT_TRUE(cache.note_read(a, 4096, now));
+  // too big to hold
+  hobject_t b = obj("b");
+  ASSERT_FALSE(cache.note_read(b, 2 << 20, now));
+  now += period;
+  ASSERT_FALSE(cache.note_read(b, 2 << 20, now));
+}
+
+TEST_F(HotObjectCacheTest, queue_promote)
+{
+  ASSERT_EQ(0, cache.open(path, 1 << 20));
+  hobject_t a = obj("a"), b = obj("b");
+  cache.queue_promote(a, eversion_t(1, 1), [](bufferlist *bl) {
+      *bl = data(4096, 'a');
+      return 0;
+    });
+  // the object changed before the promotion could read it
+  cache.queue_promote(b, eversion_t(1, 1), [](bufferlist *bl) {
+      return -ESTALE;
+    });
+  cache.wait_for_promotions();
+
+  bufferlist bl;
+  ASSERT_EQ(4096, cache.read(a, eversion_t(1, 1), 0, 4096, &bl));
+  ASSERT_TRUE(bl.contents_equal(data(4096, 'a')));
+  ASSERT_EQ(-ENOENT, cache.read(b, eversion_t(1, 1), 0, 4096, &bl));
+  ASSERT_EQ(1u, counter(l_hot_object_cache_promote));
+}
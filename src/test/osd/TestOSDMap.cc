@@ -345,6 +345,113 @@ TEST_F(OSDMapTest, PrimaryTempRespected) {
   EXPECT_EQ(acting_primary, acting_osds[1]);
 }
 
+TEST_F(OSDMapTest, SharedEpochsCopyOnWrite) {
+  set_up_map();
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+  vector<int> up_osds, acting_osds;
+  int up_primary, acting_primary;
+  osdmap.pg_to_up_acting_osds(pgid, &up_osds, &up_primary,
+                              &acting_osds, &acting_primary);
+  ASSERT_LT(1u, acting_osds.size());
+
+  // the next epoch starts out sharing pg_temp, primary_temp and the
+  // upmaps with this one; modifying them must not leak back.
+  OSDMap next;
+  next.deepish_copy_from(osdmap);
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.fsid = osdmap.get_fsid();
+  inc.new_pg_temp[pgid] = {acting_osds[1], acting_osds[0]};
+  inc.new_primary_temp[pgid] = acting_osds[1];
+  inc.new_pg_upmap_items[pgid] = {{acting_osds[0], acting_osds[1]}};
+  ASSERT_EQ(0, next.apply_incremental(inc));
+
+  EXPECT_TRUE(next.have_pg_upmaps(pgid));
+  EXPECT_FALSE(osdmap.have_pg_upmaps(pgid));
+  EXPECT_EQ(1u, next.get_num_pg_temp());
+  EXPECT_EQ(0u, osdmap.get_num_pg_temp());
+
+  vector<int> old_acting;
+  int old_primary;
+  osdmap.pg_to_up_acting_osds(pgid, nullptr, nullptr,
+                              &old_acting, &old_primary);
+  EXPECT_EQ(acting_osds, old_acting);
+  EXPECT_EQ(acting_primary, old_primary);
+
+  // and dedup shares whatever ends up identical again
+  OSDMap copy;
+  copy.deepish_copy_from(next);
+  OSDMap::Incremental noop(next.get_epoch() + 1);
+  noop.fsid = next.get_fsid();
+  ASSERT_EQ(0, copy.apply_incremental(noop));
+  OSDMap::dedup(&next, &copy);
+  EXPECT_TRUE(copy.have_pg_upmaps(pgid));
+  EXPECT_EQ(1u, copy.get_num_pg_temp());
+}
+
+TEST_F(OSDMapTest, IncrementalMappingUpdate) {
+  set_up_map();
+  mapping.update(osdmap);
+
+  // after each epoch the kept mapping must match one built from scratch
+  auto check = [this]() {
+    mapping.update(osdmap);
+    OSDMapMapping scratch;
+    scratch.update(osdmap);
+    for (auto& p : osdmap.get_pools()) {
+      for (unsigned ps = 0; ps < p.second.get_pg_num(); ++ps) {
+	pg_t pgid(ps, p.first);
+	vector<int> up, acting, up2, acting2;
+	int up_primary, acting_primary, up_primary2, acting_primary2;
+	mapping.get(pgid, &up, &up_primary, &acting, &acting_primary);
+	scratch.get(pgid, &up2, &up_primary2, &acting2, &acting_primary2);
+	ASSERT_EQ(up2, up) << pgid;
+	ASSERT_EQ(up_primary2, up_primary) << pgid;
+	ASSERT_EQ(acting2, acting) << pgid;
+	ASSERT_EQ(acting_primary2, acting_primary) << pgid;
+      }
+    }
+  };
+  auto apply = [this](std::function<void(OSDMap::Incremental&)> f) {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    f(inc);
+    ASSERT_EQ(0, osdmap.apply_incremental(inc));
+  };
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+  vector<int> acting;
+  osdmap.pg_to_acting_osds(pgid, acting);
+  ASSERT_LT(1u, acting.size());
+
+  apply([](OSDMap::Incremental& inc) { inc.new_weight[0] = CEPH_OSD_IN / 2; });
+  check();
+  apply([](OSDMap::Incremental& inc) { inc.new_state[1] = CEPH_OSD_UP; });
+  check();
+  apply([&](OSDMap::Incremental& inc) {
+    inc.new_pg_temp[pgid] = {acting[1], acting[0]};
+    inc.new_primary_temp[pgid] = acting[1];
+  });
+  check();
+  apply([&](OSDMap::Incremental& inc) {
+    inc.new_pg_upmap_items[pgid] = {{acting[0], 5}};
+  });
+  check();
+  apply([](OSDMap::Incremental& inc) { inc.new_weight[5] = CEPH_OSD_OUT; });
+  check();
+  apply([](OSDMap::Incremental& inc) {
+    inc.new_primary_affinity[2] = 0;
+    inc.new_state[1] = CEPH_OSD_UP;
+  });
+  check();
+  apply([&](OSDMap::Incremental& inc) { inc.new_pg_temp[pgid].clear(); });
+  check();
+
+  // crush changes made in place are picked up too
+  osdmap.crush->adjust_item_weightf(g_ceph_context, 3, 0.5);
+  check();
+}
+
 TEST_F(OSDMapTest, CleanTemps) {
   set_up_map();
 
@@ -1341,6 +1448,38 @@ TEST_F(OSDMapTest, BUG_38897) {
   }
 }
 
+TEST_F(OSDMapTest, CalcPGUpmapsThreadsDeterministic) {
+  set_up_map(20);
+  auto& conf = g_ceph_context->_conf;
+  conf.set_val("osd_calc_pg_upmaps_max_stddev", "0");
+  conf.set_val("osd_calc_pg_upmaps_seed", "42");
+  conf.apply_changes(nullptr);
+
+  // the same seed must give the same proposals however many threads
+  // score the candidates
+  auto calc = [&](const char *threads) {
+    conf.set_val("osd_calc_pg_upmaps_threads", threads);
+    conf.apply_changes(nullptr);
+    OSDMap tmp;
+    tmp.deepish_copy_from(osdmap);
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    tmp.calc_pg_upmaps(g_ceph_context, 0, 20, {}, &pending_inc);
+    return pending_inc;
+  };
+  auto serial = calc("1");
+  auto parallel = calc("4");
+  auto again = calc("4");
+  EXPECT_FALSE(serial.new_pg_upmap_items.empty());
+  EXPECT_EQ(serial.new_pg_upmap_items, parallel.new_pg_upmap_items);
+  EXPECT_EQ(serial.old_pg_upmap_items, parallel.old_pg_upmap_items);
+  EXPECT_EQ(parallel.new_pg_upmap_items, again.new_pg_upmap_items);
+
+  conf.rm_val("osd_calc_pg_upmaps_seed");
+  conf.rm_val("osd_calc_pg_upmaps_threads");
+  conf.rm_val("osd_calc_pg_upmaps_max_stddev");
+  conf.apply_changes(nullptr);
+}
+
 TEST(PGTempMap, basic)
 {
   PGTempMap m;
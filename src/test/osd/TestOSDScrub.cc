@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <signal.h>
+#include <fstream>
 #include <gtest/gtest.h>
 #include "osd/OSD.h"
 #include "os/ObjectStore.h"
@@ -142,6 +143,75 @@ TEST(TestOSDScrub, scrub_time_permit) {
 
 }
 
+TEST(TestOSDScrub, scrub_idle) {
+  std::ostringstream why;
+  // disabled
+  ASSERT_TRUE(OSDService::scrub_idle(0, 100, 0, 0, 1.0, 0.1, &why));
+
+  // idle: nothing queued, quiet for longer than the window, device idle
+  ASSERT_TRUE(OSDService::scrub_idle(1.0, 0, 0, 2.0, 0.05, 0.1, &why));
+  ASSERT_TRUE(why.str().empty());
+
+  // a few queued ops are tolerated up to max_queued
+  ASSERT_TRUE(OSDService::scrub_idle(1.0, 2, 2, 2.0, 0.05, 0.1, &why));
+  ASSERT_FALSE(OSDService::scrub_idle(1.0, 3, 2, 2.0, 0.05, 0.1, &why));
+  ASSERT_NE(std::string::npos, why.str().find("queued"));
+
+  // a client op within the window
+  why.str("");
+  ASSERT_FALSE(OSDService::scrub_idle(1.0, 0, 0, 0.5, 0.05, 0.1, &why));
+  ASSERT_NE(std::string::npos, why.str().find("last client op"));
+
+  // busy device
+  why.str("");
+  ASSERT_FALSE(OSDService::scrub_idle(1.0, 0, 0, 2.0, 0.5, 0.1, &why));
+  ASSERT_NE(std::string::npos, why.str().find("device util"));
+}
+
+TEST(TestOSDScrub, scrub_yield) {
+  using yield_t = OSDService::scrub_yield_t;
+  // no limit
+  ASSERT_EQ(yield_t::YIELD, OSDService::scrub_yield(1000, 0, false));
+  ASSERT_EQ(yield_t::YIELD, OSDService::scrub_yield(1000, 0, true));
+  // within the limit
+  ASSERT_EQ(yield_t::YIELD, OSDService::scrub_yield(59, 60, false));
+  ASSERT_EQ(yield_t::YIELD, OSDService::scrub_yield(59, 60, true));
+  // past it, a scrub that has not started lets its reservations go, one
+  // that has goes on
+  ASSERT_EQ(yield_t::GIVE_UP, OSDService::scrub_yield(60, 60, false));
+  ASSERT_EQ(yield_t::PROCEED, OSDService::scrub_yield(60, 60, true));
+}
+
+TEST(TestOSDScrub, get_device_io_ticks) {
+  char dir[] = "/tmp/osdscrub-sysfs-XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir));
+  const std::string sysfs(dir);
+  auto write_stat = [&](const std::string& path, const std::string& stat) {
+    ASSERT_EQ(0, ::system(("mkdir -p " + sysfs + path).c_str()));
+    std::ofstream f(sysfs + path + "/stat");
+    f << stat;
+  };
+  // whole disk
+  write_stat("/block/sda",
+	     "  100 0 800 10 200 0 1600 20 0 4321 30 0 0 0 0\n");
+  // partition: only under /sys/class/block
+  write_stat("/class/block/sda1",
+	     "  100 0 800 10 200 0 1600 20 0 1234 30\n");
+  // truncated
+  write_stat("/block/sdb", "1 2 3\n");
+
+  uint64_t io_ticks = 0;
+  ASSERT_EQ(0, OSDService::get_device_io_ticks("sda", &io_ticks, sysfs));
+  ASSERT_EQ(4321u, io_ticks);
+  ASSERT_EQ(0, OSDService::get_device_io_ticks("sda1", &io_ticks, sysfs));
+  ASSERT_EQ(1234u, io_ticks);
+  ASSERT_EQ(-EINVAL, OSDService::get_device_io_ticks("sdb", &io_ticks, sysfs));
+  ASSERT_EQ(-ENOENT, OSDService::get_device_io_ticks("nvme0n1", &io_ticks,
+						     sysfs));
+
+  ASSERT_EQ(0, ::system(("rm -rf " + sysfs).c_str()));
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_osdscrub ; ./unittest_osdscrub --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
@@ -2291,6 +2291,78 @@ TEST_F(PGLogTest, split_into_preserves_may_include_deletes) {
   }
 }
 
+TEST_F(PGLogTest, split_into_keeps_index) {
+  clear();
+
+  // two entries for each of 16 objects; the child (seed 1, 2 bits)
+  // gets the objects whose hash & 3 == 1
+  unsigned v = 0;
+  for (unsigned round = 0; round < 2; ++round) {
+    for (unsigned id = 0; id < 16; ++id) {
+      ++v;
+      log.add(mk_ple_mod(mk_obj(id), mk_evt(10, v), mk_evt(10, v - 1),
+			 osd_reqid_t(entity_name_t::CLIENT(777), 8, v)));
+    }
+  }
+  PGLog child_log(cct);
+  split_into(pg_t(1, 1), 2, &child_log);
+
+  ASSERT_EQ(24u, log.log.size());
+  ASSERT_EQ(8u, child_log.get_log().log.size());
+  for (unsigned id = 0; id < 16; ++id) {
+    hobject_t soid = mk_obj(id);
+    bool in_child = (id & 3) == 1;
+    const IndexedLog &owner = in_child ? child_log.get_log() : log;
+    const IndexedLog &other = in_child ? log : child_log.get_log();
+    ASSERT_TRUE(owner.logged_object(soid));
+    ASSERT_FALSE(other.logged_object(soid));
+    ASSERT_EQ(mk_evt(10, 16 + id + 1), owner.objects.find(soid)->second->version);
+  }
+  for (unsigned i = 1; i <= v; ++i) {
+    bool in_child = (((i - 1) % 16) & 3) == 1;
+    osd_reqid_t r(entity_name_t::CLIENT(777), 8, i);
+    ASSERT_EQ(in_child, child_log.get_log().logged_req(r));
+    ASSERT_EQ(!in_child, log.logged_req(r));
+  }
+}
+
+TEST_F(PGLogTest, move_keeps_index) {
+  clear();
+
+  IndexedLog a;
+  for (unsigned v = 1; v <= 8; ++v) {
+    a.add(mk_ple_mod(mk_obj(v), mk_evt(10, v), mk_evt(10, v - 1),
+		     osd_reqid_t(entity_name_t::CLIENT(777), 8, v)));
+  }
+  a.complete_to = std::next(a.log.begin(), 3);
+
+  IndexedLog b(std::move(a));
+  ASSERT_EQ(8u, b.log.size());
+  ASSERT_EQ(mk_evt(10, 4), b.complete_to->version);
+  for (unsigned v = 1; v <= 8; ++v) {
+    ASSERT_TRUE(b.logged_object(mk_obj(v)));
+    ASSERT_EQ(&*std::next(b.log.begin(), v - 1),
+	      b.objects.find(mk_obj(v))->second);
+    ASSERT_TRUE(b.logged_req(osd_reqid_t(entity_name_t::CLIENT(777), 8, v)));
+  }
+  // the moved-from log is empty and can be used again
+  ASSERT_TRUE(a.log.empty());
+  ASSERT_FALSE(a.logged_object(mk_obj(1)));
+  ASSERT_TRUE(a.complete_to == a.log.end());
+
+  // complete_to at the end stays at the end of the new list
+  IndexedLog c;
+  c = std::move(b);
+  ASSERT_EQ(mk_evt(10, 4), c.complete_to->version);
+  c.complete_to = c.log.end();
+  b = std::move(c);
+  ASSERT_TRUE(b.complete_to == b.log.end());
+  ASSERT_EQ(8u, b.log.size());
+  ASSERT_TRUE(b.logged_object(mk_obj(8)));
+  ASSERT_TRUE(c.log.empty());
+  ASSERT_TRUE(c.complete_to == c.log.end());
+}
+
 class PGLogTestRebuildMissing : public PGLogTest, public StoreTestFixture {
 public:
   PGLogTestRebuildMissing() : PGLogTest(), StoreTestFixture("memstore") {}
@@ -2672,6 +2744,338 @@ TEST_F(PGLogMergeDupsTest, Superset) {
 }
 
 
+class PGLogChunkTest : public PGLogTestBase, public StoreTestFixture {
+public:
+  struct ChunkedPGLog : public PGLog {
+    explicit ChunkedPGLog(CephContext *cct) : PGLog(cct) {}
+    using PGLog::log;
+    using PGLog::log_chunks;
+    using PGLog::dup_chunks;
+    using PGLog::spilled;
+  };
+
+  PGLogChunkTest() : StoreTestFixture("memstore") {}
+
+  void SetUp() override {
+    StoreTestFixture::SetUp();
+    SetVal(g_conf(), "osd_pg_log_chunk_entries", "4");
+    test_coll = coll_t(spg_t(pg_t(1, 1)));
+    ch = store->create_new_collection(test_coll);
+    ObjectStore::Transaction t;
+    t.create_collection(test_coll, 0);
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+    hobject_t hoid;
+    hoid.pool = 1;
+    hoid.oid = "log";
+    log_oid = ghobject_t(hoid);
+    info.last_backfill = hobject_t::get_max();
+  }
+
+  void add_entries(ChunkedPGLog &pglog, unsigned epoch,
+		   unsigned from, unsigned to) {
+    for (unsigned v = from; v <= to; ++v) {
+      pg_log_entry_t e = mk_ple_mod(
+	mk_obj(v % 3), mk_evt(epoch, v), mk_evt(epoch, v - 1),
+	osd_reqid_t(entity_name_t::CLIENT(777), 8, v));
+      e.user_version = v;
+      pglog.add(e, false);
+      info.last_update = info.last_complete = e.version;
+    }
+  }
+
+  void write(ChunkedPGLog &pglog) {
+    ObjectStore::Transaction t;
+    map<string, bufferlist> km;
+    pglog.write_log_and_missing(t, &km, test_coll, log_oid, false);
+    if (!km.empty())
+      t.omap_setkeys(test_coll, log_oid, km);
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  }
+
+  // count on-disk keys: chunks, individual entries, dup chunks, dups
+  void count_keys(unsigned *chunks, unsigned *entries,
+		  unsigned *dup_chunks, unsigned *dups) {
+    *chunks = *entries = *dup_chunks = *dups = 0;
+    set<string> keys;
+    ASSERT_EQ(0, store->omap_get_keys(ch, log_oid, &keys));
+    for (auto &k : keys) {
+      if (pg_log_entry_chunk_t::is_key_name(k))
+	++*chunks;
+      else if (pg_log_dup_chunk_t::is_key_name(k))
+	++*dup_chunks;
+      else if (k.compare(0, 4, "dup_") == 0)
+	++*dups;
+      else if (isdigit(k[0]))
+	++*entries;
+    }
+  }
+
+  void verify_roundtrip(ChunkedPGLog &pglog) {
+    ChunkedPGLog copy(g_ceph_context);
+    ostringstream err;
+    copy.read_log_and_missing(store.get(), ch, log_oid, info, err, false);
+    ASSERT_EQ(pglog.log.log.size(), copy.log.log.size());
+    for (auto i = pglog.log.log.begin(), j = copy.log.log.begin();
+	 i != pglog.log.log.end();
+	 ++i, ++j) {
+      bufferlist a, b;
+      i->encode(a);
+      j->encode(b);
+      ASSERT_TRUE(a.contents_equal(b)) << *i << " != " << *j;
+    }
+    ASSERT_EQ(pglog.log.dups, copy.log.dups);
+    ASSERT_EQ(pglog.log_chunks, copy.log_chunks);
+    ASSERT_EQ(pglog.dup_chunks, copy.dup_chunks);
+    ASSERT_EQ(pglog.spilled, copy.spilled);
+  }
+
+  pg_info_t info;
+  coll_t test_coll;
+  ghobject_t log_oid;
+};
+
+TEST_F(PGLogChunkTest, FoldAndRead) {
+  ChunkedPGLog pglog(g_ceph_context);
+  unsigned chunks, entries, dup_chunks, dups;
+
+  add_entries(pglog, 1, 1, 3);
+  write(pglog);
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(0u, chunks);
+  EXPECT_EQ(3u, entries);
+  verify_roundtrip(pglog);
+
+  add_entries(pglog, 1, 4, 10);
+  write(pglog);
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(2u, chunks);
+  EXPECT_EQ(2u, entries);
+  EXPECT_EQ(2u, pglog.log_chunks.size());
+  verify_roundtrip(pglog);
+}
+
+TEST_F(PGLogChunkTest, Trim) {
+  SetVal(g_conf(), "osd_pg_log_dups_tracked", "8");
+  ChunkedPGLog pglog(g_ceph_context);
+  unsigned chunks, entries, dup_chunks, dups;
+
+  add_entries(pglog, 1, 1, 10);
+  write(pglog);
+
+  // only the first chunk is entirely trimmed
+  pglog.trim(mk_evt(1, 6), info);
+  EXPECT_EQ(mk_evt(1, 6), info.log_tail);
+  write(pglog);
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(1u, chunks);
+  EXPECT_EQ(2u, entries);
+  // entries 3-6 became dups and were folded right away
+  EXPECT_EQ(1u, dup_chunks);
+  EXPECT_EQ(0u, dups);
+  verify_roundtrip(pglog);
+
+  // trimming everything drops all log chunks
+  pglog.trim(mk_evt(1, 10), info);
+  write(pglog);
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(0u, chunks);
+  EXPECT_EQ(0u, entries);
+  EXPECT_TRUE(pglog.log_chunks.empty());
+  verify_roundtrip(pglog);
+}
+
+TEST_F(PGLogChunkTest, RewindIntoChunk) {
+  ChunkedPGLog pglog(g_ceph_context);
+  unsigned chunks, entries, dup_chunks, dups;
+
+  add_entries(pglog, 1, 1, 10);
+  write(pglog);
+
+  list<hobject_t> removed;
+  TestHandler h(removed);
+  bool dirty_info = false;
+  bool dirty_big_info = false;
+  pglog.rewind_divergent_log(mk_evt(1, 6), info, &h,
+			     dirty_info, dirty_big_info);
+  write(pglog);
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(1u, chunks);
+  EXPECT_EQ(2u, entries);
+  EXPECT_EQ(6u, pglog.log.log.size());
+  verify_roundtrip(pglog);
+
+  add_entries(pglog, 2, 7, 9);
+  write(pglog);
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(2u, chunks);
+  EXPECT_EQ(1u, entries);
+  verify_roundtrip(pglog);
+}
+
+TEST_F(PGLogChunkTest, ConvertInPlace) {
+  unsigned chunks, entries, dup_chunks, dups;
+  {
+    // legacy one-key-per-entry log
+    SetVal(g_conf(), "osd_pg_log_chunk_entries", "0");
+    ChunkedPGLog pglog(g_ceph_context);
+    add_entries(pglog, 1, 1, 9);
+    write(pglog);
+    count_keys(&chunks, &entries, &dup_chunks, &dups);
+    EXPECT_EQ(0u, chunks);
+    EXPECT_EQ(9u, entries);
+  }
+  {
+    SetVal(g_conf(), "osd_pg_log_chunk_entries", "4");
+    ChunkedPGLog pglog(g_ceph_context);
+    ostringstream err;
+    pglog.read_log_and_missing(store.get(), ch, log_oid, info, err, false);
+    add_entries(pglog, 1, 10, 10);
+    write(pglog);
+    count_keys(&chunks, &entries, &dup_chunks, &dups);
+    EXPECT_EQ(2u, chunks);
+    EXPECT_EQ(2u, entries);
+    verify_roundtrip(pglog);
+  }
+  {
+    // and back again
+    SetVal(g_conf(), "osd_pg_log_chunk_entries", "0");
+    ChunkedPGLog pglog(g_ceph_context);
+    ostringstream err;
+    pglog.read_log_and_missing(store.get(), ch, log_oid, info, err, false);
+    add_entries(pglog, 1, 11, 11);
+    write(pglog);
+    count_keys(&chunks, &entries, &dup_chunks, &dups);
+    EXPECT_EQ(0u, chunks);
+    EXPECT_EQ(11u, entries);
+    verify_roundtrip(pglog);
+  }
+}
+
+class PGLogSpillTest : public PGLogChunkTest {
+public:
+  void SetUp() override {
+    PGLogChunkTest::SetUp();
+    SetVal(g_conf(), "osd_pg_log_chunk_entries", "0");
+    SetVal(g_conf(), "osd_pg_log_spill_entries", "4");
+  }
+
+  bool load(ChunkedPGLog &pglog, eversion_t since) {
+    return pglog.load_spilled(store.get(), ch, log_oid, info, since);
+  }
+};
+
+TEST_F(PGLogSpillTest, TrimKeepsEntriesOnDisk) {
+  ChunkedPGLog pglog(g_ceph_context);
+  unsigned chunks, entries, dup_chunks, dups;
+
+  add_entries(pglog, 1, 1, 10);
+  write(pglog);
+
+  pglog.trim(mk_evt(1, 6), info);
+  write(pglog);
+  EXPECT_EQ(4u, pglog.log.log.size());
+  // only the newest 4 trimmed entries stay on disk
+  ASSERT_EQ(4u, pglog.spilled.size());
+  EXPECT_EQ(mk_evt(1, 3), pglog.spilled.front());
+  EXPECT_EQ(mk_evt(1, 6), pglog.spilled.back());
+  EXPECT_EQ(mk_evt(1, 3), pglog.get_spilled_tail());
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(8u, entries);
+  verify_roundtrip(pglog);
+}
+
+TEST_F(PGLogSpillTest, LoadSpilled) {
+  ChunkedPGLog pglog(g_ceph_context);
+  unsigned chunks, entries, dup_chunks, dups;
+
+  add_entries(pglog, 1, 1, 10);
+  write(pglog);
+  pglog.trim(mk_evt(1, 6), info);
+  write(pglog);
+  EXPECT_FALSE(load(pglog, mk_evt(1, 6)));
+
+  ASSERT_TRUE(load(pglog, mk_evt(1, 4)));
+  EXPECT_EQ(mk_evt(1, 4), pglog.get_tail());
+  EXPECT_EQ(mk_evt(1, 4), info.log_tail);
+  EXPECT_EQ(6u, pglog.log.log.size());
+  EXPECT_EQ(mk_evt(1, 5), pglog.log.log.front().version);
+  EXPECT_EQ(2u, pglog.spilled.size());
+  // dups of the reloaded entries are gone
+  EXPECT_EQ(mk_evt(1, 4), pglog.log.dups.back().version);
+  write(pglog);
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(8u, entries);
+  EXPECT_EQ(4u, dups);
+  verify_roundtrip(pglog);
+
+  // reloaded entries can be trimmed and spilled again
+  pglog.trim(mk_evt(1, 8), info);
+  write(pglog);
+  ASSERT_EQ(4u, pglog.spilled.size());
+  EXPECT_EQ(mk_evt(1, 5), pglog.spilled.front());
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(6u, entries);
+  verify_roundtrip(pglog);
+}
+
+TEST_F(PGLogSpillTest, LoadFromChunks) {
+  SetVal(g_conf(), "osd_pg_log_chunk_entries", "4");
+  ChunkedPGLog pglog(g_ceph_context);
+  unsigned chunks, entries, dup_chunks, dups;
+
+  add_entries(pglog, 1, 1, 10);
+  write(pglog);
+  pglog.trim(mk_evt(1, 6), info);
+  write(pglog);
+  // entries 1 and 2 share a chunk with entry 3, so they stay spilled
+  ASSERT_EQ(6u, pglog.spilled.size());
+  EXPECT_EQ(mk_evt(1, 1), pglog.spilled.front());
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(2u, chunks);
+  EXPECT_EQ(2u, entries);
+  verify_roundtrip(pglog);
+
+  ASSERT_TRUE(load(pglog, mk_evt(1, 1)));
+  EXPECT_EQ(mk_evt(1, 1), pglog.get_tail());
+  EXPECT_EQ(9u, pglog.log.log.size());
+  write(pglog);
+  verify_roundtrip(pglog);
+
+  pglog.trim(mk_evt(1, 10), info);
+  write(pglog);
+  EXPECT_EQ(mk_evt(1, 5), pglog.get_spilled_tail());
+  count_keys(&chunks, &entries, &dup_chunks, &dups);
+  EXPECT_EQ(1u, chunks);
+  EXPECT_EQ(2u, entries);
+  EXPECT_EQ(1u, pglog.log_chunks.size());
+  verify_roundtrip(pglog);
+}
+
+TEST_F(PGLogSpillTest, Disable) {
+  unsigned chunks, entries, dup_chunks, dups;
+  {
+    ChunkedPGLog pglog(g_ceph_context);
+    add_entries(pglog, 1, 1, 10);
+    write(pglog);
+    pglog.trim(mk_evt(1, 6), info);
+    write(pglog);
+  }
+  {
+    // spilled entries are removed on the next write
+    SetVal(g_conf(), "osd_pg_log_spill_entries", "0");
+    ChunkedPGLog pglog(g_ceph_context);
+    ostringstream err;
+    pglog.read_log_and_missing(store.get(), ch, log_oid, info, err, false);
+    EXPECT_TRUE(pglog.spilled.empty());
+    add_entries(pglog, 1, 11, 11);
+    write(pglog);
+    count_keys(&chunks, &entries, &dup_chunks, &dups);
+    EXPECT_EQ(5u, entries);
+    verify_roundtrip(pglog);
+  }
+}
+
+
 struct PGLogTrimTest :
   public ::testing::Test,
   public PGLogTestBase,
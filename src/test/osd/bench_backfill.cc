@@ -0,0 +1,243 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Measures the backfill data path for many small objects on MemStore:
+ * the primary reads each object into a PushOp, the pushes are packed
+ * into messages (encoded and decoded as they would be on the wire) and
+ * the replica applies one transaction per message, with a bounded
+ * number of messages in flight.  Runs once with one object per message
+ * and once with --batch objects per message (osd_backfill_batch_objects).
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "common/ceph_argparse.h"
+#include "common/errno.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "os/ObjectStore.h"
+#include "osd/osd_types.h"
+
+#include "bench_store.h"
+
+#define dout_context g_ceph_context
+
+static void usage()
+{
+  cout << "usage: ceph_bench_backfill [flags]\n"
+    "	 --objects\n"
+    "	       number of objects to backfill (default 100000)\n"
+    "	 --object-size\n"
+    "	       object size in bytes (default 4096)\n"
+    "	 --batch\n"
+    "	       objects per push message in the batched run (default 64)\n"
+    "	 --in-flight\n"
+    "	       push messages in flight (default 3)\n" << std::endl;
+  generic_server_usage();
+}
+
+struct Config {
+  unsigned objects = 100000;
+  unsigned object_size = 4096;
+  unsigned batch = 64;
+  unsigned in_flight = 3;
+};
+
+// bounds the number of queued transactions, like the recovery
+// reservations bound the pushes in flight
+class InFlight {
+  std::mutex lock;
+  std::condition_variable cond;
+  unsigned count = 0;
+  unsigned max;
+public:
+  explicit InFlight(unsigned max) : max(max) {}
+  void get() {
+    std::unique_lock<std::mutex> l(lock);
+    cond.wait(l, [this] { return count < max; });
+    ++count;
+  }
+  void put() {
+    std::lock_guard<std::mutex> l(lock);
+    --count;
+    cond.notify_all();
+  }
+  void wait_idle() {
+    std::unique_lock<std::mutex> l(lock);
+    cond.wait(l, [this] { return count == 0; });
+  }
+};
+
+class C_Put : public Context {
+  InFlight *in_flight;
+public:
+  explicit C_Put(InFlight *in_flight) : in_flight(in_flight) {}
+  void finish(int r) override {
+    in_flight->put();
+  }
+};
+
+static void build_push(ObjectStore *os, ObjectStore::CollectionHandle &ch,
+		       const ghobject_t &oid, PushOp *pop)
+{
+  pop->soid = oid.hobj;
+  int r = os->read(ch, oid, 0, 0, pop->data);
+  ceph_assert(r >= 0);
+  if (pop->data.length())
+    pop->data_included.insert(0, pop->data.length());
+  r = os->getattrs(ch, oid, pop->attrset);
+  ceph_assert(r == 0);
+  pop->recovery_info.soid = oid.hobj;
+  pop->recovery_info.size = pop->data.length();
+  pop->before_progress.first = true;
+  pop->after_progress.first = false;
+  pop->after_progress.data_complete = true;
+  pop->after_progress.omap_complete = true;
+}
+
+static double run(ObjectStore *os, const Config &cfg,
+		  ObjectStore::CollectionHandle &src,
+		  const vector<ghobject_t> &oids,
+		  const coll_t &dst_cid, unsigned batch)
+{
+  ObjectStore::CollectionHandle dst = os->create_new_collection(dst_cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(dst_cid, 0);
+    os->queue_transaction(dst, std::move(t));
+  }
+
+  InFlight in_flight(cfg.in_flight);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < oids.size(); i += batch) {
+    // primary: read the objects into one message
+    vector<PushOp> pushes(std::min<size_t>(batch, oids.size() - i));
+    for (size_t j = 0; j < pushes.size(); ++j) {
+      build_push(os, src, oids[i + j], &pushes[j]);
+    }
+    bufferlist wire;
+    encode(pushes, wire, CEPH_FEATURES_ALL);
+
+    // replica: decode and apply the message in one transaction
+    vector<PushOp> received;
+    auto p = wire.cbegin();
+    decode(received, p);
+    ObjectStore::Transaction t;
+    for (auto &pop : received) {
+      ghobject_t oid(pop.soid);
+      t.remove(dst_cid, oid);
+      t.touch(dst_cid, oid);
+      t.write(dst_cid, oid, 0, pop.data.length(), pop.data);
+      t.setattrs(dst_cid, oid, pop.attrset);
+    }
+    in_flight.get();
+    t.register_on_commit(new C_Put(&in_flight));
+    os->queue_transaction(dst, std::move(t));
+  }
+  in_flight.wait_idle();
+  auto elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  ObjectStore::Transaction t;
+  for (auto &oid : oids)
+    t.remove(dst_cid, oid);
+  t.remove_collection(dst_cid);
+  os->queue_transaction(dst, std::move(t));
+  return elapsed;
+}
+
+int main(int argc, const char **argv)
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)nullptr)) {
+      cfg.objects = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--object-size", (char*)nullptr)) {
+      cfg.object_size = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--batch", (char*)nullptr)) {
+      cfg.batch = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--in-flight", (char*)nullptr)) {
+      cfg.in_flight = atoi(val.c_str());
+    } else {
+      cerr << "Error: can't understand argument: " << *i << std::endl;
+      exit(1);
+    }
+  }
+  if (!cfg.objects || !cfg.batch || !cfg.in_flight) {
+    cerr << "Error: --objects, --batch and --in-flight must be > 0"
+	 << std::endl;
+    exit(1);
+  }
+
+  common_init_finish(g_ceph_context);
+
+  BenchStore os("ceph_bench_backfill", "memstore");
+
+  // populate the primary's collection
+  const coll_t src_cid(spg_t(pg_t(0, 1)));
+  ObjectStore::CollectionHandle src = os->create_new_collection(src_cid);
+  vector<ghobject_t> oids;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(src_cid, 0);
+    bufferlist data;
+    data.append_zero(cfg.object_size);
+    bufferlist oi;
+    oi.append_zero(250);  // roughly an encoded object_info_t
+    for (unsigned n = 0; n < cfg.objects; ++n) {
+      oids.emplace_back(hobject_t(object_t("obj" + stringify(n)), "",
+				  CEPH_NOSNAP, n, 1, ""));
+      t.write(src_cid, oids.back(), 0, data.length(), data);
+      t.setattr(src_cid, oids.back(), OI_ATTR, oi);
+    }
+    os->queue_transaction(src, std::move(t));
+  }
+
+  double single = run(os.get(), cfg, src, oids,
+		      coll_t(spg_t(pg_t(1, 1))), 1);
+  double batched = run(os.get(), cfg, src, oids,
+		       coll_t(spg_t(pg_t(2, 1))), cfg.batch);
+  cout << cfg.objects << " objects of " << cfg.object_size << " bytes, "
+       << cfg.in_flight << " messages in flight\n"
+       << "  1 object per push message: " << single << "s, "
+       << (uint64_t)(cfg.objects / single) << " objects/s\n"
+       << "  " << cfg.batch << " objects per push message: " << batched
+       << "s, " << (uint64_t)(cfg.objects / batched) << " objects/s"
+       << std::endl;
+
+  ObjectStore::Transaction t;
+  for (auto &oid : oids)
+    t.remove(src_cid, oid);
+  t.remove_collection(src_cid);
+  os->queue_transaction(src, std::move(t));
+  return 0;
+}
@@ -0,0 +1,211 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Replays a read trace against an OSD hot object cache the way
+ * PrimaryLogPG::do_read() drives it: each read is tried in the cache,
+ * and on a miss is served by the (simulated) store and promoted once
+ * the object is hot.  The trace is either --trace, a file of "oid
+ * size" lines, or --reads reads of --objects objects drawn from a zipf
+ * distribution.  The osd_hot_object_cache_* options apply as usual.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include "common/ceph_argparse.h"
+#include "common/errno.h"
+#include "common/perf_counters.h"
+#include "common/strtol.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "osd/HotObjectCache.h"
+
+#include "bench_store.h"
+
+#define dout_context g_ceph_context
+
+static void usage()
+{
+  cout << "usage: ceph_bench_hot_cache [flags]\n"
+    "	 --trace\n"
+    "	       file of \"oid size\" lines to replay\n"
+    "	 --objects\n"
+    "	       objects in the synthetic trace (default 100000)\n"
+    "	 --reads\n"
+    "	       reads in the synthetic trace (default 1000000)\n"
+    "	 --zipf\n"
+    "	       zipf exponent of the synthetic trace (default .99)\n"
+    "	 --object-size\n"
+    "	       object size in the synthetic trace (default 64K)\n"
+    "	 --rate\n"
+    "	       reads per second of trace time (default 10000)\n"
+    "	 --cache-size\n"
+    "	       cache size (default 1G)\n"
+    "	 --cache-path\n"
+    "	       cache file (default a temporary file)\n" << std::endl;
+  generic_server_usage();
+}
+
+struct Config {
+  string trace;
+  unsigned objects = 100000;
+  unsigned reads = 1000000;
+  double zipf = .99;
+  uint64_t object_size = 64 << 10;
+  double rate = 10000;
+  uint64_t cache_size = 1ull << 30;
+  string cache_path;
+};
+
+struct Read {
+  unsigned oid;
+  uint64_t size;
+};
+
+static vector<Read> make_trace(const Config &cfg)
+{
+  vector<Read> trace;
+  if (!cfg.trace.empty()) {
+    std::ifstream in(cfg.trace);
+    if (!in) {
+      cerr << "Error: unable to open " << cfg.trace << std::endl;
+      exit(1);
+    }
+    map<string, unsigned> oids;
+    string oid;
+    uint64_t size;
+    while (in >> oid >> size) {
+      auto p = oids.emplace(oid, oids.size());
+      trace.push_back(Read{p.first->second, size});
+    }
+    return trace;
+  }
+  vector<double> cdf(cfg.objects);
+  double sum = 0;
+  for (unsigned n = 0; n < cfg.objects; ++n) {
+    sum += 1.0 / std::pow(n + 1, cfg.zipf);
+    cdf[n] = sum;
+  }
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<double> dist(0, sum);
+  for (unsigned i = 0; i < cfg.reads; ++i) {
+    unsigned n = std::lower_bound(cdf.begin(), cdf.end(), dist(rng)) -
+      cdf.begin();
+    trace.push_back(Read{std::min(n, cfg.objects - 1), cfg.object_size});
+  }
+  return trace;
+}
+
+int main(int argc, const char **argv)
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--trace", (char*)nullptr)) {
+      cfg.trace = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)nullptr)) {
+      cfg.objects = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--reads", (char*)nullptr)) {
+      cfg.reads = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--zipf", (char*)nullptr)) {
+      cfg.zipf = atof(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--object-size", (char*)nullptr)) {
+      cfg.object_size = strict_iecstrtoll(val.c_str(), nullptr);
+    } else if (ceph_argparse_witharg(args, i, &val, "--rate", (char*)nullptr)) {
+      cfg.rate = atof(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--cache-size", (char*)nullptr)) {
+      cfg.cache_size = strict_iecstrtoll(val.c_str(), nullptr);
+    } else if (ceph_argparse_witharg(args, i, &val, "--cache-path", (char*)nullptr)) {
+      cfg.cache_path = val;
+    } else {
+      cerr << "Error: can't understand argument: " << *i << std::endl;
+      exit(1);
+    }
+  }
+  if (!cfg.objects || !cfg.object_size || !cfg.cache_size || cfg.rate <= 0) {
+    cerr << "Error: --objects, --object-size, --cache-size and --rate must"
+	 << " be > 0" << std::endl;
+    exit(1);
+  }
+
+  common_init_finish(g_ceph_context);
+
+  std::unique_ptr<BenchTmpDir> tmp;
+  if (cfg.cache_path.empty()) {
+    tmp = std::make_unique<BenchTmpDir>("ceph_bench_hot_cache");
+    cfg.cache_path = tmp->get_path() + "/cache";
+  }
+
+  vector<Read> trace = make_trace(cfg);
+  HotObjectCache cache(g_ceph_context);
+  int r = cache.open(cfg.cache_path, cfg.cache_size);
+  if (r < 0) {
+    cerr << "Error: open " << cfg.cache_path << ": " << cpp_strerror(r)
+	 << std::endl;
+    exit(1);
+  }
+
+  // objects are never modified, so every copy is at version 1'1
+  const eversion_t v(1, 1);
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned n = 0; n < trace.size(); ++n) {
+    hobject_t soid(object_t("obj" + stringify(trace[n].oid)), "",
+		   CEPH_NOSNAP, trace[n].oid, 1, "");
+    bufferlist bl;
+    if (cache.read(soid, v, 0, trace[n].size, &bl) >= 0) {
+      continue;
+    }
+    utime_t now;
+    now.set_from_double(n / cfg.rate);
+    if (cache.note_read(soid, trace[n].size, now)) {
+      bl.append_zero(trace[n].size);
+      cache.promote(soid, v, bl);
+    }
+  }
+  double elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  PerfCounters *l = cache.get_logger();
+  uint64_t hit = l->get(l_hot_object_cache_hit);
+  uint64_t miss = l->get(l_hot_object_cache_miss);
+  cout << trace.size() << " reads in " << elapsed << "s\n"
+       << "  hit ratio: " << (double)hit / std::max<uint64_t>(1, hit + miss)
+       << "\n"
+       << "  promotions: " << l->get(l_hot_object_cache_promote)
+       << " (" << byte_u_t(l->get(l_hot_object_cache_promote_bytes)) << ")\n"
+       << "  evictions: " << l->get(l_hot_object_cache_evict) << "\n"
+       << "  cached: " << l->get(l_hot_object_cache_objects) << " objects ("
+       << byte_u_t(l->get(l_hot_object_cache_bytes)) << ")" << std::endl;
+
+  cache.close();
+  return 0;
+}
@@ -0,0 +1,201 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Measures how long OSD startup spends reading PGs from the store: a
+ * synthetic MemStore holds --pgs PGs with --log-entries log entries
+ * each.  Reports the time to peek at every PG's map epoch (all that
+ * load_pgs() blocks on with osd_load_pgs_threads > 0), and the time to
+ * read every PG's info, log and missing set on one thread and on
+ * --threads threads.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "common/ceph_argparse.h"
+#include "common/errno.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "os/ObjectStore.h"
+#include "osd/PG.h"
+#include "osd/PGLog.h"
+
+#include "bench_store.h"
+
+#define dout_context g_ceph_context
+
+static void usage()
+{
+  cout << "usage: ceph_bench_pg_load [flags]\n"
+    "	 --pgs\n"
+    "	       number of PGs (default 300)\n"
+    "	 --log-entries\n"
+    "	       log entries per PG (default 3000)\n"
+    "	 --threads\n"
+    "	       loader threads in the parallel run (default 8)\n" << std::endl;
+  generic_server_usage();
+}
+
+struct Config {
+  unsigned pgs = 300;
+  unsigned log_entries = 3000;
+  unsigned threads = 8;
+};
+
+static spg_t make_pgid(unsigned n)
+{
+  return spg_t(pg_t(n, 1));
+}
+
+// write the pgmeta object of each PG: info, epoch and a full log, as
+// PG::prepare_write() leaves them
+static void populate(ObjectStore *os, const Config &cfg)
+{
+  for (unsigned n = 0; n < cfg.pgs; ++n) {
+    spg_t pgid = make_pgid(n);
+    coll_t cid(pgid);
+    ghobject_t pgmeta_oid(pgid.make_pgmeta_oid());
+    ObjectStore::CollectionHandle ch = os->create_new_collection(cid);
+    ObjectStore::Transaction t;
+    PG::_create(t, pgid, 0);
+    PG::_init(t, pgid, nullptr);
+
+    pg_log_t log;
+    for (unsigned v = 1; v <= cfg.log_entries; ++v) {
+      hobject_t soid(object_t("obj" + stringify(v)), "", CEPH_NOSNAP,
+		     v, 1, "");
+      log.log.push_back(pg_log_entry_t(
+	pg_log_entry_t::MODIFY, soid, eversion_t(1, v), eversion_t(1, v - 1),
+	v, osd_reqid_t(entity_name_t::CLIENT(n), 0, v), utime_t(), 0));
+    }
+    log.head = eversion_t(1, cfg.log_entries);
+
+    pg_info_t info(pgid);
+    info.last_update = info.last_complete = log.head;
+    info.history.same_interval_since = 1;
+    pg_info_t last_written_info;
+    PastIntervals past_intervals;
+    map<string, bufferlist> km;
+    int r = prepare_info_keymap(g_ceph_context, &km, 1, info,
+				last_written_info, past_intervals,
+				true, true, false);
+    ceph_assert(r == 0);
+    map<eversion_t, hobject_t> divergent_priors;
+    PGLog::write_log_and_missing_wo_missing(
+      t, &km, log, cid, pgmeta_oid, divergent_priors, false);
+    t.omap_setkeys(cid, pgmeta_oid, km);
+    os->queue_transaction(ch, std::move(t));
+  }
+}
+
+// what PG::read_state() reads
+static void load_pg(ObjectStore *os, unsigned n)
+{
+  spg_t pgid = make_pgid(n);
+  coll_t cid(pgid);
+  ObjectStore::CollectionHandle ch = os->open_collection(cid);
+  pg_info_t info;
+  PastIntervals past_intervals;
+  __u8 struct_v;
+  int r = PG::read_info(os, pgid, cid, info, past_intervals, struct_v);
+  ceph_assert(r >= 0);
+  PGLog pglog(g_ceph_context);
+  ostringstream oss;
+  pglog.read_log_and_missing(os, ch, pgid.make_pgmeta_oid(), info, oss,
+			     false);
+  ceph_assert(pglog.get_log().log.size() > 0);
+}
+
+static double run(ObjectStore *os, const Config &cfg, unsigned threads)
+{
+  std::atomic<unsigned> next = {0};
+  auto start = std::chrono::steady_clock::now();
+  vector<std::thread> workers;
+  for (unsigned i = 0; i < threads; ++i) {
+    workers.emplace_back([&] {
+	unsigned n;
+	while ((n = next++) < cfg.pgs) {
+	  load_pg(os, n);
+	}
+      });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, const char **argv)
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--pgs", (char*)nullptr)) {
+      cfg.pgs = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--log-entries", (char*)nullptr)) {
+      cfg.log_entries = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)nullptr)) {
+      cfg.threads = atoi(val.c_str());
+    } else {
+      cerr << "Error: can't understand argument: " << *i << std::endl;
+      exit(1);
+    }
+  }
+  if (!cfg.pgs || !cfg.log_entries || !cfg.threads) {
+    cerr << "Error: --pgs, --log-entries and --threads must be > 0"
+	 << std::endl;
+    exit(1);
+  }
+
+  common_init_finish(g_ceph_context);
+
+  BenchStore os("ceph_bench_pg_load", "memstore");
+  populate(os.get(), cfg);
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned n = 0; n < cfg.pgs; ++n) {
+    epoch_t e;
+    int r = PG::peek_map_epoch(os.get(), make_pgid(n), &e);
+    ceph_assert(r == 0 && e == 1);
+  }
+  double peek = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  double serial = run(os.get(), cfg, 1);
+  double parallel = run(os.get(), cfg, cfg.threads);
+
+  cout << cfg.pgs << " pgs with " << cfg.log_entries << " log entries\n"
+       << "  peek map epochs: " << peek << "s\n"
+       << "  load, 1 thread: " << serial << "s\n"
+       << "  load, " << cfg.threads << " threads: " << parallel << "s"
+       << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,140 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Reports the osd_pglog mempool usage per PG for a given log length,
+ * once with the whole log in memory and once with all but the most
+ * recent entries spilled to disk (osd_pg_log_spill_entries).
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <iostream>
+#include <memory>
+
+#include "common/ceph_argparse.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "osd/PGLog.h"
+
+#define dout_context g_ceph_context
+
+static void usage()
+{
+  cout << "usage: ceph_bench_pglog_mempool [flags]\n"
+    "	 --pgs\n"
+    "	       number of PGs (default 100)\n"
+    "	 --log-entries\n"
+    "	       log entries per PG available for log-based recovery (default 10000)\n"
+    "	 --memory-entries\n"
+    "	       log entries per PG kept in memory when spilling (default 500)\n"
+    "	 --objects\n"
+    "	       distinct objects written per PG (default 1000)\n" << std::endl;
+  generic_server_usage();
+}
+
+struct Config {
+  unsigned pgs = 100;
+  unsigned log_entries = 10000;
+  unsigned memory_entries = 500;
+  unsigned objects = 1000;
+};
+
+// write log_entries + memory_entries ops to each PG, keeping at most
+// keep entries in memory, and report the osd_pglog mempool usage
+static void run(const Config &cfg, const char *name,
+		unsigned keep, unsigned spill)
+{
+  g_conf().set_val_or_die("osd_pg_log_spill_entries", stringify(spill));
+  g_conf().apply_changes(nullptr);
+
+  size_t base_bytes = mempool::osd_pglog::allocated_bytes();
+  size_t base_items = mempool::osd_pglog::allocated_items();
+
+  coll_t coll;
+  ghobject_t log_oid;
+  vector<std::unique_ptr<PGLog>> pglogs;
+  for (unsigned pg = 0; pg < cfg.pgs; ++pg) {
+    pglogs.emplace_back(new PGLog(g_ceph_context));
+    PGLog &pglog = *pglogs.back();
+    pglog.index();
+    pg_info_t info;
+    unsigned ops = cfg.log_entries + cfg.memory_entries;
+    for (unsigned v = 1; v <= ops; ++v) {
+      hobject_t soid(object_t("obj" + stringify(v % cfg.objects)), "",
+		     CEPH_NOSNAP, v % cfg.objects, 1, "");
+      pg_log_entry_t e(
+	pg_log_entry_t::MODIFY, soid, eversion_t(1, v), eversion_t(1, v - 1),
+	v, osd_reqid_t(entity_name_t::CLIENT(pg), 0, v), utime_t(), 0);
+      pglog.add(e, false);
+      info.last_update = info.last_complete = e.version;
+      if (v > keep)
+	pglog.trim(eversion_t(1, v - keep), info);
+
+      ObjectStore::Transaction t;
+      map<string, bufferlist> km;
+      pglog.write_log_and_missing(t, &km, coll, log_oid, false);
+    }
+  }
+
+  size_t bytes = mempool::osd_pglog::allocated_bytes() - base_bytes;
+  size_t items = mempool::osd_pglog::allocated_items() - base_items;
+  cout << name << ": " << keep << " entries in memory, "
+       << spill << " spilled, dups tracked "
+       << g_conf()->osd_pg_log_dups_tracked << "\n"
+       << "  osd_pglog bytes " << bytes << " items " << items << "\n"
+       << "  per PG " << bytes / cfg.pgs << " bytes" << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--pgs", (char*)nullptr)) {
+      cfg.pgs = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--log-entries", (char*)nullptr)) {
+      cfg.log_entries = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--memory-entries", (char*)nullptr)) {
+      cfg.memory_entries = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)nullptr)) {
+      cfg.objects = atoi(val.c_str());
+    } else {
+      cerr << "Error: can't understand argument: " << *i << std::endl;
+      exit(1);
+    }
+  }
+  if (!cfg.pgs || !cfg.objects || cfg.memory_entries > cfg.log_entries) {
+    cerr << "Error: need --pgs, --objects > 0 and "
+	 << "--memory-entries <= --log-entries" << std::endl;
+    exit(1);
+  }
+
+  common_init_finish(g_ceph_context);
+
+  run(cfg, "in-memory", cfg.log_entries, 0);
+  run(cfg, "spill", cfg.memory_entries,
+      cfg.log_entries - cfg.memory_entries);
+  return 0;
+}
@@ -0,0 +1,250 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Replays a snapshot removal storm against MemStore: a PG holds --heads
+ * objects with one clone per snapshot, every snapshot is removed and the
+ * clones are trimmed through the SnapMapper the way the snap trimmer
+ * does.  Runs once trimming one clone per transaction, with
+ * osd_pg_max_concurrent_snap_trims transactions per round, and once
+ * trimming --batch clones per transaction (osd_snap_trim_batch_objects).
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "common/ceph_argparse.h"
+#include "common/errno.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "os/ObjectStore.h"
+#include "osd/SnapMapper.h"
+#include "osd/osd_types.h"
+
+#include "bench_store.h"
+
+#define dout_context g_ceph_context
+
+static void usage()
+{
+  cout << "usage: ceph_bench_snaptrim [flags]\n"
+    "	 --heads\n"
+    "	       head objects in the PG (default 10000)\n"
+    "	 --snaps\n"
+    "	       snapshots, each with one clone of every head (default 4)\n"
+    "	 --object-size\n"
+    "	       clone size in bytes (default 4096)\n"
+    "	 --batch\n"
+    "	       clones per transaction in the batched run (default 256)\n"
+    << std::endl;
+  generic_server_usage();
+}
+
+struct Config {
+  unsigned heads = 10000;
+  unsigned snaps = 4;
+  unsigned object_size = 4096;
+  unsigned batch = 256;
+};
+
+// waits for every queued transaction to commit, as the snap trimmer
+// waits for its repops before starting the next round
+class Commits {
+  std::mutex lock;
+  std::condition_variable cond;
+  unsigned pending = 0;
+public:
+  Context *get() {
+    std::lock_guard<std::mutex> l(lock);
+    ++pending;
+    return new FunctionContext([this](int r) {
+	std::lock_guard<std::mutex> l(lock);
+	--pending;
+	cond.notify_all();
+      });
+  }
+  void wait() {
+    std::unique_lock<std::mutex> l(lock);
+    cond.wait(l, [this] { return pending == 0; });
+  }
+};
+
+struct Result {
+  double seconds = 0;
+  unsigned clones = 0;
+  unsigned transactions = 0;
+};
+
+static Result run(ObjectStore *os, const Config &cfg, pg_t pgid,
+		  unsigned per_round, unsigned per_transaction)
+{
+  const int64_t pool = pgid.pool();
+  const coll_t cid{spg_t(pgid)};
+  const ghobject_t mapper_oid(hobject_t(sobject_t(object_t("snapmapper"),
+						  CEPH_NOSNAP)));
+  ObjectStore::CollectionHandle ch = os->create_new_collection(cid);
+  Commits commits;
+
+  // one clone of every head per snapshot
+  map<hobject_t, SnapSet> heads;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.touch(cid, mapper_oid);
+    os->queue_transaction(ch, std::move(t));
+  }
+  OSDriver driver(os, cid, mapper_oid);
+  SnapMapper mapper(g_ceph_context, &driver, 0, 0, pool, shard_id_t::NO_SHARD);
+  bufferlist data;
+  data.append_zero(cfg.object_size);
+  for (unsigned h = 0; h < cfg.heads; ++h) {
+    ObjectStore::Transaction t;
+    OSDriver::OSTransaction mt(driver.get_transaction(&t));
+    hobject_t head(object_t("rbd_data." + stringify(h)), "", CEPH_NOSNAP,
+		   h * 2654435761u, pool, "");
+    SnapSet &ss = heads[head];
+    for (unsigned s = 1; s <= cfg.snaps; ++s) {
+      hobject_t clone = head;
+      clone.snap = s;
+      t.write(cid, ghobject_t(clone), 0, data.length(), data);
+      mapper.add_oid(clone, {snapid_t(s)}, &mt);
+      ss.clones.push_back(s);
+      ss.clone_snaps[s] = {snapid_t(s)};
+      ss.clone_size[s] = cfg.object_size;
+      ss.clone_overlap[s];
+    }
+    ss.seq = cfg.snaps;
+    bufferlist bl;
+    encode(ss, bl);
+    t.write(cid, ghobject_t(head), 0, data.length(), data);
+    t.setattr(cid, ghobject_t(head), SS_ATTR, bl);
+    t.register_on_commit(commits.get());
+    os->queue_transaction(ch, std::move(t));
+  }
+  commits.wait();
+
+  // remove every snapshot
+  Result r;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned s = 1; s <= cfg.snaps; ++s) {
+    while (true) {
+      vector<hobject_t> to_trim;
+      int ret = mapper.get_next_objects_to_trim(
+	s, per_round * per_transaction, &to_trim);
+      if (ret == -ENOENT)
+	break;
+      ceph_assert(ret == 0);
+      for (size_t i = 0; i < to_trim.size(); i += per_transaction) {
+	ObjectStore::Transaction t;
+	OSDriver::OSTransaction mt(driver.get_transaction(&t));
+	set<hobject_t> dirty;
+	for (size_t j = i; j < to_trim.size() && j < i + per_transaction; ++j) {
+	  const hobject_t &clone = to_trim[j];
+	  t.remove(cid, ghobject_t(clone));
+	  ret = mapper.remove_oid(clone, &mt);
+	  ceph_assert(ret == 0);
+	  SnapSet &ss = heads[clone.get_head()];
+	  ss.clones.erase(std::find(ss.clones.begin(), ss.clones.end(),
+				    clone.snap));
+	  ss.clone_snaps.erase(clone.snap);
+	  ss.clone_size.erase(clone.snap);
+	  ss.clone_overlap.erase(clone.snap);
+	  dirty.insert(clone.get_head());
+	  ++r.clones;
+	}
+	// each head's SnapSet is written once per transaction
+	for (auto &head : dirty) {
+	  bufferlist bl;
+	  encode(heads[head], bl);
+	  t.setattr(cid, ghobject_t(head), SS_ATTR, bl);
+	}
+	t.register_on_commit(commits.get());
+	os->queue_transaction(ch, std::move(t));
+	++r.transactions;
+      }
+      commits.wait();
+    }
+  }
+  r.seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  ObjectStore::Transaction t;
+  for (auto &p : heads)
+    t.remove(cid, ghobject_t(p.first));
+  t.remove(cid, mapper_oid);
+  t.remove_collection(cid);
+  t.register_on_commit(commits.get());
+  os->queue_transaction(ch, std::move(t));
+  commits.wait();
+  return r;
+}
+
+static void report(const char *name, const Result &r)
+{
+  cout << "  " << name << ": " << r.clones << " clones in " << r.seconds
+       << "s, " << (uint64_t)(r.clones / r.seconds) << " clones/s, "
+       << r.transactions << " transactions" << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--heads", (char*)nullptr)) {
+      cfg.heads = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--snaps", (char*)nullptr)) {
+      cfg.snaps = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--object-size", (char*)nullptr)) {
+      cfg.object_size = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--batch", (char*)nullptr)) {
+      cfg.batch = atoi(val.c_str());
+    } else {
+      cerr << "Error: can't understand argument: " << *i << std::endl;
+      exit(1);
+    }
+  }
+  if (!cfg.heads || !cfg.snaps || !cfg.batch) {
+    cerr << "Error: --heads, --snaps and --batch must be > 0" << std::endl;
+    exit(1);
+  }
+
+  common_init_finish(g_ceph_context);
+
+  BenchStore os("ceph_bench_snaptrim", "memstore");
+
+  cout << cfg.heads << " heads, " << cfg.snaps << " snapshots, "
+       << cfg.object_size << " byte clones" << std::endl;
+  report("one clone per transaction",
+	 run(os.get(), cfg, pg_t(0, 1), g_conf()->osd_pg_max_concurrent_snap_trims, 1));
+  report((stringify(cfg.batch) + " clones per transaction").c_str(),
+	 run(os.get(), cfg, pg_t(1, 1), 1, cfg.batch));
+
+  return 0;
+}
@@ -0,0 +1,220 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Times a PG split the way OSD::split_pgs() does it: a collection of
+ * --objects objects is split into 2^--bits PGs with one
+ * split_collection per child in a single transaction, and a PG log of
+ * --log-entries entries is split into the children.  With --merge the
+ * children are merged back afterwards.  BlueStore splits by changing
+ * the collections' hash bits, so its split time should not grow with
+ * --objects.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "common/ceph_argparse.h"
+#include "common/errno.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "os/ObjectStore.h"
+#include "osd/PGLog.h"
+
+#include "bench_store.h"
+
+#define dout_context g_ceph_context
+
+static void usage()
+{
+  cout << "usage: ceph_bench_split [flags]\n"
+    "	 --type\n"
+    "	       objectstore type (default bluestore)\n"
+    "	 --objects\n"
+    "	       objects in the parent collection (default 1000000)\n"
+    "	 --bits\n"
+    "	       split the parent into 2^bits PGs (default 3)\n"
+    "	 --log-entries\n"
+    "	       entries in the parent's PG log (default 3000)\n"
+    "	 --merge\n"
+    "	       merge the children back into the parent afterwards\n"
+    << std::endl;
+  generic_server_usage();
+}
+
+struct Config {
+  string type = "bluestore";
+  unsigned objects = 1000000;
+  unsigned bits = 3;
+  unsigned log_entries = 3000;
+  bool merge = false;
+};
+
+class Commit {
+  std::mutex lock;
+  std::condition_variable cond;
+  bool done = false;
+public:
+  Context *get() {
+    return new FunctionContext([this](int r) {
+	std::lock_guard<std::mutex> l(lock);
+	done = true;
+	cond.notify_all();
+      });
+  }
+  void wait() {
+    std::unique_lock<std::mutex> l(lock);
+    cond.wait(l, [this] { return done; });
+    done = false;
+  }
+};
+
+static double since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+static hobject_t make_oid(unsigned n)
+{
+  return hobject_t(object_t("rbd_data." + stringify(n)), "", CEPH_NOSNAP,
+		   n * 2654435761u, 1, "");
+}
+
+static void split_log(const Config &cfg)
+{
+  PGLog parent(g_ceph_context);
+  for (unsigned v = 1; v <= cfg.log_entries; ++v) {
+    pg_log_entry_t e(
+      pg_log_entry_t::MODIFY, make_oid(v), eversion_t(1, v),
+      eversion_t(1, v - 1), v, osd_reqid_t(entity_name_t::CLIENT(1), 0, v),
+      utime_t(), 0);
+    parent.add(e);
+  }
+  parent.index();
+  vector<std::unique_ptr<PGLog>> children;
+  for (unsigned seed = 1; seed < (1u << cfg.bits); ++seed) {
+    children.emplace_back(new PGLog(g_ceph_context));
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned seed = 1; seed < (1u << cfg.bits); ++seed) {
+    parent.split_into(pg_t(seed, 1), cfg.bits, children[seed - 1].get());
+  }
+  cout << "  split pg log of " << cfg.log_entries << " entries: "
+       << since(start) << "s" << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--type", (char*)nullptr)) {
+      cfg.type = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)nullptr)) {
+      cfg.objects = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--bits", (char*)nullptr)) {
+      cfg.bits = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--log-entries", (char*)nullptr)) {
+      cfg.log_entries = atoi(val.c_str());
+    } else if (ceph_argparse_flag(args, i, "--merge", (char*)nullptr)) {
+      cfg.merge = true;
+    } else {
+      cerr << "Error: can't understand argument: " << *i << std::endl;
+      exit(1);
+    }
+  }
+  if (!cfg.objects || !cfg.bits || cfg.bits > 16) {
+    cerr << "Error: need --objects > 0 and 0 < --bits <= 16" << std::endl;
+    exit(1);
+  }
+
+  common_init_finish(g_ceph_context);
+
+  BenchStore os("ceph_bench_split", cfg.type);
+
+  // the parent pg 1.0 of a pool with pg_num 1
+  const coll_t parent(spg_t(pg_t(0, 1)));
+  ObjectStore::CollectionHandle ch = os->create_new_collection(parent);
+  Commit commit;
+  auto start = std::chrono::steady_clock::now();
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(parent, 0);
+    os->queue_transaction(ch, std::move(t));
+  }
+  for (unsigned n = 0; n < cfg.objects; ) {
+    ObjectStore::Transaction t;
+    for (unsigned j = 0; j < 1000 && n < cfg.objects; ++j, ++n) {
+      t.touch(parent, ghobject_t(make_oid(n)));
+    }
+    if (n == cfg.objects) {
+      t.register_on_commit(commit.get());
+    }
+    os->queue_transaction(ch, std::move(t));
+  }
+  commit.wait();
+  cout << cfg.type << ": " << cfg.objects << " objects created in "
+       << since(start) << "s" << std::endl;
+
+  // one transaction, like the PeeringCtx of OSD::split_pgs()
+  vector<coll_t> children;
+  vector<ObjectStore::CollectionHandle> child_chs;
+  start = std::chrono::steady_clock::now();
+  {
+    ObjectStore::Transaction t;
+    for (unsigned seed = 1; seed < (1u << cfg.bits); ++seed) {
+      children.push_back(coll_t(spg_t(pg_t(seed, 1))));
+      child_chs.push_back(os->create_new_collection(children.back()));
+      t.create_collection(children.back(), cfg.bits);
+      t.split_collection(parent, cfg.bits, seed, children.back());
+    }
+    t.register_on_commit(commit.get());
+    os->queue_transaction(ch, std::move(t));
+  }
+  commit.wait();
+  cout << "  split into " << (1u << cfg.bits) << " pgs: " << since(start)
+       << "s" << std::endl;
+
+  split_log(cfg);
+
+  if (cfg.merge) {
+    start = std::chrono::steady_clock::now();
+    ObjectStore::Transaction t;
+    for (auto &c : children) {
+      t.merge_collection(c, parent, 0);
+    }
+    t.register_on_commit(commit.get());
+    os->queue_transaction(ch, std::move(t));
+    commit.wait();
+    cout << "  merge back into 1 pg: " << since(start) << "s" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_TEST_OSD_BENCH_STORE_H
+#define CEPH_TEST_OSD_BENCH_STORE_H
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "common/errno.h"
+#include "global/global_context.h"
+#include "os/ObjectStore.h"
+
+/**
+ * BenchTmpDir - a scratch directory for the ceph_bench_* tools
+ *
+ * Created as /tmp/<name>.XXXXXX and removed with its contents when
+ * the bench is done.  StoreTestFixture does the same for the gtest
+ * based tests, but the benches have their own main().
+ */
+class BenchTmpDir {
+  std::string path;
+
+public:
+  explicit BenchTmpDir(const std::string &name) {
+    std::string templ = "/tmp/" + name + ".XXXXXX";
+    if (!::mkdtemp(templ.data())) {
+      std::cerr << "Error: mkdtemp: " << cpp_strerror(errno) << std::endl;
+      exit(1);
+    }
+    path = templ;
+  }
+  ~BenchTmpDir() {
+    std::string cmd = "rm -r " + path;
+    if (::system(cmd.c_str()) != 0) {
+      std::cerr << "Error: unable to remove " << path << std::endl;
+    }
+  }
+  BenchTmpDir(const BenchTmpDir&) = delete;
+  BenchTmpDir& operator=(const BenchTmpDir&) = delete;
+
+  const std::string& get_path() const {
+    return path;
+  }
+};
+
+/**
+ * BenchStore - an ObjectStore of the given type, mounted in a
+ * BenchTmpDir, unmounted and removed again by the destructor
+ */
+class BenchStore {
+  BenchTmpDir dir;
+  std::unique_ptr<ObjectStore> os;
+
+public:
+  BenchStore(const std::string &name, const std::string &type)
+    : dir(name),
+      os(ObjectStore::create(g_ceph_context, type, dir.get_path(), "")) {
+    if (!os || os->mkfs() < 0 || os->mount() < 0) {
+      std::cerr << "Error: unable to create " << type << " in "
+		<< dir.get_path() << std::endl;
+      exit(1);
+    }
+  }
+  ~BenchStore() {
+    os->umount();
+  }
+
+  ObjectStore* get() const {
+    return os.get();
+  }
+  ObjectStore* operator->() const {
+    return os.get();
+  }
+};
+
+#endif
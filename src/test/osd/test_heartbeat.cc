@@ -0,0 +1,349 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Fast heartbeat mode: round trip time tracking, the per peer
+ * HeartbeatInfo bookkeeping, and two OSDs pinging each other over local
+ * messengers with it the way OSD::heartbeat() and OSD::heartbeat_check()
+ * do.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "common/ceph_argparse.h"
+#include "common/ceph_context.h"
+#include "common/Clock.h"
+#include "global/global_init.h"
+#include "messages/MOSDPing.h"
+#include "msg/Dispatcher.h"
+#include "msg/Messenger.h"
+#include "mon/OSDMonitor.h"
+#include "osd/HeartbeatInfo.h"
+
+static utime_t msec(double ms)
+{
+  utime_t t;
+  t.set_from_double(ms / 1000.0);
+  return t;
+}
+
+TEST(HeartbeatRTT, percentile)
+{
+  HeartbeatRTT rtt;
+  ASSERT_EQ(utime_t(), rtt.percentile(.99));
+  for (unsigned i = 0; i < 99; ++i) {
+    rtt.add(msec(.1));
+  }
+  rtt.add(msec(10));
+  // bins are powers of two of microseconds
+  ASSERT_NEAR(.000128, (double)rtt.percentile(.5), 1e-9);
+  ASSERT_NEAR(.000128, (double)rtt.percentile(.99), 1e-9);
+  ASSERT_NEAR(.016384, (double)rtt.percentile(1), 1e-9);
+  ASSERT_EQ(100u, rtt.get_samples());
+  ASSERT_EQ(msec(10), rtt.get_last());
+}
+
+TEST(HeartbeatRTT, grace)
+{
+  HeartbeatRTT rtt;
+  // no trusted samples yet
+  ASSERT_EQ(20.0, rtt.get_grace(20, .5, 20));
+  for (unsigned i = 0; i < HeartbeatRTT::MIN_SAMPLES; ++i) {
+    rtt.add(msec(.1));
+  }
+  // 20 * .128ms is below the minimum
+  ASSERT_EQ(.5, rtt.get_grace(20, .5, 20));
+  ASSERT_NEAR(.00256, rtt.get_grace(20, 0, 20), 1e-9);
+  for (unsigned i = 0; i < 1000; ++i) {
+    rtt.add(msec(100));
+  }
+  // 20 * 131.072ms
+  ASSERT_NEAR(2.62144, rtt.get_grace(20, .5, 20), 1e-9);
+  ASSERT_EQ(1.0, rtt.get_grace(20, .5, 1));
+}
+
+TEST(HeartbeatRTT, decay)
+{
+  HeartbeatRTT rtt;
+  for (unsigned i = 0; i < HeartbeatRTT::DECAY_SAMPLES; ++i) {
+    rtt.add(msec(100));
+  }
+  // a peer that got fast again stops being judged by its old slowness
+  for (unsigned i = 0; i < 8 * HeartbeatRTT::DECAY_SAMPLES; ++i) {
+    rtt.add(msec(.1));
+  }
+  ASSERT_NEAR(.000128, (double)rtt.percentile(.99), 1e-9);
+}
+
+// answers pings, like the heartbeat dispatcher of the peer OSD
+class Responder : public Dispatcher {
+public:
+  uuid_d fsid;
+  explicit Responder(CephContext *cct) : Dispatcher(cct) {}
+
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == MSG_OSD_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    auto ping = static_cast<MOSDPing*>(m);
+    if (ping->op == MOSDPing::PING) {
+      m->get_connection()->send_message(
+	new MOSDPing(fsid, 1, MOSDPing::PING_REPLY, ping->stamp, 0));
+    }
+    m->put();
+  }
+  bool ms_dispatch(Message *m) override {
+    ms_fast_dispatch(m);
+    return true;
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return true; }
+};
+
+// sends pings and tracks their replies with the HeartbeatInfo of the
+// peer, like OSD::heartbeat() and OSD::handle_osd_ping() do
+class Pinger : public Dispatcher {
+  std::mutex lock;
+  HeartbeatInfo hi;
+
+public:
+  uuid_d fsid;
+  explicit Pinger(CephContext *cct) : Dispatcher(cct) {
+    hi.peer = 1;
+    hi.epoch = 1;
+  }
+
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == MSG_OSD_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    auto ping = static_cast<MOSDPing*>(m);
+    if (ping->op == MOSDPing::PING_REPLY) {
+      std::lock_guard<std::mutex> l(lock);
+      hi.handle_reply(m->get_connection().get(), ping->stamp,
+		      ceph_clock_now());
+    }
+    m->put();
+  }
+  bool ms_dispatch(Message *m) override {
+    ms_fast_dispatch(m);
+    return true;
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return true; }
+
+  /// heartbeat over the back connection only, as with no front network
+  void set_con(ConnectionRef con) {
+    std::lock_guard<std::mutex> l(lock);
+    hi.con_back = con;
+  }
+  void ping() {
+    utime_t now = ceph_clock_now();
+    ConnectionRef con;
+    {
+      std::lock_guard<std::mutex> l(lock);
+      utime_t deadline = now;
+      deadline += hi.get_fast_grace(g_conf());
+      hi.sent_ping(now, deadline);
+      con = hi.con_back;
+    }
+    con->send_message(new MOSDPing(fsid, 1, MOSDPing::PING, now, 0));
+  }
+  bool is_unhealthy(utime_t now) {
+    std::lock_guard<std::mutex> l(lock);
+    return hi.is_unhealthy(now);
+  }
+  bool is_healthy(utime_t now) {
+    std::lock_guard<std::mutex> l(lock);
+    return hi.is_healthy(now);
+  }
+  unsigned get_samples() {
+    std::lock_guard<std::mutex> l(lock);
+    return hi.rtt_back.get_samples();
+  }
+};
+
+// stands in for a heartbeat connection; only its identity matters
+class NullConnection : public Connection {
+public:
+  explicit NullConnection(CephContext *cct) : Connection(cct, nullptr) {}
+  bool is_connected() override { return true; }
+  int send_message(Message *m) override {
+    m->put();
+    return 0;
+  }
+  void send_keepalive() override {}
+  void mark_down() override {}
+  void mark_disposable() override {}
+  entity_addr_t get_peer_socket_addr() const override {
+    return entity_addr_t();
+  }
+};
+
+TEST(HeartbeatInfo, replies)
+{
+  HeartbeatInfo hi;
+  ConnectionRef back(new NullConnection(g_ceph_context));
+  ConnectionRef front(new NullConnection(g_ceph_context));
+  hi.con_back = back;
+  hi.con_front = front;
+
+  utime_t t0(100, 0), t1(101, 0);
+  hi.sent_ping(t0, t0 + msec(500));
+  hi.sent_ping(t1, t1 + msec(500));
+  ASSERT_EQ(t0, hi.first_tx);
+  ASSERT_EQ(t1, hi.last_tx);
+  ASSERT_FALSE(hi.is_unhealthy(t0 + msec(400)));
+  ASSERT_TRUE(hi.is_unhealthy(t0 + msec(600)));
+
+  // a ping is only done once both connections answered it
+  ASSERT_TRUE(hi.handle_reply(back.get(), t1, t1 + msec(1)));
+  ASSERT_EQ(2u, hi.ping_history.size());
+  ASSERT_FALSE(hi.is_healthy(t1 + msec(1)));
+  ASSERT_TRUE(hi.handle_reply(front.get(), t1, t1 + msec(2)));
+  // ... and answering it covers the older ones
+  ASSERT_TRUE(hi.ping_history.empty());
+  ASSERT_TRUE(hi.is_healthy(t1 + msec(600)));
+  ASSERT_FALSE(hi.handle_reply(back.get(), t0, t1 + msec(3)));
+  ASSERT_EQ(1u, hi.rtt_back.get_samples());
+  ASSERT_EQ(1u, hi.rtt_front.get_samples());
+  ASSERT_EQ(msec(2), hi.rtt_front.get_last());
+
+  // without a front connection the back reply counts for both
+  hi.con_front.reset();
+  utime_t t2(102, 0);
+  hi.sent_ping(t2, t2 + msec(500));
+  ASSERT_TRUE(hi.handle_reply(back.get(), t2, t2 + msec(1)));
+  ASSERT_TRUE(hi.ping_history.empty());
+  ASSERT_EQ(t2 + msec(1), hi.last_rx_front);
+}
+
+TEST(HeartbeatInfo, fast_grace)
+{
+  HeartbeatInfo hi;
+  hi.con_back.reset(new NullConnection(g_ceph_context));
+  const double max_grace = g_conf()->osd_heartbeat_grace;
+  const double min_grace = g_conf()->osd_heartbeat_fast_grace;
+  // untrusted until enough samples arrived
+  ASSERT_EQ(max_grace, hi.get_fast_grace(g_conf()));
+  for (unsigned i = 0; i < HeartbeatRTT::MIN_SAMPLES; ++i) {
+    hi.rtt_back.add(msec(.1));
+  }
+  ASSERT_EQ(min_grace, hi.get_fast_grace(g_conf()));
+  // a slow front network widens the grace
+  hi.con_front.reset(new NullConnection(g_ceph_context));
+  for (unsigned i = 0; i < HeartbeatRTT::MIN_SAMPLES; ++i) {
+    hi.rtt_front.add(utime_t(1, 0));
+  }
+  ASSERT_LT(min_grace, hi.get_fast_grace(g_conf()));
+  ASSERT_GE(max_grace, hi.get_fast_grace(g_conf()));
+}
+
+TEST(Heartbeat, all_fast)
+{
+  // the mon only skips its own grace adjustment when every reporter
+  // already applied a fast grace
+  failure_info_t fi;
+  ASSERT_FALSE(fi.all_fast());
+  fi.add_report(1, utime_t(100, 0), MonOpRequestRef(), true);
+  ASSERT_TRUE(fi.all_fast());
+  fi.add_report(2, utime_t(101, 0), MonOpRequestRef(), false);
+  ASSERT_FALSE(fi.all_fast());
+  fi.cancel_report(2);
+  ASSERT_TRUE(fi.all_fast());
+}
+
+TEST(Heartbeat, FastFailureDetection)
+{
+  const double interval = .02;
+  const double min_grace = g_conf()->osd_heartbeat_fast_grace;
+  const double max_grace = g_conf()->osd_heartbeat_grace;
+
+  std::unique_ptr<Messenger> a(Messenger::create(
+    g_ceph_context, "async+posix", entity_name_t::OSD(0), "hb_a", getpid(), 0));
+  std::unique_ptr<Messenger> b(Messenger::create(
+    g_ceph_context, "async+posix", entity_name_t::OSD(1), "hb_b", getpid(), 0));
+  a->set_policy(entity_name_t::TYPE_OSD, Messenger::Policy::lossy_client(0));
+  b->set_policy(entity_name_t::TYPE_OSD, Messenger::Policy::stateless_server(0));
+
+  Pinger pinger(g_ceph_context);
+  Responder responder(g_ceph_context);
+  entity_addr_t addr;
+  // let the kernel pick the ports, the peer address is read back below
+  addr.parse("v2:127.0.0.1:0");
+  ASSERT_EQ(0, a->bind(addr));
+  a->add_dispatcher_head(&pinger);
+  a->start();
+  ASSERT_EQ(0, b->bind(addr));
+  b->add_dispatcher_head(&responder);
+  b->start();
+
+  ASSERT_NE(0, b->get_myaddrs().front().get_port());
+  pinger.set_con(a->connect_to(b->get_mytype(), b->get_myaddrs()));
+
+  // a healthy peer never misses a deadline, even once the grace has
+  // shrunk to a multiple of the loopback round trip time
+  auto until = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+  while (std::chrono::steady_clock::now() < until) {
+    pinger.ping();
+    std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    ASSERT_FALSE(pinger.is_unhealthy(ceph_clock_now()));
+  }
+  ASSERT_TRUE(pinger.is_healthy(ceph_clock_now()));
+  ASSERT_GE(pinger.get_samples(), HeartbeatRTT::MIN_SAMPLES);
+
+  // the peer dies: it is noticed within the fast grace, not within
+  // osd_heartbeat_grace
+  b->shutdown();
+  b->wait();
+  utime_t died = ceph_clock_now();
+  utime_t detected;
+  while (true) {
+    pinger.ping();
+    std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    utime_t now = ceph_clock_now();
+    if (pinger.is_unhealthy(now)) {
+      detected = now;
+      break;
+    }
+    ASSERT_LT((double)(now - died), max_grace);
+  }
+  ASSERT_LT((double)(detected - died), min_grace + 5 * interval);
+
+  a->shutdown();
+  a->wait();
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  g_ceph_context->_conf.set_val("auth_cluster_required", "none");
+  g_ceph_context->_conf.set_val("auth_service_required", "none");
+  g_ceph_context->_conf.set_val("auth_client_required", "none");
+  g_ceph_context->_conf.set_val("keyring", "/dev/null");
+  common_init_finish(g_ceph_context);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
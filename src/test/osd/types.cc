@@ -1326,6 +1326,85 @@ TEST(pg_missing_t, split_into)
   EXPECT_TRUE(missing.is_missing(oid2));
 }
 
+TEST(pg_log_entry_chunk_t, encode_decode)
+{
+  pg_log_entry_chunk_t chunk;
+  bufferlist individual;
+  entity_name_t client = entity_name_t::CLIENT(777);
+  for (unsigned v = 1; v <= 16; ++v) {
+    hobject_t oid(object_t("obj" + stringify(v % 5)), "", CEPH_NOSNAP,
+		  v % 5, 1, "");
+    pg_log_entry_t e(v % 4 ? pg_log_entry_t::MODIFY : pg_log_entry_t::DELETE,
+		     oid, eversion_t(10 + v / 8, 100 + v),
+		     eversion_t(10, 90 + v), 100 + v,
+		     osd_reqid_t(client, 1, 1000 + v), utime_t(v, 0), 0);
+    if (v == 7) {
+      e.op = pg_log_entry_t::ERROR;
+      e.return_code = -ENOENT;
+    }
+    if (v == 9) {
+      e.op = pg_log_entry_t::LOST_REVERT;
+      e.reverting_to = eversion_t(9, 50);
+    }
+    if (v == 11) {
+      e.reqid = osd_reqid_t(entity_name_t::CLIENT(778), 3, 5);
+      e.extra_reqids.push_back(make_pair(osd_reqid_t(client, 1, 999), 99));
+      e.extra_reqid_return_codes[0] = -EEXIST;
+    }
+    e.encode_with_checksum(individual);
+    chunk.entries.push_back(e);
+  }
+  EXPECT_EQ("chunk_0000000010.00000000000000000101", chunk.get_key_name());
+
+  bufferlist bl;
+  encode(chunk, bl);
+  // deltas make the chunk smaller than the individual encodings
+  EXPECT_LT(bl.length(), individual.length());
+
+  pg_log_entry_chunk_t decoded;
+  auto p = bl.cbegin();
+  decode(decoded, p);
+  ASSERT_EQ(chunk.entries.size(), decoded.entries.size());
+  for (auto i = chunk.entries.begin(), j = decoded.entries.begin();
+       i != chunk.entries.end();
+       ++i, ++j) {
+    bufferlist a, b;
+    i->encode(a);
+    j->encode(b);
+    EXPECT_TRUE(a.contents_equal(b)) << *i << " != " << *j;
+  }
+
+  // corruption is detected
+  bufferlist bad;
+  bad.append(bl.c_str(), bl.length());
+  bad.c_str()[bad.length() / 2] ^= 0xff;
+  p = bad.cbegin();
+  EXPECT_THROW(decode(decoded, p), buffer::error);
+}
+
+TEST(pg_log_dup_chunk_t, encode_decode)
+{
+  pg_log_dup_chunk_t chunk;
+  entity_name_t client = entity_name_t::CLIENT(777);
+  for (unsigned v = 1; v <= 8; ++v) {
+    chunk.dups.push_back(
+      pg_log_dup_t(eversion_t(10, 100 + v), 100 + v,
+		   osd_reqid_t(client, 1, 1000 + v), 0));
+  }
+  // extra reqids share the version of the op they belong to
+  chunk.dups.push_back(
+    pg_log_dup_t(eversion_t(10, 108), 7,
+		 osd_reqid_t(entity_name_t::CLIENT(778), 2, 3), -ENOENT));
+  EXPECT_EQ("dupchunk_0000000010.00000000000000000101", chunk.get_key_name());
+
+  bufferlist bl;
+  encode(chunk, bl);
+  pg_log_dup_chunk_t decoded;
+  auto p = bl.cbegin();
+  decode(decoded, p);
+  EXPECT_EQ(chunk.dups, decoded.dups);
+}
+
 TEST(pg_pool_t_test, get_pg_num_divisor) {
   pg_pool_t p;
   p.set_pg_num(16);
@@ -1888,6 +1967,94 @@ TEST_F(PITest, past_intervals_ec_lost) {
 }
 
 
+static object_info_t unchanged_oi(const hobject_t& hoid, eversion_t v,
+				  uint64_t size)
+{
+  object_info_t oi(hoid);
+  oi.version = v;
+  oi.size = size;
+  oi.set_data_digest(0x1234);
+  return oi;
+}
+
+TEST(ScrubMapBuilder, deep_unchanged)
+{
+  hobject_t hoid(object_t("foo"), "", CEPH_NOSNAP, 0x42, 1, "");
+  ScrubMapBuilder pos;
+  pos.deep = true;
+
+  // no checkpoint: always read
+  EXPECT_FALSE(pos.deep_unchanged(hoid, unchanged_oi(hoid, eversion_t(3, 10),
+						     4096), 4096));
+
+  pos.deep_since = eversion_t(3, 10);
+  // at or before the checkpoint
+  EXPECT_TRUE(pos.deep_unchanged(hoid, unchanged_oi(hoid, eversion_t(3, 10),
+						    4096), 4096));
+  EXPECT_TRUE(pos.deep_unchanged(hoid, unchanged_oi(hoid, eversion_t(2, 20),
+						    4096), 4096));
+  // written since
+  EXPECT_FALSE(pos.deep_unchanged(hoid, unchanged_oi(hoid, eversion_t(3, 11),
+						     4096), 4096));
+  EXPECT_FALSE(pos.deep_unchanged(hoid, unchanged_oi(hoid, eversion_t(4, 1),
+						     4096), 4096));
+  // on-disk size does not match the object_info
+  EXPECT_FALSE(pos.deep_unchanged(hoid, unchanged_oi(hoid, eversion_t(3, 10),
+						     4096), 8192));
+  // no data digest
+  object_info_t oi = unchanged_oi(hoid, eversion_t(3, 10), 4096);
+  oi.clear_data_digest();
+  EXPECT_FALSE(pos.deep_unchanged(hoid, oi, 4096));
+
+  // everything is re-read at 100%
+  pos.deep_reread_ppm = 1000000;
+  EXPECT_FALSE(pos.deep_unchanged(hoid, unchanged_oi(hoid, eversion_t(3, 10),
+						     4096), 4096));
+}
+
+TEST(ScrubMapBuilder, deep_reread_selection)
+{
+  const unsigned num = 10000;
+  std::vector<hobject_t> objects;
+  for (unsigned i = 0; i < num; i++) {
+    objects.emplace_back(object_t("obj" + stringify(i)), "", CEPH_NOSNAP,
+			 i * 0x9e3779b1, 1, "");
+  }
+  auto selected = [&](uint32_t seed, uint32_t ppm) {
+    // a shard scanning the objects with this seed and ratio
+    ScrubMapBuilder pos;
+    pos.deep = true;
+    pos.deep_since = eversion_t(5, 100);
+    pos.deep_seed = seed;
+    pos.deep_reread_ppm = ppm;
+    std::set<hobject_t> reread;
+    for (auto& hoid : objects) {
+      if (!pos.deep_unchanged(hoid, unchanged_oi(hoid, eversion_t(5, 1), 0),
+			      0)) {
+	reread.insert(hoid);
+      }
+    }
+    return reread;
+  };
+
+  // every shard of the PG gets the same seed from the primary and so
+  // re-reads the same objects
+  auto primary = selected(12345, 100000);
+  auto replica = selected(12345, 100000);
+  EXPECT_EQ(primary, replica);
+
+  // roughly the requested share
+  EXPECT_GT(primary.size(), num * 8 / 100);
+  EXPECT_LT(primary.size(), num * 12 / 100);
+
+  // a new seed rotates the selection
+  auto next = selected(54321, 100000);
+  EXPECT_NE(primary, next);
+
+  EXPECT_TRUE(selected(12345, 0).empty());
+  EXPECT_EQ(num, selected(12345, 1000000).size());
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ;
@@ -93,6 +93,8 @@ TYPE_FEATUREFUL(pg_query_t)
 TYPE(ObjectModDesc)
 TYPE(pg_log_entry_t)
 TYPE(pg_log_dup_t)
+TYPE(pg_log_entry_chunk_t)
+TYPE(pg_log_dup_chunk_t)
 TYPE(pg_log_t)
 TYPE_FEATUREFUL(pg_missing_item)
 TYPE_FEATUREFUL(pg_missing_t)
@@ -529,6 +529,17 @@ int do_trim_pg_log(ObjectStore *store, const coll_t &coll,
   eversion_t new_tail;
   bool done = false;
 
+  // in the compact format the oldest entries are in chunks, which sort
+  // after the individual keys
+  bool chunked = false;
+  {
+    ObjectMap::ObjectMapIterator p = store->get_omap_iterator(ch, oid);
+    if (p) {
+      p->lower_bound("chunk_");
+      chunked = p->valid() && pg_log_entry_chunk_t::is_key_name(p->key());
+    }
+  }
+
   while (!done) {
     // gather keys so we can delete them in a batch without
     // affecting the iterator
@@ -552,9 +563,36 @@ int do_trim_pg_log(ObjectStore *store, const coll_t &coll,
 	continue;
       if (p->key().substr(0, 4) == string("dup_"))
 	continue;
+      if (pg_log_dup_chunk_t::is_key_name(p->key()))
+	continue;
 
       bufferlist bl = p->value();
       auto bp = bl.cbegin();
+      if (pg_log_entry_chunk_t::is_key_name(p->key())) {
+	// compact log format: chunks hold the oldest entries and can
+	// only be removed as a whole
+	pg_log_entry_chunk_t chunk;
+	try {
+	  decode(chunk, bp);
+	} catch (const buffer::error &e) {
+	  cerr << "Error reading pg log chunk: " << e << std::endl;
+	  continue;
+	}
+	if (chunk.entries.empty() ||
+	    chunk.entries.back().version.version > trim_to) {
+	  done = true;
+	  break;
+	}
+	if (debug) {
+	  cerr << "read chunk " << chunk.entries.front().version << "~"
+	       << chunk.entries.back().version << std::endl;
+	}
+	keys_to_trim.insert(p->key());
+	new_tail = std::max(new_tail, chunk.entries.back().version);
+	if (keys_to_trim.size() >= trim_at_once)
+	  break;
+	continue;
+      }
       pg_log_entry_t e;
       try {
 	e.decode_with_checksum(bp);
@@ -565,11 +603,15 @@ int do_trim_pg_log(ObjectStore *store, const coll_t &coll,
 	cerr << "read entry " << e << std::endl;
       }
       if (e.version.version > trim_to) {
-	done = true;
-	break;
+	if (!chunked) {
+	  done = true;
+	  break;
+	}
+	// individual keys sort before any chunks, but hold newer entries
+	continue;
       }
       keys_to_trim.insert(p->key());
-      new_tail = e.version;
+      new_tail = std::max(new_tail, e.version);
       if (keys_to_trim.size() >= trim_at_once)
 	break;
     }
@@ -208,6 +208,8 @@ void usage()
   cout << "      [--simulate]       simulate placements using a random\n";
   cout << "                         number generator in place of the CRUSH\n";
   cout << "                         algorithm\n";
+  cout << "      [--bench-straw2]   time the mappings with straw2 items hashed\n";
+  cout << "                         one at a time and several at a time\n";
   cout << "   --show-utilization    show OSD usage\n";
   cout << "   --show-utilization-all\n";
   cout << "                         include zero weight items\n";
@@ -430,6 +432,7 @@ int main(int argc, const char **argv)
   map<string,string> set_subtree_class;     // bucket -> class
 
   string compare;
+  bool bench_straw2 = false;
 
   CrushWrapper crush;
 
@@ -537,6 +540,8 @@ int main(int argc, const char **argv)
     } else if (ceph_argparse_witharg(args, i, &full_location, err, "--show-location", (char*)NULL)) {
     } else if (ceph_argparse_flag(args, i, "-s", "--simulate", (char*)NULL)) {
       tester.set_random_placement();
+    } else if (ceph_argparse_flag(args, i, "--bench-straw2", (char*)NULL)) {
+      bench_straw2 = true;
     } else if (ceph_argparse_flag(args, i, "--enable-unsafe-tunables", (char*)NULL)) {
       unsafe_tunables = true;
     } else if (ceph_argparse_witharg(args, i, &choose_local_tries, err,
@@ -826,7 +831,8 @@ int main(int argc, const char **argv)
     }
   }
 
-  if (test && !check && !display && !write_to_file && compare.empty()) {
+  if (test && !check && !display && !write_to_file && compare.empty() &&
+      !bench_straw2) {
     cerr << "WARNING: no output selected; use --output-csv or --show-X" << std::endl;
   }
 
@@ -1273,7 +1279,7 @@ int main(int argc, const char **argv)
 	tester.get_output_utilization())
       tester.set_output_statistics(true);
 
-    int r = tester.test();
+    int r = bench_straw2 ? tester.bench_straw2() : tester.test();
     if (r < 0)
       return EXIT_FAILURE;
   }
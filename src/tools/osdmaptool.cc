@@ -12,16 +12,19 @@
  * 
  */
 
+#include <chrono>
 #include <string>
 #include <sys/stat.h>
 
 #include "common/ceph_argparse.h"
 #include "common/errno.h"
 #include "common/safe_io.h"
+#include "include/stringify.h"
 #include "mon/health_check.h"
 
 #include "global/global_init.h"
 #include "osd/OSDMap.h"
+#include "osd/OSDMapMapping.h"
 
 
 void usage()
@@ -55,9 +58,15 @@ void usage()
   cout << "                           max deviation from target [default: .01]" << std::endl;
   cout << "   --upmap-pool <poolname> restrict upmap balancing to 1 or more pools" << std::endl;
   cout << "   --upmap-save            write modified OSDMap with upmap changes" << std::endl;
+  cout << "   --bench-upmap           time the --upmap calculation with one thread and with" << std::endl;
+  cout << "                           osd_calc_pg_upmaps_threads, checking both agree" << std::endl;
   cout << "   --dump <format>         displays the map in plain text when <format> is 'plain', 'json' if specified format is not supported" << std::endl;
   cout << "   --tree                  displays a tree of the map" << std::endl;
   cout << "   --test-crush [--range-first <first> --range-last <last>] map pgs to acting osds" << std::endl;
+  cout << "   --bench-apply <epochs>  apply <epochs> synthetic incrementals, keeping every" << std::endl;
+  cout << "                           epoch, and report osdmap memory and apply latency" << std::endl;
+  cout << "   --bench-mapping <epochs> apply <epochs> synthetic incrementals and compare" << std::endl;
+  cout << "                           full and incremental pg mapping time per epoch" << std::endl;
   exit(1);
 }
 
@@ -92,6 +101,206 @@ void print_inc_upmaps(const OSDMap::Incremental& pending_inc, int fd)
   }
 }
 
+// Build <epochs> maps on top of base the way the OSD does (copy the
+// previous epoch, apply the incremental, dedup against the previous
+// epoch) and keep all of them, as a PG lagging behind would pin them.
+// Then decode the same epochs from their full encodings, which shares
+// nothing, for comparison.
+void bench_apply(const OSDMap& base, int epochs)
+{
+  typedef std::chrono::steady_clock clock;
+  int max_osd = base.get_max_osd();
+  int64_t poolid = base.get_pools().empty() ?
+    0 : base.get_pools().begin()->first;
+  if (max_osd < 2) {
+    cerr << "bench-apply needs a map with at least 2 osds" << std::endl;
+    exit(1);
+  }
+
+  size_t start_bytes = mempool::osdmap::allocated_bytes();
+  vector<std::shared_ptr<OSDMap>> maps;
+  vector<bufferlist> fulls;
+  auto prev = std::make_shared<OSDMap>();
+  prev->deepish_copy_from(base);
+  clock::duration apply = clock::duration::zero();
+  for (int e = 0; e < epochs; e++) {
+    // some pg_temp and up_thru churn, as peering and backfill cause
+    OSDMap::Incremental inc(prev->get_epoch() + 1);
+    inc.fsid = prev->get_fsid();
+    inc.new_pg_temp[pg_t(e, poolid)] = {e % max_osd, (e + 1) % max_osd};
+    if (e >= 64)
+      inc.new_pg_temp[pg_t(e - 64, poolid)].clear();
+    inc.new_up_thru[e % max_osd] = inc.epoch;
+
+    auto start = clock::now();
+    auto n = std::make_shared<OSDMap>();
+    n->deepish_copy_from(*prev);
+    int r = n->apply_incremental(inc);
+    ceph_assert(r == 0);
+    OSDMap::dedup(prev.get(), n.get());
+    apply += clock::now() - start;
+
+    fulls.emplace_back();
+    n->encode(fulls.back(), CEPH_FEATURES_SUPPORTED_DEFAULT);
+    maps.push_back(n);
+    prev = n;
+  }
+  size_t shared_bytes = mempool::osdmap::allocated_bytes() - start_bytes;
+  maps.clear();
+  prev.reset();
+
+  start_bytes = mempool::osdmap::allocated_bytes();
+  clock::duration decode = clock::duration::zero();
+  for (auto& bl : fulls) {
+    auto start = clock::now();
+    auto n = std::make_shared<OSDMap>();
+    n->decode(bl);
+    decode += clock::now() - start;
+    maps.push_back(n);
+  }
+  size_t full_bytes = mempool::osdmap::allocated_bytes() - start_bytes;
+  maps.clear();
+
+  auto usec = [epochs](clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count() / epochs;
+  };
+  cout << "bench-apply: " << epochs << " epochs on top of e"
+       << base.get_epoch() << ", " << max_osd << " osds\n"
+       << "  incremental: " << shared_bytes << " osdmap bytes ("
+       << shared_bytes / epochs << " per epoch), "
+       << usec(apply) << " us per epoch\n"
+       << "  full decode: " << full_bytes << " osdmap bytes ("
+       << full_bytes / epochs << " per epoch), "
+       << usec(decode) << " us per epoch" << std::endl;
+}
+
+// Time calc_pg_upmaps on a (typically recorded) map serially and with
+// osd_calc_pg_upmaps_threads threads.  A fixed seed makes both runs
+// shuffle the same way, so they must propose the same changes.
+void bench_upmap(const OSDMap& osdmap, float deviation, int max,
+		 const set<int64_t>& pools)
+{
+  typedef std::chrono::steady_clock clock;
+  auto threads = g_conf().get_val<uint64_t>("osd_calc_pg_upmaps_threads");
+  if (g_conf().get_val<uint64_t>("osd_calc_pg_upmaps_seed") == 0) {
+    g_conf().set_val_or_die("osd_calc_pg_upmaps_seed", "1");
+  }
+
+  OSDMap::Incremental incs[2];
+  double secs[2];
+  uint64_t runs[2] = {1, threads};
+  for (int r = 0; r < 2; ++r) {
+    g_conf().set_val_or_die("osd_calc_pg_upmaps_threads", stringify(runs[r]));
+    OSDMap tmp;
+    tmp.deepish_copy_from(osdmap);
+    incs[r].epoch = osdmap.get_epoch() + 1;
+    incs[r].fsid = osdmap.get_fsid();
+    auto start = clock::now();
+    tmp.calc_pg_upmaps(g_ceph_context, deviation, max, pools, &incs[r]);
+    secs[r] = std::chrono::duration<double>(clock::now() - start).count();
+  }
+  g_conf().set_val_or_die("osd_calc_pg_upmaps_threads", stringify(threads));
+
+  cout << "bench-upmap: " << osdmap.get_max_osd() << " osds, max-count "
+       << max << ", max deviation " << deviation << "\n"
+       << "  1 thread: " << secs[0] << "s, "
+       << incs[0].new_pg_upmap_items.size() << " upmaps, "
+       << incs[0].old_pg_upmap_items.size() << " removals\n"
+       << "  " << threads << " threads: " << secs[1] << "s, "
+       << incs[1].new_pg_upmap_items.size() << " upmaps, "
+       << incs[1].old_pg_upmap_items.size() << " removals" << std::endl;
+  if (incs[0].new_pg_upmap_items != incs[1].new_pg_upmap_items ||
+      incs[0].old_pg_upmap_items != incs[1].old_pg_upmap_items) {
+    cerr << "bench-upmap: serial and parallel runs proposed different changes"
+	 << std::endl;
+    exit(1);
+  }
+}
+
+// Apply <epochs> incrementals (reweights, osds going down and up, upmap
+// items) on top of base and time remapping every pg from scratch
+// against updating a mapping kept from the previous epoch.  For the
+// 10k osd case: --createsimple 10000 --with-default-pool --mark-up-in.
+void bench_mapping(const OSDMap& base, int epochs)
+{
+  typedef std::chrono::steady_clock clock;
+  int max_osd = base.get_max_osd();
+  if (max_osd < 2 || base.get_pools().empty()) {
+    cerr << "bench-mapping needs a map with at least 2 osds and a pool"
+	 << std::endl;
+    exit(1);
+  }
+  int64_t poolid = base.get_pools().begin()->first;
+  unsigned pg_num = base.get_pools().begin()->second.get_pg_num();
+
+  auto prev = std::make_shared<OSDMap>();
+  prev->deepish_copy_from(base);
+  OSDMapMapping mapping;
+  mapping.update(*prev);
+  clock::duration full = clock::duration::zero();
+  clock::duration incremental = clock::duration::zero();
+  for (int e = 0; e < epochs; e++) {
+    OSDMap::Incremental inc(prev->get_epoch() + 1);
+    inc.fsid = prev->get_fsid();
+    int osd = (e * 7) % max_osd;
+    switch (e % 3) {
+    case 0:
+      inc.new_weight[osd] = prev->get_weight(osd) == CEPH_OSD_IN ?
+	CEPH_OSD_IN / 2 : CEPH_OSD_IN;
+      break;
+    case 1:
+      inc.new_state[osd] = CEPH_OSD_UP;
+      break;
+    case 2:
+      inc.new_pg_upmap_items[pg_t(e % pg_num, poolid)] = {
+	{osd, (osd + 1) % max_osd}};
+      break;
+    }
+    auto n = std::make_shared<OSDMap>();
+    n->deepish_copy_from(*prev);
+    int r = n->apply_incremental(inc);
+    ceph_assert(r == 0);
+
+    auto start = clock::now();
+    OSDMapMapping scratch;
+    scratch.update(*n);
+    full += clock::now() - start;
+
+    start = clock::now();
+    mapping.update(*n);
+    incremental += clock::now() - start;
+
+    for (auto& p : n->get_pools()) {
+      for (unsigned ps = 0; ps < p.second.get_pg_num(); ++ps) {
+	pg_t pgid(ps, p.first);
+	vector<int> up, acting, sup, sacting;
+	int up_primary, acting_primary, sup_primary, sacting_primary;
+	mapping.get(pgid, &up, &up_primary, &acting, &acting_primary);
+	scratch.get(pgid, &sup, &sup_primary, &sacting, &sacting_primary);
+	if (up != sup || up_primary != sup_primary ||
+	    acting != sacting || acting_primary != sacting_primary) {
+	  cerr << "bench-mapping: e" << n->get_epoch() << " " << pgid
+	       << " maps to " << up << "/" << acting
+	       << " incrementally, " << sup << "/" << sacting
+	       << " from scratch" << std::endl;
+	  ceph_abort();
+	}
+      }
+    }
+    prev = n;
+  }
+
+  auto usec = [epochs](clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count() / epochs;
+  };
+  cout << "bench-mapping: " << epochs << " epochs on top of e"
+       << base.get_epoch() << ", " << max_osd << " osds, "
+       << mapping.get_num_pgs() << " pgs\n"
+       << "  full: " << usec(full) << " us per epoch\n"
+       << "  incremental: " << usec(incremental) << " us per epoch"
+       << std::endl;
+}
+
 int main(int argc, const char **argv)
 {
   vector<const char*> args;
@@ -146,6 +355,9 @@ int main(int argc, const char **argv)
   std::set<std::string> upmap_pools;
   int64_t pg_num = -1;
   bool test_map_pgs_dump_all = false;
+  int bench_epochs = 0;
+  int bench_mapping_epochs = 0;
+  bool bench_upmap_calc = false;
 
   std::string val;
   std::ostringstream err;
@@ -234,6 +446,18 @@ int main(int argc, const char **argv)
       }
     } else if (ceph_argparse_witharg(args, i, &range_first, err, "--range_first", (char*)NULL)) {
     } else if (ceph_argparse_witharg(args, i, &range_last, err, "--range_last", (char*)NULL)) {
+    } else if (ceph_argparse_witharg(args, i, &bench_epochs, err, "--bench-apply", (char*)NULL)) {
+      if (!err.str().empty() || bench_epochs < 1) {
+	cerr << "--bench-apply needs a number of epochs > 0" << std::endl;
+	exit(EXIT_FAILURE);
+      }
+    } else if (ceph_argparse_flag(args, i, "--bench-upmap", (char*)NULL)) {
+      bench_upmap_calc = true;
+    } else if (ceph_argparse_witharg(args, i, &bench_mapping_epochs, err, "--bench-mapping", (char*)NULL)) {
+      if (!err.str().empty() || bench_mapping_epochs < 1) {
+	cerr << "--bench-mapping needs a number of epochs > 0" << std::endl;
+	exit(EXIT_FAILURE);
+      }
     } else if (ceph_argparse_witharg(args, i, &pool, err, "--pool", (char*)NULL)) {
       if (!err.str().empty()) {
         cerr << err.str() << std::endl;
@@ -406,6 +630,18 @@ int main(int argc, const char **argv)
   if (upmap_file != "-") {
     ::close(upmap_fd);
   }
+  if (bench_upmap_calc) {
+    set<int64_t> pools;
+    for (auto& s : upmap_pools) {
+      int64_t p = osdmap.lookup_pg_pool_name(s);
+      if (p < 0) {
+	cerr << " pool '" << s << "' does not exist" << std::endl;
+	exit(1);
+      }
+      pools.insert(p);
+    }
+    bench_upmap(osdmap, upmap_deviation, upmap_max, pools);
+  }
 
   if (!import_crush.empty()) {
     bufferlist cbl;
@@ -645,11 +881,19 @@ int main(int argc, const char **argv)
     }
   }
 
+  if (bench_epochs > 0) {
+    bench_apply(osdmap, bench_epochs);
+  }
+  if (bench_mapping_epochs > 0) {
+    bench_mapping(osdmap, bench_mapping_epochs);
+  }
+
   if (!print && !health && !tree && !modified &&
       export_crush.empty() && import_crush.empty() && 
       test_map_pg.empty() && test_map_object.empty() &&
       !test_map_pgs && !test_map_pgs_dump && !test_map_pgs_dump_all &&
-      !upmap && !upmap_cleanup) {
+      !upmap && !upmap_cleanup && !bench_epochs && !bench_mapping_epochs &&
+      !bench_upmap_calc) {
     cerr << me << ": no action specified?" << std::endl;
     usage();
   }